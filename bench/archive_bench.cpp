@@ -0,0 +1,56 @@
+/**
+ * @file    archive_bench.cpp
+ * @brief   Startup cost of a monolithic store versus the hot file of a tiered
+ *          one, and how well the cold archive compresses.
+ *
+ * Usage: ./archive_bench [num_tasks]
+ */
+
+#include "bench.hpp"
+#include "task_file.hpp"
+#include "task_manager.hpp"
+#include <cstdlib>
+#include <filesystem>
+
+using namespace std;
+
+static void remove_store(const string &path) {
+  for (const string &file :
+       {path, index_path(path), search_path(path), tombstone_path(path), lock_path(path), archive_path(path)})
+    filesystem::remove(file);
+}
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  auto tmp = filesystem::temp_directory_path();
+  string mono = (tmp / "archive_bench_mono.json").string(), tiered = (tmp / "archive_bench.json").string();
+  auto mib = [](uint64_t bytes) { return bytes / (1024.0 * 1024.0); };
+
+  printf("%d tasks\n", n);
+  printf("pending   mono MiB   load ms |  hot MiB   load ms | cold MiB  ratio  archive ms   save ms\n");
+  for (double pending : {0.7, 0.3, 0.05}) {
+    remove_store(tiered);
+    bench::write_store(mono, n, 42, pending);
+
+    TaskManager all;
+    double mono_ms = bench::time_ms([&] { all.loadFromFile(mono); });
+    double save_ms = bench::time_ms([&] { all.saveToFile(tiered); });
+
+    TaskManager hot;
+    double hot_ms = bench::time_ms([&] { hot.loadFromFile(tiered); });
+    double cold_ms = bench::time_ms([&] { hot.loadArchive(tiered); });
+
+    // Cold records as they would sit uncompressed, against the archive
+    string raw;
+    for (const auto &task : read_archive(archive_path(tiered)).tasks)
+      write_record(raw, *task, false);
+    uint64_t cold_bytes = filesystem::file_size(archive_path(tiered));
+    printf("%6.0f%% %10.1f %9.1f | %8.1f %9.1f | %8.1f %5.1fx %11.1f %9.1f\n", pending * 100,
+           mib(filesystem::file_size(mono)), mono_ms, mib(filesystem::file_size(tiered)), hot_ms, mib(cold_bytes),
+           double(raw.size()) / cold_bytes, cold_ms, save_ms);
+  }
+
+  filesystem::remove(mono);
+  remove_store(tiered);
+  return 0;
+}
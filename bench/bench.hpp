@@ -0,0 +1,74 @@
+/**
+ * @file    bench.hpp
+ * @brief   Tiny header-only helpers shared by the micro-benchmarks in bench/.
+ *
+ * Each source under bench/ builds into its own executable. They are not registered
+ * with CTest; run them by hand from a Release build.
+ */
+
+#pragma once
+#include "task.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+
+namespace bench {
+
+/**
+ * @brief   Run a callable once and return the elapsed wall time.
+ * @param   fn  Work to time.
+ * @return  Milliseconds taken.
+ */
+template <typename Fn>
+double time_ms(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+/**
+ * @brief   Write a synthetic store in the same JSON layout TaskManager::saveToFile uses.
+ *          Priorities are uniform and due dates spread over -30..+60 days so aging
+ *          produces plenty of ties.
+ * @param   path     File to (over)write.
+ * @param   n        Number of tasks.
+ * @param   seed     RNG seed so runs are comparable.
+ * @param   pending  Share of pending tasks; the rest are completed and
+ *                   archived two to one.
+ */
+inline void write_store(const std::string &path, int n, unsigned seed = 42, double pending = 0.7) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> pr_dist(0, 3);
+  std::uniform_int_distribution<int> due_dist(-30, 60);
+  std::uniform_real_distribution<double> status_dist(0.0, 1.0);
+  const double completed = pending + (1.0 - pending) * 2 / 3;
+  const auto today = std::chrono::sys_days{get_today()};
+
+  std::ofstream out(path);
+  out << "{\n\t\"tasks\": [\n";
+  for (int id = 1; id <= n; ++id) {
+    out << "\t\t{\n";
+    out << "\t\t\t\"id\": " << id << ",\n";
+    out << "\t\t\t\"title\": \"Task number " << id << "\",\n";
+    out << "\t\t\t\"priority\": " << pr_dist(rng) << ",\n";
+    int offset = due_dist(rng);
+    if (offset % 4 == 0) {
+      out << "\t\t\t\"due\": null,\n";
+    } else {
+      ymd due{today + std::chrono::days{offset}};
+      char buf[16];
+      std::snprintf(buf, sizeof buf, "%04d-%02u-%02u", int(due.year()),
+                    unsigned(due.month()), unsigned(due.day()));
+      out << "\t\t\t\"due\": \"" << buf << "\",\n";
+    }
+    double roll = status_dist(rng);
+    out << "\t\t\t\"status\": " << (roll < pending ? 0 : roll < completed ? 1 : 2) << "\n";
+    out << "\t\t}" << (id < n ? "," : "") << "\n";
+  }
+  out << "\t]\n}";
+}
+
+} // namespace bench
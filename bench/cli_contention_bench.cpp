@@ -0,0 +1,67 @@
+/**
+ * @file    cli_contention_bench.cpp
+ * @brief   Many `todo add` processes against one store at once: throughput,
+ *          and a check that no add was lost to a racing save.
+ *
+ * Each process runs the CLI's add command in a loop, exactly as separate
+ * `todo` invocations would (load, add, optimistic save, re-apply under the
+ * lock on conflict).
+ *
+ * Usage: ./cli_contention_bench [max_processes] [adds_per_process]
+ */
+
+#include "bench.hpp"
+#include "task_cli.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  int max_procs = argc > 1 ? atoi(argv[1]) : 256;
+  int adds = argc > 2 ? atoi(argv[2]) : 4;
+
+  filesystem::path dir = filesystem::temp_directory_path() / ("cli_contention_" + to_string(getpid()));
+  printf("%d adds per process\n", adds);
+  printf("procs    adds/s      stored/expected\n");
+
+  for (int procs = 1; procs <= max_procs; procs *= 4) {
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+    filesystem::current_path(dir);
+    MAX_TASKS = procs * adds + 1;
+    fflush(stdout); // children would flush our buffered lines again
+
+    double ms = bench::time_ms([&] {
+      vector<pid_t> children;
+      for (int p = 0; p < procs; ++p) {
+        pid_t pid = fork();
+        if (pid == 0) {
+          freopen("/dev/null", "w", stdout);
+          freopen("/dev/null", "w", stderr);
+          for (int i = 0; i < adds; ++i) {
+            string title = "proc " + to_string(p) + " add " + to_string(i);
+            char *args[] = {(char *)"todo", (char *)"add", title.data()};
+            TaskCLI().run(3, args);
+          }
+          _exit(0);
+        }
+        children.push_back(pid);
+      }
+      for (pid_t pid : children)
+        waitpid(pid, nullptr, 0);
+    });
+
+    TaskManager mgr;
+    mgr.loadFromFile(STORE_FILE);
+    printf("%5d  %9.0f      %zu/%d%s\n", procs, procs * adds * 1000.0 / ms, mgr.size(), procs * adds,
+           mgr.size() == size_t(procs * adds) ? "" : "  LOST UPDATES");
+  }
+
+  filesystem::current_path(filesystem::temp_directory_path());
+  filesystem::remove_all(dir);
+  return 0;
+}
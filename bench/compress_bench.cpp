@@ -0,0 +1,56 @@
+/**
+ * @file    compress_bench.cpp
+ * @brief   Plain versus block-compressed tasks.json: file size, save time,
+ *          and load throughput (as uncompressed MiB/s) per parser thread count.
+ *
+ * Usage: ./compress_bench [num_tasks]
+ */
+
+#include "bench.hpp"
+#include "task_file.hpp"
+#include "task_manager.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <thread>
+
+using namespace std;
+
+static void remove_store(const string &path) {
+  for (const string &file :
+       {path, index_path(path), search_path(path), tombstone_path(path), lock_path(path), archive_path(path)})
+    filesystem::remove(file);
+}
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  auto tmp = filesystem::temp_directory_path();
+  string source = (tmp / "compress_bench_src.json").string(), plain = (tmp / "compress_bench.json").string(),
+         packed = (tmp / "compress_bench_z.json").string();
+  bench::write_store(source, n, 42, 1.0);
+
+  TaskManager mgr;
+  mgr.loadFromFile(source);
+  double plain_save = bench::time_ms([&] { mgr.saveToFile(plain); });
+  mgr.setCompressed(true);
+  double packed_save = bench::time_ms([&] { mgr.saveToFile(packed); });
+
+  double raw_mib = filesystem::file_size(plain) / (1024.0 * 1024.0);
+  double packed_mib = filesystem::file_size(packed) / (1024.0 * 1024.0);
+  printf("%d tasks: plain %.1f MiB, compressed %.1f MiB (%.1fx), %u hardware threads\n", n, raw_mib, packed_mib,
+         raw_mib / packed_mib, thread::hardware_concurrency());
+  printf("save ms: plain %.1f, compressed %.1f\n", plain_save, packed_save);
+  printf("threads   plain ms   MiB/s | compressed ms   MiB/s\n");
+
+  for (unsigned threads : {1u, 2u, 4u, 8u}) {
+    TaskManager a, b;
+    double plain_ms = bench::time_ms([&] { a.loadFromFile(plain, threads); });
+    double packed_ms = bench::time_ms([&] { b.loadFromFile(packed, threads); });
+    printf("%7u %10.1f %7.1f | %13.1f %7.1f\n", threads, plain_ms, raw_mib / (plain_ms / 1000.0), packed_ms,
+           raw_mib / (packed_ms / 1000.0));
+  }
+
+  filesystem::remove(source);
+  remove_store(plain);
+  remove_store(packed);
+  return 0;
+}
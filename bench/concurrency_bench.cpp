@@ -0,0 +1,88 @@
+/**
+ * @file    concurrency_bench.cpp
+ * @brief   Mixed read/write throughput against one shared TaskManager as the
+ *          number of threads grows from 1 to 32.
+ *
+ * Each thread performs ~90% reads (top-10, count, lookup) and ~10% writes
+ * (complete, archive, add + remove) for a fixed wall-clock window.
+ *
+ * Usage: ./concurrency_bench [num_tasks] [millis_per_run]
+ */
+
+#include "bench.hpp"
+#include "task_manager.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <thread>
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 20000;
+  int millis = argc > 2 ? atoi(argv[2]) : 500;
+
+  string path = (filesystem::temp_directory_path() / "concurrency_bench.json").string();
+  bench::write_store(path, n);
+
+  printf("%d tasks, %d ms per run, %u hardware threads\n", n, millis, thread::hardware_concurrency());
+  printf("threads    reads/s     writes/s\n");
+
+  for (int threads : {1, 2, 4, 8, 16, 32}) {
+    TaskManager mgr;
+    mgr.loadFromFile(path);
+    mgr.setTaskLimit(SIZE_MAX);
+
+    atomic<bool> stop{false};
+    atomic<long> reads{0}, writes{0};
+    vector<thread> pool;
+
+    for (int t = 0; t < threads; ++t) {
+      pool.emplace_back([&, t] {
+        mt19937 rng(t);
+        uniform_int_distribution<int> id_dist(1, n);
+        long r = 0, w = 0;
+        for (int i = 0; !stop; ++i) {
+          int id = id_dist(rng);
+          switch (i % 20) {
+          case 0:
+            mgr.completeTask(id);
+            ++w;
+            break;
+          case 10: {
+            int added = mgr.addTask("bench " + to_string(t) + "-" + to_string(i));
+            mgr.removeTask(added);
+            w += 2;
+            break;
+          }
+          case 5:
+          case 15:
+            mgr.topTasks(10);
+            ++r;
+            break;
+          case 1:
+            mgr.count(Status::Pending);
+            ++r;
+            break;
+          default:
+            mgr.getTask(id);
+            ++r;
+          }
+        }
+        reads += r;
+        writes += w;
+      });
+    }
+
+    this_thread::sleep_for(chrono::milliseconds(millis));
+    stop = true;
+    for (auto &th : pool)
+      th.join();
+
+    double secs = millis / 1000.0;
+    printf("%7d %10.0f %12.0f\n", threads, reads / secs, writes / secs);
+  }
+
+  filesystem::remove(path);
+  return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file    edit_bench.cpp
+ * @brief   Cost of one edit: in-place re-rank (updateTask) versus re-keying
+ *          and heapifying the whole store, and writing just the edited record
+ *          to the journal versus saving the whole file.
+ *
+ * Usage: ./edit_bench [num_tasks] [edits]
+ */
+
+#include "bench.hpp"
+#include "task_file.hpp"
+#include "task_manager.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+
+using namespace std;
+
+static void remove_store(const string &path) {
+  for (const string &file : {path, index_path(path), search_path(path), tombstone_path(path), lock_path(path),
+                             archive_path(path), journal_path(path), stats_path(path),
+                             history_path(path)})
+    filesystem::remove(file);
+}
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  int edits = argc > 2 ? atoi(argv[2]) : 100000;
+  string path = (filesystem::temp_directory_path() / "edit_bench.json").string();
+  remove_store(path);
+  bench::write_store(path, n, 42, 1.0);
+
+  TaskManager mgr;
+  mgr.loadFromFile(path);
+  mt19937 rng(7);
+  double update_ms = bench::time_ms([&] {
+    for (int i = 0; i < edits; ++i)
+      mgr.updateTask(static_cast<int>(rng() % n) + 1, {nullopt, static_cast<Priority>(rng() % 4), nullopt});
+  });
+  double rebuild_ms = bench::time_ms([&] { mgr.setReferenceDay(get_today()); });
+  printf("%d tasks: updateTask %.3f us/edit, re-key + heapify %.1f ms (%.0fx)\n", n, update_ms * 1000.0 / edits,
+         rebuild_ms, rebuild_ms / (update_ms / edits));
+
+  // Persisting: the journal only grows by one record per edit
+  TaskManager store;
+  store.loadFromFile(path);
+  store.saveIfUnchanged(path); // writes the id index the journal path needs
+  int journalled = 100;
+  double record_ms = bench::time_ms([&] {
+    for (int i = 0; i < journalled; ++i) {
+      int id = static_cast<int>(rng() % n) + 1;
+      store.updateTask(id, {nullopt, static_cast<Priority>(rng() % 4), nullopt});
+      store.saveTaskIfUnchanged(path, id);
+    }
+  });
+  double full_ms = bench::time_ms([&] { store.saveIfUnchanged(path); });
+  printf("save one edit: journal %.3f ms, whole file %.1f ms (%.0fx)\n", record_ms / journalled, full_ms,
+         full_ms / (record_ms / journalled));
+
+  remove_store(path);
+  return 0;
+}
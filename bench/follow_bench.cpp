@@ -0,0 +1,85 @@
+/**
+ * @file    follow_bench.cpp
+ * @brief   What a long-running reader pays to catch up with another
+ *          process's writes: StoreFollower's journal tail and record diff
+ *          against loading the whole store again.
+ *
+ * Usage: ./follow_bench [num_tasks] [edits]
+ */
+
+#include "bench.hpp"
+#include "store_follower.hpp"
+#include "task_file.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+
+using namespace std;
+
+static void remove_store(const string &path) {
+  for (const string &file : {path, index_path(path), search_path(path), tombstone_path(path), lock_path(path),
+                             archive_path(path), journal_path(path), stats_path(path), history_path(path)})
+    filesystem::remove(file);
+}
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  int edits = argc > 2 ? atoi(argv[2]) : 100;
+  string path = (filesystem::temp_directory_path() / "follow_bench.json").string();
+  remove_store(path);
+  bench::write_store(path, n, 42, 1.0);
+
+  TaskManager writer;
+  writer.loadFromFile(path);
+  writer.saveIfUnchanged(path); // adds the header fields and the id index
+
+  StoreFollower follower(path);
+  TaskManager reader;
+  double load_ms = bench::time_ms([&] { follower.load(reader); });
+  printf("%d tasks: load and fingerprint %.0f ms\n", n, load_ms);
+
+  double full_ms = bench::time_ms([&] {
+    TaskManager again;
+    again.loadFromFile(path);
+  });
+  printf("full reload: %.0f ms\n", full_ms);
+
+  // One journaled edit per refresh
+  mt19937 rng(7);
+  double journal_ms = 0;
+  size_t parsed = 0;
+  for (int i = 0; i < edits; ++i) {
+    int id = static_cast<int>(rng() % n) + 1;
+    writer.updateTask(id, {nullopt, static_cast<Priority>(rng() % 4), nullopt});
+    writer.saveTaskIfUnchanged(path, id);
+    journal_ms += bench::time_ms([&] { parsed += follower.refresh(reader).parsed; });
+  }
+  printf("journal tail: %.3f ms/refresh (%zu records parsed) (%.0fx)\n", journal_ms / edits, parsed,
+         full_ms / (journal_ms / edits));
+
+  // One status patched in place per refresh
+  double patch_ms = 0;
+  parsed = 0;
+  for (int i = 0; i < edits; ++i) {
+    TaskManager::patchStatus(path, static_cast<int>(rng() % n) + 1, Status::Archived);
+    patch_ms += bench::time_ms([&] { parsed += follower.refresh(reader).parsed; });
+  }
+  printf("record diff after a patch: %.1f ms/refresh (%zu records parsed) (%.1fx)\n", patch_ms / edits, parsed,
+         full_ms / (patch_ms / edits));
+
+  // A full save after a batch of edits
+  TaskManager saver;
+  saver.loadFromFile(path);
+  for (int i = 0; i < edits; ++i)
+    saver.updateTask(static_cast<int>(rng() % n) + 1, {nullopt, static_cast<Priority>(rng() % 4), nullopt});
+  saver.saveToFile(path);
+  StoreFollower::Refresh step;
+  double save_ms = bench::time_ms([&] { step = follower.refresh(reader); });
+  printf("record diff after a full save: %.0f ms (%zu records parsed) (%.1fx)\n", save_ms, step.parsed,
+         full_ms / save_ms);
+
+  double idle_ms = bench::time_ms([&] { follower.refresh(reader); });
+  printf("refresh with nothing new: %.3f ms\n", idle_ms);
+  remove_store(path);
+  return 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file    history_bench.cpp
+ * @brief   Size of the columnar history per event, the cost of appending a
+ *          save's worth of transitions, and `todo report` over years of it.
+ *
+ * Usage: ./history_bench [events] [events_per_save]
+ */
+
+#include "bench.hpp"
+#include "task_history.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+
+using namespace std;
+using namespace std::chrono;
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 2000000;
+  int batch = argc > 2 ? atoi(argv[2]) : 20;
+  string path = (filesystem::temp_directory_path() / "history_bench.history").string();
+  filesystem::remove(path);
+
+  // About five years of a busy store: tasks are created, then most are
+  // completed or archived a few hours to a few weeks later
+  sys_days today = floor<days>(system_clock::now());
+  int64_t start = duration_cast<seconds>((today - days{5 * 365}).time_since_epoch()).count();
+  int64_t step = 5 * 365 * 86400LL / n;
+  mt19937 rng(42);
+  vector<HistoryEvent> events;
+  events.reserve(n);
+  vector<int> open;
+  int next_id = 1;
+  for (int i = 0; i < n; ++i) {
+    int64_t at = start + i * step;
+    if (open.size() < 50 || rng() % 2 == 0) {
+      open.push_back(next_id);
+      events.push_back({at, next_id++, HistoryKind::Created, static_cast<Priority>(rng() % 4), true});
+      continue;
+    }
+    size_t pick = rng() % open.size();
+    HistoryKind kind = rng() % 5 == 0 ? HistoryKind::Archived : HistoryKind::Completed;
+    events.push_back({at, open[pick], kind, static_cast<Priority>(rng() % 4), true});
+    open[pick] = open.back();
+    open.pop_back();
+  }
+
+  double append_ms = bench::time_ms([&] {
+    for (size_t i = 0; i < events.size(); i += batch)
+      append_history(path, span{events}.subspan(i, min<size_t>(batch, events.size() - i)));
+  });
+  uintmax_t bytes = filesystem::file_size(path);
+  size_t saves = (events.size() + batch - 1) / batch;
+  printf("%d events in %zu saves: %.2f MB (%.2f bytes/event), append %.1f us/save\n", n, saves,
+         static_cast<double>(bytes) / 1e6, static_cast<double>(bytes) / n, append_ms * 1000.0 / saves);
+
+  size_t seen = 0;
+  double scan_ms = bench::time_ms([&] { seen = scan_history(path, [](const HistoryEvent &) {}); });
+  printf("scan: %.1f ms (%.1f M events/s)%s\n", scan_ms, seen / scan_ms / 1000.0,
+         seen == events.size() ? "" : "  MISMATCH");
+
+  for (int window : {30, 365, 5 * 365}) {
+    HistoryReport report;
+    double report_ms = bench::time_ms([&] { report = build_report(path, today - days{window - 1}, today, open.size()); });
+    size_t done = 0;
+    for (const vector<double> &hours : report.lead_hours)
+      done += hours.size();
+    printf("report over %4d days: %.1f ms (%zu completions)\n", window, report_ms, done);
+  }
+
+  filesystem::remove(path);
+  return 0;
+}
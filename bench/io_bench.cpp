@@ -0,0 +1,98 @@
+/**
+ * @file    io_bench.cpp
+ * @brief   Store load and save through the coroutine I/O layer, on io_uring
+ *          and on the worker-thread fallback, with the page cache dropped
+ *          and warm. Reading alone, and reading then parsing with nothing
+ *          overlapped, show how much of a load the I/O is.
+ *
+ * Usage: ./io_bench [num_tasks]
+ */
+
+#include "async_io.hpp"
+#include "bench.hpp"
+#include "task_file.hpp"
+#include "task_manager.hpp"
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <unistd.h>
+
+using namespace std;
+
+static void remove_store(const string &path) {
+  for (const string &file : {path, index_path(path), search_path(path), tombstone_path(path), lock_path(path),
+                             archive_path(path), journal_path(path), stats_path(path), history_path(path)})
+    filesystem::remove(file);
+}
+
+/**
+ * @brief  Drop the store's pages from the cache so the next read goes to disk.
+ */
+static void drop_cache(const string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  fdatasync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+}
+
+/**
+ * @brief  One pread of the whole file, then (if `parse`) one parse: nothing
+ *         overlaps.
+ */
+static void read_then_parse(const string &path, bool parse) {
+  int fd = open(path.c_str(), O_RDONLY);
+  string text(filesystem::file_size(path), '\0');
+  for (size_t at = 0; at < text.size();) {
+    ssize_t n = pread(fd, text.data() + at, text.size() - at, static_cast<off_t>(at));
+    if (n <= 0)
+      break;
+    at += static_cast<size_t>(n);
+  }
+  close(fd);
+  vector<unique_ptr<Task>> tasks;
+  if (parse)
+    parse_records(text, tasks);
+}
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  string path = (filesystem::temp_directory_path() / "io_bench.json").string();
+  remove_store(path);
+  bench::write_store(path, n);
+  {
+    TaskManager mgr;
+    mgr.loadFromFile(path);
+    mgr.saveToFile(path); // current layout, with the header fields
+  }
+  double mb = filesystem::file_size(path) / (1024.0 * 1024.0);
+  printf("%d tasks, %.1f MiB, io_uring %s\n", n, mb, IoRing{}.kernel() ? "available" : "unavailable");
+  printf("%-22s %10s %10s\n", "load (1 thread)", "cold ms", "warm ms");
+
+  auto row = [&](const char *name, auto &&load) {
+    drop_cache(path);
+    double cold = bench::time_ms(load);
+    double warm = bench::time_ms(load);
+    printf("%-22s %10.1f %10.1f\n", name, cold, warm);
+  };
+  row("read only", [&] { read_then_parse(path, false); });
+  row("read, then parse", [&] { read_then_parse(path, true); });
+  for (const char *mode : {"", "threads"}) {
+    setenv("TODO_IO", mode, 1);
+    row(*mode ? "load, threads" : "load, io_uring", [&] {
+      TaskManager mgr;
+      mgr.loadFromFile(path, 1);
+    });
+  }
+
+  printf("%-22s %10s\n", "", "ms");
+  TaskManager mgr;
+  mgr.loadFromFile(path);
+  for (const char *mode : {"", "threads"}) {
+    setenv("TODO_IO", mode, 1);
+    double ms = bench::time_ms([&] { mgr.saveToFile(path); });
+    printf("%-22s %10.1f\n", *mode ? "save, threads" : "save, io_uring", ms);
+  }
+  unsetenv("TODO_IO");
+  remove_store(path);
+  return 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file    list_bench.cpp
+ * @brief   `todo list` inner loops: the old runtime-branching path (copy the
+ *          heap, pop until K matches with a per-task filter switch, stream each
+ *          row through switch-built strings) vs. the specialised kernels in
+ *          list_kernel.hpp.
+ *
+ * Usage: ./list_bench [num_tasks]
+ */
+
+#include "bench.hpp"
+#include "list_kernel.hpp"
+#include "task_manager.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace legacy {
+
+bool matches(const Task &task, Status filter) {
+  switch (filter) {
+  case Status::All:
+    return true;
+  default:
+    return task.state == filter;
+  }
+}
+
+struct PriorityCmp {
+  bool operator()(const Task *a, const Task *b) const { return a->sort_key < b->sort_key; }
+};
+
+vector<const Task *> collect_top(const vector<Task *> &heap, Status filter, size_t k) {
+  vector<const Task *> list;
+  vector<Task *> heap_copy = heap;
+  while (!heap_copy.empty() && list.size() < k) {
+    pop_heap(heap_copy.begin(), heap_copy.end(), PriorityCmp{});
+    Task *t = heap_copy.back();
+    heap_copy.pop_back();
+    if (matches(*t, filter))
+      list.push_back(t);
+  }
+  return list;
+}
+
+string status(Status s) {
+  switch (s) {
+  case Status::Archived:
+    return "ARCHIVED";
+  case Status::Pending:
+    return "PENDING";
+  case Status::Completed:
+    return "COMPLETED";
+  default:
+    return "---";
+  }
+}
+
+void print_rows(ostream &out, const vector<const Task *> &list) {
+  for (const Task *task : list) {
+    out << "[" << task->id << "]  " << status(task->state) << "\t" << print_priority(task->pr) << "   ";
+    if (!task->due.has_value()) {
+      out << "None\t\t\t";
+    } else {
+      bool over = is_overdue(*task, get_today());
+      out << to_string(task->due.value()) << ' ' << (over ? RED : GREEN) << '(' << (over ? "" : "+")
+          << task->days_until_due() << "d)\t";
+    }
+    out << RESET << truncate(task->title) << endl;
+  }
+}
+
+} // namespace legacy
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+
+  mt19937 rng(5);
+  uniform_int_distribution<int> pr(0, 3), state(0, 9), offset(-30, 60);
+  sys_days today{get_today()};
+  vector<Task> store;
+  store.reserve(n);
+  for (int id = 1; id <= n; ++id) {
+    optional<ymd> due;
+    if (id % 3)
+      due = ymd{today + days{offset(rng)}};
+    Task &t = store.emplace_back(id, "task number " + to_string(id), Priority(pr(rng)), due);
+    int s = state(rng); // ~30% pending, the rest completed or archived
+    t.state = s < 3 ? Status::Pending : s < 8 ? Status::Completed : Status::Archived;
+    t.sort_key = TaskManager::make_sort_key(t, today, kRecentThreshold);
+  }
+  vector<Task *> heap;
+  for (auto &t : store)
+    heap.push_back(&t);
+  make_heap(heap.begin(), heap.end(), legacy::PriorityCmp{});
+
+  printf("%d tasks\n\n%-10s %-8s %12s %12s %8s\n", n, "filter", "limit", "legacy ms", "kernel ms", "speedup");
+  for (Status filter : {Status::Pending, Status::Archived, Status::All}) {
+    for (size_t limit : {size_t(20), SIZE_MAX}) {
+      size_t a = 0, b = 0;
+      double slow = bench::time_ms([&] { a = legacy::collect_top(heap, filter, limit).size(); });
+      double fast = bench::time_ms([&] { b = select_ranked(heap, filter, limit).size(); });
+      printf("%-10s %-8s %12.1f %12.1f %7.1fx%s\n", string(status_name(filter)).c_str(),
+             limit == SIZE_MAX ? "all" : "20", slow, fast, slow / fast, a == b ? "" : "  MISMATCH");
+    }
+  }
+
+  // Row rendering for a full pending listing
+  auto rows = select_ranked(heap, Status::Pending, SIZE_MAX);
+  ostringstream sink;
+  double slow = bench::time_ms([&] { legacy::print_rows(sink, rows); });
+  string body;
+  double fast = bench::time_ms([&] {
+    for (const Task *t : rows)
+      append_row(body, *t, today);
+  });
+  printf("\nformat %zu rows: legacy %.1f ms, kernel %.1f ms (%.1fx)%s\n", rows.size(), slow, fast, slow / fast,
+         sink.str().size() == body.size() ? "" : "  MISMATCH");
+  return 0;
+}
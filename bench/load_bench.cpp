@@ -0,0 +1,33 @@
+/**
+ * @file    load_bench.cpp
+ * @brief   Cold-start load time of a large store for 1, 2, 4 and 8 parser threads.
+ *
+ * Usage: ./load_bench [num_tasks]
+ */
+
+#include "bench.hpp"
+#include "task_manager.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <thread>
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  string path = (filesystem::temp_directory_path() / "load_bench.json").string();
+  bench::write_store(path, n);
+
+  double mb = filesystem::file_size(path) / (1024.0 * 1024.0);
+  printf("%d tasks, %.1f MiB, %u hardware threads\n", n, mb, thread::hardware_concurrency());
+  printf("threads    load ms     MiB/s\n");
+
+  for (unsigned threads : {1u, 2u, 4u, 8u}) {
+    TaskManager mgr;
+    double ms = bench::time_ms([&] { mgr.loadFromFile(path, threads); });
+    printf("%7u %10.1f %9.1f\n", threads, ms, mb / (ms / 1000.0));
+  }
+
+  filesystem::remove(path);
+  return 0;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file    merge_bench.cpp
+ * @brief   `todo merge` of two diverged copies of a large store, in both
+ *          directions, and whether they converge.
+ *
+ * Usage: ./merge_bench [num_tasks]
+ */
+
+#include "bench.hpp"
+#include "task_file.hpp"
+#include "task_manager.hpp"
+#include <cstdlib>
+#include <filesystem>
+
+using namespace std;
+
+/**
+ * @brief  Both sides complete, archive, remove and add different tasks.
+ */
+static void diverge(TaskManager &mgr, int n, int side) {
+  mgr.setTaskLimit(SIZE_MAX);
+  for (int id = 1 + side; id <= n; id += 10)
+    side ? mgr.archiveTask(id) : mgr.completeTask(id);
+  for (int id = 3 + side; id <= n; id += 2000)
+    mgr.removeTask(id);
+  for (int i = 0; i < n / 20; ++i)
+    mgr.addTask("Side " + to_string(side) + " task " + to_string(i));
+}
+
+static void remove_store(const string &path) {
+  for (const string &file :
+       {path, index_path(path), search_path(path), tombstone_path(path), lock_path(path), archive_path(path)})
+    filesystem::remove(file);
+}
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  auto tmp = filesystem::temp_directory_path();
+  string base = (tmp / "merge_bench.json").string(), left = (tmp / "merge_left.json").string(),
+         right = (tmp / "merge_right.json").string();
+  bench::write_store(base, n);
+
+  TaskManager a, b;
+  a.loadFromFile(base);
+  b.loadFromFile(base);
+  diverge(a, n, 0);
+  diverge(b, n, 1);
+  a.saveToFile(left);
+  b.saveToFile(right);
+  printf("%d base tasks; sides hold %zu and %zu\n", n, a.size(), b.size());
+
+  optional<TaskManager::MergeStats> into_a, into_b;
+  double a_ms = bench::time_ms([&] { into_a = a.mergeFile(right); });
+  double b_ms = bench::time_ms([&] { into_b = b.mergeFile(left); });
+
+  printf("direction   merge ms     added   updated   removed\n");
+  printf("A <- B    %10.1f %9zu %9zu %9zu\n", a_ms, into_a->added, into_a->updated, into_a->removed);
+  printf("B <- A    %10.1f %9zu %9zu %9zu\n", b_ms, into_b->added, into_b->updated, into_b->removed);
+  printf("converged: %s (%zu vs %zu tasks, %zu vs %zu completed)\n",
+         a.size() == b.size() && a.count(Status::Completed) == b.count(Status::Completed) ? "yes" : "NO", a.size(),
+         b.size(), a.count(Status::Completed), b.count(Status::Completed));
+
+  for (const string &path : {base, left, right})
+    remove_store(path);
+  return 0;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file    page_bench.cpp
+ * @brief   `todo list --limit N --after CURSOR` at increasing depth: seeking
+ *          the ranked store for the cursor and reading one page, versus
+ *          loading the whole store and selecting below the cursor in memory.
+ *
+ * Usage: ./page_bench [num_tasks] [page_size]
+ */
+
+#include "bench.hpp"
+#include "task_file.hpp"
+#include "task_manager.hpp"
+#include <cstdlib>
+#include <filesystem>
+
+using namespace std;
+
+static void remove_store(const string &path) {
+  for (const string &file : {path, index_path(path), search_path(path), tombstone_path(path), lock_path(path),
+                             archive_path(path), journal_path(path), stats_path(path),
+                             history_path(path)})
+    filesystem::remove(file);
+}
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  size_t page = argc > 2 ? static_cast<size_t>(atoi(argv[2])) : 50;
+  string path = (filesystem::temp_directory_path() / "page_bench.json").string();
+  remove_store(path);
+  bench::write_store(path, n, 42, 1.0);
+
+  // Save once so the file is ranked for today
+  TaskManager mgr;
+  mgr.loadFromFile(path);
+  mgr.saveToFile(path);
+  vector<Task> ranked = mgr.topTasks(SIZE_MAX);
+
+  printf("%d tasks, %zu per page\n%8s %12s %12s %9s\n", n, page, "depth", "seek ms", "full ms", "speedup");
+  for (double depth : {0.0, 0.1, 0.5, 0.9}) {
+    optional<TaskManager::PageCursor> after;
+    if (depth > 0) {
+      const Task &last = ranked[static_cast<size_t>(depth * static_cast<double>(ranked.size()))];
+      after = TaskManager::PageCursor{last.sort_key, last.id};
+    }
+    uint64_t below = after ? after->key : UINT64_MAX;
+
+    vector<Task> fast, slow;
+    double seek_ms = bench::time_ms([&] {
+      TaskManager paged;
+      paged.loadFirstPage(path, Status::Pending, page, nullopt, after);
+      fast = paged.topTasks(page, Status::Pending, nullopt, below);
+    });
+    double full_ms = bench::time_ms([&] {
+      TaskManager full;
+      full.loadFromFile(path);
+      slow = full.topTasks(page, Status::Pending, nullopt, below);
+    });
+    printf("%7.0f%% %12.2f %12.1f %8.0fx%s\n", depth * 100, seek_ms, full_ms, full_ms / seek_ms,
+           fast == slow ? "" : "  MISMATCH");
+  }
+
+  remove_store(path);
+  return 0;
+}
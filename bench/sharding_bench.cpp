@@ -0,0 +1,45 @@
+/**
+ * @file    sharding_bench.cpp
+ * @brief   Write-only ingestion throughput (addTask + completeTask) as the
+ *          number of writer threads grows.
+ *
+ * Usage: ./sharding_bench [ops_per_thread]
+ */
+
+#include "bench.hpp"
+#include "task_manager.hpp"
+#include <cstdlib>
+#include <thread>
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  int per_thread = argc > 1 ? atoi(argv[1]) : 20000;
+
+  printf("%d add+complete pairs per thread, %u hardware threads\n", per_thread, thread::hardware_concurrency());
+  printf("threads      ops/s\n");
+
+  for (int threads : {1, 2, 4, 8, 16, 32}) {
+    TaskManager mgr;
+    mgr.setTaskLimit(SIZE_MAX);
+    vector<thread> pool;
+
+    double ms = bench::time_ms([&] {
+      for (int t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t] {
+          string prefix = "ingest " + to_string(t) + "-";
+          for (int i = 0; i < per_thread; ++i) {
+            int id = mgr.addTask(prefix + to_string(i), Priority::High);
+            mgr.completeTask(id);
+          }
+        });
+      }
+      for (auto &th : pool)
+        th.join();
+    });
+
+    double ops = 2.0 * threads * per_thread;
+    printf("%7d %10.0f\n", threads, ops / (ms / 1000.0));
+  }
+  return 0;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file    sort_key_bench.cpp
+ * @brief   Heap build / top-K / full sort with the old double comparator versus
+ *          the packed integer sort key.
+ *
+ * Usage: ./sort_key_bench [num_tasks]
+ */
+
+#include "bench.hpp"
+#include "task_manager.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+// The comparator PriorityCmp used before sort keys existed.
+struct ScoreCmp {
+  bool operator()(const Task *a, const Task *b) const noexcept {
+    return TaskManager::effective_score(*a, kRecentThreshold) <
+           TaskManager::effective_score(*b, kRecentThreshold);
+  }
+};
+
+struct KeyCmp {
+  bool operator()(const Task *a, const Task *b) const noexcept {
+    return a->sort_key < b->sort_key;
+  }
+};
+
+template <typename Cmp>
+void run(const char *label, vector<Task *> ptrs, size_t k) {
+  Cmp cmp;
+  double build = bench::time_ms([&] { make_heap(ptrs.begin(), ptrs.end(), cmp); });
+
+  vector<Task *> heap = ptrs;
+  double top = bench::time_ms([&] {
+    for (size_t i = 0; i < k && !heap.empty(); ++i) {
+      pop_heap(heap.begin(), heap.end(), cmp);
+      heap.pop_back();
+    }
+  });
+
+  double sorted = bench::time_ms([&] { sort(ptrs.begin(), ptrs.end(), cmp); });
+
+  printf("%-12s build %9.2f ms   top-%zu %9.2f ms   sort %9.2f ms\n",
+         label, build, k, top, sorted);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 200000;
+  string path = (filesystem::temp_directory_path() / "sort_key_bench.json").string();
+  bench::write_store(path, n);
+
+  TaskManager mgr;
+  mgr.loadFromFile(path);
+  filesystem::remove(path);
+
+  double rekey = bench::time_ms([&] { mgr.setReferenceDay(get_today()); });
+  printf("%d tasks, setReferenceDay (re-key + heapify) %.2f ms\n\n", n, rekey);
+
+  vector<Task> tasks = mgr.topTasks(SIZE_MAX, Status::All);
+  vector<Task *> ptrs;
+  ptrs.reserve(tasks.size());
+  for (auto &t : tasks)
+    ptrs.push_back(&t);
+
+  for (size_t k : {10, 1000}) {
+    run<ScoreCmp>("double", ptrs, k);
+    run<KeyCmp>("sort_key", ptrs, k);
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file    stats_bench.cpp
+ * @brief   `todo stats` from the saved aggregates versus loading the store and
+ *          its archive and counting, and what keeping the counts costs a
+ *          mutation.
+ *
+ * Usage: ./stats_bench [num_tasks] [edits]
+ */
+
+#include "bench.hpp"
+#include "task_file.hpp"
+#include "task_manager.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+
+using namespace std;
+
+static void remove_store(const string &path) {
+  for (const string &file : {path, index_path(path), search_path(path), tombstone_path(path), lock_path(path),
+                             archive_path(path), journal_path(path), stats_path(path),
+                             history_path(path)})
+    filesystem::remove(file);
+}
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  int edits = argc > 2 ? atoi(argv[2]) : 100000;
+  string path = (filesystem::temp_directory_path() / "stats_bench.json").string();
+  remove_store(path);
+  bench::write_store(path, n, 42, 0.7);
+
+  // One save splits off the archive and writes the aggregates
+  {
+    TaskManager mgr;
+    mgr.loadFromFile(path);
+    mgr.saveToFile(path);
+  }
+
+  optional<StoreStats> saved, counted;
+  double file_ms = bench::time_ms([&] { saved = TaskManager::statsFile(path); });
+  double load_ms = bench::time_ms([&] {
+    TaskManager mgr;
+    mgr.loadFromFile(path);
+    mgr.loadArchive(path);
+    counted = mgr.stats();
+  });
+  bool same = saved && counted && saved->counts == counted->counts && saved->due == counted->due;
+  printf("%d tasks: stats file %.3f ms, load + archive %.1f ms (%.0fx)%s\n", n, file_ms, load_ms, load_ms / file_ms,
+         same ? "" : "  MISMATCH");
+
+  // Each edit moves one task between counters; only hot tasks are loaded
+  TaskManager mgr;
+  mgr.loadFromFile(path);
+  vector<Task> hot = mgr.topTasks(SIZE_MAX, Status::All);
+  mt19937 rng(7);
+  double edit_ms = bench::time_ms([&] {
+    for (int i = 0; i < edits; ++i)
+      mgr.updateTask(hot[rng() % hot.size()].id, {nullopt, static_cast<Priority>(rng() % 4), nullopt});
+  });
+  printf("updateTask with counters: %.3f us/edit\n", edit_ms * 1000.0 / edits);
+
+  remove_store(path);
+  return 0;
+}
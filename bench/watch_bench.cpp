@@ -0,0 +1,68 @@
+/**
+ * @file    watch_bench.cpp
+ * @brief   What `todo watch` pays per task change and per second of waiting
+ *          with the timer wheel, against rescanning every task each poll.
+ *
+ * Usage: ./watch_bench [num_tasks] [reschedules]
+ */
+
+#include "bench.hpp"
+#include "task_watch.hpp"
+#include <cstdlib>
+#include <random>
+
+using namespace std;
+using namespace std::chrono;
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? atoi(argv[1]) : 1000000;
+  int moves = argc > 2 ? atoi(argv[2]) : 1000000;
+  sys_days today = floor<days>(system_clock::now());
+  int64_t now = duration_cast<seconds>(today.time_since_epoch()).count();
+
+  // Due dates spread over the coming year
+  mt19937 rng(42);
+  vector<Task> tasks;
+  tasks.reserve(n);
+  for (int id = 1; id <= n; ++id)
+    tasks.emplace_back(id, "Task " + to_string(id), static_cast<Priority>(rng() % 4), ymd{today + days{rng() % 365}});
+
+  DueWatcher watcher({86400, 3600}, now);
+  double track_ms = bench::time_ms([&] {
+    for (const Task &task : tasks)
+      watcher.track(task);
+  });
+  printf("%d tasks, %zu timers: track %.0f ns/task\n", n, watcher.timers(), track_ms * 1e6 / n);
+
+  // A reschedule cancels three timers and schedules three
+  double move_ms = bench::time_ms([&] {
+    for (int i = 0; i < moves; ++i) {
+      Task &task = tasks[rng() % tasks.size()];
+      task.due = ymd{today + days{rng() % 365}};
+      watcher.track(task);
+    }
+  });
+  printf("reschedule: %.0f ns/change\n", move_ms * 1e6 / moves);
+
+  // A week of one-second wakeups, then a jump to the end of the year
+  size_t events = 0;
+  auto count = [&](const DueEvent &) { ++events; };
+  double week_ms = bench::time_ms([&] {
+    for (int64_t t = now; t < now + 7 * 86400; ++t)
+      watcher.advance(t, count);
+  });
+  printf("advance a week second by second: %.1f ms (%.2f us/tick), %zu events\n", week_ms, week_ms * 1000 / (7 * 86400),
+         events);
+  double year_ms = bench::time_ms([&] { watcher.advance(now + 366 * 86400, count); });
+  printf("advance to the end of the year: %.1f ms, %zu events in all\n", year_ms, events);
+
+  // What a polling loop would do instead on every wakeup
+  size_t overdue = 0;
+  ymd day{today + days{7}};
+  double scan_ms = bench::time_ms([&] {
+    for (const Task &task : tasks)
+      overdue += is_overdue(task, day);
+  });
+  printf("one rescan of every task: %.2f ms (%zu overdue)\n", scan_ms, overdue);
+  return 0;
+}
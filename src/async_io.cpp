@@ -0,0 +1,329 @@
+/**
+ * @file    async_io.cpp
+ * @brief   Implements the io_uring rings (raw system calls, no liburing), the
+ *          worker-thread fallback and the chunked writer.
+ */
+
+#include "async_io.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Largest transfer handed over at once (the kernel takes 32-bit lengths).
+constexpr size_t kMaxTransfer = size_t{1} << 30;
+
+int uring_enter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0));
+}
+
+} // namespace
+
+IoRing::Op::~Op() {
+  if (slot != kNoSlot)
+    ring->wait(*this);
+}
+
+bool IoRing::Op::await_ready() const noexcept {
+  return ring->slots[slot].done;
+}
+
+void IoRing::Op::await_suspend(coroutine_handle<> waiter) noexcept {
+  ring->slots[slot].waiter = waiter;
+}
+
+int64_t IoRing::Op::await_resume() noexcept {
+  int64_t moved = ring->slots[slot].moved;
+  ring->slots[slot] = {};
+  ring->free_slots.push_back(exchange(slot, kNoSlot));
+  return moved;
+}
+
+IoRing::IoRing(unsigned depth) : depth(max(depth, 1u)) {
+  if (setupKernel())
+    return;
+  unsigned threads = min(this->depth, 4u);
+  for (unsigned i = 0; i < threads; ++i)
+    workers.emplace_back(&IoRing::serve, this);
+}
+
+IoRing::~IoRing() {
+  while (in_flight > 0)
+    reap(true);
+  if (ring_fd >= 0) {
+    munmap(sqes, sqe_bytes);
+    munmap(ring_map, ring_bytes);
+    close(ring_fd);
+    return;
+  }
+  {
+    lock_guard lock(pool_mtx);
+    stopping = true;
+  }
+  pool_work.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+/**
+ * @brief  Needs a kernel that maps both rings at once (5.4 and later);
+ *         anything else, or a seccomp filter refusing the calls, falls back.
+ */
+bool IoRing::setupKernel() {
+  if (const char *mode = getenv("TODO_IO"); mode != nullptr && string_view{mode} == "threads")
+    return false;
+
+  io_uring_params params{};
+  int fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+  if (fd < 0)
+    return false;
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0) {
+    close(fd);
+    return false;
+  }
+
+  ring_bytes = max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                   params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+  ring_map = mmap(nullptr, ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (ring_map == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  sqe_bytes = params.sq_entries * sizeof(io_uring_sqe);
+  void *entries = mmap(nullptr, sqe_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (entries == MAP_FAILED) {
+    munmap(ring_map, ring_bytes);
+    close(fd);
+    return false;
+  }
+
+  auto *base = static_cast<char *>(ring_map);
+  sqes = static_cast<io_uring_sqe *>(entries);
+  sq_tail = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+  sq_mask = reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+  sq_array = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+  cq_head = reinterpret_cast<unsigned *>(base + params.cq_off.head);
+  cq_tail = reinterpret_cast<unsigned *>(base + params.cq_off.tail);
+  cq_mask = reinterpret_cast<unsigned *>(base + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<io_uring_cqe *>(base + params.cq_off.cqes);
+  ring_fd = fd;
+  return true;
+}
+
+IoRing::Op IoRing::read(int fd, span<char> buf, uint64_t offset) {
+  return submit(fd, false, buf.data(), buf.size(), offset);
+}
+
+IoRing::Op IoRing::write(int fd, span<const char> buf, uint64_t offset) {
+  return submit(fd, true, const_cast<char *>(buf.data()), buf.size(), offset);
+}
+
+IoRing::Op IoRing::submit(int fd, bool write, char *data, size_t len, uint64_t offset) {
+  uint32_t slot;
+  if (!free_slots.empty()) {
+    slot = free_slots.back();
+    free_slots.pop_back();
+  } else {
+    slot = static_cast<uint32_t>(slots.size());
+    slots.emplace_back();
+  }
+  slots[slot] = {fd, write, data, len, offset, 0, len == 0, true, {}};
+  if (len > 0) {
+    while (in_flight >= depth)
+      reap(true);
+    issue(slot);
+  }
+  return Op{this, slot};
+}
+
+void IoRing::issue(uint32_t slot) {
+  Slot &s = slots[slot];
+  if (s.moved > 0 && faults.reissues.has_value()) {
+    if (*faults.reissues == 0) {
+      s.moved = -EIO;
+      s.done = true;
+      return;
+    }
+    --*faults.reissues;
+  }
+  size_t len = min(s.left, faults.max_transfer > 0 ? faults.max_transfer : kMaxTransfer);
+  ++in_flight;
+  if (ring_fd < 0) {
+    {
+      lock_guard lock(pool_mtx);
+      queued.push_back({slot, s.fd, s.write, s.data, len, s.offset});
+    }
+    pool_work.notify_one();
+    return;
+  }
+
+  // Only this thread writes the tail, so a plain read of it is enough
+  unsigned tail = *sq_tail;
+  unsigned index = tail & *sq_mask;
+  io_uring_sqe &sqe = sqes[index];
+  memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode = s.write ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe.fd = s.fd;
+  sqe.addr = reinterpret_cast<uint64_t>(s.data);
+  sqe.len = static_cast<uint32_t>(len);
+  sqe.off = s.offset;
+  sqe.user_data = slot;
+  sq_array[index] = index;
+  atomic_ref<unsigned>(*sq_tail).store(tail + 1, memory_order_release);
+  int entered;
+  while ((entered = uring_enter(ring_fd, 1, 0, 0)) < 0 && errno == EINTR) {
+  }
+  if (entered < 0) {
+    // Never reached the kernel: fail it here
+    atomic_ref<unsigned>(*sq_tail).store(tail, memory_order_release);
+    --in_flight;
+    s.moved = -errno;
+    s.done = true;
+  }
+}
+
+void IoRing::reap(bool block) {
+  vector<pair<uint32_t, int64_t>> results;
+  if (ring_fd >= 0) {
+    unsigned head = *cq_head;
+    while (block && head == atomic_ref<unsigned>(*cq_tail).load(memory_order_acquire) && in_flight > 0)
+      uring_enter(ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+    unsigned tail = atomic_ref<unsigned>(*cq_tail).load(memory_order_acquire);
+    for (; head != tail; ++head) {
+      const io_uring_cqe &cqe = cqes[head & *cq_mask];
+      results.emplace_back(static_cast<uint32_t>(cqe.user_data), cqe.res);
+    }
+    atomic_ref<unsigned>(*cq_head).store(head, memory_order_release);
+  } else {
+    unique_lock lock(pool_mtx);
+    if (block)
+      pool_done.wait(lock, [&] { return !finished.empty() || in_flight == 0; });
+    results.assign(finished.begin(), finished.end());
+    finished.clear();
+  }
+
+  in_flight -= static_cast<unsigned>(results.size());
+  for (auto [slot, result] : results) {
+    Slot &s = slots[slot];
+    if (result < 0) {
+      s.moved = result;
+    } else {
+      s.moved += result;
+      s.left -= static_cast<size_t>(result);
+      s.data += result;
+      s.offset += static_cast<uint64_t>(result);
+      // A short transfer short of end of file carries on where it stopped;
+      // one that cannot be reissued is done, failed, and its waiter told
+      if (result > 0 && s.left > 0) {
+        issue(slot);
+        if (!s.done)
+          continue;
+      }
+    }
+    s.done = true;
+    if (s.waiter)
+      ready.push_back(exchange(s.waiter, {}));
+  }
+}
+
+/**
+ * @brief  Each request is carried out whole: pread/pwrite loop until done,
+ *         end of file or an error.
+ */
+void IoRing::serve() {
+  while (true) {
+    Request request;
+    {
+      unique_lock lock(pool_mtx);
+      pool_work.wait(lock, [&] { return stopping || !queued.empty(); });
+      if (queued.empty())
+        return;
+      request = queued.front();
+      queued.pop_front();
+    }
+
+    int64_t moved = 0;
+    while (static_cast<size_t>(moved) < request.len) {
+      auto off = static_cast<off_t>(request.offset + static_cast<uint64_t>(moved));
+      ssize_t n = request.write ? pwrite(request.fd, request.data + moved, request.len - moved, off)
+                                : pread(request.fd, request.data + moved, request.len - moved, off);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0) {
+        moved = -errno;
+        break;
+      }
+      if (n == 0)
+        break;
+      moved += n;
+    }
+    {
+      lock_guard lock(pool_mtx);
+      finished.emplace_back(request.slot, moved);
+    }
+    pool_done.notify_one();
+  }
+}
+
+int64_t IoRing::wait(Op &op) {
+  while (!slots[op.slot].done)
+    reap(true);
+  return op.await_resume();
+}
+
+bool IoRing::run(IoJob &job) {
+  while (true) {
+    while (!ready.empty()) {
+      coroutine_handle<> waiter = ready.back();
+      ready.pop_back();
+      waiter.resume();
+    }
+    if (job.done() || in_flight == 0)
+      break;
+    reap(true);
+  }
+  if (job.done() && job.handle.promise().error)
+    rethrow_exception(job.handle.promise().error);
+  return job.done();
+}
+
+void AsyncWriter::submit() {
+  if (piece.size() >= kIoChunk)
+    handOver();
+}
+
+void AsyncWriter::handOver() {
+  if (piece.empty())
+    return;
+  while (writes.size() >= kIoDepth)
+    retire();
+  buffers.push_back(std::move(piece));
+  piece = string();
+  piece.reserve(kIoChunk + kIoChunk / 8);
+  writes.push_back(ring.write(fd, buffers.back(), written));
+  written += buffers.back().size();
+}
+
+void AsyncWriter::retire() {
+  int64_t moved = ring.wait(writes.front());
+  failed = failed || moved != static_cast<int64_t>(buffers.front().size());
+  writes.pop_front();
+  buffers.pop_front();
+}
+
+bool AsyncWriter::finish() {
+  handOver();
+  while (!writes.empty())
+    retire();
+  return !failed;
+}
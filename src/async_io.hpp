@@ -0,0 +1,286 @@
+/**
+ * @file    async_io.hpp
+ * @brief   Small coroutine I/O layer: reads and writes at file offsets go to
+ *          io_uring, or to a few worker threads where the kernel does not
+ *          offer it, and finish on the thread that waits for them.
+ *
+ * A request is submitted as soon as it is made, so a caller puts several in
+ * flight and then co_awaits them (or wait()s outside a coroutine) while it
+ * works on what has already arrived. Completions are reaped only by the
+ * thread driving the ring, which is also where every coroutine resumes, so
+ * coroutine code needs no locks of its own.
+ *
+ * Set TODO_IO=threads to use the worker threads even where io_uring works.
+ */
+
+#pragma once
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// Requests in flight at most.
+static constexpr unsigned kIoDepth = 8;
+// Bytes per read or write request.
+static constexpr size_t kIoChunk = size_t{4} << 20;
+
+/**
+ * @class IoJob
+ * @brief  Coroutine that runs at once up to its first co_await; IoRing::run
+ *         takes it the rest of the way.
+ */
+class IoJob {
+public:
+  struct promise_type {
+    std::exception_ptr error;
+    IoJob get_return_object() { return IoJob{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { error = std::current_exception(); }
+  };
+
+  IoJob(IoJob &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+  IoJob(const IoJob &) = delete;
+  ~IoJob() {
+    if (handle)
+      handle.destroy();
+  }
+
+  /**
+   * @brief  True once the coroutine has returned (or thrown).
+   */
+  bool done() const { return handle.done(); }
+
+private:
+  friend class IoRing;
+  explicit IoJob(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+  std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * @struct IoFaults
+ * @brief  Failures an IoRing simulates, for tests of the error paths.
+ */
+struct IoFaults {
+  size_t max_transfer{0};           //< Cap on one transfer, so requests come back short; 0 for none.
+  std::optional<unsigned> reissues; //< Reissues of short transfers let through before the rest fail with -EIO.
+};
+
+class IoRing {
+public:
+  /**
+   * @class Op
+   * @brief  One submitted request. co_await it for the bytes moved, or
+   *         -errno; a short count means end of file. Destroying an Op that
+   *         is still in flight waits for it.
+   */
+  class Op {
+  public:
+    Op(Op &&other) noexcept : ring(other.ring), slot(std::exchange(other.slot, kNoSlot)) {}
+    Op(const Op &) = delete;
+    ~Op();
+
+    bool await_ready() const noexcept;
+    void await_suspend(std::coroutine_handle<> waiter) noexcept;
+    int64_t await_resume() noexcept;
+
+  private:
+    friend class IoRing;
+    Op(IoRing *ring, uint32_t slot) : ring(ring), slot(slot) {}
+    IoRing *ring;
+    uint32_t slot;
+  };
+
+  /**
+   * @brief  Set up io_uring, or the worker threads if it is unavailable.
+   * @param  depth  Requests the kernel (or the workers) hold at once.
+   */
+  explicit IoRing(unsigned depth = kIoDepth);
+  ~IoRing();
+
+  IoRing(const IoRing &) = delete;
+  IoRing &operator=(const IoRing &) = delete;
+
+  /**
+   * @brief  Read into a buffer from a file offset; the buffer must outlive
+   *         the request.
+   */
+  Op read(int fd, std::span<char> buf, uint64_t offset);
+
+  /**
+   * @brief  Write a buffer at a file offset; the buffer must outlive the
+   *         request.
+   */
+  Op write(int fd, std::span<const char> buf, uint64_t offset);
+
+  /**
+   * @brief  Block until a request is done, outside any coroutine.
+   * @return Bytes moved, or -errno.
+   */
+  int64_t wait(Op &op);
+
+  /**
+   * @brief  Resume coroutines as their requests complete until the job
+   *         returns. An exception it threw is rethrown here.
+   * @return False if nothing is left in flight but the job is still waiting,
+   *         so it never finished.
+   */
+  [[nodiscard]] bool run(IoJob &job);
+
+  /**
+   * @brief  True if requests go to io_uring, false for the worker threads.
+   */
+  bool kernel() const { return ring_fd >= 0; }
+
+  /**
+   * @brief  Simulate failures in rings created from now on; `{}` stops.
+   *         Not thread-safe: call it before the rings are made.
+   */
+  static void inject(IoFaults faults) { injected = faults; }
+
+private:
+  static constexpr uint32_t kNoSlot = UINT32_MAX;
+
+  struct Slot {
+    int fd{-1};
+    bool write{false};
+    char *data{nullptr};
+    size_t left{0};     //< Bytes still to move.
+    uint64_t offset{0}; //< Where the rest goes.
+    int64_t moved{0};   //< Bytes moved so far, or -errno once failed.
+    bool done{false};
+    bool used{false};
+    std::coroutine_handle<> waiter;
+  };
+
+  /**
+   * @struct Request
+   * @brief  What a worker thread needs to carry out one transfer.
+   */
+  struct Request {
+    uint32_t slot;
+    int fd;
+    bool write;
+    char *data;
+    size_t len;
+    uint64_t offset;
+  };
+
+  std::vector<Slot> slots; //< Touched only by the thread driving the ring.
+  std::vector<uint32_t> free_slots;
+  static inline IoFaults injected;
+  IoFaults faults{injected};
+  std::vector<std::coroutine_handle<>> ready; //< Waiters whose request is done.
+  unsigned depth;
+  unsigned in_flight{0};
+
+  // io_uring: one mapping for both rings, one for the submission entries
+  int ring_fd{-1};
+  void *ring_map{nullptr};
+  size_t ring_bytes{0};
+  io_uring_sqe *sqes{nullptr};
+  size_t sqe_bytes{0};
+  unsigned *sq_tail{nullptr}, *sq_mask{nullptr}, *sq_array{nullptr};
+  unsigned *cq_head{nullptr}, *cq_tail{nullptr}, *cq_mask{nullptr};
+  io_uring_cqe *cqes{nullptr};
+
+  // Worker threads, when io_uring is not used
+  std::vector<std::thread> workers;
+  std::mutex pool_mtx;
+  std::condition_variable pool_work, pool_done;
+  std::deque<Request> queued;
+  std::deque<std::pair<uint32_t, int64_t>> finished; //< Slot and bytes moved (or -errno).
+  bool stopping{false};
+
+  /**
+   * @brief  Set up io_uring; false leaves the ring unused.
+   */
+  bool setupKernel();
+
+  /**
+   * @brief  Take a slot for a new request and hand it over.
+   */
+  Op submit(int fd, bool write, char *data, size_t len, uint64_t offset);
+
+  /**
+   * @brief  Pass a slot's remaining bytes to the kernel or a worker. If they
+   *         cannot be handed over, the slot is marked done with -errno.
+   */
+  void issue(uint32_t slot);
+
+  /**
+   * @brief  Collect completions (waiting for at least one if `block`) and
+   *         reissue short transfers; waiters go to `ready`, not resumed here.
+   */
+  void reap(bool block);
+
+  /**
+   * @brief  Worker loop: pread/pwrite whole requests.
+   */
+  void serve();
+};
+
+/**
+ * @class AsyncWriter
+ * @brief  Writes a file front to back in kIoChunk pieces through an IoRing,
+ *         at most kIoDepth in flight, so the caller fills the next piece
+ *         while earlier ones are written.
+ */
+class AsyncWriter {
+public:
+  AsyncWriter(IoRing &ring, int fd) : ring(ring), fd(fd) {}
+
+  /**
+   * @brief  The piece being filled; append to it freely.
+   */
+  std::string &pending() { return piece; }
+
+  /**
+   * @brief  Bytes handed over plus the ones pending: the offset of the next
+   *         byte appended.
+   */
+  uint64_t size() const { return written + piece.size(); }
+
+  /**
+   * @brief  Hand the pending piece over once it reaches kIoChunk.
+   */
+  void submit();
+
+  /**
+   * @brief  Hand over the rest and wait for every write.
+   * @return True if every byte was written.
+   */
+  bool finish();
+
+private:
+  IoRing &ring;
+  int fd;
+  std::string piece;
+  uint64_t written{0};
+  std::deque<std::string> buffers; //< Pieces being written, oldest first
+  std::deque<IoRing::Op> writes;   //< and their requests.
+  bool failed{false};
+
+  /**
+   * @brief  Start writing the pending piece, waiting for the oldest write
+   *         first if kIoDepth are in flight.
+   */
+  void handOver();
+
+  /**
+   * @brief  Wait for the oldest write and free its buffer.
+   */
+  void retire();
+};
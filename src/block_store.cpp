@@ -0,0 +1,184 @@
+/**
+ * @file    block_store.cpp
+ * @brief   Implements block packing, the block index and the seekable reader.
+ */
+
+#include "block_store.hpp"
+#include "lz_codec.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+static constexpr char kBlockMagic[4] = {'T', 'B', 'L', 'K'};
+// Trailer: block count, index offset, magic.
+static constexpr size_t kTrailer = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(kBlockMagic);
+
+namespace {
+
+template <typename T>
+void put(string &out, const T &value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+T get(string_view in, size_t at) {
+  T value;
+  memcpy(&value, in.data() + at, sizeof(value));
+  return value;
+}
+
+/**
+ * @brief  Count and index offset from the trailer, checked against the size.
+ */
+optional<pair<uint32_t, uint64_t>> readTrailer(string_view tail, uint64_t file_size) {
+  if (tail.size() != kTrailer || memcmp(tail.data() + kTrailer - sizeof(kBlockMagic), kBlockMagic, sizeof(kBlockMagic)) != 0)
+    return nullopt;
+  uint32_t count = get<uint32_t>(tail, 0);
+  uint64_t index_at = get<uint64_t>(tail, sizeof(uint32_t));
+  if (index_at + uint64_t{count} * sizeof(BlockEntry) + kTrailer != file_size)
+    return nullopt;
+  return pair{count, index_at};
+}
+
+/**
+ * @brief  Entries must tile the text and lie inside the file.
+ */
+bool checkIndex(const vector<BlockEntry> &blocks, uint64_t index_at) {
+  uint64_t raw = 0;
+  for (const BlockEntry &b : blocks) {
+    if (b.raw_offset != raw || b.offset < sizeof(kBlockMagic) || b.offset + b.packed_size > index_at)
+      return false;
+    raw += b.raw_size;
+  }
+  return true;
+}
+
+} // namespace
+
+bool is_block_store(string_view head) {
+  return head.size() >= sizeof(kBlockMagic) && memcmp(head.data(), kBlockMagic, sizeof(kBlockMagic)) == 0;
+}
+
+/**
+ * @brief  Greedy: close a block at the first cut at or past kBlockBytes.
+ */
+string pack_blocks(string_view text, span<const uint64_t> cuts) {
+  string out(kBlockMagic, sizeof(kBlockMagic));
+  out.reserve(text.size() / 4);
+  vector<BlockEntry> blocks;
+
+  uint64_t start = 0;
+  auto cut = cuts.begin();
+  while (start < text.size()) {
+    cut = lower_bound(cut, cuts.end(), start + kBlockBytes);
+    uint64_t end = cut == cuts.end() ? text.size() : min<uint64_t>(*cut, text.size());
+    string packed = lz_compress(text.substr(start, end - start));
+    blocks.push_back({start, out.size(), static_cast<uint32_t>(end - start), static_cast<uint32_t>(packed.size())});
+    out += packed;
+    start = end;
+  }
+
+  uint64_t index_at = out.size();
+  for (const BlockEntry &b : blocks)
+    put(out, b);
+  put(out, static_cast<uint32_t>(blocks.size()));
+  put(out, index_at);
+  out.append(kBlockMagic, sizeof(kBlockMagic));
+  return out;
+}
+
+optional<vector<BlockEntry>> block_index(string_view file) {
+  if (!is_block_store(file) || file.size() < sizeof(kBlockMagic) + kTrailer)
+    return nullopt;
+  auto trailer = readTrailer(file.substr(file.size() - kTrailer), file.size());
+  if (!trailer.has_value())
+    return nullopt;
+
+  vector<BlockEntry> blocks(trailer->first);
+  memcpy(blocks.data(), file.data() + trailer->second, blocks.size() * sizeof(BlockEntry));
+  if (!checkIndex(blocks, trailer->second))
+    return nullopt;
+  return blocks;
+}
+
+optional<string> unpack_block(string_view file, const BlockEntry &block) {
+  return lz_decompress(file.substr(block.offset, block.packed_size), block.raw_size);
+}
+
+BlockStreamBuf::BlockStreamBuf(const string &path) : file(path, ios::binary) {
+  char magic[sizeof(kBlockMagic)];
+  if (!file.read(magic, sizeof(magic)) || !is_block_store({magic, sizeof(magic)}))
+    return;
+
+  file.seekg(0, ios::end);
+  uint64_t size = static_cast<uint64_t>(file.tellg());
+  if (size < sizeof(kBlockMagic) + kTrailer)
+    return;
+  string tail(kTrailer, '\0');
+  file.seekg(static_cast<streamoff>(size - kTrailer));
+  file.read(tail.data(), kTrailer);
+  auto trailer = readTrailer(tail, size);
+  if (!file || !trailer.has_value())
+    return;
+
+  blocks.resize(trailer->first);
+  file.seekg(static_cast<streamoff>(trailer->second));
+  file.read(reinterpret_cast<char *>(blocks.data()), static_cast<streamsize>(blocks.size() * sizeof(BlockEntry)));
+  ok = file && checkIndex(blocks, trailer->second);
+}
+
+bool BlockStreamBuf::load(size_t i) {
+  if (i != current) {
+    const BlockEntry &b = blocks[i];
+    packed.resize(b.packed_size);
+    file.seekg(static_cast<streamoff>(b.offset));
+    if (!file.read(packed.data(), b.packed_size))
+      return false;
+    optional<string> text = lz_decompress(packed, b.raw_size);
+    if (!text.has_value())
+      return false;
+    raw = std::move(*text);
+    current = i;
+  }
+  setg(raw.data(), raw.data(), raw.data() + raw.size());
+  return true;
+}
+
+BlockStreamBuf::int_type BlockStreamBuf::underflow() {
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  size_t next = current == SIZE_MAX ? 0 : current + 1;
+  if (!ok || next >= blocks.size() || !load(next))
+    return traits_type::eof();
+  return traits_type::to_int_type(*gptr());
+}
+
+BlockStreamBuf::pos_type BlockStreamBuf::seekoff(off_type off, ios_base::seekdir dir, ios_base::openmode which) {
+  off_type base = 0;
+  if (dir == ios_base::cur)
+    base = current == SIZE_MAX ? 0 : static_cast<off_type>(blocks[current].raw_offset + (gptr() - eback()));
+  else if (dir == ios_base::end)
+    base = blocks.empty() ? 0 : static_cast<off_type>(blocks.back().raw_offset + blocks.back().raw_size);
+  return seekpos(base + off, which);
+}
+
+/**
+ * @brief  Binary search for the block holding pos; only that one is read.
+ */
+BlockStreamBuf::pos_type BlockStreamBuf::seekpos(pos_type pos, ios_base::openmode which) {
+  const pos_type fail = pos_type(off_type(-1));
+  if (!ok || !(which & ios_base::in) || pos < 0)
+    return fail;
+
+  uint64_t at = static_cast<uint64_t>(off_type(pos));
+  auto it = upper_bound(blocks.begin(), blocks.end(), at,
+                        [](uint64_t value, const BlockEntry &b) { return value < b.raw_offset; });
+  if (it == blocks.begin())
+    return at == 0 ? pos : fail; // an empty store
+  size_t i = static_cast<size_t>(it - blocks.begin()) - 1;
+  if (at > blocks[i].raw_offset + blocks[i].raw_size || !load(i))
+    return fail;
+  setg(eback(), eback() + (at - blocks[i].raw_offset), egptr());
+  return pos;
+}
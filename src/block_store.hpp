@@ -0,0 +1,120 @@
+/**
+ * @file    block_store.hpp
+ * @brief   Block-compressed container for the store file.
+ *
+ * The compressed form of tasks.json holds the same text, cut at record
+ * boundaries into blocks of about kBlockBytes and compressed one by one with
+ * lz_compress. A block index at the end maps raw (uncompressed) offsets to
+ * blocks, so a reader can seek to any record by decompressing one block.
+ * Offsets in tasks.json.idx stay raw ones. Parallel loads give each parser
+ * thread whole blocks.
+ *
+ * Layout: "TBLK", the blocks back to back, one BlockEntry per block, then
+ * the block count, the index offset and "TBLK" again.
+ */
+
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <optional>
+#include <span>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Raw bytes per block before it is closed at the next record boundary.
+static constexpr size_t kBlockBytes = 64 * 1024;
+
+/**
+ * @struct BlockEntry
+ * @brief  Where one block's text sits before and after compression.
+ */
+struct BlockEntry {
+  uint64_t raw_offset;  //< Offset of its first byte in the uncompressed text.
+  uint64_t offset;      //< Offset of its packed bytes in the file.
+  uint32_t raw_size;    //< Uncompressed length.
+  uint32_t packed_size; //< Compressed length.
+};
+
+/**
+ * @brief   Whether a file starts like a block store.
+ * @param   head  The first bytes of the file (at least 4 to say yes).
+ */
+bool is_block_store(std::string_view head);
+
+/**
+ * @brief   Compress text into the block layout.
+ * @param   text  Whole store text.
+ * @param   cuts  Ascending offsets where a block may end (record ends).
+ * @return  The file's bytes.
+ */
+std::string pack_blocks(std::string_view text, std::span<const uint64_t> cuts);
+
+/**
+ * @brief   Read the block index of a block store held in memory.
+ * @param   file  Whole file.
+ * @return  One entry per block, or nullopt if the layout is damaged.
+ */
+std::optional<std::vector<BlockEntry>> block_index(std::string_view file);
+
+/**
+ * @brief   Decompress one block of a block store held in memory.
+ * @param   file   Whole file.
+ * @param   block  Entry from block_index.
+ * @return  The block's text, or nullopt if it is corrupt.
+ */
+std::optional<std::string> unpack_block(std::string_view file, const BlockEntry &block);
+
+/**
+ * @class BlockStreamBuf
+ * @brief Read-only, seekable view of a block store's uncompressed text. Only
+ *        the block under the read position is held in memory.
+ */
+class BlockStreamBuf : public std::streambuf {
+public:
+  /**
+   * @brief  Open a block store and read its index.
+   * @param  path  Store file path.
+   */
+  explicit BlockStreamBuf(const std::string &path);
+
+  /**
+   * @brief  False if the file is missing or its index is damaged.
+   */
+  bool valid() const { return ok; }
+
+protected:
+  int_type underflow() override;
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+private:
+  /**
+   * @brief  Decompress block i and make it the get area.
+   */
+  bool load(size_t i);
+
+  std::ifstream file;
+  std::vector<BlockEntry> blocks;
+  size_t current{SIZE_MAX}; //< Block in the get area; SIZE_MAX before the first read.
+  std::string raw, packed;
+  bool ok{false};
+};
+
+/**
+ * @class BlockStream
+ * @brief An istream over a BlockStreamBuf it owns.
+ */
+class BlockStream : public std::istream {
+public:
+  explicit BlockStream(const std::string &path) : std::istream(nullptr), buf(path) {
+    rdbuf(&buf);
+    if (!buf.valid())
+      setstate(std::ios::failbit);
+  }
+
+private:
+  BlockStreamBuf buf;
+};
@@ -0,0 +1,177 @@
+/**
+ * @file    list_kernel.hpp
+ * @brief   Selection and row-formatting loops for `todo list`, specialised at
+ *          compile time so the per-task work has no filter or order branches.
+ *
+ * The caller dispatches once on the runtime Status filter and page size
+ * (select_ranked's non-template overload); each instantiation's loop tests a
+ * constant state, or nothing at all for Status::All, and either walks the
+ * heap for a short page or filters and sorts for a long one. Rows are appended to one buffer from
+ * constexpr status/priority tables instead of being streamed piecewise.
+ */
+
+#pragma once
+#include "task.hpp"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * @brief   Filter predicate resolved at compile time.
+ */
+template <Status F>
+constexpr bool passes(const Task &task) {
+  if constexpr (F == Status::All)
+    return true;
+  else
+    return task.state == F;
+}
+
+/**
+ * @brief   The k most important tasks passing F, best first.
+ * @tparam  F      Status filter.
+ * @tparam  Paged  True: walk the heap best-first from the root, touching only
+ *                 the nodes ranked above the k-th hit. False: filter every
+ *                 task, then sort the hits.
+ * @param   heap   Max-heap on sort_key (one of TaskManager's per-list heaps).
+ * @param   k      Page size (SIZE_MAX for everything).
+ * @param   below  Only tasks keyed below this (a page cursor); UINT64_MAX for all.
+ * @return  Pointers into the heap's tasks.
+ */
+template <Status F, bool Paged>
+std::vector<const Task *> select_ranked(const std::vector<Task *> &heap, size_t k, uint64_t below = UINT64_MAX) {
+  std::vector<const Task *> hits;
+
+  if constexpr (Paged) {
+    // Frontier of heap slots, itself a max-heap; a node's children can only
+    // outrank what is left once the node has been taken
+    auto lower = [&](size_t a, size_t b) { return heap[a]->sort_key < heap[b]->sort_key; };
+    std::vector<size_t> frontier;
+
+    // Nodes at or above the cursor only lead down to the first ones below it
+    std::vector<size_t> above;
+    if (!heap.empty())
+      above.push_back(0);
+    while (!above.empty()) {
+      size_t slot = above.back();
+      above.pop_back();
+      if (heap[slot]->sort_key < below) {
+        frontier.push_back(slot);
+        continue;
+      }
+      for (size_t child = 2 * slot + 1; child <= 2 * slot + 2 && child < heap.size(); ++child)
+        above.push_back(child);
+    }
+    std::make_heap(frontier.begin(), frontier.end(), lower);
+
+    while (!frontier.empty() && hits.size() < k) {
+      std::pop_heap(frontier.begin(), frontier.end(), lower);
+      size_t slot = frontier.back();
+      frontier.pop_back();
+      if (passes<F>(*heap[slot]))
+        hits.push_back(heap[slot]);
+
+      for (size_t child = 2 * slot + 1; child <= 2 * slot + 2 && child < heap.size(); ++child) {
+        frontier.push_back(child);
+        std::push_heap(frontier.begin(), frontier.end(), lower);
+      }
+    }
+  } else {
+    if (F == Status::All && below == UINT64_MAX)
+      hits.assign(heap.begin(), heap.end());
+    else
+      for (const Task *task : heap)
+        if (passes<F>(*task) && task->sort_key < below)
+          hits.push_back(task);
+
+    auto by_rank = [](const Task *a, const Task *b) { return a->sort_key > b->sort_key; };
+    if (k < hits.size()) {
+      std::partial_sort(hits.begin(), hits.begin() + static_cast<std::ptrdiff_t>(k), hits.end(), by_rank);
+      hits.resize(k);
+    } else {
+      std::sort(hits.begin(), hits.end(), by_rank);
+    }
+  }
+  return hits;
+}
+
+// Pages up to 1/kPagedFraction of the store walk the heap; bigger ones sort.
+static constexpr size_t kPagedFraction = 16;
+
+/**
+ * @brief   Runtime entry point: one switch on filter and page size, then a
+ *          specialised loop.
+ */
+template <bool Paged>
+std::vector<const Task *> select_ranked(const std::vector<Task *> &heap, Status filter, size_t k,
+                                        uint64_t below = UINT64_MAX) {
+  switch (filter) {
+  case Status::Pending:
+    return select_ranked<Status::Pending, Paged>(heap, k, below);
+  case Status::Completed:
+    return select_ranked<Status::Completed, Paged>(heap, k, below);
+  case Status::Archived:
+    return select_ranked<Status::Archived, Paged>(heap, k, below);
+  case Status::All:
+    break;
+  }
+  return select_ranked<Status::All, Paged>(heap, k, below);
+}
+
+inline std::vector<const Task *> select_ranked(const std::vector<Task *> &heap, Status filter, size_t k,
+                                               uint64_t below = UINT64_MAX) {
+  if (k < heap.size() / kPagedFraction)
+    return select_ranked<true>(heap, filter, k, below);
+  return select_ranked<false>(heap, filter, k, below);
+}
+
+/**
+ * @brief   Append an integer without a temporary string.
+ */
+inline void append_int(std::string &out, long long v) {
+  char digits[24];
+  auto [end, ec] = std::to_chars(digits, digits + sizeof digits, v);
+  out.append(digits, end);
+}
+
+/**
+ * @brief   Append one table row (same layout as TaskManager::printTable).
+ * @param   out    Output buffer.
+ * @param   task   Task to render.
+ * @param   today  Reference day, computed once per table.
+ */
+inline void append_row(std::string &out, const Task &task, std::chrono::sys_days today) {
+  out += '[';
+  append_int(out, task.id);
+  out += "]  ";
+  out += status_name(task.state);
+  out += '\t';
+  out += priority_bar(task.pr);
+  out += "   ";
+
+  if (!task.due.has_value()) {
+    out += "None\t\t\t";
+  } else {
+    // ISO date + color + overdue info
+    std::chrono::year_month_day due = task.due.value();
+    append_int(out, static_cast<int>(due.year()));
+    out += unsigned(due.month()) < 10 ? "-0" : "-";
+    append_int(out, unsigned(due.month()));
+    out += unsigned(due.day()) < 10 ? "-0" : "-";
+    append_int(out, unsigned(due.day()));
+
+    long long delta = (std::chrono::sys_days{due} - today).count();
+    bool over = delta < 0 && task.state != Status::Completed;
+    out += ' ';
+    out += over ? RED : GREEN;
+    out += over ? "(" : "(+";
+    append_int(out, delta);
+    out += "d)\t";
+  }
+
+  out += RESET;
+  out += truncate(task.title);
+  out += '\n';
+}
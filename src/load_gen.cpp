@@ -0,0 +1,338 @@
+/**
+ * @file    load_gen.cpp
+ * @brief   Implements trace generation, the trace file format and the timed
+ *          replay.
+ */
+
+#include "load_gen.hpp"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <thread>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+constexpr array<string_view, kLoadOpCount> kOpNames = {"add", "complete", "archive", "remove", "list"};
+
+// What the generator believes became of each id.
+enum class Life : uint8_t { Gone,
+                            Pending,
+                            Completed,
+                            Archived };
+
+// Draws before a complete/archive/remove settles for an id it cannot apply to.
+constexpr int kRedraws = 8;
+
+// A paced client spins rather than sleeps when its next arrival is this close.
+constexpr microseconds kSpin{200};
+
+bool applies(LoadOp op, Life life) {
+  switch (op) {
+  case LoadOp::Complete:
+    return life == Life::Pending;
+  case LoadOp::Archive:
+    return life == Life::Pending || life == Life::Completed;
+  case LoadOp::Remove:
+    return life != Life::Gone;
+  default:
+    return true;
+  }
+}
+
+// log1p(x) / x, and expm1(x) / x, both tending to 1 near x = 0.
+double log1p_ratio(double x) {
+  return abs(x) > 1e-8 ? log1p(x) / x : 1 - x * (0.5 - x / 3);
+}
+
+double expm1_ratio(double x) {
+  return abs(x) > 1e-8 ? expm1(x) / x : 1 + x * (0.5 + x / 6);
+}
+
+/**
+ * @brief  Title, priority and due date of the task an add creates: all
+ *         derived from its id so a trace only needs to carry that.
+ */
+string load_title(int id) {
+  return "Load task " + to_string(id);
+}
+
+int add_load_task(TaskManager &mgr, int id, sys_days today) {
+  optional<ymd> due;
+  if (id % 3 != 0)
+    due = ymd{today + days{id % 30}};
+  return mgr.addTask(load_title(id), static_cast<Priority>(id % 4), due);
+}
+
+/**
+ * @brief  Latency at quantile q of sorted samples (nearest rank).
+ */
+double quantile(const vector<double> &sorted, double q) {
+  if (sorted.empty())
+    return 0;
+  size_t rank = static_cast<size_t>(ceil(q * static_cast<double>(sorted.size())));
+  return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
+} // namespace
+
+string_view load_op_name(LoadOp op) {
+  return kOpNames[static_cast<size_t>(op)];
+}
+
+optional<LoadOp> parse_load_op(string_view name) {
+  for (size_t i = 0; i < kOpNames.size(); ++i)
+    if (kOpNames[i] == name)
+      return static_cast<LoadOp>(i);
+  return nullopt;
+}
+
+ZipfSampler::ZipfSampler(double s) : s(s) {
+  h_first = hIntegral(1.5) - 1;
+  squeeze = 2 - hIntegralInverse(hIntegral(2.5) - h(2));
+}
+
+double ZipfSampler::h(double x) const {
+  return exp(-s * log(x));
+}
+
+double ZipfSampler::hIntegral(double x) const {
+  double log_x = log(x);
+  return expm1_ratio((1 - s) * log_x) * log_x;
+}
+
+double ZipfSampler::hIntegralInverse(double x) const {
+  double t = max(-1.0, x * (1 - s));
+  return exp(log1p_ratio(t) * x);
+}
+
+/**
+ * @brief  Draws a point under the integral of h over [0.5, n + 0.5] and
+ *         keeps the integer nearest its inverse if it falls under the
+ *         histogram bar there; most do, so a draw takes about one try.
+ */
+uint64_t ZipfSampler::operator()(mt19937_64 &rng, uint64_t n) const {
+  double h_last = hIntegral(static_cast<double>(n) + 0.5);
+  uniform_real_distribution<double> unit(0.0, 1.0);
+  while (true) {
+    double u = h_last + unit(rng) * (h_first - h_last);
+    double x = hIntegralInverse(u);
+    double k = clamp(floor(x + 0.5), 1.0, static_cast<double>(n));
+    if (k - x <= squeeze || u >= hIntegral(k + 0.5) - h(k))
+      return static_cast<uint64_t>(k) - 1;
+  }
+}
+
+/**
+ * @brief  Arrivals: exponential gaps at the current rate, which switches
+ *         between base and burst after exponentially distributed spells.
+ *         Ids: Zipf rank r picks the r-th newest id.
+ */
+Trace generate_trace(const LoadProfile &profile) {
+  mt19937_64 rng(profile.seed);
+  ZipfSampler zipf(profile.zipf);
+  discrete_distribution<size_t> pick(profile.mix.begin(), profile.mix.end());
+  exponential_distribution<double> unit_gap(1.0);
+
+  Trace trace{profile.preload, {}};
+  trace.entries.reserve(profile.ops);
+  vector<Life> life(profile.preload + 1, Life::Pending);
+  life[0] = Life::Gone;
+
+  bool bursting = false;
+  double now_us = 0;
+  double switch_us = unit_gap(rng) * profile.calm_ms * 1000;
+  for (size_t i = 0; i < profile.ops; ++i) {
+    now_us += unit_gap(rng) / (profile.rate * (bursting ? profile.burst : 1)) * 1e6;
+    while (now_us >= switch_us) {
+      bursting = !bursting;
+      switch_us += unit_gap(rng) * (bursting ? profile.burst_ms : profile.calm_ms) * 1000;
+    }
+
+    auto op = static_cast<LoadOp>(pick(rng));
+    int id = 0;
+    if (op == LoadOp::Add) {
+      id = static_cast<int>(life.size());
+      life.push_back(Life::Pending);
+    } else if (op == LoadOp::List) {
+      id = profile.list_rows;
+    } else if (life.size() > 1) {
+      size_t newest = life.size() - 1;
+      for (int tries = 0; tries < kRedraws; ++tries) {
+        id = static_cast<int>(newest - zipf(rng, newest));
+        if (applies(op, life[id]))
+          break;
+      }
+      if (applies(op, life[id]))
+        life[id] = op == LoadOp::Complete ? Life::Completed : op == LoadOp::Archive ? Life::Archived : Life::Gone;
+    }
+    trace.entries.push_back({static_cast<int64_t>(now_us), op, id});
+  }
+  return trace;
+}
+
+bool write_trace(const string &path, const Trace &trace) {
+  string buf = "# todo-loadgen trace: <µs> <op> <id>\n# preload " + to_string(trace.preload) + "\n";
+  for (const TraceEntry &entry : trace.entries) {
+    buf += to_string(entry.at_us);
+    buf += ' ';
+    buf += load_op_name(entry.op);
+    buf += ' ';
+    buf += to_string(entry.id);
+    buf += '\n';
+  }
+  ofstream out(path, ios::binary | ios::trunc);
+  out.write(buf.data(), static_cast<streamsize>(buf.size()));
+  out.close();
+  if (!out) {
+    cerr << BLOOD << FAIL << " Error writing file " << path << "." << RESET << endl;
+    return false;
+  }
+  return true;
+}
+
+optional<Trace> read_trace(const string &path) {
+  ifstream in(path);
+  if (!in) {
+    cerr << BLOOD << FAIL << " Error opening file " << path << "." << RESET << endl;
+    return nullopt;
+  }
+
+  static constexpr string_view kPreload = "# preload ";
+  Trace trace;
+  string line;
+  for (size_t number = 1; getline(in, line); ++number) {
+    string_view text{line};
+    if (text.starts_with(kPreload)) {
+      text.remove_prefix(kPreload.size());
+      from_chars(text.data(), text.data() + text.size(), trace.preload);
+      continue;
+    }
+    if (text.empty() || text.front() == '#')
+      continue;
+
+    TraceEntry entry;
+    size_t first = text.find(' ');
+    size_t second = first == string_view::npos ? first : text.find(' ', first + 1);
+    optional<LoadOp> op = second == string_view::npos ? nullopt
+                                                      : parse_load_op(text.substr(first + 1, second - first - 1));
+    if (!op.has_value() || from_chars(text.data(), text.data() + first, entry.at_us).ec != errc{} ||
+        from_chars(text.data() + second + 1, text.data() + text.size(), entry.id).ec != errc{}) {
+      cerr << BLOOD << FAIL << " Bad trace line " << number << " in " << path << "." << RESET << endl;
+      return nullopt;
+    }
+    entry.op = *op;
+    trace.entries.push_back(entry);
+  }
+  return trace;
+}
+
+void preload_tasks(TaskManager &mgr, size_t count) {
+  sys_days today{get_today()};
+  for (size_t id = 1; id <= count; ++id)
+    add_load_task(mgr, static_cast<int>(id), today);
+}
+
+/**
+ * @brief  Each client takes every clients-th entry. An add whose task got a
+ *         different id than the trace expected (a manager that was not
+ *         empty) is remembered, so later operations on it find it.
+ */
+LoadReport replay_trace(const Trace &trace, TaskManager &mgr, unsigned clients, bool paced) {
+  clients = max(clients, 1u);
+  int last_id = static_cast<int>(trace.preload);
+  for (const TraceEntry &entry : trace.entries)
+    if (entry.op == LoadOp::Add)
+      last_id = max(last_id, entry.id);
+  vector<atomic<int>> moved(static_cast<size_t>(last_id) + 1);
+  auto resolve = [&](int id) {
+    int to = id >= 0 && id <= last_id ? moved[id].load(memory_order_relaxed) : 0;
+    return to != 0 ? to : id;
+  };
+
+  struct Sample {
+    LoadOp op;
+    bool ok;
+    double us;
+  };
+  vector<vector<Sample>> samples(clients);
+  sys_days today{get_today()};
+  auto start = steady_clock::now();
+
+  auto client = [&](unsigned c) {
+    vector<Sample> &out = samples[c];
+    out.reserve(trace.entries.size() / clients + 1);
+    for (size_t i = c; i < trace.entries.size(); i += clients) {
+      const TraceEntry &entry = trace.entries[i];
+      // Behind schedule, the wait since arrival counts; ahead of it, only
+      // the operation does, not how late the sleep woke up
+      auto arrival = start + microseconds{entry.at_us};
+      auto begin = steady_clock::now();
+      if (paced && begin < arrival) {
+        // Sleeps overshoot by tens of µs, so the last stretch is spun
+        if (arrival - begin > kSpin)
+          this_thread::sleep_until(arrival - kSpin);
+        while ((begin = steady_clock::now()) < arrival) {
+        }
+      } else if (paced) {
+        begin = arrival;
+      }
+
+      bool ok = true;
+      switch (entry.op) {
+      case LoadOp::Add: {
+        int got = add_load_task(mgr, entry.id, today);
+        ok = got != FXN_FAILURE;
+        if (ok && got != entry.id && entry.id >= 0 && entry.id <= last_id)
+          moved[entry.id].store(got, memory_order_relaxed);
+        break;
+      }
+      case LoadOp::Complete:
+        ok = mgr.completeTask(resolve(entry.id));
+        break;
+      case LoadOp::Archive:
+        ok = mgr.archiveTask(resolve(entry.id));
+        break;
+      case LoadOp::Remove:
+        ok = mgr.removeTask(resolve(entry.id));
+        break;
+      case LoadOp::List:
+        mgr.topTasks(static_cast<size_t>(max(entry.id, 0)));
+        break;
+      }
+      out.push_back({entry.op, ok, duration<double, micro>(steady_clock::now() - begin).count()});
+    }
+  };
+  vector<thread> workers;
+  for (unsigned c = 1; c < clients; ++c)
+    workers.emplace_back(client, c);
+  client(0);
+  for (auto &w : workers)
+    w.join();
+
+  LoadReport report;
+  report.seconds = duration<double>(steady_clock::now() - start).count();
+  array<vector<double>, kLoadOpCount> times;
+  for (const auto &out : samples) {
+    for (const Sample &sample : out) {
+      OpLatency &stats = report.per_op[static_cast<size_t>(sample.op)];
+      ++stats.count;
+      stats.misses += sample.ok ? 0 : 1;
+      times[static_cast<size_t>(sample.op)].push_back(sample.us);
+    }
+    report.ops += out.size();
+  }
+  for (size_t op = 0; op < kLoadOpCount; ++op) {
+    sort(times[op].begin(), times[op].end());
+    OpLatency &stats = report.per_op[op];
+    stats.p50 = quantile(times[op], 0.5);
+    stats.p99 = quantile(times[op], 0.99);
+    stats.p999 = quantile(times[op], 0.999);
+    stats.max = times[op].empty() ? 0 : times[op].back();
+  }
+  return report;
+}
@@ -0,0 +1,165 @@
+/**
+ * @file    load_gen.hpp
+ * @brief   Synthetic and recorded command traffic for `todo_loadgen`: traces
+ *          of add/complete/archive/remove/list operations, and a replayer
+ *          that times each one against a TaskManager.
+ *
+ * A generated trace mixes operations in fixed proportions. Ids are drawn
+ * from a Zipf distribution over recency, so the newest tasks are the
+ * hottest. Arrivals follow a two-state Poisson process that spends most of
+ * its time at the base rate and short spells at a multiple of it. A trace is
+ * saved as text, one "<µs> <op> <id>" line per operation, so one recorded
+ * elsewhere can be replayed as is.
+ */
+
+#pragma once
+#include "task_manager.hpp"
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class LoadOp : uint8_t { Add,
+                              Complete,
+                              Archive,
+                              Remove,
+                              List };
+
+static constexpr size_t kLoadOpCount = 5;
+
+/**
+ * @brief   Name used in traces and reports ("add", "complete", ...).
+ */
+std::string_view load_op_name(LoadOp op);
+
+/**
+ * @brief   Inverse of load_op_name.
+ */
+std::optional<LoadOp> parse_load_op(std::string_view name);
+
+/**
+ * @struct TraceEntry
+ * @brief  One operation: when it arrives and what it touches. For an add,
+ *         `id` is the id the task is expected to get; for a list, the number
+ *         of rows asked for.
+ */
+struct TraceEntry {
+  int64_t at_us{0}; //< Arrival, in µs from the start of the trace.
+  LoadOp op{LoadOp::List};
+  int id{0};
+
+  bool operator==(const TraceEntry &) const = default;
+};
+
+/**
+ * @struct Trace
+ * @brief  Operations in arrival order, after `preload` tasks (ids 1..preload)
+ *         have been added to an empty manager.
+ */
+struct Trace {
+  size_t preload{0};
+  std::vector<TraceEntry> entries;
+};
+
+/**
+ * @struct LoadProfile
+ * @brief  Shape of a generated trace.
+ */
+struct LoadProfile {
+  size_t preload{10000};
+  size_t ops{100000};
+  std::array<double, kLoadOpCount> mix{25, 20, 5, 5, 45}; //< Relative weight per LoadOp.
+  double zipf{0.99};      //< Skew of id popularity by recency; 0 is uniform.
+  double rate{5000};      //< Base arrivals per second.
+  double burst{10};       //< Arrival rate multiplier during a burst.
+  double burst_ms{200};   //< Mean length of a burst,
+  double calm_ms{2000};   //< and of the calm between two.
+  int list_rows{20};      //< Rows per list.
+  uint32_t seed{1};
+};
+
+/**
+ * @class ZipfSampler
+ * @brief  Ranks 0..n-1 with P(r) ∝ 1/(r+1)^s, by rejection-inversion
+ *         (Hörmann and Derflinger), so n may change from draw to draw at no
+ *         setup cost.
+ */
+class ZipfSampler {
+public:
+  explicit ZipfSampler(double s);
+
+  /**
+   * @brief  Draw a rank below n (n ≥ 1).
+   */
+  uint64_t operator()(std::mt19937_64 &rng, uint64_t n) const;
+
+private:
+  double s;
+  double h_first; //< hIntegral(1.5) - 1.
+  double squeeze; //< Below this distance a candidate is accepted at once.
+
+  double h(double x) const;
+  double hIntegral(double x) const;
+  double hIntegralInverse(double x) const;
+};
+
+/**
+ * @brief   Generate a trace. Completes, archives and removes aim at tasks
+ *          still in a state they apply to, redrawing a few times before
+ *          settling for one that is not (which the replay counts as a miss).
+ */
+Trace generate_trace(const LoadProfile &profile);
+
+/**
+ * @brief   Save a trace as text.
+ * @return  False if the file could not be written.
+ */
+bool write_trace(const std::string &path, const Trace &trace);
+
+/**
+ * @brief   Read a trace saved by write_trace. Blank lines and lines starting
+ *          with '#' other than the preload header are skipped.
+ * @return  nullopt (with the bad line reported) if it does not parse.
+ */
+std::optional<Trace> read_trace(const std::string &path);
+
+/**
+ * @struct OpLatency
+ * @brief  Latency summary for one kind of operation, in µs.
+ */
+struct OpLatency {
+  size_t count{0};
+  size_t misses{0}; //< Operations the manager refused (task missing or in
+                    //< the wrong state).
+  double p50{0}, p99{0}, p999{0}, max{0};
+};
+
+/**
+ * @struct LoadReport
+ * @brief  What a replay did and how long it took.
+ */
+struct LoadReport {
+  double seconds{0}; //< Wall time, first arrival to last completion.
+  size_t ops{0};
+  std::array<OpLatency, kLoadOpCount> per_op{};
+
+  double throughput() const { return seconds > 0 ? static_cast<double>(ops) / seconds : 0; }
+};
+
+/**
+ * @brief   Add the trace's preload tasks to a manager (within its task
+ *          limit; see TaskManager::setTaskLimit).
+ */
+void preload_tasks(TaskManager &mgr, size_t count);
+
+/**
+ * @brief   Run a trace against a manager and time every operation.
+ * @param   clients  Threads sharing the trace round-robin.
+ * @param   paced    Issue each operation at its arrival time and measure
+ *                   from then, so time spent queued behind a slow one
+ *                   counts; otherwise back to back, measuring each alone.
+ */
+LoadReport replay_trace(const Trace &trace, TaskManager &mgr, unsigned clients = 1, bool paced = false);
@@ -0,0 +1,127 @@
+/**
+ * @file    loadgen_main.cpp
+ * @brief   `todo_loadgen`: drive a TaskManager with generated or recorded
+ *          traffic and report throughput and latency per operation.
+ *
+ * Usage: ./todo_loadgen [--ops N] [--preload N] [--mix add=W,complete=W,...]
+ *                       [--zipf S] [--rate OPS] [--burst X] [--seed N]
+ *                       [--record FILE | --replay FILE] [--store FILE]
+ *                       [--clients N] [--paced] [--max-p99 US]
+ */
+
+#include "load_gen.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+
+using namespace std;
+
+namespace {
+
+void usage() {
+  cerr << BLOOD << FAIL
+       << " Usage: ./todo_loadgen [--ops N] [--preload N] [--mix add=W,complete=W,archive=W,remove=W,list=W]"
+          " [--zipf S] [--rate OPS] [--burst X] [--seed N] [--record FILE | --replay FILE] [--store FILE]"
+          " [--clients N] [--paced] [--max-p99 US]"
+       << RESET << endl;
+}
+
+/**
+ * @brief  "add=25,list=75": ops left out get weight 0.
+ */
+bool parse_mix(string_view text, array<double, kLoadOpCount> &mix) {
+  mix.fill(0);
+  while (!text.empty()) {
+    string_view term = text.substr(0, text.find(','));
+    text.remove_prefix(min(text.size(), term.size() + 1));
+    size_t eq = term.find('=');
+    optional<LoadOp> op = eq == string_view::npos ? nullopt : parse_load_op(term.substr(0, eq));
+    if (!op.has_value())
+      return false;
+    mix[static_cast<size_t>(*op)] = atof(string{term.substr(eq + 1)}.c_str());
+  }
+  return any_of(mix.begin(), mix.end(), [](double w) { return w > 0; });
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  LoadProfile profile;
+  string record, replay, store;
+  unsigned clients = 1;
+  bool paced = false;
+  double max_p99 = 0;
+  for (int i = 1; i < argc; ++i) {
+    string_view arg{argv[i]};
+    bool more = i + 1 < argc;
+    if (arg == "--ops" && more)
+      profile.ops = strtoull(argv[++i], nullptr, 10);
+    else if (arg == "--preload" && more)
+      profile.preload = strtoull(argv[++i], nullptr, 10);
+    else if (arg == "--mix" && more && parse_mix(argv[i + 1], profile.mix))
+      ++i;
+    else if (arg == "--zipf" && more)
+      profile.zipf = atof(argv[++i]);
+    else if (arg == "--rate" && more && atof(argv[i + 1]) > 0)
+      profile.rate = atof(argv[++i]);
+    else if (arg == "--burst" && more && atof(argv[i + 1]) > 0)
+      profile.burst = atof(argv[++i]);
+    else if (arg == "--seed" && more)
+      profile.seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    else if (arg == "--record" && more)
+      record = argv[++i];
+    else if (arg == "--replay" && more)
+      replay = argv[++i];
+    else if (arg == "--store" && more)
+      store = argv[++i];
+    else if (arg == "--clients" && more && atoi(argv[i + 1]) > 0)
+      clients = static_cast<unsigned>(atoi(argv[++i]));
+    else if (arg == "--paced")
+      paced = true;
+    else if (arg == "--max-p99" && more)
+      max_p99 = atof(argv[++i]);
+    else {
+      usage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  optional<Trace> trace = replay.empty() ? generate_trace(profile) : read_trace(replay);
+  if (!trace.has_value())
+    return EXIT_FAILURE;
+  if (!record.empty() && !write_trace(record, *trace))
+    return EXIT_FAILURE;
+
+  // A real store stands in for the preload: the trace's ids refer to its tasks
+  TaskManager mgr;
+  mgr.setTaskLimit(SIZE_MAX);
+  if (!store.empty()) {
+    if (!mgr.loadFromFile(store))
+      return EXIT_FAILURE;
+  } else {
+    preload_tasks(mgr, trace->preload);
+  }
+
+  // Refused operations are expected and counted, not reported one by one
+  streambuf *err = cerr.rdbuf(nullptr);
+  LoadReport report = replay_trace(*trace, mgr, clients, paced);
+  cerr.rdbuf(err);
+
+  printf("%zu ops in %.2f s (%u client%s, %s): %.0f ops/s\n", report.ops, report.seconds, clients,
+         clients == 1 ? "" : "s", paced ? "paced" : "back to back", report.throughput());
+  printf("%-9s %9s %8s %10s %10s %10s %10s\n", "op", "count", "misses", "p50 µs", "p99 µs", "p999 µs", "max µs");
+  bool slow = false;
+  for (size_t op = 0; op < kLoadOpCount; ++op) {
+    const OpLatency &stats = report.per_op[op];
+    if (stats.count == 0)
+      continue;
+    printf("%-9s %9zu %8zu %9.1f %9.1f %9.1f %9.1f\n", load_op_name(static_cast<LoadOp>(op)).data(), stats.count,
+           stats.misses, stats.p50, stats.p99, stats.p999, stats.max);
+    slow = slow || (max_p99 > 0 && stats.p99 > max_p99);
+  }
+  if (slow) {
+    cerr << BLOOD << FAIL << " p99 above " << max_p99 << " µs." << RESET << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file    lz_codec.cpp
+ * @brief   Implements the LZ77 sequence encoder and decoder.
+ */
+
+#include "lz_codec.hpp"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+// Shortest match worth a sequence, and the farthest one an offset can reach.
+static constexpr size_t kMinMatch = 4;
+static constexpr size_t kMaxOffset = 65535;
+// Hash table of the last position each 4-byte prefix was seen at.
+static constexpr int kHashBits = 16;
+
+namespace {
+
+uint32_t read32(const char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint32_t hash4(const char *p) {
+  return (read32(p) * 2654435761u) >> (32 - kHashBits);
+}
+
+/**
+ * @brief  Length beyond a nibble: 255-valued bytes, then the remainder.
+ */
+void put_length(string &out, size_t extra) {
+  for (; extra >= 255; extra -= 255)
+    out += static_cast<char>(255);
+  out += static_cast<char>(extra);
+}
+
+bool get_length(string_view in, size_t &pos, size_t &length) {
+  unsigned char byte;
+  do {
+    if (pos >= in.size())
+      return false;
+    byte = static_cast<unsigned char>(in[pos++]);
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+void put_sequence(string &out, string_view literals, size_t offset, size_t match) {
+  size_t lit_nibble = min<size_t>(literals.size(), 15);
+  size_t match_nibble = match == 0 ? 0 : min<size_t>(match - kMinMatch, 15);
+  out += static_cast<char>((lit_nibble << 4) | match_nibble);
+  if (lit_nibble == 15)
+    put_length(out, literals.size() - 15);
+  out.append(literals);
+  if (match == 0)
+    return;
+  out += static_cast<char>(offset & 0xff);
+  out += static_cast<char>(offset >> 8);
+  if (match_nibble == 15)
+    put_length(out, match - kMinMatch - 15);
+}
+
+} // namespace
+
+/**
+ * @brief  Greedy: take the candidate the hash table remembers if it really
+ *         matches, extend it as far as it goes, and move on.
+ */
+string lz_compress(string_view raw) {
+  string out;
+  out.reserve(raw.size() / 2 + 16);
+  vector<uint32_t> table(size_t{1} << kHashBits, UINT32_MAX);
+
+  const char *base = raw.data();
+  size_t anchor = 0, pos = 0;
+  while (pos + kMinMatch <= raw.size()) {
+    uint32_t h = hash4(base + pos);
+    size_t candidate = table[h];
+    table[h] = static_cast<uint32_t>(pos);
+
+    if (candidate == UINT32_MAX || pos - candidate > kMaxOffset || read32(base + candidate) != read32(base + pos)) {
+      ++pos;
+      continue;
+    }
+
+    size_t match = kMinMatch;
+    while (pos + match < raw.size() && base[candidate + match] == base[pos + match])
+      ++match;
+    put_sequence(out, raw.substr(anchor, pos - anchor), pos - candidate, match);
+    pos += match;
+    anchor = pos;
+  }
+  put_sequence(out, raw.substr(anchor), 0, 0);
+  return out;
+}
+
+/**
+ * @brief  Bounds-checks every length and offset, so corrupt input fails
+ *         instead of reading or writing out of range.
+ */
+optional<string> lz_decompress(string_view packed, size_t raw_size) {
+  string out;
+  out.reserve(raw_size);
+  size_t pos = 0;
+  while (pos < packed.size()) {
+    unsigned char token = static_cast<unsigned char>(packed[pos++]);
+
+    size_t literals = token >> 4;
+    if (literals == 15 && !get_length(packed, pos, literals))
+      return nullopt;
+    if (literals > packed.size() - pos || out.size() + literals > raw_size)
+      return nullopt;
+    out.append(packed.substr(pos, literals));
+    pos += literals;
+
+    // The last sequence carries literals only
+    if (pos == packed.size())
+      break;
+
+    if (packed.size() - pos < 2)
+      return nullopt;
+    size_t offset = static_cast<unsigned char>(packed[pos]) | (static_cast<unsigned char>(packed[pos + 1]) << 8);
+    pos += 2;
+    size_t match = (token & 0x0f) + kMinMatch;
+    if ((token & 0x0f) == 15 && !get_length(packed, pos, match))
+      return nullopt;
+    if (offset == 0 || offset > out.size() || out.size() + match > raw_size)
+      return nullopt;
+
+    // Byte by byte: the source may overlap what is being written
+    size_t from = out.size() - offset;
+    for (size_t i = 0; i < match; ++i)
+      out += out[from + i];
+  }
+  if (out.size() != raw_size)
+    return nullopt;
+  return out;
+}
@@ -0,0 +1,32 @@
+/**
+ * @file    lz_codec.hpp
+ * @brief   Small self-contained LZ77 codec for the store's compressed files.
+ *
+ * Byte-oriented in the style of LZ4: each sequence is a token (literal count
+ * in the high nibble, match length - 4 in the low nibble, 15 meaning more
+ * length bytes follow), the literals, then a 2-byte little-endian offset and
+ * any extra length bytes. The final sequence has literals only. Matches are
+ * found through a hash of the next 4 bytes, so compression is one pass and
+ * decompression is a plain copy loop. Task records repeat their field names
+ * and much of their titles, which is where the ratio comes from.
+ */
+
+#pragma once
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief   Compress a buffer.
+ * @param   raw  Bytes to compress.
+ * @return  Compressed bytes (slightly larger than raw if it does not compress).
+ */
+std::string lz_compress(std::string_view raw);
+
+/**
+ * @brief   Decompress a buffer produced by lz_compress.
+ * @param   packed    Compressed bytes.
+ * @param   raw_size  Size of the original buffer.
+ * @return  The original bytes, or nullopt if packed is corrupt.
+ */
+std::optional<std::string> lz_decompress(std::string_view packed, size_t raw_size);
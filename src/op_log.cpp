@@ -0,0 +1,245 @@
+/**
+ * @file    op_log.cpp
+ * @brief   Implements inverse operations and the one-line-per-operation log.
+ */
+
+#include "op_log.hpp"
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+string_view op_name(OpKind kind) {
+  switch (kind) {
+  case OpKind::Add:
+    return "add";
+  case OpKind::Complete:
+    return "complete";
+  case OpKind::Archive:
+    return "archive";
+  case OpKind::Remove:
+    return "remove";
+  case OpKind::Edit:
+    return "edit";
+  }
+  return "?";
+}
+
+namespace {
+
+string join(const vector<int> &ids) {
+  if (ids.empty())
+    return "-";
+  string out;
+  for (int id : ids)
+    out += (out.empty() ? "" : ",") + to_string(id);
+  return out;
+}
+
+vector<int> split(const string &text) {
+  vector<int> ids;
+  if (text == "-")
+    return ids;
+  stringstream in(text);
+  string item;
+  while (getline(in, item, ','))
+    ids.push_back(stoi(item));
+  return ids;
+}
+
+/**
+ * @brief  "<kind> <id> <pr> <state> <due> <repeat> <after> <waiting> <spawned> <uid> <list> <title>"
+ */
+string write_op(const Operation &op) {
+  const Task &t = op.task;
+  return string(1, static_cast<char>(op.kind)) + ' ' + to_string(t.id) + ' ' +
+         to_string(static_cast<int>(t.pr)) + ' ' + to_string(static_cast<int>(t.state)) + ' ' +
+         (t.due.has_value() ? to_string(t.due.value()) : "-") + ' ' +
+         (t.repeat.active() ? t.repeat.str() : "-") + ' ' + join(t.after) + ' ' + join(op.waiting) + ' ' +
+         to_string(op.spawned) + ' ' + to_string(t.uid) + ' ' + list_name(t.list) + ' ' + t.title;
+}
+
+optional<Operation> read_op(const string &line) {
+  istringstream in(line);
+  char kind;
+  int pr, state;
+  string due, repeat, after, waiting, list;
+  Operation op;
+  if (!(in >> kind >> op.task.id >> pr >> state >> due >> repeat >> after >> waiting >> op.spawned >> op.task.uid >> list))
+    return nullopt;
+  if (kind != 'a' && kind != 'c' && kind != 'x' && kind != 'r' && kind != 'e')
+    return nullopt;
+  if (pr < 0 || pr > static_cast<int>(Priority::Critical) || state < 0 || state >= static_cast<int>(Status::All))
+    return nullopt;
+
+  in.get(); // the space before the title
+  getline(in, op.task.title);
+  op.kind = static_cast<OpKind>(kind);
+  op.task.pr = static_cast<Priority>(pr);
+  op.task.state = static_cast<Status>(state);
+  op.task.list = intern_list(list);
+  if (due != "-")
+    op.task.due = to_ymd(due);
+  if (repeat != "-")
+    op.task.repeat = Recurrence::parse(repeat).value_or(Recurrence{});
+  try {
+    op.task.after = split(after);
+    op.waiting = split(waiting);
+  } catch (...) {
+    return nullopt;
+  }
+  return op;
+}
+
+/**
+ * @brief  Waiting tasks lost their edge to op.task when it finished or went away.
+ */
+void relink(TaskManager &mgr, const Operation &op) {
+  for (int dependent : op.waiting)
+    if (mgr.getTask(dependent).has_value())
+      mgr.addDependency(dependent, op.task.id);
+}
+
+/**
+ * @brief  Put the snapshot's title, priority and due date back and keep the
+ *         ones they replace in it, so the same swap takes the step back.
+ */
+bool swap_edit(TaskManager &mgr, Operation &op) {
+  optional<Task> now = mgr.getTask(op.task.id);
+  if (!now.has_value()) {
+    cerr << BLOOD << FAIL << " Could not find task #" << op.task.id << " to edit." << RESET << endl;
+    return false;
+  }
+  if (!mgr.updateTask(op.task.id, {op.task.title, op.task.pr, op.task.due}))
+    return false;
+  op.task = std::move(*now);
+  return true;
+}
+
+} // namespace
+
+void OpLog::record(Operation op) {
+  undo_stack.push_back(std::move(op));
+  if (undo_stack.size() > kMaxOps)
+    undo_stack.pop_front();
+  redo_stack.clear();
+}
+
+bool OpLog::undo(TaskManager &mgr, Operation *done) {
+  if (undo_stack.empty())
+    return false;
+  Operation op = std::move(undo_stack.back());
+  undo_stack.pop_back();
+  if (!revert(mgr, op))
+    return false;
+
+  if (done)
+    *done = op;
+  redo_stack.push_back(std::move(op));
+  if (redo_stack.size() > kMaxOps)
+    redo_stack.pop_front();
+  return true;
+}
+
+bool OpLog::redo(TaskManager &mgr, Operation *done) {
+  if (redo_stack.empty())
+    return false;
+  Operation op = std::move(redo_stack.back());
+  redo_stack.pop_back();
+  if (!replay(mgr, op))
+    return false;
+
+  if (done)
+    *done = op;
+  undo_stack.push_back(std::move(op));
+  if (undo_stack.size() > kMaxOps)
+    undo_stack.pop_front();
+  return true;
+}
+
+/**
+ * @brief  Inverse of each kind; a recurring completion also takes back the
+ *         occurrence it spawned, and an edit swaps its fields back.
+ */
+bool OpLog::revert(TaskManager &mgr, Operation &op) {
+  switch (op.kind) {
+  case OpKind::Add:
+    return mgr.removeTask(op.task.id);
+  case OpKind::Complete:
+  case OpKind::Archive:
+    if (op.spawned != FXN_FAILURE && mgr.getTask(op.spawned).has_value())
+      mgr.removeTask(op.spawned);
+    if (!mgr.revertTask(op.task))
+      return false;
+    relink(mgr, op);
+    return true;
+  case OpKind::Remove:
+    if (!mgr.restoreTask(op.task))
+      return false;
+    relink(mgr, op);
+    return true;
+  case OpKind::Edit:
+    return swap_edit(mgr, op);
+  }
+  return false;
+}
+
+/**
+ * @brief  Redo runs the original command again, refreshing the snapshot and
+ *         released dependents so a later undo sees the current store.
+ */
+bool OpLog::replay(TaskManager &mgr, Operation &op) {
+  if (op.kind == OpKind::Add)
+    return mgr.restoreTask(op.task);
+  if (op.kind == OpKind::Edit)
+    return swap_edit(mgr, op);
+
+  optional<Task> before = mgr.getTask(op.task.id);
+  if (!before.has_value()) {
+    cerr << BLOOD << FAIL << " Could not find task #" << op.task.id << " to " << op_name(op.kind) << "." << RESET
+         << endl;
+    return false;
+  }
+  op.task = *before;
+  op.waiting = mgr.dependentsOf(op.task.id);
+
+  switch (op.kind) {
+  case OpKind::Complete:
+    return mgr.completeTask(op.task.id, &op.spawned);
+  case OpKind::Archive:
+    return mgr.archiveTask(op.task.id);
+  default:
+    return mgr.removeTask(op.task.id);
+  }
+}
+
+bool OpLog::load(const string &path) {
+  undo_stack.clear();
+  redo_stack.clear();
+  ifstream in(path);
+  if (!in)
+    return true;
+
+  string line;
+  while (getline(in, line)) {
+    if (line.size() < 3 || (line[0] != 'U' && line[0] != 'R') || line[1] != ' ')
+      return false;
+    optional<Operation> op = read_op(line.substr(2));
+    if (!op.has_value())
+      return false;
+    (line[0] == 'U' ? undo_stack : redo_stack).push_back(std::move(*op));
+  }
+  return true;
+}
+
+bool OpLog::save(const string &path) const {
+  string out;
+  for (const Operation &op : undo_stack)
+    out += "U " + write_op(op) + '\n';
+  for (const Operation &op : redo_stack)
+    out += "R " + write_op(op) + '\n';
+
+  ofstream file(path, ios::trunc);
+  file << out;
+  return static_cast<bool>(file);
+}
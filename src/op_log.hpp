@@ -0,0 +1,100 @@
+/**
+ * @file    op_log.hpp
+ * @brief   Bounded undo/redo history for `todo undo` and `todo redo`.
+ *
+ * Every mutating command records one Operation: what kind it was and a
+ * snapshot of the one task it touched, which is all its inverse needs (undo
+ * of add removes the task, undo of remove re-inserts the snapshot under its
+ * old id, undo of complete or archive restores the snapshot's status). The
+ * store itself is never copied. The log lives next to the store as one line
+ * per operation (tasks.json.log) and keeps at most kMaxOps per stack.
+ */
+
+#pragma once
+#include "task_manager.hpp"
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @enum   OpKind
+ * @brief  Command that produced an operation; the value is its log letter.
+ */
+enum class OpKind : char { Add = 'a',
+                           Complete = 'c',
+                           Archive = 'x',
+                           Remove = 'r',
+                           Edit = 'e' };
+
+/**
+ * @struct Operation
+ * @brief  One undoable change to a single task.
+ */
+struct Operation {
+  OpKind kind{OpKind::Add};
+  Task task{};                   //< After an add; before a complete, archive, remove or edit.
+  std::vector<int> waiting{};    //< Tasks that waited on it and were released.
+  int spawned{FXN_FAILURE};      //< Next occurrence added by completing a recurring task.
+};
+
+/**
+ * @brief  Verb for messages, e.g. "remove".
+ */
+std::string_view op_name(OpKind kind);
+
+/**
+ * @class  OpLog
+ * @brief  Undo and redo stacks of operations.
+ */
+class OpLog {
+public:
+  // Operations kept per stack; older ones are forgotten.
+  static constexpr size_t kMaxOps = 100;
+
+  /**
+   * @brief  Push a freshly applied operation; clears the redo stack.
+   */
+  void record(Operation op);
+
+  /**
+   * @brief  Apply the inverse of the latest operation and move it to redo.
+   * @param  mgr   Manager holding the full store.
+   * @param  done  (out, optional) The operation that was undone.
+   * @return False if there is nothing to undo or the store no longer
+   *         matches (the operation is then dropped).
+   */
+  bool undo(TaskManager &mgr, Operation *done = nullptr);
+
+  /**
+   * @brief  Re-apply the latest undone operation and move it back to undo.
+   * @param  mgr   Manager holding the full store.
+   * @param  done  (out, optional) The operation that was redone.
+   * @return False if there is nothing to redo or it no longer applies.
+   */
+  bool redo(TaskManager &mgr, Operation *done = nullptr);
+
+  size_t undoDepth() const { return undo_stack.size(); }
+  size_t redoDepth() const { return redo_stack.size(); }
+
+  /**
+   * @brief  Read a log written by save(). A missing file is an empty log.
+   * @param  path  Log file path.
+   * @return False if the file exists but is malformed.
+   */
+  bool load(const std::string &path);
+
+  /**
+   * @brief  Write both stacks, oldest first.
+   * @param  path  Log file path.
+   * @return True on success.
+   */
+  bool save(const std::string &path) const;
+
+private:
+  std::deque<Operation> undo_stack;
+  std::deque<Operation> redo_stack;
+
+  static bool revert(TaskManager &mgr, Operation &op);
+  static bool replay(TaskManager &mgr, Operation &op);
+};
@@ -0,0 +1,36 @@
+/**
+ * @file    rw_lock.hpp
+ * @brief   Reader-writer mutex that cannot starve writers.
+ *
+ * std::shared_mutex on glibc prefers readers, so a steady stream of list
+ * queries can block an add forever. RwLock puts a turnstile in front of it:
+ * a waiting writer holds the turnstile, new readers queue behind it and the
+ * readers already inside drain out.
+ */
+
+#pragma once
+#include <mutex>
+#include <shared_mutex>
+
+class RwLock {
+public:
+  // Exclusive side (std::unique_lock)
+  void lock() {
+    std::lock_guard gate(turnstile);
+    rw.lock();
+  }
+  bool try_lock() { return rw.try_lock(); }
+  void unlock() { rw.unlock(); }
+
+  // Shared side (std::shared_lock)
+  void lock_shared() {
+    { std::lock_guard gate(turnstile); }
+    rw.lock_shared();
+  }
+  bool try_lock_shared() { return rw.try_lock_shared(); }
+  void unlock_shared() { rw.unlock_shared(); }
+
+private:
+  std::mutex turnstile;
+  std::shared_mutex rw;
+};
@@ -0,0 +1,264 @@
+/**
+ * @file    store_follower.cpp
+ * @brief   Implements change notification and the two incremental refresh
+ *          paths (journal tail and record diff).
+ */
+
+#include "store_follower.hpp"
+#include "block_store.hpp"
+#include "store_lock.hpp"
+#include "task_file.hpp"
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <poll.h>
+#include <sstream>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+/**
+ * @brief  Size and modification time of the store and its edit journal;
+ *         any write to either changes it.
+ */
+array<int64_t, 4> file_stamp(const string &filename) {
+  array<int64_t, 4> stamp{};
+  struct stat info{};
+  if (stat(filename.c_str(), &info) == 0)
+    stamp = {info.st_size, info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec, 0, 0};
+  if (stat(journal_path(filename).c_str(), &info) == 0) {
+    stamp[2] = info.st_size;
+    stamp[3] = info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+  }
+  return stamp;
+}
+
+/**
+ * @brief  The whole store, decompressed. Caller holds the StoreLock.
+ * @return False if there is no store.
+ */
+bool read_text(const string &filename, string &text) {
+  ifstream in(filename, ios::binary);
+  if (!in)
+    return false;
+  in.seekg(0, ios::end);
+  text.resize(static_cast<size_t>(in.tellg()));
+  in.seekg(0);
+  in.read(text.data(), static_cast<streamsize>(text.size()));
+  if (is_block_store(text)) {
+    unique_ptr<istream> blocks = open_store(filename);
+    if (!blocks)
+      return false;
+    text.assign(istreambuf_iterator<char>(*blocks), istreambuf_iterator<char>());
+  }
+  return true;
+}
+
+StoreHeader header_of(string_view text) {
+  istringstream head(string{text.substr(0, min(text.size(), size_t{256}))});
+  return read_store_header(head);
+}
+
+} // namespace
+
+StoreFollower::StoreFollower(string filename) : filename(std::move(filename)) {
+  fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0)
+    return;
+  // The directory, not the file: a store that does not exist yet can appear
+  string dir = filesystem::path(this->filename).parent_path().string();
+  if (inotify_add_watch(fd, dir.empty() ? "." : dir.c_str(),
+                        IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_TO) < 0) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+StoreFollower::~StoreFollower() {
+  if (fd >= 0)
+    close(fd);
+}
+
+bool StoreFollower::load(TaskManager &mgr) {
+  StoreLock lock(filename, StoreLock::Mode::Shared);
+  stamp = file_stamp(filename);
+  string text;
+  if (!mgr.loadFromFile(filename) || !read_text(filename, text))
+    return false;
+
+  StoreHeader header = header_of(text);
+  generation = header.generation;
+  rewritten = header.rewritten;
+  journal_at = 0;
+  read_journal(journal_path(filename), journal_at);
+  sums.clear();
+  fingerprint(text, nullptr, {});
+  return true;
+}
+
+/**
+ * @brief  Events for the lock file and other sidecars are drained but do not
+ *         count; the wait goes on until its deadline.
+ */
+bool StoreFollower::wait(int timeout_ms) {
+  if (fd < 0) {
+    this_thread::sleep_for(milliseconds{timeout_ms});
+    array<int64_t, 4> now = file_stamp(filename);
+    bool moved = now != stamp;
+    stamp = now;
+    return moved;
+  }
+
+  string store = filesystem::path(filename).filename().string();
+  string journal = filesystem::path(journal_path(filename)).filename().string();
+  auto deadline = steady_clock::now() + milliseconds{timeout_ms};
+  bool hit = false;
+  while (true) {
+    auto left = hit ? 0 : max<int64_t>(0, duration_cast<milliseconds>(deadline - steady_clock::now()).count());
+    pollfd ready{fd, POLLIN, 0};
+    if (poll(&ready, 1, static_cast<int>(left)) <= 0)
+      return hit;
+
+    alignas(inotify_event) char buffer[4096];
+    for (ssize_t n; (n = read(fd, buffer, sizeof(buffer))) > 0;) {
+      for (char *at = buffer; at < buffer + n;) {
+        auto *event = reinterpret_cast<inotify_event *>(at);
+        string_view name = event->len > 0 ? string_view{event->name} : string_view{};
+        hit = hit || name == store || name == journal;
+        at += sizeof(inotify_event) + event->len;
+      }
+    }
+    if (!hit && left == 0)
+      return false;
+  }
+}
+
+/**
+ * @brief  The header alone decides between nothing to do, the journal tail
+ *         and the record diff; a store without the "rewritten" field always
+ *         takes the diff.
+ */
+StoreFollower::Refresh StoreFollower::refresh(TaskManager &mgr) {
+  Refresh result;
+  string text;
+  vector<unique_ptr<Task>> edits;
+  TaskManager::StoreChanges changes;
+  uint64_t journal_end = journal_at;
+  {
+    StoreLock lock(filename, StoreLock::Mode::Shared);
+    stamp = file_stamp(filename);
+    unique_ptr<istream> in = open_store(filename);
+    if (!in)
+      return result;
+    StoreHeader header = read_store_header(*in);
+    in.reset();
+    if (header.generation == generation && !sums.empty())
+      return result;
+    changes.generation = header.generation;
+    changes.next_id = header.next_id;
+
+    if (header.rewritten_at != 0 && header.rewritten == rewritten && !sums.empty()) {
+      // Appends only: fold the new journal records into the tasks they edit
+      edits = read_journal(journal_path(filename), journal_end);
+      result.kind = Refresh::Kind::Journal;
+      result.parsed = edits.size();
+      unordered_set<int> picked;
+      for (const auto &edit : edits)
+        if (optional<Task> task = mgr.getTask(edit->id);
+            task.has_value() && task->uid == edit->uid && picked.insert(edit->id).second)
+          changes.records.push_back(make_unique<Task>(std::move(*task)));
+      fold_journal(changes.records, std::move(edits));
+      generation = header.generation;
+      journal_at = journal_end;
+    } else {
+      if (!read_text(filename, text))
+        return result;
+      journal_end = 0;
+      edits = read_journal(journal_path(filename), journal_end);
+      changes.removed = read_tombstones(tombstone_path(filename));
+      generation = header.generation;
+      rewritten = header.rewritten;
+      journal_at = journal_end;
+    }
+  }
+  if (result.kind == Refresh::Kind::Journal) {
+    result.changed = mgr.adoptChanges(std::move(changes), filename);
+    return result;
+  }
+
+  // Records edited in the journal are re-read too, since their hash does
+  // not show the edit
+  unordered_set<int> touched;
+  for (const auto &edit : edits)
+    touched.insert(edit->id);
+  string changed;
+  changes.gone = fingerprint(text, &changed, touched);
+
+  parse_records(changed, changes.records);
+  fold_journal(changes.records, std::move(edits));
+  result.kind = Refresh::Kind::Diff;
+  result.parsed = changes.records.size();
+  result.changed = mgr.adoptChanges(std::move(changes), filename);
+  return result;
+}
+
+/**
+ * @brief  A record runs from the line after the previous one closed to its
+ *         own closing line, found by jumping from '}' to '}' rather than
+ *         looking at every line. The comma after all but the last record is
+ *         left out of the hash, so appending a record does not change its
+ *         predecessor's.
+ */
+vector<int> StoreFollower::fingerprint(string_view text, string *changed, const unordered_set<int> &touched) {
+  ++pass;
+  sums.reserve(sums.size() + 16);
+  size_t start = text.find("\"tasks\"");
+  start = start == string_view::npos ? text.size() : text.find('\n', start) + 1;
+
+  static constexpr string_view kId = "\"id\": ";
+  for (size_t pos = start; (pos = text.find('}', pos)) != string_view::npos;) {
+    size_t bol = text.rfind('\n', pos) + 1;
+    size_t eol = text.find('\n', pos);
+    if (eol == string_view::npos)
+      break;
+    if (!closes_record(text.substr(bol, eol - bol))) {
+      pos = eol;
+      continue;
+    }
+    string_view record = text.substr(start, eol + 1 - start);
+    start = pos = eol + 1;
+
+    size_t key = record.find(kId);
+    int id = 0;
+    if (key == string_view::npos ||
+        from_chars(record.data() + key + kId.size(), record.data() + record.size(), id).ec != errc{})
+      continue;
+    string_view body = record.substr(0, record.size() - 1);
+    if (body.ends_with(','))
+      body.remove_suffix(1);
+    uint64_t hash = std::hash<string_view>{}(body);
+
+    auto [it, fresh] = sums.try_emplace(id);
+    if (changed != nullptr && (fresh || it->second.hash != hash || touched.contains(id)))
+      changed->append(record);
+    it->second = {hash, pass};
+  }
+
+  vector<int> gone;
+  for (auto it = sums.begin(); it != sums.end();) {
+    if (it->second.pass != pass) {
+      gone.push_back(it->first);
+      it = sums.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return gone;
+}
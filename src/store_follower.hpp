@@ -0,0 +1,106 @@
+/**
+ * @file    store_follower.hpp
+ * @brief   Keeps a loaded TaskManager in step with a store that other
+ *          processes write, without re-reading the whole file per change.
+ *
+ * inotify on the store's directory says when tasks.json or its journal was
+ * written; where inotify is unavailable the files' size and mtime are
+ * compared instead. The header then tells what kind of write it was:
+ *
+ *  - Only "generation" moved: an edit was appended to the journal. Just the
+ *    records past the journal offset already read are parsed, and folded
+ *    into the tasks they edit.
+ *  - "rewritten" moved too: a full save or an in-place status patch. The file
+ *    is split into records and each one hashed; only records whose hash
+ *    differs from last time are parsed, and ids no longer present are dropped.
+ *
+ * Either way the manager ends up as a fresh loadFromFile would leave it.
+ */
+
+#pragma once
+#include "task_manager.hpp"
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+class StoreFollower {
+public:
+  /**
+   * @struct Refresh
+   * @brief  What one refresh() found and did.
+   */
+  struct Refresh {
+    enum class Kind { Unchanged,
+                      Journal,
+                      Diff };
+    Kind kind{Kind::Unchanged};
+    size_t parsed{0};  //< Records parsed.
+    size_t changed{0}; //< Tasks replaced, added or dropped.
+  };
+
+  /**
+   * @brief  Start watching a store's directory. Nothing is read yet.
+   * @param  filename  Path to JSON file.
+   */
+  explicit StoreFollower(std::string filename);
+  ~StoreFollower();
+
+  StoreFollower(const StoreFollower &) = delete;
+  StoreFollower &operator=(const StoreFollower &) = delete;
+
+  /**
+   * @brief  Load the store into an empty manager and remember the record
+   *         fingerprints, both under one shared lock.
+   * @return False if there is no store yet (a later refresh reads it whole).
+   */
+  bool load(TaskManager &mgr);
+
+  /**
+   * @brief  Block until the store or its journal is written, or a timeout.
+   * @param  timeout_ms  Longest wait.
+   * @return True if either file changed (refresh() then has work to do).
+   */
+  bool wait(int timeout_ms);
+
+  /**
+   * @brief  Apply whatever was saved since the last load or refresh.
+   * @param  mgr  Manager filled by load(), holding no unsaved changes.
+   */
+  Refresh refresh(TaskManager &mgr);
+
+  /**
+   * @brief  Whether change notification is on (false: wait() polls).
+   */
+  bool watching() const { return fd >= 0; }
+
+private:
+  std::string filename;
+  int fd{-1}; //< inotify descriptor, or -1.
+
+  /**
+   * @struct Sum
+   * @brief  Hash of one record's bytes, and the pass that last saw it.
+   */
+  struct Sum {
+    uint64_t hash{0};
+    uint32_t pass{0};
+  };
+
+  std::unordered_map<int, Sum> sums; //< Id → its record's fingerprint.
+  uint32_t pass{0};                  //< Bumped by every fingerprint().
+  uint64_t generation{0};            //< Header as last read.
+  uint64_t rewritten{0};
+  uint64_t journal_at{0};            //< Journal bytes already folded in.
+  std::array<int64_t, 4> stamp{-1}; //< Store and journal mtime and size, for polling.
+
+  /**
+   * @brief  Hash every record of a whole store text and update `sums`.
+   * @param  text     The store, decompressed.
+   * @param  changed  (out, optional) Records whose hash changed, or that are
+   *                  in `touched`, back to back.
+   * @param  touched  Ids to put in `changed` regardless (journaled edits).
+   * @return Ids that were in `sums` but are no longer in the store.
+   */
+  std::vector<int> fingerprint(std::string_view text, std::string *changed, const std::unordered_set<int> &touched);
+};
@@ -0,0 +1,50 @@
+/**
+ * @file    store_lock.cpp
+ * @brief   Implements the flock-based store lock.
+ */
+
+#include "store_lock.hpp"
+#include "task_file.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <unordered_set>
+
+using namespace std;
+
+namespace {
+
+// Lock files this thread already holds; inner StoreLocks on them are no-ops.
+thread_local unordered_set<string> held_here;
+
+} // namespace
+
+StoreLock::StoreLock(const string &store, Mode mode) : path(lock_path(store)) {
+  if (held_here.contains(path)) {
+    nested = true;
+    return;
+  }
+
+  fd = ::open(path.c_str(), mode == Mode::Exclusive ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+  if (fd < 0)
+    return;
+
+  int rc;
+  while ((rc = ::flock(fd, mode == Mode::Exclusive ? LOCK_EX : LOCK_SH)) != 0 && errno == EINTR) {
+  }
+  if (rc != 0) {
+    ::close(fd);
+    fd = -1;
+    return;
+  }
+  held_here.insert(path);
+}
+
+StoreLock::~StoreLock() {
+  if (fd < 0)
+    return;
+  held_here.erase(path);
+  ::flock(fd, LOCK_UN);
+  ::close(fd);
+}
@@ -0,0 +1,42 @@
+/**
+ * @file    store_lock.hpp
+ * @brief   Advisory lock shared by every `todo` process using one store.
+ *
+ * flock(2) on a sidecar (tasks.json.lock) rather than the store itself, since
+ * saves truncate and rewrite the store. Readers take it shared for the length
+ * of a read; writers take it exclusive to check the store's generation and
+ * write. Locks are re-entrant per thread, so a caller that already holds the
+ * exclusive lock can run code that locks again (a thread holding it shared
+ * must not ask for exclusive).
+ */
+
+#pragma once
+#include <string>
+
+class StoreLock {
+public:
+  enum class Mode { Shared,
+                    Exclusive };
+
+  /**
+   * @brief  Block until the lock is held. If the lock file cannot be opened
+   *         (e.g. a shared lock before any store was saved) it runs unlocked.
+   * @param  store  Path to tasks.json.
+   * @param  mode   Shared for reads, Exclusive for writes.
+   */
+  StoreLock(const std::string &store, Mode mode);
+  ~StoreLock();
+
+  StoreLock(const StoreLock &) = delete;
+  StoreLock &operator=(const StoreLock &) = delete;
+
+  /**
+   * @brief  True if this object (or an outer one on this thread) holds it.
+   */
+  bool held() const { return fd >= 0 || nested; }
+
+private:
+  std::string path;
+  int fd{-1};
+  bool nested{false};
+};
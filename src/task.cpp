@@ -4,11 +4,17 @@
  */
 
 #include "task.hpp"
+#include <algorithm>
+#include <charconv>
 #include <chrono>
+#include <deque>
 #include <iomanip>
+#include <mutex>
+#include <random>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 
 using namespace std;
 using namespace std::chrono;
@@ -20,7 +26,29 @@ static constexpr const char *kPriorityBlocks[4] = {
     "\e[0;105m \033[0m",
     "\e[0;101m \033[0m"};
 
-static const int LEN_PRIORITY_BAR = 8;
+static constexpr int LEN_PRIORITY_BAR = 8;
+static constexpr std::string_view kBlankBlock = "\033[40m \033[0m";
+
+/**
+ * @brief  One rendered bar: painted blocks then blank ones, built at compile time.
+ */
+struct PriorityBar {
+  std::array<char, LEN_PRIORITY_BAR * 16> text{};
+  size_t len = 0;
+};
+
+static consteval PriorityBar make_bar(int p) {
+  PriorityBar bar;
+  int painted_blocks = (p + 1) * 2;
+  for (int i = 0; i < LEN_PRIORITY_BAR; i++, painted_blocks--) {
+    std::string_view block = painted_blocks > 0 ? std::string_view{kPriorityBlocks[p]} : kBlankBlock;
+    for (char c : block)
+      bar.text[bar.len++] = c;
+  }
+  return bar;
+}
+
+static constexpr std::array<PriorityBar, 4> kPriorityBars = {make_bar(0), make_bar(1), make_bar(2), make_bar(3)};
 
 /**
  * @brief  Construct a Task with all fields.
@@ -51,6 +79,162 @@ bool is_overdue(const Task &task, const ymd &today) {
   return task.due.has_value() && (task.state != Status::Completed) && (task.due.value() < today);
 }
 
+/**
+ * @brief  Days/weeks step from the day; monthly picks day n of this month, or
+ *         of the next one if that is not after `from`.
+ */
+ymd Recurrence::nextAfter(const ymd &from) const {
+  switch (kind) {
+  case Repeat::Days:
+    return sys_days{from} + days{n};
+  case Repeat::Weeks:
+    return sys_days{from} + weeks{n};
+  case Repeat::Monthly: {
+    year_month ym = from.year() / from.month();
+    for (int step = 0; step < 2; ++step, ym += months{1}) {
+      unsigned last = unsigned((ym / std::chrono::last).day());
+      ymd candidate = ym / day{std::min(unsigned(n), last)};
+      if (sys_days{candidate} > sys_days{from})
+        return candidate;
+    }
+    return ym / day{1}; // unreachable: next month always qualifies
+  }
+  case Repeat::None:
+    break;
+  }
+  return from;
+}
+
+ymd Recurrence::firstFrom(const ymd &today) const {
+  return kind == Repeat::Monthly ? nextAfter(sys_days{today} - days{1}) : today;
+}
+
+/**
+ * @brief  Jumps whole periods for days/weeks instead of stepping one by one.
+ */
+ymd Recurrence::nextOccurrence(const ymd &due, const ymd &today) const {
+  ymd next = nextAfter(due);
+  if (sys_days{next} >= sys_days{today})
+    return next;
+
+  if (kind == Repeat::Days || kind == Repeat::Weeks) {
+    int period = kind == Repeat::Days ? n : 7 * n;
+    int behind = (sys_days{today} - sys_days{next}).count();
+    return sys_days{next} + days{(behind + period - 1) / period * period};
+  }
+  while (sys_days{next} < sys_days{today})
+    next = nextAfter(next);
+  return next;
+}
+
+optional<Recurrence> Recurrence::parse(string_view text) {
+  if (text == "day" || text == "daily")
+    return Recurrence{Repeat::Days, 1};
+  if (text == "week" || text == "weekly")
+    return Recurrence{Repeat::Weeks, 1};
+
+  int value = 0;
+  if (text.starts_with("month:")) {
+    string_view num = text.substr(6);
+    auto [end, ec] = from_chars(num.data(), num.data() + num.size(), value);
+    if (ec != errc{} || end != num.data() + num.size() || value < 1 || value > 31)
+      return nullopt;
+    return Recurrence{Repeat::Monthly, value};
+  }
+
+  auto [end, ec] = from_chars(text.data(), text.data() + text.size(), value);
+  if (ec != errc{} || value < 1 || value > 3650 || end + 1 != text.data() + text.size())
+    return nullopt;
+  if (*end == 'd')
+    return Recurrence{Repeat::Days, value};
+  if (*end == 'w')
+    return Recurrence{Repeat::Weeks, value};
+  return nullopt;
+}
+
+string Recurrence::str() const {
+  switch (kind) {
+  case Repeat::Days:
+    return std::to_string(n) + "d";
+  case Repeat::Weeks:
+    return std::to_string(n) + "w";
+  case Repeat::Monthly:
+    return "month:" + std::to_string(n);
+  case Repeat::None:
+    break;
+  }
+  return "";
+}
+
+namespace {
+
+/**
+ * Process-wide list name pool. A deque never moves its elements, so
+ * references handed out by list_name() stay valid as it grows.
+ */
+struct ListPool {
+  mutex mtx;
+  deque<string> names{string{kDefaultListName}};
+  unordered_map<string_view, ListId> ids{{names.front(), kDefaultList}};
+};
+
+ListPool &list_pool() {
+  static ListPool pool;
+  return pool;
+}
+
+} // namespace
+
+ListId intern_list(string_view name) {
+  ListPool &pool = list_pool();
+  lock_guard lock(pool.mtx);
+  if (auto it = pool.ids.find(name); it != pool.ids.end())
+    return it->second;
+  auto id = static_cast<ListId>(pool.names.size());
+  pool.ids.emplace(pool.names.emplace_back(name), id);
+  return id;
+}
+
+const string &list_name(ListId id) {
+  ListPool &pool = list_pool();
+  lock_guard lock(pool.mtx);
+  return id < pool.names.size() ? pool.names[id] : pool.names.front();
+}
+
+optional<ListId> find_list(string_view name) {
+  ListPool &pool = list_pool();
+  lock_guard lock(pool.mtx);
+  auto it = pool.ids.find(name);
+  return it == pool.ids.end() ? nullopt : optional{it->second};
+}
+
+/**
+ * @brief  64 random bits; collisions across stores are negligible.
+ */
+uint64_t new_uid() {
+  thread_local mt19937_64 rng{(static_cast<uint64_t>(random_device{}()) << 32) ^ random_device{}()};
+  uint64_t uid;
+  do
+    uid = rng();
+  while (uid == 0);
+  return uid;
+}
+
+/**
+ * @brief  FNV-1a over the id and title.
+ */
+uint64_t legacy_uid(const Task &task) {
+  uint64_t hash = 14695981039346656037ull;
+  auto mix = [&](string_view bytes) {
+    for (unsigned char c : bytes)
+      hash = (hash ^ c) * 1099511628211ull;
+  };
+  mix(std::to_string(task.id));
+  mix(string_view{"\0", 1});
+  mix(task.title);
+  return hash == 0 ? 1 : hash;
+}
+
 /**
  * @brief  Shorten titles longer than TITLE_MAX_LEN, appending "...".
  */
@@ -72,28 +256,14 @@ ymd get_today() {
  * @brief  Render a bar of colored blocks for a Priority.
  */
 string print_priority(Priority p) {
-  string bar;
-  int total_blocks = LEN_PRIORITY_BAR;
-  int painted_blocks = (static_cast<int>(p) + 1) * 2;
-
-  for (int i = 0; i < total_blocks; i++, painted_blocks--) {
-    if (painted_blocks > 0)
-      bar += kPriorityBlocks[static_cast<int>(p)];
-    else
-      bar += "\033[40m \033[0m"; // Unfilled block with black background
-  }
-  return bar; // Safe: returning by value
+  return string(priority_bar(p));
+}
+
+string_view priority_bar(Priority p) {
+  const PriorityBar &bar = kPriorityBars[static_cast<size_t>(p)];
+  return {bar.text.data(), bar.len};
 }
 
 string print_status(Status s) {
-  switch (s) {
-  case Status::Archived:
-    return "ARCHIVED";
-  case Status::Pending:
-    return "PENDING";
-  case Status::Completed:
-    return "COMPLETED";
-  default:
-    return "---";
-  }
+  return string(status_name(s));
 }
@@ -8,9 +8,14 @@
  * and standalone helpers for date parsing/formatting, title truncation, etc.
  */
 #pragma once
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 // Shortcut for C++20 chrono date type YYYY‑MM‑DD
@@ -34,6 +39,83 @@ enum class Status { Pending,
                     Archived,
                     All };
 
+/**
+ * @enum Repeat
+ * @brief How a recurring task schedules its next occurrence.
+ */
+enum class Repeat { None,
+                    Days,    //< every n days
+                    Weeks,   //< every n weeks
+                    Monthly }; //< on day n of each month (clamped to month end)
+
+/**
+ * @struct Recurrence
+ * @brief  Rule carried by the one pending occurrence of a recurring task.
+ *         Text form (CLI and store): "3d", "2w" or "month:15".
+ */
+struct Recurrence {
+  Repeat kind{Repeat::None};
+  int n{0};
+
+  bool active() const { return kind != Repeat::None; }
+  bool operator==(const Recurrence &other) const = default;
+
+  /**
+   * @brief  First scheduled date strictly after a day.
+   */
+  ymd nextAfter(const ymd &from) const;
+
+  /**
+   * @brief  First scheduled date on or after a day: the day itself for
+   *         days/weeks, the next day n of a month for monthly.
+   */
+  ymd firstFrom(const ymd &today) const;
+
+  /**
+   * @brief  Next due date once the occurrence due on `due` is done. Missed
+   *         occurrences are skipped, so the result is never before today.
+   */
+  ymd nextOccurrence(const ymd &due, const ymd &today) const;
+
+  /**
+   * @brief  Parse "Nd", "Nw", "day", "week" or "month:X".
+   * @return nullopt if malformed or out of range.
+   */
+  static std::optional<Recurrence> parse(std::string_view text);
+
+  /**
+   * @brief  Canonical text form, as accepted by parse().
+   */
+  std::string str() const;
+};
+
+/**
+ * Named list a task belongs to, as an index into a process-wide pool of list
+ * names, so every task of a list shares one copy of its name.
+ */
+using ListId = uint16_t;
+static constexpr ListId kDefaultList = 0;
+static constexpr std::string_view kDefaultListName = "default";
+
+/**
+ * @enum Field
+ * @brief Task fields that `todo merge` reconciles one by one, each carrying
+ *        its own logical clock (see Task::clock).
+ */
+enum class Field { Title,
+                   Pr,
+                   Due,
+                   List,
+                   Repeat,
+                   State };
+static constexpr size_t kFieldCount = 6;
+
+/**
+ * Removed tasks by uid, with the logical time of the removal, so a merge does
+ * not bring back a task another store already deleted.
+ */
+using Tombstones = std::unordered_map<uint64_t, uint32_t>;
+
 /* ANSI text styles */
 static constexpr char const *BOLD = "\033[1m";
 static constexpr char const *NOTICE = "\e[1;35m";
@@ -50,6 +132,9 @@ static constexpr char const *WARN = "⚠️";
 static constexpr char const *FAIL = "⛔️";
 static constexpr char const *DONE = "✅";
 
+/* Display words indexed by Status (All is only a filter) */
+static constexpr std::array<std::string_view, 4> kStatusNames = {"PENDING", "COMPLETED", "ARCHIVED", "---"};
+
 /* Maximum length of title before truncation */
 static constexpr size_t TITLE_MAX_LEN = 35;
 
@@ -63,6 +148,13 @@ struct Task {
   Priority pr{Priority::Medium};
   Status state{Status::Pending};
   std::optional<ymd> due{std::nullopt};
+  ListId list{kDefaultList}; //< See intern_list().
+  Recurrence repeat{};    //< Only the pending occurrence carries the rule.
+  std::vector<int> after; //< Unfinished prerequisites, maintained by TaskManager.
+  uint64_t sort_key{0};   //< Packed ranking, maintained by TaskManager.
+  size_t heap_slot{SIZE_MAX}; //< Position in its list's rank heap, maintained by TaskManager.
+  uint64_t uid{0};        //< Identity across stores; `id` is only a local handle.
+  std::array<uint32_t, kFieldCount> clock{}; //< Lamport time each Field last changed.
 
   /**
    * @brief  Default constructor (invalid id of -1).
@@ -88,6 +180,21 @@ struct Task {
    */
   bool operator==(const Task &other) const;
 
+  /**
+   * @brief  A pending task still waiting on a prerequisite.
+   */
+  bool blocked() const { return state == Status::Pending && !after.empty(); }
+
+  /**
+   * @brief  Record a change to one field at a logical time.
+   */
+  void stamp(Field field, uint32_t at) { clock[static_cast<size_t>(field)] = at; }
+
+  /**
+   * @brief  Logical time of the latest change to any field.
+   */
+  uint32_t lastChange() const { return *std::max_element(clock.begin(), clock.end()); }
+
   /**
    * @brief  Compute days remaining until the due date.
    * @return Number of days (may be negative if overdue).
@@ -112,6 +219,40 @@ ymd get_today();
  */
 bool is_overdue(const Task &task, const ymd &today);
 
+/**
+ * @brief   Look up or add a list name in the shared pool (thread-safe).
+ * @param   name  List name; kDefaultListName maps to kDefaultList.
+ * @return  Id of the name, stable for the life of the process.
+ */
+ListId intern_list(std::string_view name);
+
+/**
+ * @brief   Name of an interned list.
+ * @param   id  Id from intern_list().
+ * @return  Reference into the pool (never invalidated).
+ */
+const std::string &list_name(ListId id);
+
+/**
+ * @brief   Look up a list name without adding it to the pool.
+ * @param   name  List name.
+ * @return  Its id, or nullopt if nothing has interned it in this process.
+ */
+std::optional<ListId> find_list(std::string_view name);
+
+/**
+ * @brief   Fresh random uid for a new task (never 0).
+ */
+uint64_t new_uid();
+
+/**
+ * @brief   Uid for a record saved before tasks had one. Derived from the id and
+ *          title, so copies of the same old store agree on it.
+ * @param   task  Parsed record.
+ * @return  Stable non-zero uid.
+ */
+uint64_t legacy_uid(const Task &task);
+
 /**
  * @brief   Truncate a title to fit within TITLE_MAX_LEN.
  * @param   title  Original title.
@@ -126,9 +267,25 @@ std::string truncate(const std::string &title);
  */
 std::string print_priority(Priority p);
 
+/**
+ * @brief   Priority bar from a table built at compile time (no allocation).
+ * @param   p  Priority enum to draw.
+ * @return  View of static storage.
+ */
+std::string_view priority_bar(Priority p);
+
 /**
  * @brief   Print out word for status.
  * @param   s  Status enum.
  * @return  Text
  */
 std::string print_status(Status s);
+
+/**
+ * @brief   Status word from kStatusNames (no allocation).
+ * @param   s  Status enum.
+ * @return  View of static storage.
+ */
+constexpr std::string_view status_name(Status s) {
+  return kStatusNames[static_cast<size_t>(s)];
+}
@@ -4,11 +4,23 @@
  */
 
 #include "task_cli.hpp"
+#include "store_follower.hpp"
+#include "store_lock.hpp"
+#include "task_file.hpp"
+#include "task_watch.hpp"
 #include <algorithm>
+#include <charconv>
 #include <chrono>
+#include <filesystem>
 #include <optional>
+#include <spawn.h>
 #include <string_view>
 #include <strings.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unordered_set>
+
+extern char **environ;
 
 using namespace std;
 using namespace std::chrono;
@@ -52,7 +64,9 @@ optional<ymd> TaskCLI::parseDate(const string &in) {
 int TaskCLI::parseAdd(int argc, char *argv[],
                       string &title,
                       Priority &pr,
-                      optional<ymd> &due) {
+                      optional<ymd> &due,
+                      Recurrence &repeat,
+                      vector<int> &after) {
 
   string_view title_arg{argv[TITLE_IDX]};
   if (title_arg == "help") {
@@ -67,6 +81,15 @@ int TaskCLI::parseAdd(int argc, char *argv[],
       pr = parsePriority(argv[++i]);
     else if (arg == "--due" && ((i + 1) < argc))
       due = parseDate(argv[++i]);
+    else if (arg == "--every" && ((i + 1) < argc)) {
+      optional<Recurrence> rule = Recurrence::parse(argv[++i]);
+      if (!rule.has_value()) {
+        cerr << BLOOD << FAIL << " Repeat must be Nd, Nw or month:X (e.g. 3d, 2w, month:15)." << RESET << endl;
+        return EXIT_FAILURE;
+      }
+      repeat = *rule;
+    } else if (arg == "--after" && ((i + 1) < argc) && atoi(argv[i + 1]) > 0)
+      after.push_back(atoi(argv[++i]));
     else
       cerr << "Received unknown flag or argument: " << arg << endl;
   }
@@ -74,14 +97,385 @@ int TaskCLI::parseAdd(int argc, char *argv[],
   return EXIT_SUCCESS;
 }
 
+int TaskCLI::parseEdit(int argc, char *argv[], TaskManager::TaskEdit &edit) {
+  for (int i = TASK_ID_IDX + 1; i < argc; ++i) {
+    string_view arg{argv[i]};
+    if (arg == "--title" && ((i + 1) < argc))
+      edit.title = argv[++i];
+    else if (arg == "--priority" && ((i + 1) < argc))
+      edit.pr = parsePriority(argv[++i]);
+    else if (arg == "--due" && ((i + 1) < argc)) {
+      string date{argv[++i]};
+      optional<ymd> due = parseDate(date);
+      if (!due.has_value() && strcasecmp(date.c_str(), "none") != 0) {
+        cerr << BLOOD << FAIL << " Due date must be YYYY-MM-DD or none." << RESET << endl;
+        return EXIT_FAILURE;
+      }
+      edit.due = due;
+    } else
+      cerr << "Received unknown flag or argument: " << arg << endl;
+  }
+
+  if (!edit.title.has_value() && !edit.pr.has_value() && !edit.due.has_value()) {
+    cerr << BLOOD << FAIL << " Nothing to edit: give --title, --priority or --due." << RESET << endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief  Compacts argv in place so later positional indexes are unchanged.
+ */
+bool TaskCLI::extractList(int &argc, char *argv[], optional<ListId> &list) {
+  int out = 0;
+  for (int i = 0; i < argc; ++i) {
+    if (string_view{argv[i]} != "--list") {
+      argv[out++] = argv[i];
+      continue;
+    }
+    if (i + 1 >= argc) {
+      cerr << BLOOD << FAIL << " --list requires a name." << RESET << endl;
+      return false;
+    }
+    string name{argv[++i]};
+    transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return char(tolower(c)); });
+    if (name.empty() || !all_of(name.begin(), name.end(), [](unsigned char c) { return isalnum(c) || c == '-' || c == '_'; })) {
+      cerr << BLOOD << FAIL << " List names may only use letters, digits, '-' and '_'." << RESET << endl;
+      return false;
+    }
+    list = intern_list(name);
+  }
+  argc = out;
+  return true;
+}
+
+/**
+ * @brief  Tries the single-record patch first; loads everything only if the
+ *         store has no usable index yet.
+ */
+int TaskCLI::changeStatus(int id, Status state) {
+  const char *verb = state == Status::Completed ? "completed" : "archived";
+  Operation op{state == Status::Completed ? OpKind::Complete : OpKind::Archive};
+  optional<Task> spawned;
+
+  TaskManager::PatchResult patched;
+  {
+    // The log entry goes in under the same lock as the patch it records
+    StoreLock lock(STORE_FILE, StoreLock::Mode::Exclusive);
+    patched = TaskManager::patchStatus(STORE_FILE, id, state, &op.task);
+    if (patched == TaskManager::PatchResult::Patched)
+      recordOp(op);
+  }
+
+  switch (patched) {
+  case TaskManager::PatchResult::Patched:
+    break;
+  case TaskManager::PatchResult::Missing:     // may be in the cold archive
+  case TaskManager::PatchResult::Unavailable: {
+    auto apply = [&](TaskManager &mgr) {
+      if (!mgr.getTask(id).has_value())
+        mgr.loadArchive(STORE_FILE);
+      op.task = mgr.getTask(id).value_or(Task{});
+      op.waiting = mgr.dependentsOf(id);
+      bool ok = state == Status::Completed ? mgr.completeTask(id, &op.spawned) : mgr.archiveTask(id);
+      spawned = op.spawned == FXN_FAILURE ? nullopt : mgr.getTask(op.spawned);
+      return ok;
+    };
+    if (commit(apply, [&](TaskManager &) { recordOp(op); }) != EXIT_SUCCESS)
+      return EXIT_FAILURE;
+    break;
+  }
+  }
+
+  cout << NOTICE << DONE << " Successfully " << verb << " task #"
+       << id << endl;
+  if (spawned.has_value())
+    cout << NOTICE << "Next occurrence: task #" << spawned->id << " due "
+         << to_string(spawned->due.value()) << "." << RESET << endl;
+  cout << endl;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief  Optimistic first: load without the lock, apply, and save only if no
+ *         other process wrote meanwhile. On a conflict the change is applied
+ *         again to a fresh load with the exclusive lock held throughout, so
+ *         the retry cannot conflict.
+ */
+int TaskCLI::commit(const function<bool(TaskManager &)> &apply, const function<void(TaskManager &)> &saved,
+                    optional<int> only) {
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    optional<StoreLock> held;
+    if (attempt > 0)
+      held.emplace(STORE_FILE, StoreLock::Mode::Exclusive);
+
+    TaskManager mgr;
+    mgr.loadFromFile(STORE_FILE);
+    if (!apply(mgr))
+      return EXIT_FAILURE;
+
+    // Held across the save and the hook, so the undo log stays in store order
+    StoreLock lock(STORE_FILE, StoreLock::Mode::Exclusive);
+    switch (only.has_value() ? mgr.saveTaskIfUnchanged(STORE_FILE, *only) : mgr.saveIfUnchanged(STORE_FILE)) {
+    case TaskManager::SaveResult::Saved:
+      if (saved)
+        saved(mgr);
+      return EXIT_SUCCESS;
+    case TaskManager::SaveResult::Failed:
+      return EXIT_FAILURE;
+    case TaskManager::SaveResult::Conflict:
+      break;
+    }
+  }
+  return EXIT_FAILURE;
+}
+
+/**
+ * @brief  The log is small (bounded), so it is rewritten whole each time.
+ */
+void TaskCLI::recordOp(Operation op) {
+  StoreLock lock(STORE_FILE, StoreLock::Mode::Exclusive);
+  OpLog log;
+  log.load(log_path(STORE_FILE));
+  log.record(std::move(op));
+  log.save(log_path(STORE_FILE));
+}
+
+/**
+ * @brief  Inverses may touch several records (restored dependents), so this
+ *         always loads and saves the whole store.
+ */
+int TaskCLI::undoRedo(bool redo) {
+  OpLog log;
+  if (!log.load(log_path(STORE_FILE))) {
+    cerr << BLOOD << FAIL << " Undo history is unreadable." << RESET << endl;
+    return EXIT_FAILURE;
+  }
+  if ((redo ? log.redoDepth() : log.undoDepth()) == 0) {
+    cerr << GOLD << WARN << "  Nothing to " << (redo ? "redo" : "undo") << "." << RESET << endl
+         << endl;
+    return EXIT_FAILURE;
+  }
+
+  Operation op;
+  string title;
+  auto apply = [&](TaskManager &mgr) {
+    // Ops may name finished tasks, which can be cold by now
+    mgr.loadArchive(STORE_FILE);
+    log.load(log_path(STORE_FILE));
+    if (redo ? log.redo(mgr, &op) : log.undo(mgr, &op)) {
+      // The task as it is now (the logged snapshot is from before an edit);
+      // an undone add has no task left, so its snapshot names it
+      optional<Task> now = mgr.getTask(op.task.id);
+      title = now.has_value() ? now->title : op.task.title;
+      return true;
+    }
+    // A failed step is dropped either way, so the next one can still run
+    StoreLock lock(STORE_FILE, StoreLock::Mode::Exclusive);
+    log.save(log_path(STORE_FILE));
+    return false;
+  };
+  if (commit(apply, [&](TaskManager &) { log.save(log_path(STORE_FILE)); }) != EXIT_SUCCESS)
+    return EXIT_FAILURE;
+
+  cout << NOTICE << DONE << (redo ? " Redid " : " Undid ") << op_name(op.kind) << " of task #" << op.task.id
+       << ": " << truncate(title) << "." << RESET << "\n\n";
+  return EXIT_SUCCESS;
+}
+
+namespace {
+
+/**
+ * @brief  Reminder lead such as "2d", "3h" or "30m", in seconds.
+ */
+optional<int64_t> parse_lead(string_view text) {
+  int64_t n = 0;
+  auto [end, ec] = from_chars(text.data(), text.data() + text.size(), n);
+  if (ec != errc{} || n <= 0 || end + 1 != text.data() + text.size())
+    return nullopt;
+  switch (*end) {
+  case 'd':
+    return n * 86400;
+  case 'h':
+    return n * 3600;
+  case 'm':
+    return n * 60;
+  default:
+    return nullopt;
+  }
+}
+
+/**
+ * @brief  Lead in the largest whole unit, for display ("1d", "90m").
+ */
+string lead_text(int64_t lead) {
+  if (lead % 86400 == 0)
+    return to_string(lead / 86400) + "d";
+  if (lead % 3600 == 0)
+    return to_string(lead / 3600) + "h";
+  return to_string(lead / 60) + "m";
+}
+
+/**
+ * @brief  Run a hook through the shell with the event in its environment,
+ *         waiting for it so hooks never overlap.
+ */
+void run_hook(const string &command, const DueEvent &event) {
+  static constexpr array<const char *, 4> kNames = {"low", "med", "high", "crit"};
+  vector<string> vars = {"TODO_EVENT=" + string(event.lead == 0 ? "overdue" : "reminder"),
+                         "TODO_ID=" + to_string(event.id),
+                         "TODO_TITLE=" + event.title,
+                         "TODO_PRIORITY=" + string(kNames[static_cast<size_t>(event.pr)]),
+                         "TODO_DUE=" + to_string(event.due),
+                         "TODO_LEAD=" + to_string(event.lead)};
+  vector<char *> envp;
+  for (char **env = environ; *env != nullptr; ++env)
+    envp.push_back(*env);
+  for (string &var : vars)
+    envp.push_back(var.data());
+  envp.push_back(nullptr);
+
+  string shell = "sh", flag = "-c", script = command;
+  array<char *, 4> args = {shell.data(), flag.data(), script.data(), nullptr};
+  pid_t pid = 0;
+  if (posix_spawn(&pid, "/bin/sh", nullptr, nullptr, args.data(), envp.data()) != 0) {
+    cerr << BLOOD << FAIL << " Could not run hook: " << command << RESET << endl;
+    return;
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+}
+
+} // namespace
+
+/**
+ * @brief  Reloads only when the store's stamp changes; between changes the
+ *         wheel alone decides when to wake.
+ */
+int TaskCLI::watch(int argc, char *argv[], optional<ListId> only) {
+  vector<int64_t> leads;
+  string hook;
+  bool once = false;
+  int interval = kWatchPollSeconds;
+  for (int i = TASK_ID_IDX; i < argc; ++i) {
+    string_view arg{argv[i]};
+    optional<int64_t> lead = arg == "--remind" && i + 1 < argc ? parse_lead(argv[++i]) : nullopt;
+    if (lead.has_value())
+      leads.push_back(*lead);
+    else if (arg == "--exec" && i + 1 < argc)
+      hook = argv[++i];
+    else if (arg == "--interval" && i + 1 < argc && atoi(argv[i + 1]) > 0)
+      interval = atoi(argv[++i]);
+    else if (arg == "--once")
+      once = true;
+    else {
+      cerr << BLOOD << FAIL << " Usage: ./todo watch [--remind <Nd|Nh|Nm>]... [--exec CMD] [--interval SECS] [--once]"
+           << RESET << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (leads.size() > kMaxReminders) {
+    cerr << BLOOD << FAIL << " At most " << kMaxReminders << " reminders." << RESET << endl;
+    return EXIT_FAILURE;
+  }
+
+  auto unix_now = [] { return duration_cast<seconds>(system_clock::now().time_since_epoch()).count(); };
+  DueWatcher watcher(leads, unix_now());
+  auto emit = [&](const DueEvent &event) {
+    static constexpr array<const char *, 4> kHeads = {"LOW", "MED", "HIGH", "CRIT"};
+    string when = event.lead == 0 ? string(BLOOD) + "overdue" : string(GOLD) + "due in " + lead_text(event.lead);
+    cout << when << RESET << "  #" << event.id << "  " << kHeads[static_cast<size_t>(event.pr)] << "  "
+         << truncate(event.title) << " (due " << to_string(event.due) << ")" << endl;
+    if (!hook.empty())
+      run_hook(hook, event);
+  };
+
+  // Reload only what other processes change: the journal tail or the
+  // records that differ
+  StoreFollower follower(STORE_FILE);
+  TaskManager mgr;
+  follower.load(mgr);
+  watcher.sync(mgr.topTasks(SIZE_MAX, Status::Pending, only));
+  while (true) {
+    watcher.advance(unix_now(), emit);
+    if (once)
+      return EXIT_SUCCESS;
+
+    int64_t now = unix_now();
+    int64_t wake = min(watcher.nextWake(), now + interval);
+    if (follower.wait(static_cast<int>(max<int64_t>(wake - now, 1) * 1000)) &&
+        follower.refresh(mgr).kind != StoreFollower::Refresh::Kind::Unchanged)
+      watcher.sync(mgr.topTasks(SIZE_MAX, Status::Pending, only));
+  }
+}
+
+/**
+ * @brief  Chosen access path, the ones it beat, and the work actually done.
+ */
+void TaskCLI::printPlan(const QueryPlan &plan) {
+  cout << NOTICE << "Plan:" << RESET << " " << plan.access << " (est. " << plan.estimate << " rows)" << endl;
+  for (auto &[access, rows] : plan.alternatives)
+    cout << "  rejected: " << access << " (est. " << rows << " rows)" << endl;
+  cout << "Examined " << plan.examined << " rows, matched " << plan.matched << "." << endl
+       << endl;
+}
+
+/**
+ * @brief  Help for a named subcommand; overall help for anything else.
+ */
+void TaskCLI::printCommandHelp(string_view cmd) {
+  if (cmd == "add")
+    printAddHelp();
+  else if (cmd == "list")
+    printListHelp();
+  else if (cmd == "complete")
+    printCompleteHelp();
+  else if (cmd == "archive")
+    printArchiveHelp();
+  else if (cmd == "remove")
+    printRemoveHelp();
+  else if (cmd == "search")
+    printSearchHelp();
+  else if (cmd == "find")
+    printFindHelp();
+  else if (cmd == "edit")
+    printEditHelp();
+  else if (cmd == "depend")
+    printDependHelp();
+  else if (cmd == "undo" || cmd == "redo")
+    printUndoHelp();
+  else if (cmd == "lists")
+    printListsHelp();
+  else if (cmd == "merge")
+    printMergeHelp();
+  else if (cmd == "compress")
+    printCompressHelp();
+  else if (cmd == "stats")
+    printStatsHelp();
+  else if (cmd == "report")
+    printReportHelp();
+  else if (cmd == "watch")
+    printWatchHelp();
+  else
+    printHelp();
+}
+
 /**
- * @brief  Main dispatch method: load, execute command, save if needed
+ * @brief  Main dispatch method: parse, load only what the command needs,
+ *         execute, save if needed
  */
 int TaskCLI::run(int argc, char *argv[]) {
   TaskManager mgr;
+  optional<ListId> only;
+  if (!extractList(argc, argv, only))
+    return EXIT_FAILURE;
 
-  // Load previous state (first time running program, file doesn't exist)
-  mgr.loadFromFile("tasks.json");
+  // Store-wide results narrowed to the selected list, if any
+  auto in_list = [&](vector<Task> hits) {
+    if (only.has_value())
+      erase_if(hits, [&](const Task &t) { return t.list != *only; });
+    return hits;
+  };
 
   if (argc < MIN_ARGS) {
     // No command provided
@@ -105,20 +499,46 @@ int TaskCLI::run(int argc, char *argv[]) {
       string title = "";
       Priority pr = Priority::Medium;
       optional<ymd> due_opt = nullopt;
+      Recurrence repeat;
+      vector<int> after;
 
-      if (parseAdd(argc, argv, title, pr, due_opt) != EXIT_SUCCESS)
+      if (parseAdd(argc, argv, title, pr, due_opt, repeat, after) != EXIT_SUCCESS)
         return EXIT_FAILURE;
 
-      // Create the task in the manager and report its new ID
-      int id = mgr.addTask(title, pr, due_opt);
-      if (id == FXN_FAILURE)
-        return EXIT_FAILURE;
+      ListId list = only.value_or(kDefaultList);
+      int id = FXN_FAILURE;
+      optional<Task> similar;
+      auto apply = [&](TaskManager &store) {
+        // Likely typo of an existing task in the same list: add anyway, but say so
+        similar.reset();
+        for (const Task &hit : store.findSimilar(title, TrigramIndex::duplicateThreshold(title), 10, FuzzyMetric::Jaccard))
+          if (hit.list == list) {
+            similar = hit;
+            break;
+          }
+
+        // Create the task in the manager
+        id = store.addTask(title, pr, due_opt, repeat, list);
+        if (id == FXN_FAILURE)
+          return false;
+
+        // All or nothing: a bad prerequisite leaves the store untouched
+        for (int prereq : after)
+          if (!store.addDependency(id, prereq))
+            return false;
+        return true;
+      };
+
+      // Save updated task list back to disk, then report its new ID
+      int rc = commit(apply, [&](TaskManager &store) { recordOp({OpKind::Add, store.getTask(id).value_or(Task{})}); });
+      if (similar.has_value())
+        cerr << GOLD << WARN << "  Warning: Similar to task #" << similar->id << ": "
+             << truncate(similar->title) << "." << RESET << endl;
+      if (rc != EXIT_SUCCESS)
+        return rc;
 
       cout << NOTICE << DONE << " Successfully add task #" << id << ": "
            << truncate(title) << "." << RESET << "\n\n";
-
-      // Save updated task list back to disk
-      mgr.saveToFile("tasks.json");
       return EXIT_SUCCESS;
     } else if (cmd == "complete") {
       // 2) Check for invalid usage
@@ -133,44 +553,104 @@ int TaskCLI::run(int argc, char *argv[]) {
 
       // Extract ID and change to complete
       int id = atoi(argv[TASK_ID_IDX]);
-      if (id == 0 || !mgr.completeTask(id)) {
+      if (id == 0)
         return EXIT_FAILURE;
-      } else {
-        cout << NOTICE << DONE << " Successfully completed task #"
-             << id << endl
-             << endl;
-      }
-
-      mgr.saveToFile("tasks.json");
-      return EXIT_SUCCESS;
+      return changeStatus(id, Status::Completed);
     } else if (cmd == "list") {
       // By default, just list will show pending
-      if (argc < ADD_MIN_ARGS) {
-        mgr.printPendingTasks();
-        return EXIT_SUCCESS;
+      Status filter = Status::Pending;
+      size_t limit = SIZE_MAX;
+      TaskQuery query;
+      bool use_query = false, explain = false, blocked = false;
+      optional<TaskManager::PageCursor> after;
+
+      // Otherwise, check each arg for help, a filter, a page size or a query term
+      for (int i = 2; i < argc; ++i) {
+        string_view arg{argv[i]};
+        string error;
+        if (arg == "help") {
+          printListHelp();
+          return EXIT_FAILURE;
+        } else if (arg == "-a" || arg == "--all") {
+          filter = Status::All;
+        } else if (arg == "-p" || arg == "--pending") {
+          filter = Status::Pending;
+        } else if (arg == "-c" || arg == "--completed") {
+          filter = Status::Completed;
+        } else if (arg == "-r" || arg == "--archived") {
+          filter = Status::Archived;
+        } else if ((arg == "-n" || arg == "--limit") && (i + 1) < argc && atoi(argv[i + 1]) > 0) {
+          limit = static_cast<size_t>(atoi(argv[++i]));
+          continue;
+        } else if (arg == "--after" && (i + 1) < argc) {
+          after = TaskManager::PageCursor::parse(argv[++i]);
+          if (!after.has_value()) {
+            cerr << BLOOD << FAIL << " Not a page cursor: " << argv[i] << RESET << endl
+                 << endl;
+            return EXIT_FAILURE;
+          }
+          continue;
+        } else if (arg == "-b" || arg == "--blocked") {
+          blocked = true;
+          continue;
+        } else if (arg == "--explain") {
+          explain = use_query = true;
+          continue;
+        } else if (TaskQuery::isTerm(argv[i])) {
+          if (!query.addTerm(argv[i], error)) {
+            cerr << BLOOD << FAIL << " " << error << RESET << endl
+                 << endl;
+            return EXIT_FAILURE;
+          }
+          use_query = true;
+          continue;
+        } else {
+          cout << BLOOD << FAIL << " Argument not recognized." << RESET << endl
+               << endl;
+          return EXIT_FAILURE;
+        }
+        // A status flag overrides any earlier status: term (and vice versa)
+        query.status = filter == Status::All ? nullopt : optional{filter};
       }
-      // Otherwise, check if arg is help or a filter
-      string_view filter{argv[2]};
-      if (filter == "help") {
-        printListHelp();
+
+      if (after.has_value() && (blocked || use_query)) {
+        cerr << BLOOD << FAIL << " --after pages through status listings, not --blocked or filter terms." << RESET
+             << endl
+             << endl;
         return EXIT_FAILURE;
-      } else if (filter == "-a" || filter == "--all") {
-        mgr.printAllTasks();
-        return EXIT_SUCCESS;
-      } else if (filter == "-p" || filter == "--pending") {
-        mgr.printPendingTasks();
-        return EXIT_SUCCESS;
-      } else if (filter == "-c" || filter == "--completed") {
-        mgr.printCompletedTasks();
+      }
+
+      if (blocked) {
+        mgr.loadFromFile(STORE_FILE);
+        TaskManager::printTable(in_list(mgr.blockedTasks()), "blocked");
         return EXIT_SUCCESS;
-      } else if (filter == "-r" || filter == "--archived") {
-        mgr.printArchivedTasks();
+      }
+
+      if (use_query) {
+        if (only.has_value())
+          query.list = only;
+        mgr.loadFromFile(STORE_FILE);
+        if (query.status != Status::Pending)
+          mgr.loadArchive(STORE_FILE);
+        QueryPlan plan;
+        TaskManager::printTable(mgr.queryTasks(query, limit, &plan), "matched");
+        if (explain)
+          printPlan(plan);
         return EXIT_SUCCESS;
-      } else {
-        cout << BLOOD << FAIL << " Argument not recognized." << RESET << endl
-             << endl;
-        return EXIT_FAILURE;
       }
+
+      // A bounded page of pending tasks only needs the top of the (ranked)
+      // store; finished tasks may be in the cold archive
+      if (filter != Status::Pending) {
+        mgr.loadFromFile(STORE_FILE);
+        mgr.loadArchive(STORE_FILE);
+      } else if (limit == SIZE_MAX)
+        mgr.loadFromFile(STORE_FILE);
+      else
+        mgr.loadFirstPage(STORE_FILE, filter, limit, only, after);
+
+      mgr.printTasks(filter, limit, only, after);
+      return EXIT_SUCCESS;
     } else if (cmd == "remove") {
       if (argc < ADD_MIN_ARGS) {
         cerr << BLOOD << FAIL << " Removing a task requires at least 1 argument. None provided." << RESET << endl;
@@ -181,17 +661,23 @@ int TaskCLI::run(int argc, char *argv[]) {
         return EXIT_FAILURE;
       }
 
-      // Extract ID and remove
+      // Extract ID and remove (shifts every later record, so needs a full rewrite)
       int id = atoi(argv[TASK_ID_IDX]);
-      if (id == 0 || !mgr.removeTask(id)) {
+      if (id == 0)
+        return EXIT_FAILURE;
+      Operation op;
+      auto apply = [&](TaskManager &store) {
+        if (!store.getTask(id).has_value())
+          store.loadArchive(STORE_FILE);
+        op = {OpKind::Remove, store.getTask(id).value_or(Task{}), store.dependentsOf(id)};
+        return store.removeTask(id);
+      };
+      if (commit(apply, [&](TaskManager &) { recordOp(op); }) != EXIT_SUCCESS)
         return EXIT_FAILURE;
-      } else {
-        cout << NOTICE << DONE << " Successfully removed task #"
-             << id << endl
-             << endl;
-      }
 
-      mgr.saveToFile("tasks.json");
+      cout << NOTICE << DONE << " Successfully removed task #"
+           << id << endl
+           << endl;
       return EXIT_SUCCESS;
     } else if (cmd == "archive") {
       if (argc < ADD_MIN_ARGS) {
@@ -203,20 +689,230 @@ int TaskCLI::run(int argc, char *argv[]) {
         return EXIT_FAILURE;
       }
 
-      // Extract ID and remove
+      // Extract ID and archive
+      int id = atoi(argv[TASK_ID_IDX]);
+      if (id == 0)
+        return EXIT_FAILURE;
+      return changeStatus(id, Status::Archived);
+    } else if (cmd == "edit") {
+      if (argc < ADD_MIN_ARGS || strcasecmp(argv[TASK_ID_IDX], "help") == 0) {
+        printEditHelp();
+        return EXIT_FAILURE;
+      }
+
       int id = atoi(argv[TASK_ID_IDX]);
-      if (id == 0 || !mgr.archiveTask(id)) {
+      TaskManager::TaskEdit edit;
+      if (id == 0 || parseEdit(argc, argv, edit) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+      // Only this task's record changes, so only it is written
+      Operation op{OpKind::Edit};
+      auto apply = [&](TaskManager &store) {
+        if (!store.getTask(id).has_value())
+          store.loadArchive(STORE_FILE);
+        op.task = store.getTask(id).value_or(Task{});
+        return store.updateTask(id, edit);
+      };
+      if (commit(apply, [&](TaskManager &) { recordOp(op); }, id) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+      cout << NOTICE << DONE << " Successfully edited task #"
+           << id << endl
+           << endl;
+      return EXIT_SUCCESS;
+    } else if (cmd == "search") {
+      if (argc < ADD_MIN_ARGS) {
+        cerr << BLOOD << FAIL << " Searching requires at least 1 word. None provided." << RESET << endl;
+        return EXIT_FAILURE;
+      }
+      if (strcasecmp(argv[TITLE_IDX], "help") == 0) {
+        printSearchHelp();
+        return EXIT_FAILURE;
+      }
+
+      string query;
+      for (int i = TITLE_IDX; i < argc; ++i)
+        query += string(argv[i]) + ' ';
+
+      // Saved indexes answer without parsing the store; otherwise load and search
+      optional<vector<Task>> hits = TaskManager::searchFile(STORE_FILE, query);
+      if (!hits.has_value()) {
+        mgr.loadFromFile(STORE_FILE);
+        mgr.loadArchive(STORE_FILE);
+        hits = mgr.searchTasks(query);
+      } else {
+        // The archive may still hold an older copy of a task that is hot again
+        unordered_set<uint64_t> hot;
+        for (const Task &t : *hits)
+          hot.insert(t.uid);
+        for (Task &t : TaskManager::searchArchive(STORE_FILE, query))
+          if (!hot.contains(t.uid))
+            hits->push_back(std::move(t));
+        stable_sort(hits->begin(), hits->end(), [](const Task &a, const Task &b) { return a.sort_key > b.sort_key; });
+      }
+
+      TaskManager::printTable(in_list(std::move(*hits)), "found");
+      return EXIT_SUCCESS;
+    } else if (cmd == "depend") {
+      if (argc < ADD_MIN_ARGS + 1 || strcasecmp(argv[TASK_ID_IDX], "help") == 0) {
+        printDependHelp();
+        return EXIT_FAILURE;
+      }
+
+      int id = atoi(argv[TASK_ID_IDX]), prereq = atoi(argv[TASK_ID_IDX + 1]);
+      if (id == 0 || prereq == 0)
+        return EXIT_FAILURE;
+      auto apply = [&](TaskManager &store) {
+        if (!store.getTask(id).has_value() || !store.getTask(prereq).has_value())
+          store.loadArchive(STORE_FILE);
+        return store.addDependency(id, prereq);
+      };
+      if (commit(apply) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+      cout << NOTICE << DONE << " Task #" << id << " now waits on task #" << prereq << "." << RESET << "\n\n";
+      return EXIT_SUCCESS;
+    } else if (cmd == "find") {
+      if (argc < ADD_MIN_ARGS) {
+        cerr << BLOOD << FAIL << " Finding requires some text. None provided." << RESET << endl;
+        return EXIT_FAILURE;
+      }
+      if (strcasecmp(argv[TITLE_IDX], "help") == 0) {
+        printFindHelp();
+        return EXIT_FAILURE;
+      }
+
+      string query;
+      for (int i = TITLE_IDX; i < argc; ++i)
+        query += string(argv[i]) + ' ';
+
+      // Closest titles first, not rank order
+      mgr.loadFromFile(STORE_FILE);
+      mgr.loadArchive(STORE_FILE);
+      TaskManager::printTable(in_list(mgr.findSimilar(query)), "matched");
+      return EXIT_SUCCESS;
+    } else if (cmd == "undo" || cmd == "redo") {
+      if (argc > TASK_ID_IDX && strcasecmp(argv[TASK_ID_IDX], "help") == 0) {
+        printUndoHelp();
+        return EXIT_FAILURE;
+      }
+      return undoRedo(cmd == "redo");
+    } else if (cmd == "lists") {
+      mgr.loadFromFile(STORE_FILE);
+      cout << BOLD << "\nLIST\t\t\tPENDING" << RESET << endl;
+      cout << "-----------------------------------" << endl;
+      vector<pair<ListId, size_t>> counts = mgr.listCounts();
+      for (auto &[list, pending] : counts)
+        cout << list_name(list) << (list_name(list).size() < 8 ? "\t\t\t" : "\t\t") << pending << endl;
+      cout << "-----------------------------------" << endl;
+      cout << counts.size() << " lists." << endl
+           << endl;
+      return EXIT_SUCCESS;
+    } else if (cmd == "stats") {
+      if (argc > TASK_ID_IDX && strcasecmp(argv[TASK_ID_IDX], "help") == 0) {
+        printStatsHelp();
+        return EXIT_FAILURE;
+      }
+      if (only.has_value()) {
+        cerr << BLOOD << FAIL << " Stats cover every list; --list does not apply." << RESET << endl;
         return EXIT_FAILURE;
+      }
+
+      // The saved counts answer without loading; stale ones are rebuilt once
+      optional<StoreStats> stats = TaskManager::statsFile(STORE_FILE);
+      if (!stats.has_value()) {
+        mgr.loadFromFile(STORE_FILE);
+        mgr.loadArchive(STORE_FILE);
+        mgr.saveStats(STORE_FILE);
+        stats = mgr.stats();
+      }
+      TaskManager::printStats(stats.value_or(StoreStats{}));
+      return EXIT_SUCCESS;
+    } else if (cmd == "report") {
+      if (argc > TASK_ID_IDX && strcasecmp(argv[TASK_ID_IDX], "help") == 0) {
+        printReportHelp();
+        return EXIT_FAILURE;
+      }
+      if (only.has_value()) {
+        cerr << BLOOD << FAIL << " The report covers every list; --list does not apply." << RESET << endl;
+        return EXIT_FAILURE;
+      }
+
+      sys_days today{get_today()};
+      sys_days since = today - days{kReportDays - 1};
+      for (int i = TASK_ID_IDX; i < argc; ++i) {
+        string_view arg{argv[i]};
+        optional<ymd> date = arg == "--since" && i + 1 < argc ? parseDate(argv[++i]) : nullopt;
+        if (!date.has_value() || sys_days{*date} > today) {
+          cerr << BLOOD << FAIL << " Usage: ./todo report [--since YYYY-MM-DD] (a date up to today)" << RESET
+               << endl;
+          return EXIT_FAILURE;
+        }
+        since = sys_days{*date};
+      }
+
+      // The backlog is walked back from today's pending count; pending tasks are never cold
+      optional<StoreStats> stats = TaskManager::statsFile(STORE_FILE);
+      size_t pending = 0;
+      if (stats.has_value()) {
+        pending = stats->total(Status::Pending);
       } else {
-        cout << NOTICE << DONE << " Successfully archived task #"
-             << id << endl
-             << endl;
+        mgr.loadFromFile(STORE_FILE);
+        pending = mgr.count(Status::Pending);
       }
+      TaskManager::printReport(build_report(history_path(STORE_FILE), since, today, pending));
+      return EXIT_SUCCESS;
+    } else if (cmd == "watch") {
+      if (argc > TASK_ID_IDX && strcasecmp(argv[TASK_ID_IDX], "help") == 0) {
+        printWatchHelp();
+        return EXIT_FAILURE;
+      }
+      return watch(argc, argv, only);
+    } else if (cmd == "merge") {
+      if (argc < ADD_MIN_ARGS || strcasecmp(argv[TASK_ID_IDX], "help") == 0) {
+        printMergeHelp();
+        return EXIT_FAILURE;
+      }
+
+      string other{argv[TASK_ID_IDX]};
+      TaskManager::MergeStats stats;
+      auto apply = [&](TaskManager &store) {
+        // Tasks are matched by uid, so every one of ours must be loaded
+        store.loadArchive(STORE_FILE);
+        optional<TaskManager::MergeStats> merged = store.mergeFile(other);
+        if (!merged.has_value()) {
+          cerr << BLOOD << FAIL << " Could not read " << other << "." << RESET << endl;
+          return false;
+        }
+        stats = *merged;
+        return true;
+      };
+      if (commit(apply) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+      cout << NOTICE << DONE << " Merged " << other << ": " << stats.added << " added, " << stats.updated
+           << " updated, " << stats.removed << " removed." << RESET << "\n\n";
+      return EXIT_SUCCESS;
+    } else if (cmd == "compress") {
+      string_view mode = argc > TASK_ID_IDX ? argv[TASK_ID_IDX] : "";
+      if (mode != "on" && mode != "off") {
+        printCompressHelp();
+        return EXIT_FAILURE;
+      }
+
+      // Rewrites the hot file only; the archive is always compressed
+      bool on = mode == "on";
+      if (commit([&](TaskManager &store) { store.setCompressed(on); return true; }) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
 
-      mgr.saveToFile("tasks.json");
+      error_code ec;
+      uintmax_t bytes = filesystem::file_size(STORE_FILE, ec);
+      cout << NOTICE << DONE << " Saved " << STORE_FILE << (on ? " compressed" : " as plain text") << " ("
+           << (ec ? 0 : bytes) << " bytes)." << RESET << "\n\n";
       return EXIT_SUCCESS;
     } else if (cmd == "help") {
-      printHelp();
+      // Help never touches the store
+      printCommandHelp(argc > TASK_ID_IDX ? argv[TASK_ID_IDX] : "");
       return EXIT_SUCCESS;
     } else {
       cerr << BLOOD << FAIL << " Did not recognize command." << RESET << endl;
@@ -7,8 +7,10 @@
  */
 
 #pragma once
+#include "op_log.hpp"
 #include "task.hpp"
 #include "task_manager.hpp"
+#include <functional>
 #include <iostream>
 
 // Minimum number of arguments required for commands that need a parameter
@@ -19,6 +21,12 @@ static constexpr int MIN_ARGS = 2;
 static constexpr int TITLE_IDX = 2;
 // Index of the ID argument in argv for ID-based commands
 static constexpr int TASK_ID_IDX = 2;
+// Store file in the working directory
+static constexpr const char *STORE_FILE = "tasks.json";
+// Days shown by `report` when no --since is given
+static constexpr int kReportDays = 30;
+// Longest `watch` sleeps before checking the store when file changes are not reported
+static constexpr int kWatchPollSeconds = 5;
 
 class TaskCLI {
 public:
@@ -48,12 +56,18 @@ public:
   std::optional<ymd> parseDate(const std::string &in);
 
 private:
+  /**
+   * @brief   Print the plan chosen for `list ... --explain`.
+   * @param   plan  Filled in by TaskManager::queryTasks.
+   */
+  void printPlan(const QueryPlan &plan);
+
   /**
    * @brief   Display detailed help for the `add` command.
    */
   void printAddHelp() {
     std::cout << NOTICE << "Add a task\n\nUsage:" << RESET << std::endl;
-    std::cout << "./todo add \"TITLE\" [--priority <low|med|high|crit>] [--due YYYY-MM-DD]"
+    std::cout << "./todo add \"TITLE\" [--priority <low|med|high|crit>] [--due YYYY-MM-DD] [--every RULE] [--after ID]"
                  "\n\n"
                  "Add a new task with the given TITLE.\n"
                  "If no options are supplied the task is created with medium priority and no due date.\n"
@@ -61,11 +75,15 @@ private:
     std::cout << NOTICE << "Options:" << RESET << std::endl;
     std::cout << "  --priority  <low|med|high|crit>   Set task priority (default: med)\n"
                  "  --due       YYYY-MM-DD            Due date in ISO-8601 format\n"
+                 "  --every     <Nd|Nw|month:X>       Repeat every N days/weeks, or monthly on day X;\n"
+                 "                                    completing it schedules the next occurrence\n"
+                 "  --after     ID                    Wait for task ID to be done (repeatable)\n"
                  "\n";
     std::cout << NOTICE << "Examples:" << RESET << std::endl;
     std::cout << "  ./todo add \"File taxes\" --priority high --due 2025-04-15\n"
                  "  ./todo add \"Buy groceries\" --due 2025-05-02\n"
                  "  ./todo add \"Read a book\"       # title only\n"
+                 "  ./todo add \"Water plants\" --every 3d\n"
               << std::endl; // flush and keep prompt on its own line
   }
 
@@ -74,20 +92,37 @@ private:
    */
   void printListHelp() {
     std::cout << NOTICE << "List tasks\n\nUsage:" << RESET << std::endl;
-    std::cout << "./todo list [--all] [--completed] [--pending] [--archived] "
+    std::cout << "./todo list [--all] [--completed] [--pending] [--archived] [--blocked] [--limit N [--after CUR]]\n"
+                 "            [FILTER...] [--explain]"
                  "\n\n"
-                 "List tasks, optionally filtered by status."
+                 "List tasks, optionally filtered by status or by FILTER terms (all must hold).\n"
+                 "A full page of a status listing ends with the cursor of the next page."
                  "\n\n";
     std::cout << NOTICE << "Options:" << RESET << std::endl;
     std::cout << "  --all            Show all tasks\n"
                  "  --archived       Show only archived tasks\n"
+                 "  --blocked        Show pending tasks still waiting on another task\n"
                  "  --completed      Show only completed tasks\n"
                  "  --pending        Show only pending tasks (default)\n"
+                 "  --limit    N     Show only the first N tasks\n"
+                 "  --after    CUR   Continue below the page that printed cursor CUR\n"
+                 "  --explain        Show the chosen index and rows examined\n"
+                 "\n";
+    std::cout << NOTICE << "Filters:" << RESET << std::endl;
+    std::cout << "  status:<pending|completed|archived|all>\n"
+                 "  pr<op><low|med|high|crit>        op is one of : = < <= > >=\n"
+                 "  due<op>YYYY-MM-DD | due:none\n"
+                 "  title~TEXT                       each word of TEXT starts a title word\n"
+                 "  blocked:<yes|no|any>             waiting on another task (default no)\n"
+                 "  list:NAME                        only tasks in the named list\n"
                  "\n\n";
     std::cout << NOTICE << "Examples:" << RESET << std::endl;
     std::cout << "  ./todo list\n"
                  "  ./todo list --completed\n"
                  "  ./todo list -r\n"
+                 "  ./todo list --limit 10\n"
+                 "  ./todo list --limit 10 --after 0000001cfffffff50000000a\n"
+                 "  ./todo list status:pending pr>=high due<2026-11-01 title~tax --explain\n"
               << std::endl;
   }
 
@@ -105,6 +140,27 @@ private:
               << std::endl; // flush and keep prompt on its own line
   }
 
+  /**
+   * @brief   Display detailed help for the `edit` command.
+   */
+  void printEditHelp() {
+    std::cout << NOTICE << "Edit a task\n\nUsage:" << RESET << std::endl;
+    std::cout << "./todo edit <ID> [--title \"TITLE\"] [--priority <low|med|high|crit>] [--due <YYYY-MM-DD|none>]"
+                 "\n\n"
+                 "Change the title, priority or due date of the task with the given ID.\n"
+                 "Only the edited task is written; the rest of the file is left as it is.\n"
+                 "\n";
+    std::cout << NOTICE << "Options:" << RESET << std::endl;
+    std::cout << "  --title     TITLE                 New title\n"
+                 "  --priority  <low|med|high|crit>   New priority\n"
+                 "  --due       YYYY-MM-DD | none     New due date, or none to clear it\n"
+                 "\n";
+    std::cout << NOTICE << "Examples:" << RESET << std::endl;
+    std::cout << "  ./todo edit 3 --priority high\n"
+                 "  ./todo edit 3 --title \"File taxes (extension)\" --due 2025-10-15\n"
+              << std::endl; // flush and keep prompt on its own line
+  }
+
   /**
    * @brief   Display detailed help for the `archive` command.
    */
@@ -133,6 +189,184 @@ private:
               << std::endl; // flush and keep prompt on its own line
   }
 
+  /**
+   * @brief   Display detailed help for the `search` command.
+   */
+  void printSearchHelp() {
+    std::cout << NOTICE << "Search tasks\n\nUsage:" << RESET << std::endl;
+    std::cout << "./todo search <WORD> [WORD...]"
+                 "\n\n"
+                 "List tasks (any status, archived ones included) whose titles contain every WORD.\n"
+                 "Matching ignores case and punctuation and uses whole words.\n"
+                 "\n";
+    std::cout << NOTICE << "Example:" << RESET << std::endl;
+    std::cout << "  ./todo search taxes 2025\n"
+              << std::endl; // flush and keep prompt on its own line
+  }
+
+  /**
+   * @brief   Display detailed help for the `depend` command.
+   */
+  void printDependHelp() {
+    std::cout << NOTICE << "Add a dependency\n\nUsage:" << RESET << std::endl;
+    std::cout << "./todo depend <ID> <PREREQ_ID>"
+                 "\n\n"
+                 "Task ID waits until task PREREQ_ID is completed or archived.\n"
+                 "Blocked tasks are hidden from `list` (see `list --blocked`).\n"
+                 "\n";
+    std::cout << NOTICE << "Example:" << RESET << std::endl;
+    std::cout << "  ./todo depend 7 3\n"
+              << std::endl; // flush and keep prompt on its own line
+  }
+
+  /**
+   * @brief   Display detailed help for the `find` command.
+   */
+  void printFindHelp() {
+    std::cout << NOTICE << "Find tasks\n\nUsage:" << RESET << std::endl;
+    std::cout << "./todo find <TEXT>"
+                 "\n\n"
+                 "List tasks (any status) whose titles look like TEXT, closest first.\n"
+                 "Tolerates typos and missing words.\n"
+                 "\n";
+    std::cout << NOTICE << "Example:" << RESET << std::endl;
+    std::cout << "  ./todo find \"grocries\"\n"
+              << std::endl; // flush and keep prompt on its own line
+  }
+
+  /**
+   * @brief   Display detailed help for the `undo` and `redo` commands.
+   */
+  void printUndoHelp() {
+    std::cout << NOTICE << "Undo or redo a change\n\nUsage:" << RESET << std::endl;
+    std::cout << "./todo undo\n"
+                 "./todo redo"
+                 "\n\n"
+                 "Undo the latest add, complete, archive, remove or edit, or redo the latest undone one.\n"
+                 "The last " << OpLog::kMaxOps << " changes are kept; a new change clears the redo history.\n"
+                 "\n";
+    std::cout << NOTICE << "Example:" << RESET << std::endl;
+    std::cout << "  ./todo remove 42\n"
+                 "  ./todo undo        # task #42 is back\n"
+              << std::endl; // flush and keep prompt on its own line
+  }
+
+  /**
+   * @brief   Display detailed help for the `lists` command and `--list`.
+   */
+  void printListsHelp() {
+    std::cout << NOTICE << "Named lists\n\nUsage:" << RESET << std::endl;
+    std::cout << "./todo lists\n"
+                 "./todo <command> ... --list NAME"
+                 "\n\n"
+                 "Every task belongs to one named list (\"" << kDefaultListName << "\" unless added with --list).\n"
+                 "`lists` shows each list and its pending tasks. With --list, add puts the task in NAME and\n"
+                 "list, search and find only show NAME; without it they show every list.\n"
+                 "Names are case-insensitive letters, digits, '-' and '_'.\n"
+                 "\n";
+    std::cout << NOTICE << "Examples:" << RESET << std::endl;
+    std::cout << "  ./todo add \"Rotate certs\" --list ops\n"
+                 "  ./todo list --list ops\n"
+                 "  ./todo list list:ops pr>=high\n"
+              << std::endl; // flush and keep prompt on its own line
+  }
+
+  /**
+   * @brief   Display detailed help for the `merge` command.
+   */
+  void printMergeHelp() {
+    std::cout << NOTICE << "Merge another task file\n\nUsage:" << RESET << std::endl;
+    std::cout << "./todo merge <FILE>"
+                 "\n\n"
+                 "Bring the changes in FILE (a tasks.json kept on another machine) into this store.\n"
+                 "Tasks are matched by their global uid, not their number. For each field the later\n"
+                 "change wins, tasks removed on either side stay removed, and new tasks get a number here.\n"
+                 "Merging in both directions leaves both stores with the same tasks. FILE is not changed.\n"
+                 "\n";
+    std::cout << NOTICE << "Example:" << RESET << std::endl;
+    std::cout << "  ./todo merge ~/laptop/tasks.json\n"
+              << std::endl; // flush and keep prompt on its own line
+  }
+
+  /**
+   * @brief   Display detailed help for the `compress` command.
+   */
+  void printCompressHelp() {
+    std::cout << NOTICE << "Compress the task file\n\nUsage:" << RESET << std::endl;
+    std::cout << "./todo compress <on|off>"
+                 "\n\n"
+                 "Save tasks.json block-compressed (on) or as plain text (off). Later saves keep\n"
+                 "the chosen form. A compressed store is several times smaller and loads about as\n"
+                 "fast, but complete and archive rewrite the file instead of patching it in place.\n"
+                 "\n";
+    std::cout << NOTICE << "Example:" << RESET << std::endl;
+    std::cout << "  ./todo compress on\n"
+              << std::endl; // flush and keep prompt on its own line
+  }
+
+  /**
+   * @brief   Display detailed help for the `stats` command.
+   */
+  void printStatsHelp() {
+    std::cout << NOTICE << "Store statistics\n\nUsage:" << RESET << std::endl;
+    std::cout << "./todo stats"
+                 "\n\n"
+                 "Show how many tasks there are per status and priority, how many pending tasks are\n"
+                 "overdue or due in each of the coming weeks, and how many tasks were completed today,\n"
+                 "in the last 7 days and in the last 30 days. Counts cover every list and the archive.\n"
+                 "They are kept up to date by every change, so this is instant however big the store.\n"
+                 "\n";
+    std::cout << NOTICE << "Example:" << RESET << std::endl;
+    std::cout << "  ./todo stats\n"
+              << std::endl; // flush and keep prompt on its own line
+  }
+
+  /**
+   * @brief   Display detailed help for the `report` command.
+   */
+  void printReportHelp() {
+    std::cout << NOTICE << "History report\n\nUsage:" << RESET << std::endl;
+    std::cout << "./todo report [--since YYYY-MM-DD]"
+                 "\n\n"
+                 "Show, for each day since the given date (default: the last 30 days), how many tasks\n"
+                 "were added and closed and how many were still open at the end of the day; windows\n"
+                 "longer than a month are shown by week. Then show how long tasks completed in the\n"
+                 "window took, from creation (or reopening) to completion, per priority.\n"
+                 "Every change is recorded in tasks.json.history, which stays small and is read in\n"
+                 "one pass, so years of history report in well under a second.\n"
+                 "\n";
+    std::cout << NOTICE << "Examples:" << RESET << std::endl;
+    std::cout << "  ./todo report\n"
+                 "  ./todo report --since 2025-01-01\n"
+              << std::endl; // flush and keep prompt on its own line
+  }
+
+  /**
+   * @brief   Display detailed help for the `watch` command.
+   */
+  void printWatchHelp() {
+    std::cout << NOTICE << "Watch due dates\n\nUsage:" << RESET << std::endl;
+    std::cout << "./todo watch [--remind <Nd|Nh|Nm>]... [--exec CMD] [--interval SECS] [--once]"
+                 "\n\n"
+                 "Keep running and print a line when a pending task becomes overdue (its due day has\n"
+                 "ended) and, for each --remind, that long before. Tasks already overdue or inside a\n"
+                 "reminder window are reported once at start. Changes made by other commands are\n"
+                 "picked up as they are saved (within --interval seconds, default 5, where the\n"
+                 "system cannot report file changes).\n"
+                 "\n";
+    std::cout << NOTICE << "Options:" << RESET << std::endl;
+    std::cout << "  --remind    <Nd|Nh|Nm>   Also remind this long before the deadline (repeatable)\n"
+                 "  --exec      CMD          Run CMD for each event, with TODO_EVENT, TODO_ID, TODO_TITLE,\n"
+                 "                           TODO_PRIORITY, TODO_DUE and TODO_LEAD set\n"
+                 "  --interval  SECS         Without change notification, check the store this often\n"
+                 "  --once      Report what is due now and exit\n"
+                 "\n";
+    std::cout << NOTICE << "Examples:" << RESET << std::endl;
+    std::cout << "  ./todo watch --remind 1d --remind 2h\n"
+                 "  ./todo watch --exec 'notify-send \"$TODO_TITLE\" \"$TODO_EVENT\"'\n"
+              << std::endl; // flush and keep prompt on its own line
+  }
+
   /**
    * @brief   Display overall CLI usage and subcommands.
    */
@@ -144,10 +378,23 @@ private:
     std::cout << "  add        Add a new task\n"
                  "  archive    Mark a task as archived\n"
                  "  complete   Mark a task as completed\n"
+                 "  compress   Save the task file compressed or as plain text\n"
+                 "  depend     Make a task wait for another one\n"
+                 "  edit       Change a task's title, priority or due date\n"
+                 "  find       Find tasks with titles similar to the given text\n"
                  "  help       Show this help, or detailed help for a subcommand\n"
                  "  list       List tasks (pending by default)\n"
-                 "  remove     Delete a task\n\n";
+                 "  lists      Show named lists and their pending counts\n"
+                 "  merge      Merge in the tasks of another task file\n"
+                 "  redo       Redo the latest undone change\n"
+                 "  remove     Delete a task\n"
+                 "  report     Show a burn-down and lead times from the change history\n"
+                 "  search     Find tasks whose titles contain every given word\n"
+                 "  stats      Show counts by status and priority, due dates and throughput\n"
+                 "  undo       Undo the latest change\n"
+                 "  watch      Print reminders as due dates approach and pass\n\n";
 
+    std::cout << "Any command takes --list NAME to work in a named list (see './todo help lists').\n";
     std::cout << "Run './todo help <command>' for more information on a specific command.\n";
   }
 
@@ -158,10 +405,88 @@ private:
    * @param   title  (out) Parsed task title.
    * @param   pr     (out) Parsed priority.
    * @param   due    (out) Parsed due date.
+   * @param   repeat (out) Parsed recurrence rule.
+   * @param   after  (out) Ids the new task waits on.
    * @return  EXIT_SUCCESS on success; EXIT_FAILURE on invalid flags or missing values.
    */
   int parseAdd(int argc, char *argv[],
                std::string &title,
                Priority &pr,
-               std::optional<ymd> &due);
+               std::optional<ymd> &due,
+               Recurrence &repeat,
+               std::vector<int> &after);
+
+  /**
+   * @brief   Parse flags and values for the `edit` command.
+   * @param   argc  Argument count.
+   * @param   argv  Argument vector.
+   * @param   edit  (out) Fields to change.
+   * @return  EXIT_SUCCESS on success; EXIT_FAILURE on an invalid date or if
+   *          nothing would change.
+   */
+  int parseEdit(int argc, char *argv[], TaskManager::TaskEdit &edit);
+
+  /**
+   * @brief   Pull `--list NAME` out of the arguments.
+   * @param   argc  (in/out) Argument count, reduced by the removed pair.
+   * @param   argv  Argument vector, compacted in place.
+   * @param   list  (out) Interned list, if the flag was given.
+   * @return  False if the flag has no value or the name is invalid.
+   */
+  bool extractList(int &argc, char *argv[], std::optional<ListId> &list);
+
+  /**
+   * @brief   Print help for one subcommand (or the overview if unknown/empty).
+   * @param   cmd  Subcommand name.
+   */
+  void printCommandHelp(std::string_view cmd);
+
+  /**
+   * @brief   Complete or archive a task, patching its record in place when the
+   *          store index allows it and falling back to load/modify/save.
+   * @param   id     Task identifier.
+   * @param   state  Status::Completed or Status::Archived.
+   * @return  EXIT_SUCCESS on success; EXIT_FAILURE if the task does not exist.
+   */
+  int changeStatus(int id, Status state);
+
+  /**
+   * @brief   Apply one change to the store so that concurrent `todo`
+   *          processes never lose each other's writes.
+   * @param   apply  The change; returns false (having said why) to abort.
+   *                 Runs again on a fresh load if another process saved
+   *                 first, so it must report only through captures.
+   * @param   saved  Runs once the store is saved, still under the lock.
+   * @param   only   If set, the change touched just this task, so only its
+   *                 record is written (see TaskManager::saveTaskIfUnchanged).
+   * @return  EXIT_SUCCESS if the change was saved.
+   */
+  int commit(const std::function<bool(TaskManager &)> &apply,
+             const std::function<void(TaskManager &)> &saved = {},
+             std::optional<int> only = std::nullopt);
+
+  /**
+   * @brief   Append a just-saved change to the store's undo log.
+   * @param   op  The change, with the snapshot its inverse needs.
+   */
+  void recordOp(Operation op);
+
+  /**
+   * @brief   Run `undo` or `redo` against the full store.
+   * @param   redo  True for redo.
+   * @return  EXIT_SUCCESS on success; EXIT_FAILURE if there was nothing to do
+   *          or it no longer applies.
+   */
+  int undoRedo(bool redo);
+
+  /**
+   * @brief   Run `watch`: report deadlines and reminders as they come up,
+   *          reloading the store whenever another command changes it.
+   * @param   argc  Argument count.
+   * @param   argv  Argument vector.
+   * @param   only  If set, watch just this list.
+   * @return  EXIT_FAILURE on invalid flags; otherwise runs until killed (or
+   *          returns EXIT_SUCCESS after one round with --once).
+   */
+  int watch(int argc, char *argv[], std::optional<ListId> only);
 };
\ No newline at end of file
@@ -0,0 +1,865 @@
+/**
+ * @file    task_file.cpp
+ * @brief   Implements record parsing/serialisation and the id→offset index.
+ */
+
+#include "task_file.hpp"
+#include "block_store.hpp"
+#include "lz_codec.hpp"
+#include "task_manager.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <unordered_map>
+
+using namespace std;
+
+// Header of tasks.json.idx: magic, entry count, size of the store it indexes.
+static constexpr char kIndexMagic[4] = {'T', 'I', 'D', 'X'};
+static constexpr size_t kIndexHeader = sizeof(kIndexMagic) + sizeof(uint32_t) + sizeof(uint64_t);
+
+// Header of each tasks.json.archive frame: magic, record count, raw size, packed size.
+static constexpr char kArchiveMagic[4] = {'T', 'A', 'R', 'C'};
+static constexpr size_t kFrameHeader = sizeof(kArchiveMagic) + 3 * sizeof(uint32_t);
+
+namespace {
+
+/**
+ * @brief  Value after the first ':' on a line, with leading blanks skipped.
+ */
+string_view fieldValue(string_view line) {
+  size_t colon = line.find(':');
+  size_t start = line.find_first_not_of(" \t", colon + 1);
+  return start == string_view::npos ? string_view{} : line.substr(start);
+}
+
+/**
+ * @brief  Text between the first and last quote of a field value.
+ */
+string_view quotedValue(string_view line) {
+  string_view value = fieldValue(line);
+  size_t start = value.find('"');
+  size_t end = value.rfind('"');
+  if (start == string_view::npos || end <= start)
+    return {};
+  return value.substr(start + 1, end - start - 1);
+}
+
+int intValue(string_view line) {
+  string_view value = fieldValue(line);
+  int out = -1;
+  from_chars(value.data(), value.data() + value.size(), out);
+  return out;
+}
+
+/**
+ * @brief  Integers of a `[1, 2, 3]` field value.
+ */
+vector<int> intList(string_view line) {
+  vector<int> out;
+  string_view value = fieldValue(line);
+  const char *p = value.data(), *end = value.data() + value.size();
+  while (p < end) {
+    if (isdigit(static_cast<unsigned char>(*p)) || *p == '-') {
+      int v = 0;
+      p = from_chars(p, end, v).ptr;
+      out.push_back(v);
+    } else {
+      ++p;
+    }
+  }
+  return out;
+}
+
+/**
+ * @brief  A uid as 16 hex digits.
+ */
+string uidValue(uint64_t uid) {
+  char hex[16];
+  auto end = to_chars(hex, hex + sizeof(hex), uid, 16).ptr;
+  return string(sizeof(hex) - static_cast<size_t>(end - hex), '0') + string(hex, end);
+}
+
+/**
+ * @brief  The "clock" value: the status stamp in kStampDigits digits, then the
+ *         stamps of every other field in Field order.
+ */
+string clockValue(const Task &t) {
+  string state = std::to_string(t.clock[static_cast<size_t>(Field::State)]);
+  string out(kStampDigits - min(kStampDigits, state.size()), '0');
+  out += state;
+  for (size_t f = 0; f < kFieldCount; ++f)
+    if (f != static_cast<size_t>(Field::State))
+      out += ' ' + std::to_string(t.clock[f]);
+  return out;
+}
+
+void parseClock(string_view text, Task &t) {
+  const char *p = text.data(), *end = text.data() + text.size();
+  p = from_chars(p, end, t.clock[static_cast<size_t>(Field::State)]).ptr;
+  for (size_t f = 0; f < kFieldCount && p < end; ++f) {
+    if (f == static_cast<size_t>(Field::State))
+      continue;
+    p = from_chars(p + 1, end, t.clock[f]).ptr;
+  }
+}
+
+/**
+ * @brief  Key of a `"key": value` line, or empty if the line is not a field.
+ */
+string_view fieldKey(string_view line) {
+  size_t start = line.find_first_not_of(" \t");
+  if (start == string_view::npos || line[start] != '"')
+    return {};
+  size_t end = line.find('"', start + 1);
+  if (end == string_view::npos || line.find(':', end) == string_view::npos)
+    return {};
+  return line.substr(start + 1, end - start - 1);
+}
+
+} // namespace
+
+bool closes_record(string_view line) {
+  return fieldKey(line).empty() && line.find('}') != string_view::npos;
+}
+
+string index_path(const string &store) {
+  return store + ".idx";
+}
+
+string search_path(const string &store) {
+  return store + ".search";
+}
+
+string log_path(const string &store) {
+  return store + ".log";
+}
+
+string lock_path(const string &store) {
+  return store + ".lock";
+}
+
+string tombstone_path(const string &store) {
+  return store + ".removed";
+}
+
+string archive_path(const string &store) {
+  return store + ".archive";
+}
+
+string journal_path(const string &store) {
+  return store + ".journal";
+}
+
+string history_path(const string &store) {
+  return store + ".history";
+}
+
+string stats_path(const string &store) {
+  return store + ".stats";
+}
+
+/**
+ * @brief  Walks whole lines until one closes a record.
+ */
+size_t align_to_record(string_view text, size_t pos) {
+  while (pos < text.size()) {
+    size_t eol = text.find('\n', pos);
+    size_t next = eol == string_view::npos ? text.size() : eol + 1;
+    if (closes_record(text.substr(pos, next - pos)))
+      return next;
+    pos = next;
+  }
+  return text.size();
+}
+
+/**
+ * @brief  Line-by-line record parser; the key is matched at the start of the line.
+ */
+void parse_records(string_view text, vector<unique_ptr<Task>> &out) {
+  int id = -1, pr = 0, status = 0;
+  uint64_t uid = 0;
+  string title, clock;
+  optional<ymd> due_opt;
+  Recurrence repeat;
+  ListId list = kDefaultList;
+  vector<int> after;
+  bool has_id = false, has_title = false, has_pr = false, has_status = false;
+
+  // Read in each individual line and extract fields.
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t eol = text.find('\n', pos);
+    if (eol == string_view::npos)
+      eol = text.size();
+    string_view line = text.substr(pos, eol - pos);
+    pos = eol + 1;
+
+    string_view key = fieldKey(line);
+    if (key == "id") {
+      id = intValue(line);
+      has_id = true;
+    } else if (key == "uid") {
+      string_view hex = quotedValue(line);
+      from_chars(hex.data(), hex.data() + hex.size(), uid, 16);
+    } else if (key == "title") {
+      title = quotedValue(line);
+      has_title = true;
+    } else if (key == "priority") {
+      pr = intValue(line);
+      has_pr = true;
+    } else if (key == "due") {
+      if (fieldValue(line).starts_with("null"))
+        due_opt = nullopt;
+      else
+        due_opt = to_ymd(string{quotedValue(line)});
+    } else if (key == "list") {
+      list = intern_list(quotedValue(line));
+    } else if (key == "repeat") {
+      repeat = Recurrence::parse(quotedValue(line)).value_or(Recurrence{});
+    } else if (key == "after") {
+      after = intList(line);
+    } else if (key == "clock") {
+      clock = quotedValue(line);
+    } else if (key == "status") {
+      status = intValue(line);
+      has_status = true;
+    } else if (key.empty() && line.find('}') != string_view::npos) {
+      // Check if we have all the required fields
+      if (has_id && has_title && has_pr && has_status) {
+        auto task = make_unique<Task>(id, title, static_cast<Priority>(pr), due_opt);
+        task->state = static_cast<Status>(status);
+        task->list = list;
+        task->repeat = repeat;
+        task->after = std::move(after);
+        task->uid = uid != 0 ? uid : legacy_uid(*task);
+        parseClock(clock, *task);
+        out.push_back(std::move(task));
+      }
+      // Reset for next task
+      has_id = has_title = has_pr = has_status = false;
+      id = pr = status = -1;
+      uid = 0;
+      clock.clear();
+      due_opt = nullopt;
+      list = kDefaultList;
+      repeat = {};
+      after.clear();
+      title.clear();
+    }
+  }
+}
+
+/**
+ * @brief  Same field order and indentation saveToFile has always produced.
+ */
+void write_record(string &out, const Task &t, bool last, span<const int> unblocks) {
+  auto id_list = [&](const char *key, span<const int> ids) {
+    out += "\t\t\t\"";
+    out += key;
+    out += "\": [";
+    for (size_t i = 0; i < ids.size(); ++i)
+      out += (i ? ", " : "") + std::to_string(ids[i]);
+    out += "],\n";
+  };
+
+  out += "\t\t{\n"; // open braces
+  out += "\t\t\t\"id\": " + std::to_string(t.id) + ",\n";
+  out += "\t\t\t\"uid\": \"" + uidValue(t.uid) + "\",\n";
+  out += "\t\t\t\"title\": \"" + t.title + "\",\n";
+  out += "\t\t\t\"priority\": " + std::to_string(static_cast<int>(t.pr)) + ",\n";
+  if (t.due.has_value())
+    out += "\t\t\t\"due\": \"" + to_string(t.due.value()) + "\",\n";
+  else
+    out += "\t\t\t\"due\": null,\n";
+  if (t.list != kDefaultList)
+    out += "\t\t\t\"list\": \"" + list_name(t.list) + "\",\n";
+  if (t.repeat.active())
+    out += "\t\t\t\"repeat\": \"" + t.repeat.str() + "\",\n";
+  if (!t.after.empty())
+    id_list("after", t.after);
+  if (!unblocks.empty())
+    id_list("unblocks", unblocks);
+  out += "\t\t\t\"clock\": \"" + clockValue(t) + "\",\n";
+  out += "\t\t\t\"status\": " + std::to_string(static_cast<int>(t.state)) + "\n";
+  out += last ? "\t\t}\n" : "\t\t},\n";
+}
+
+/**
+ * @brief  Fixed-width entries sorted by id so lookups can binary-search on disk.
+ */
+bool write_index(const string &path, uint64_t store_size, vector<IndexEntry> entries) {
+  sort(entries.begin(), entries.end(), [](const IndexEntry &a, const IndexEntry &b) { return a.id < b.id; });
+
+  ofstream out(path, ios::binary | ios::trunc);
+  if (!out)
+    return false;
+
+  uint32_t count = static_cast<uint32_t>(entries.size());
+  out.write(kIndexMagic, sizeof(kIndexMagic));
+  out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+  out.write(reinterpret_cast<const char *>(&store_size), sizeof(store_size));
+  out.write(reinterpret_cast<const char *>(entries.data()), static_cast<streamsize>(entries.size() * sizeof(IndexEntry)));
+  return static_cast<bool>(out);
+}
+
+namespace {
+
+/**
+ * @brief  Reads the header and returns the entry count if it matches the store.
+ */
+optional<uint32_t> openIndex(ifstream &in, uint64_t store_size) {
+  char magic[sizeof(kIndexMagic)];
+  uint32_t count = 0;
+  uint64_t indexed_size = 0;
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char *>(&count), sizeof(count));
+  in.read(reinterpret_cast<char *>(&indexed_size), sizeof(indexed_size));
+  if (!in || memcmp(magic, kIndexMagic, sizeof(magic)) != 0 || indexed_size != store_size)
+    return nullopt;
+  return count;
+}
+
+/**
+ * @brief  Bisects entries [lo, hi) on disk for id.
+ * @return The entry, id -1 if absent, or nullopt on a short read.
+ */
+optional<IndexEntry> bisect(ifstream &in, size_t lo, size_t hi, int id) {
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    IndexEntry entry{};
+    in.seekg(static_cast<streamoff>(kIndexHeader + mid * sizeof(IndexEntry)));
+    if (!in.read(reinterpret_cast<char *>(&entry), sizeof(entry)))
+      return nullopt;
+
+    if (entry.id == id)
+      return entry;
+    if (entry.id < id)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return IndexEntry{-1, 0, 0};
+}
+
+} // namespace
+
+/**
+ * @brief  Validates the header against the store, then bisects the entries.
+ */
+optional<IndexEntry> find_in_index(const string &path, uint64_t store_size, int id) {
+  ifstream in(path, ios::binary);
+  optional<uint32_t> count = in ? openIndex(in, store_size) : nullopt;
+  if (!count.has_value())
+    return nullopt;
+  return bisect(in, 0, *count, id);
+}
+
+optional<vector<IndexEntry>> find_in_index(const string &path, uint64_t store_size, const vector<int> &ids) {
+  ifstream in(path, ios::binary);
+  optional<uint32_t> count = in ? openIndex(in, store_size) : nullopt;
+  if (!count.has_value())
+    return nullopt;
+
+  vector<IndexEntry> found;
+  for (int id : ids) {
+    optional<IndexEntry> entry = bisect(in, 0, *count, id);
+    if (!entry.has_value())
+      return nullopt;
+    if (entry->id != -1)
+      found.push_back(*entry);
+  }
+  return found;
+}
+
+unique_ptr<Task> read_record(istream &in, const IndexEntry &entry) {
+  string record(entry.length, '\0');
+  in.seekg(static_cast<streamoff>(entry.offset));
+  if (!in.read(record.data(), entry.length))
+    return nullptr;
+
+  vector<unique_ptr<Task>> parsed;
+  parse_records(record, parsed);
+  if (parsed.size() != 1 || parsed[0]->id != entry.id)
+    return nullptr;
+  return std::move(parsed[0]);
+}
+
+/**
+ * @brief  Probes land mid-record, so each one skips to the next record start;
+ *         the search narrows [lo, hi) over record starts only.
+ */
+uint64_t seek_record(istream &in, const function<bool(const Task &)> &pred) {
+  uint64_t lo = static_cast<uint64_t>(in.tellg());
+  in.seekg(0, ios::end);
+  uint64_t hi = static_cast<uint64_t>(in.tellg());
+
+  // Start of the first record beginning after pos, or hi if there is none.
+  // A start is an opening "{" line right after a closing one, so a '}' in
+  // the tail of a title the probe landed in is not taken for a boundary.
+  string line;
+  auto next_start = [&](uint64_t pos) {
+    in.clear();
+    in.seekg(static_cast<streamoff>(pos));
+    bool closed = false;
+    for (uint64_t at = pos; at < hi && getline(in, line); at += line.size() + 1) {
+      if (closed && line.find_first_not_of(" \t") != string::npos && line[line.find_first_not_of(" \t")] == '{')
+        return at;
+      closed = closes_record(line);
+    }
+    return hi;
+  };
+  // The closing "}" of the store parses to nothing and counts as past the end
+  auto holds = [&](uint64_t start) {
+    in.clear();
+    in.seekg(static_cast<streamoff>(start));
+    string record;
+    while (getline(in, line)) {
+      record += line;
+      record += '\n';
+      if (closes_record(line))
+        break;
+    }
+    vector<unique_ptr<Task>> parsed;
+    parse_records(record, parsed);
+    return parsed.empty() || pred(*parsed.front());
+  };
+
+  while (lo < hi) {
+    uint64_t start = next_start(lo + (hi - lo) / 2);
+    if (start >= hi) {
+      // Nothing starts between the probe and hi, so decide lo itself
+      if (holds(lo))
+        hi = lo;
+      else
+        lo = next_start(lo);
+    } else if (holds(start))
+      hi = start;
+    else
+      lo = next_start(start);
+  }
+
+  in.clear();
+  in.seekg(static_cast<streamoff>(lo));
+  return lo;
+}
+
+/**
+ * @brief  Re-parses the record to confirm the id, then rewrites one byte.
+ */
+bool patch_status(const string &store, const IndexEntry &entry, Status state, uint32_t stamp, Task *before) {
+  fstream file(store, ios::in | ios::out | ios::binary);
+  if (!file)
+    return false;
+
+  string record(entry.length, '\0');
+  file.seekg(static_cast<streamoff>(entry.offset));
+  if (!file.read(record.data(), entry.length))
+    return false;
+
+  vector<unique_ptr<Task>> parsed;
+  parse_records(record, parsed);
+  if (parsed.size() != 1 || parsed[0]->id != entry.id)
+    return false;
+
+  // Completing a recurring task adds its next occurrence: needs the full store
+  if (state == Status::Completed && parsed[0]->repeat.active())
+    return false;
+
+  // Dependents' records would change too
+  for (size_t pos = 0; pos < record.size();) {
+    size_t eol = record.find('\n', pos);
+    if (eol == string::npos)
+      eol = record.size();
+    if (fieldKey(string_view{record}.substr(pos, eol - pos)) == "unblocks")
+      return false;
+    pos = eol + 1;
+  }
+
+  // "status": N\n — only a single digit can be swapped without moving bytes
+  size_t key = record.find("\"status\":");
+  size_t digit = record.find_first_not_of(" \t", key + 9);
+  if (key == string::npos || digit + 1 >= record.size() || !isdigit(record[digit]) || record[digit + 1] != '\n')
+    return false;
+
+  // The status stamp leads the clock in fixed width, so it is overwritten too
+  size_t clock = record.find("\"clock\": \"");
+  string stamp_digits = std::to_string(stamp);
+  if (clock == string::npos || stamp_digits.size() > kStampDigits ||
+      record.size() < clock + 10 + kStampDigits ||
+      !all_of(record.begin() + clock + 10, record.begin() + clock + 10 + kStampDigits, ::isdigit))
+    return false;
+  stamp_digits.insert(0, kStampDigits - stamp_digits.size(), '0');
+
+  if (before)
+    *before = *parsed[0];
+  file.seekp(static_cast<streamoff>(entry.offset + clock + 10));
+  file.write(stamp_digits.data(), static_cast<streamsize>(stamp_digits.size()));
+  file.seekp(static_cast<streamoff>(entry.offset + digit));
+  file.put(static_cast<char>('0' + static_cast<int>(state)));
+  return static_cast<bool>(file.flush());
+}
+
+/**
+ * @brief  The header sits before the "tasks" array, so only a few lines are read.
+ */
+unique_ptr<istream> open_store(const string &store) {
+  auto plain = make_unique<ifstream>(store, ios::binary);
+  if (!*plain)
+    return nullptr;
+
+  char magic[4] = {};
+  plain->read(magic, sizeof(magic));
+  if (is_block_store({magic, static_cast<size_t>(plain->gcount())})) {
+    auto blocks = make_unique<BlockStream>(store);
+    if (!*blocks)
+      return nullptr;
+    return blocks;
+  }
+  plain->clear();
+  plain->seekg(0);
+  return plain;
+}
+
+StoreHeader read_store_header(istream &in) {
+  StoreHeader header;
+  string line;
+  uint64_t offset = 0;
+  while (getline(in, line)) {
+    string_view key = fieldKey(line);
+    if (key == "ranked")
+      header.ranked = to_ymd(string{quotedValue(line)});
+    else if (key == "generation") {
+      string_view digits = quotedValue(line);
+      if (digits.size() == kGenerationDigits && from_chars(digits.begin(), digits.end(), header.generation).ec == errc{})
+        header.generation_at = offset + static_cast<uint64_t>(digits.data() - line.data());
+    } else if (key == "rewritten") {
+      string_view digits = quotedValue(line);
+      if (digits.size() == kGenerationDigits && from_chars(digits.begin(), digits.end(), header.rewritten).ec == errc{})
+        header.rewritten_at = offset + static_cast<uint64_t>(digits.data() - line.data());
+    } else if (key == "next_id")
+      header.next_id = max(intValue(line), 0);
+    else if (key == "tasks")
+      break;
+    offset += line.size() + 1;
+  }
+  return header;
+}
+
+string write_store_header(const ymd &ranked, uint64_t generation, int next_id) {
+  string digits = std::to_string(generation);
+  digits.insert(0, kGenerationDigits - digits.size(), '0');
+  return "{\n\t\"ranked\": \"" + to_string(ranked) + "\",\n\t\"generation\": \"" + digits +
+         "\",\n\t\"rewritten\": \"" + digits + "\",\n\t\"next_id\": " + std::to_string(next_id) +
+         ",\n\t\"tasks\": [\n";
+}
+
+bool patch_generation(ostream &file, const StoreHeader &header, uint64_t generation, bool records) {
+  string digits = std::to_string(generation);
+  digits.insert(0, kGenerationDigits - digits.size(), '0');
+  if (records && header.rewritten_at != 0) {
+    file.seekp(static_cast<streamoff>(header.rewritten_at));
+    file.write(digits.data(), static_cast<streamsize>(digits.size()));
+  }
+  file.seekp(static_cast<streamoff>(header.generation_at));
+  file.write(digits.data(), static_cast<streamsize>(digits.size()));
+  return static_cast<bool>(file.flush());
+}
+
+/**
+ * @brief  One "uid stamp" line per removed task.
+ */
+Tombstones read_tombstones(const string &path) {
+  Tombstones removed;
+  ifstream in(path);
+  string uid;
+  uint32_t at;
+  while (in >> uid >> at) {
+    uint64_t value = 0;
+    if (from_chars(uid.data(), uid.data() + uid.size(), value, 16).ec == errc{})
+      removed[value] = at;
+  }
+  return removed;
+}
+
+bool write_tombstones(const string &path, const Tombstones &removed) {
+  string out;
+  out.reserve(removed.size() * 28);
+  for (const auto &[uid, at] : removed)
+    out += uidValue(uid) + ' ' + std::to_string(at) + '\n';
+
+  ofstream file(path, ios::trunc);
+  file << out;
+  return static_cast<bool>(file);
+}
+
+/**
+ * @brief  Lines of "<name> <numbers...>"; the closing "end" line proves the
+ *         write finished, so a torn file reads as missing.
+ */
+optional<SavedStats> read_stats(const string &path) {
+  ifstream in(path);
+  SavedStats saved;
+  string name;
+  auto counts = [&](StoreStats::Counts &into) {
+    for (auto &row : into)
+      for (size_t &n : row)
+        in >> n;
+  };
+  while (in >> name) {
+    StoreStats::Day day;
+    size_t n;
+    if (name == "generation")
+      in >> saved.generation;
+    else if (name == "total")
+      counts(saved.total.counts);
+    else if (name == "cold")
+      counts(saved.cold.counts);
+    else if (name == "due" && in >> day >> n)
+      saved.total.due[day] = n;
+    else if (name == "done" && in >> day >> n)
+      saved.total.done[day] = n;
+    else if (name == "end")
+      return saved;
+    else
+      break;
+  }
+  return nullopt;
+}
+
+bool write_stats(const string &path, const SavedStats &saved) {
+  string out = "generation " + std::to_string(saved.generation) + '\n';
+  auto counts = [&](const char *name, const StoreStats::Counts &from) {
+    out += name;
+    for (const auto &row : from)
+      for (size_t n : row)
+        out += ' ' + std::to_string(n);
+    out += '\n';
+  };
+  counts("total", saved.total.counts);
+  counts("cold", saved.cold.counts);
+  for (const auto &[day, n] : saved.total.due)
+    out += "due " + std::to_string(day) + ' ' + std::to_string(n) + '\n';
+  for (const auto &[day, n] : saved.total.done)
+    out += "done " + std::to_string(day) + ' ' + std::to_string(n) + '\n';
+  out += "end\n";
+
+  ofstream file(path, ios::trunc);
+  file << out;
+  return static_cast<bool>(file);
+}
+
+namespace {
+
+/**
+ * @brief  One frame: header, then the compressed records.
+ */
+string make_frame(span<const Task *const> tasks) {
+  string raw;
+  for (const Task *task : tasks)
+    write_record(raw, *task, false);
+  string packed = lz_compress(raw);
+
+  uint32_t sizes[3] = {static_cast<uint32_t>(tasks.size()), static_cast<uint32_t>(raw.size()),
+                       static_cast<uint32_t>(packed.size())};
+  string frame(kArchiveMagic, sizeof(kArchiveMagic));
+  frame.append(reinterpret_cast<const char *>(sizes), sizeof(sizes));
+  return frame + packed;
+}
+
+/**
+ * @brief  Reads the next frame header.
+ * @return (count, raw size, packed size), or nullopt at the end or on damage.
+ */
+optional<array<uint32_t, 3>> readFrameHeader(istream &in) {
+  char magic[sizeof(kArchiveMagic)];
+  array<uint32_t, 3> sizes{};
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char *>(sizes.data()), sizeof(uint32_t) * sizes.size());
+  if (!in || memcmp(magic, kArchiveMagic, sizeof(magic)) != 0)
+    return nullopt;
+  return sizes;
+}
+
+} // namespace
+
+/**
+ * @brief  Walks the frame headers to find where the last whole frame ends.
+ */
+bool append_archive(const string &path, span<const Task *const> tasks) {
+  if (tasks.empty())
+    return true;
+
+  error_code ec;
+  uint64_t size = filesystem::file_size(path, ec);
+  if (!ec) {
+    ifstream in(path, ios::binary);
+    uint64_t valid = 0;
+    while (auto sizes = readFrameHeader(in)) {
+      uint64_t end = valid + kFrameHeader + (*sizes)[2];
+      if (end > size)
+        break;
+      valid = end;
+      in.seekg(static_cast<streamoff>(valid));
+    }
+    if (valid != size)
+      filesystem::resize_file(path, valid, ec);
+  }
+
+  ofstream out(path, ios::binary | ios::app);
+  string frame = make_frame(tasks);
+  out.write(frame.data(), static_cast<streamsize>(frame.size()));
+  return static_cast<bool>(out.flush());
+}
+
+bool write_archive(const string &path, span<const Task *const> tasks) {
+  string tmp = path + ".tmp";
+  {
+    ofstream out(tmp, ios::binary | ios::trunc);
+    if (!tasks.empty()) {
+      string frame = make_frame(tasks);
+      out.write(frame.data(), static_cast<streamsize>(frame.size()));
+    }
+    if (!out.flush())
+      return false;
+  }
+  error_code ec;
+  filesystem::rename(tmp, path, ec);
+  return !ec;
+}
+
+/**
+ * @brief  Later records of a uid replace earlier ones in place.
+ */
+ArchiveContents read_archive(const string &path) {
+  ArchiveContents contents;
+  ifstream in(path, ios::binary);
+  unordered_map<uint64_t, size_t> slot;
+  vector<unique_ptr<Task>> frame_tasks;
+  string packed;
+
+  while (auto sizes = readFrameHeader(in)) {
+    auto [count, raw_size, packed_size] = *sizes;
+    packed.resize(packed_size);
+    if (!in.read(packed.data(), packed_size))
+      break;
+    optional<string> raw = lz_decompress(packed, raw_size);
+    if (!raw.has_value())
+      break;
+
+    frame_tasks.clear();
+    parse_records(*raw, frame_tasks);
+    if (frame_tasks.size() != count)
+      break;
+    contents.records += count;
+    for (auto &task : frame_tasks) {
+      auto [it, fresh] = slot.try_emplace(task->uid, contents.tasks.size());
+      if (fresh)
+        contents.tasks.push_back(std::move(task));
+      else
+        contents.tasks[it->second] = std::move(task);
+    }
+  }
+  return contents;
+}
+
+/**
+ * @brief  Journals stay small (saves fold them back into the store), so the
+ *         whole file is scanned for the end of its last whole record.
+ */
+bool append_journal(const string &path, const Task &task) {
+  string text;
+  if (ifstream in{path, ios::binary})
+    text.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+
+  size_t valid = 0;
+  for (size_t pos = 0, eol; (eol = text.find('\n', pos)) != string::npos; pos = eol + 1)
+    if (closes_record(string_view{text}.substr(pos, eol - pos)))
+      valid = eol + 1;
+  if (valid != text.size()) {
+    error_code ec;
+    filesystem::resize_file(path, valid, ec);
+    if (ec)
+      return false;
+  }
+
+  string record;
+  write_record(record, task, false);
+  ofstream out(path, ios::binary | ios::app);
+  out.write(record.data(), static_cast<streamsize>(record.size()));
+  return static_cast<bool>(out.flush());
+}
+
+vector<unique_ptr<Task>> read_journal(const string &path) {
+  vector<unique_ptr<Task>> tasks;
+  ifstream in(path, ios::binary);
+  if (!in)
+    return tasks;
+  string text{istreambuf_iterator<char>(in), istreambuf_iterator<char>()};
+  parse_records(text, tasks);
+  return tasks;
+}
+
+/**
+ * @brief  Only the bytes past the offset are read; a torn last record is left
+ *         for the next call, when its writer has finished it.
+ */
+vector<unique_ptr<Task>> read_journal(const string &path, uint64_t &from) {
+  vector<unique_ptr<Task>> tasks;
+  ifstream in(path, ios::binary);
+  if (!in) {
+    from = 0;
+    return tasks;
+  }
+  in.seekg(0, ios::end);
+  auto size = static_cast<uint64_t>(in.tellg());
+  if (size < from)
+    from = 0;
+  string text(size - from, '\0');
+  in.seekg(static_cast<streamoff>(from));
+  in.read(text.data(), static_cast<streamsize>(text.size()));
+  text.resize(static_cast<size_t>(in.gcount()));
+
+  size_t valid = 0;
+  for (size_t pos = 0, eol; (eol = text.find('\n', pos)) != string::npos; pos = eol + 1)
+    if (closes_record(string_view{text}.substr(pos, eol - pos)))
+      valid = eol + 1;
+  parse_records(string_view{text}.substr(0, valid), tasks);
+  from += valid;
+  return tasks;
+}
+
+/**
+ * @brief  Edits are matched by uid, since ids are reused after removals.
+ */
+void fold_journal(vector<unique_ptr<Task>> &tasks, vector<unique_ptr<Task>> edits) {
+  if (edits.empty())
+    return;
+  unordered_map<uint64_t, Task *> by_uid;
+  by_uid.reserve(tasks.size());
+  for (auto &task : tasks)
+    by_uid.emplace(task->uid, task.get());
+
+  auto at = [](const Task &task, Field field) { return task.clock[static_cast<size_t>(field)]; };
+  for (const auto &edit : edits) {
+    auto it = by_uid.find(edit->uid);
+    if (it == by_uid.end())
+      continue;
+    Task &task = *it->second;
+    if (at(*edit, Field::Title) > at(task, Field::Title)) {
+      task.title = edit->title;
+      task.stamp(Field::Title, at(*edit, Field::Title));
+    }
+    if (at(*edit, Field::Pr) > at(task, Field::Pr)) {
+      task.pr = edit->pr;
+      task.stamp(Field::Pr, at(*edit, Field::Pr));
+    }
+    if (at(*edit, Field::Due) > at(task, Field::Due)) {
+      task.due = edit->due;
+      task.stamp(Field::Due, at(*edit, Field::Due));
+    }
+  }
+}
@@ -0,0 +1,375 @@
+/**
+ * @file    task_file.hpp
+ * @brief   On-disk layout of tasks.json and its sidecar files.
+ *
+ * TaskManager owns the policy (what to load, when to save); this module owns
+ * the bytes: parsing and writing task records, and the binary id→offset
+ * index (tasks.json.idx) that lets single-task commands find a record
+ * without parsing the whole store.
+ *
+ * The store header carries a generation number that every save and in-place
+ * patch bumps, so a process can tell whether the file changed since it was
+ * loaded. It is written as fixed-width digits so a patch can bump it without
+ * moving any record.
+ *
+ * Every record carries a uid (its identity across stores) and a "clock" with
+ * the logical time each field last changed, which `todo merge` compares. The
+ * status stamp comes first and is fixed width so patch_status can bump it in
+ * place. Removed tasks are remembered by uid in tasks.json.removed.
+ *
+ * Archived and long-completed tasks live in a cold tier (tasks.json.archive):
+ * an append-only run of frames, each a batch of records in the same layout
+ * compressed with lz_compress. A task written again later supersedes its
+ * earlier copy, so readers keep the last record per uid.
+ *
+ * tasks.json.stats caches the aggregates behind `todo stats`, stamped with
+ * the generation they describe so a reader can tell whether they are current.
+ *
+ * tasks.json itself may be saved block-compressed (block_store.hpp). Readers
+ * go through open_store, which hides the difference; only the in-place status
+ * patch needs the plain form.
+ */
+
+#pragma once
+#include "task.hpp"
+#include "task_stats.hpp"
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @struct IndexEntry
+ * @brief  Where one record lives inside the store file.
+ */
+struct IndexEntry {
+  int32_t id;
+  uint32_t length; //< Bytes from the opening '{' line through the closing '}' line.
+  uint64_t offset; //< Byte offset of the opening '{' line.
+};
+
+// Digits in the fixed-width "generation" header field.
+static constexpr size_t kGenerationDigits = 20;
+
+// Digits of the status stamp that leads a record's "clock".
+static constexpr size_t kStampDigits = 10;
+
+/**
+ * @struct StoreHeader
+ * @brief  Fields that precede the "tasks" array.
+ */
+struct StoreHeader {
+  std::optional<ymd> ranked; //< Day the records were ranked for.
+  uint64_t generation{0};    //< Bumped by every write; 0 for older stores.
+  uint64_t generation_at{0}; //< Byte offset of its digits; 0 if the field is absent.
+  uint64_t rewritten{0};     //< Generation of the last write that changed record bytes
+                             //< (a full save or a status patch); journal appends leave it.
+  uint64_t rewritten_at{0};  //< Byte offset of its digits; 0 if the field is absent.
+  int next_id{0};            //< Lowest id never used, cold tasks included; 0 if absent.
+  bool compressed{false};    //< Saved in the block-compressed form.
+};
+
+/**
+ * @struct ArchiveContents
+ * @brief  Tasks read back from a cold archive.
+ */
+struct ArchiveContents {
+  std::vector<std::unique_ptr<Task>> tasks; //< Last record of each uid, in file order.
+  size_t records{0};                        //< Records in the file, superseded ones included.
+};
+
+/**
+ * @struct SavedStats
+ * @brief  Contents of tasks.json.stats.
+ */
+struct SavedStats {
+  uint64_t generation{0}; //< Store generation the counts describe; 0 marks them stale.
+  StoreStats total;       //< Every task, hot and cold, plus the completion history.
+  StoreStats cold;        //< Counts of the cold tier alone (tasks loadFromFile skips).
+};
+
+/**
+ * @brief   Path of the id→offset index that accompanies a store file.
+ * @param   store  Path to tasks.json.
+ * @return  store + ".idx".
+ */
+std::string index_path(const std::string &store);
+
+/**
+ * @brief   Path of the inverted title index that accompanies a store file.
+ * @param   store  Path to tasks.json.
+ * @return  store + ".search".
+ */
+std::string search_path(const std::string &store);
+
+/**
+ * @brief   Path of the undo/redo log that accompanies a store file.
+ * @param   store  Path to tasks.json.
+ * @return  store + ".log".
+ */
+std::string log_path(const std::string &store);
+
+/**
+ * @brief   Path of the advisory lock file (see StoreLock).
+ * @param   store  Path to tasks.json.
+ * @return  store + ".lock".
+ */
+std::string lock_path(const std::string &store);
+
+/**
+ * @brief   Path of the removed-task tombstones that accompany a store file.
+ * @param   store  Path to tasks.json.
+ * @return  store + ".removed".
+ */
+std::string tombstone_path(const std::string &store);
+
+/**
+ * @brief   Path of the cold archive of archived and old completed tasks.
+ * @param   store  Path to tasks.json.
+ * @return  store + ".archive".
+ */
+std::string archive_path(const std::string &store);
+
+/**
+ * @brief   Path of the journal of records edited since the last full save.
+ * @param   store  Path to tasks.json.
+ * @return  store + ".journal".
+ */
+std::string journal_path(const std::string &store);
+
+/**
+ * @brief   Path of the time series of task transitions (see task_history.hpp).
+ * @param   store  Path to tasks.json.
+ * @return  store + ".history".
+ */
+std::string history_path(const std::string &store);
+
+/**
+ * @brief   Path of the cached aggregates behind `todo stats`.
+ * @param   store  Path to tasks.json.
+ * @return  store + ".stats".
+ */
+std::string stats_path(const std::string &store);
+
+/**
+ * @brief   Parse every complete task record in a slice of the store file.
+ * @param   text  Slice starting at a record boundary.
+ * @param   out   (out) Parsed tasks are appended here.
+ */
+void parse_records(std::string_view text, std::vector<std::unique_ptr<Task>> &out);
+
+/**
+ * @brief   Move a split point forward to just past the next record-closing line.
+ * @param   text  Whole file.
+ * @param   pos   Candidate split offset.
+ * @return  Offset of the first byte after a record (or text.size()).
+ */
+size_t align_to_record(std::string_view text, size_t pos);
+
+/**
+ * @brief   Append one task record in the tasks.json layout.
+ * @param   out       Buffer to append to.
+ * @param   task      Task to serialise.
+ * @param   last      True for the final record (no trailing comma).
+ * @param   unblocks  Ids waiting on this task. Only written so single-record
+ *                    fast paths can tell the record has dependents.
+ */
+void write_record(std::string &out, const Task &task, bool last, std::span<const int> unblocks = {});
+
+/**
+ * @brief   Write the id→offset index for a freshly saved store.
+ * @param   path        Index file path.
+ * @param   store_size  Size of the store file the offsets refer to.
+ * @param   entries     One entry per record, any order.
+ * @return  True on success.
+ */
+bool write_index(const std::string &path, uint64_t store_size, std::vector<IndexEntry> entries);
+
+/**
+ * @brief   Binary-search the index on disk for one id (O(log n) seeks).
+ * @param   path        Index file path.
+ * @param   store_size  Current size of the store file; a mismatch means stale.
+ * @param   id          Task id to find.
+ * @return  The entry, an entry with id -1 if the index is valid but has no
+ *          such id, or nullopt if the index is missing or stale.
+ */
+std::optional<IndexEntry> find_in_index(const std::string &path, uint64_t store_size, int id);
+
+/**
+ * @brief   Batch form of find_in_index: opens the index once for many ids.
+ * @param   path        Index file path.
+ * @param   store_size  Current size of the store file.
+ * @param   ids         Ids to find; ids without a record are skipped.
+ * @return  Entries for the ids that exist, or nullopt if missing or stale.
+ */
+std::optional<std::vector<IndexEntry>> find_in_index(const std::string &path, uint64_t store_size,
+                                                     const std::vector<int> &ids);
+
+/**
+ * @brief   Read and parse the single record an index entry points at.
+ * @param   in     Open store stream.
+ * @param   entry  Index entry.
+ * @return  The task, or nullptr if the bytes there are not that record.
+ */
+std::unique_ptr<Task> read_record(std::istream &in, const IndexEntry &entry);
+
+/**
+ * @brief   Binary search over byte offsets for the first record satisfying
+ *          `pred`, which must hold for every record after it too (e.g.
+ *          "ranked below a key" in a ranked store). Reads O(log n) records.
+ * @param   in    Open store stream, positioned at the first record.
+ * @param   pred  Test on a parsed record.
+ * @return  Offset of that record (the end of the records if none); `in` is
+ *          left positioned there.
+ */
+uint64_t seek_record(std::istream &in, const std::function<bool(const Task &)> &pred);
+
+/**
+ * @brief   True for the line that closes a task record.
+ * @param   line  One line of the store, without its newline.
+ */
+bool closes_record(std::string_view line);
+
+/**
+ * @brief   Overwrite the status digit of one record in place. The record must
+ *          still hold the indexed id and a single-digit status, and must not
+ *          be a recurring task being completed (that adds a new record) or a
+ *          task others wait on (their records change too).
+ * @param   store  Path to tasks.json.
+ * @param   entry  Where the record lives (from find_in_index).
+ * @param   state  New status.
+ * @param   stamp  Logical time of the change, written to the status stamp.
+ * @param   before (out, optional) The record as it was before the patch.
+ * @return  True if the record was verified and patched.
+ */
+bool patch_status(const std::string &store, const IndexEntry &entry, Status state, uint32_t stamp,
+                  Task *before = nullptr);
+
+/**
+ * @brief   Open a store for reading in whichever form it was saved. A block
+ *          store is decompressed a block at a time as it is read or sought,
+ *          so line reads, seeks and read_record see the same text either way.
+ * @param   store  Path to tasks.json.
+ * @return  A stream over the store's text, or nullptr if it cannot be opened.
+ */
+std::unique_ptr<std::istream> open_store(const std::string &store);
+
+/**
+ * @brief   Read the store header (only the first few lines).
+ * @param   in  Stream positioned at the start of the store; left after the
+ *              line that opens the "tasks" array.
+ * @return  The header; missing fields keep their defaults.
+ */
+StoreHeader read_store_header(std::istream &in);
+
+/**
+ * @brief   Header lines for a store about to be written.
+ * @param   ranked      Day the records are ranked for.
+ * @param   generation  Generation the new file will carry.
+ * @param   next_id     Lowest id not used by any hot or cold task.
+ * @return  Everything up to and including the line opening "tasks".
+ */
+std::string write_store_header(const ymd &ranked, uint64_t generation, int next_id);
+
+/**
+ * @brief   Overwrite the generation digits of a store in place.
+ * @param   file    Store opened for writing.
+ * @param   header  Header read from that store (generation_at must be set).
+ * @param   generation  New value.
+ * @param   records     Record bytes were changed too, so "rewritten" moves
+ *                      along (if the store has the field).
+ * @return  True on success.
+ */
+bool patch_generation(std::ostream &file, const StoreHeader &header, uint64_t generation, bool records = false);
+
+/**
+ * @brief   Read the tombstones saved next to a store.
+ * @param   path  Tombstone file path; a missing file means none.
+ */
+Tombstones read_tombstones(const std::string &path);
+
+/**
+ * @brief   Write every tombstone, replacing the file.
+ * @param   path     Tombstone file path.
+ * @param   removed  Uid → logical time of the removal.
+ * @return  True on success.
+ */
+bool write_tombstones(const std::string &path, const Tombstones &removed);
+
+/**
+ * @brief   Append one compressed frame holding these tasks to an archive. A
+ *          torn frame left at the end by an interrupted append is cut off
+ *          first, so it cannot hide the new one.
+ * @param   path   Archive file path (created if missing).
+ * @param   tasks  Tasks to write; nothing is written if empty.
+ * @return  True on success.
+ */
+bool append_archive(const std::string &path, std::span<const Task *const> tasks);
+
+/**
+ * @brief   Replace an archive with a single frame of these tasks (written to
+ *          a temporary file and renamed over it).
+ * @param   path   Archive file path.
+ * @param   tasks  Every task the archive should hold.
+ * @return  True on success.
+ */
+bool write_archive(const std::string &path, std::span<const Task *const> tasks);
+
+/**
+ * @brief   Append one task's record to a journal. A torn record left at the
+ *          end by an interrupted append is cut off first.
+ * @param   path  Journal file path (created if missing).
+ * @param   task  Task as it is now.
+ * @return  True on success.
+ */
+bool append_journal(const std::string &path, const Task &task);
+
+/**
+ * @brief   Parse every complete record of a journal, oldest first.
+ * @param   path  Journal file path; a missing file reads as empty.
+ */
+std::vector<std::unique_ptr<Task>> read_journal(const std::string &path);
+
+/**
+ * @brief   Parse the complete records appended to a journal since an offset.
+ * @param   path  Journal file path; a missing file reads as empty.
+ * @param   from  (in/out) Byte offset to start at; moved past the last whole
+ *                record read. A journal shorter than it is read from the start.
+ */
+std::vector<std::unique_ptr<Task>> read_journal(const std::string &path, uint64_t &from);
+
+/**
+ * @brief   Merge journaled edits into the tasks they belong to (by uid). Only
+ *          fields an edit stamped later than the task's copy are taken, so a
+ *          status patched in place after the edit is kept.
+ * @param   tasks  Tasks as read from the store.
+ * @param   edits  Journal records, oldest first; uids not in tasks are ignored.
+ */
+void fold_journal(std::vector<std::unique_ptr<Task>> &tasks, std::vector<std::unique_ptr<Task>> edits);
+
+/**
+ * @brief   Decompress and parse every frame of an archive, stopping at the
+ *          first frame that is torn or corrupt.
+ * @param   path  Archive file path; a missing file reads as empty.
+ */
+ArchiveContents read_archive(const std::string &path);
+
+/**
+ * @brief   Read the cached aggregates saved next to a store.
+ * @param   path  Stats file path.
+ * @return  The contents, or nullopt if the file is missing or was torn.
+ */
+std::optional<SavedStats> read_stats(const std::string &path);
+
+/**
+ * @brief   Write the cached aggregates, replacing the file.
+ * @param   path   Stats file path.
+ * @param   saved  Counts and the generation they describe.
+ * @return  True on success.
+ */
+bool write_stats(const std::string &path, const SavedStats &saved);
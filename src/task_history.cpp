@@ -0,0 +1,308 @@
+/**
+ * @file    task_history.cpp
+ * @brief   Implements the columnar history frames, their append/merge and the
+ *          streaming report.
+ */
+
+#include "task_history.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+using namespace std;
+using namespace std::chrono;
+
+static constexpr char kHistoryMagic[4] = {'T', 'H', 'I', 'S'};
+static constexpr char kTrailerMagic[4] = {'T', 'H', 'N', 'D'};
+static constexpr size_t kTrailerBytes = sizeof(uint64_t) + 2 * sizeof(uint32_t) + sizeof(kTrailerMagic);
+
+namespace {
+
+/**
+ * @brief  Where a frame's run of small frames starts, and the frame's size.
+ */
+struct Trailer {
+  uint64_t run_start{0};
+  uint32_t run_frames{0};
+  uint32_t frame_bytes{0};
+};
+
+void put_varint(string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out += static_cast<char>(value | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+bool get_varint(string_view &in, uint64_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+    auto byte = static_cast<uint8_t>(in.front());
+    in.remove_prefix(1);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief  Varint straight from a stream, for the frame header.
+ */
+bool get_varint(istream &in, uint64_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int byte = in.get();
+    if (byte == EOF)
+      return false;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+// Small signed deltas as small unsigned numbers: 0, -1, 1, -2, ...
+uint64_t zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+/**
+ * @brief  Kind in bits 0-2, priority in bits 3-4, open in bit 5.
+ */
+char tag(const HistoryEvent &event) {
+  return static_cast<char>(static_cast<unsigned>(event.kind) | static_cast<unsigned>(event.pr) << 3 |
+                           static_cast<unsigned>(event.open) << 5);
+}
+
+string encode_frame(span<const HistoryEvent> events, Trailer trailer) {
+  string payload;
+  payload.reserve(events.size() * 4);
+  int64_t at = 0, id = 0;
+  for (const HistoryEvent &event : events) {
+    put_varint(payload, zigzag(event.at - at));
+    at = event.at;
+  }
+  for (const HistoryEvent &event : events) {
+    put_varint(payload, zigzag(event.id - id));
+    id = event.id;
+  }
+  for (const HistoryEvent &event : events)
+    payload += tag(event);
+
+  string frame(kHistoryMagic, sizeof(kHistoryMagic));
+  put_varint(frame, events.size());
+  put_varint(frame, payload.size());
+  frame += payload;
+  trailer.frame_bytes = static_cast<uint32_t>(frame.size() + kTrailerBytes);
+  frame.append(reinterpret_cast<const char *>(&trailer.run_start), sizeof(trailer.run_start));
+  frame.append(reinterpret_cast<const char *>(&trailer.run_frames), sizeof(trailer.run_frames));
+  frame.append(reinterpret_cast<const char *>(&trailer.frame_bytes), sizeof(trailer.frame_bytes));
+  frame.append(kTrailerMagic, sizeof(kTrailerMagic));
+  return frame;
+}
+
+/**
+ * @brief  Read the next frame from a stream and decode its columns.
+ * @param  in      Stream positioned at a frame.
+ * @param  buf     Scratch buffer reused across frames.
+ * @param  out     (out) Events, replacing what it held.
+ * @param  bytes   (out) Size of the frame in the file.
+ * @return False at the end of the file or at a torn or corrupt frame.
+ */
+bool read_frame(istream &in, string &buf, vector<HistoryEvent> &out, uint64_t &bytes) {
+  char magic[sizeof(kHistoryMagic)];
+  uint64_t count = 0, size = 0;
+  streamoff start = in.tellg();
+  if (!in.read(magic, sizeof(magic)) || memcmp(magic, kHistoryMagic, sizeof(magic)) != 0 ||
+      !get_varint(in, count) || !get_varint(in, size) || size > (1u << 30) || count > size)
+    return false;
+  buf.resize(size + kTrailerBytes);
+  if (!in.read(buf.data(), static_cast<streamsize>(buf.size())) ||
+      memcmp(buf.data() + buf.size() - sizeof(kTrailerMagic), kTrailerMagic, sizeof(kTrailerMagic)) != 0)
+    return false;
+
+  // Three columns, each as long as the event count
+  out.resize(count);
+  string_view payload{buf.data(), size};
+  uint64_t value = 0;
+  int64_t at = 0, id = 0;
+  for (HistoryEvent &event : out) {
+    if (!get_varint(payload, value))
+      return false;
+    event.at = at += unzigzag(value);
+  }
+  for (HistoryEvent &event : out) {
+    if (!get_varint(payload, value))
+      return false;
+    event.id = static_cast<int>(id += unzigzag(value));
+  }
+  if (payload.size() != count)
+    return false;
+  for (size_t i = 0; i < count; ++i) {
+    auto bits = static_cast<unsigned>(static_cast<uint8_t>(payload[i]));
+    out[i].kind = static_cast<HistoryKind>(bits & 7);
+    out[i].pr = static_cast<Priority>(bits >> 3 & 3);
+    out[i].open = bits >> 5 & 1;
+  }
+
+  // The trailer's own size check catches a frame spliced from two writes
+  uint32_t frame_bytes = 0;
+  memcpy(&frame_bytes, buf.data() + size + sizeof(uint64_t) + sizeof(uint32_t), sizeof(frame_bytes));
+  bytes = static_cast<uint64_t>(in.tellg() - start);
+  return bytes == frame_bytes;
+}
+
+/**
+ * @brief  The trailer ending a file of `size` bytes, if it looks intact.
+ */
+optional<Trailer> read_trailer(const string &path, uint64_t size) {
+  if (size < kTrailerBytes)
+    return nullopt;
+  ifstream in(path, ios::binary);
+  char raw[kTrailerBytes];
+  in.seekg(static_cast<streamoff>(size - kTrailerBytes));
+  if (!in.read(raw, sizeof(raw)) || memcmp(raw + kTrailerBytes - sizeof(kTrailerMagic), kTrailerMagic, 4) != 0)
+    return nullopt;
+
+  Trailer trailer;
+  memcpy(&trailer.run_start, raw, sizeof(trailer.run_start));
+  memcpy(&trailer.run_frames, raw + 8, sizeof(trailer.run_frames));
+  memcpy(&trailer.frame_bytes, raw + 12, sizeof(trailer.frame_bytes));
+  char magic[sizeof(kHistoryMagic)];
+  if (trailer.frame_bytes > size || trailer.run_start > size - trailer.frame_bytes)
+    return nullopt;
+  in.seekg(static_cast<streamoff>(size - trailer.frame_bytes));
+  if (!in.read(magic, sizeof(magic)) || memcmp(magic, kHistoryMagic, sizeof(magic)) != 0)
+    return nullopt;
+  return trailer;
+}
+
+} // namespace
+
+HistoryEvent history_event(const Task &task, HistoryKind kind, bool open) {
+  auto now = floor<seconds>(system_clock::now()).time_since_epoch().count();
+  return {static_cast<int64_t>(now), task.id, kind, task.pr, open};
+}
+
+/**
+ * @brief  O(1) in the file size except for the merge, which re-reads one run.
+ */
+bool append_history(const string &path, span<const HistoryEvent> events) {
+  if (events.empty())
+    return true;
+
+  error_code ec;
+  uint64_t size = filesystem::file_size(path, ec);
+  if (ec)
+    size = 0;
+
+  // Only an interrupted write leaves a bad tail; find the last whole frame
+  optional<Trailer> last;
+  if (size > 0 && !(last = read_trailer(path, size)).has_value()) {
+    ifstream in(path, ios::binary);
+    string buf;
+    vector<HistoryEvent> frame;
+    uint64_t valid = 0, bytes = 0;
+    while (read_frame(in, buf, frame, bytes))
+      valid += bytes;
+    in.close();
+    filesystem::resize_file(path, valid, ec);
+    size = valid;
+    last = size > 0 ? read_trailer(path, size) : nullopt;
+  }
+  Trailer tail = last.value_or(Trailer{});
+
+  if (tail.run_frames + 1 < kHistoryRun) {
+    Trailer trailer{tail.run_frames == 0 ? size : tail.run_start, tail.run_frames + 1};
+    string frame = encode_frame(events, trailer);
+    ofstream out(path, ios::binary | ios::app);
+    out.write(frame.data(), static_cast<streamsize>(frame.size()));
+    return static_cast<bool>(out.flush());
+  }
+
+  // The run is full: re-encode it and the new events as one frame in its place
+  vector<HistoryEvent> run, frame;
+  {
+    ifstream in(path, ios::binary);
+    in.seekg(static_cast<streamoff>(tail.run_start));
+    string buf;
+    uint64_t bytes = 0;
+    while (read_frame(in, buf, frame, bytes))
+      run.insert(run.end(), frame.begin(), frame.end());
+  }
+  run.insert(run.end(), events.begin(), events.end());
+  string merged = encode_frame(run, {tail.run_start, 0});
+  {
+    fstream out(path, ios::in | ios::out | ios::binary);
+    out.seekp(static_cast<streamoff>(tail.run_start));
+    out.write(merged.data(), static_cast<streamsize>(merged.size()));
+    if (!out.flush())
+      return false;
+  }
+  filesystem::resize_file(path, tail.run_start + merged.size(), ec);
+  return !ec;
+}
+
+size_t scan_history(const string &path, const function<void(const HistoryEvent &)> &visit) {
+  ifstream in(path, ios::binary);
+  string buf;
+  vector<HistoryEvent> frame;
+  uint64_t bytes = 0;
+  size_t seen = 0;
+  while (in && read_frame(in, buf, frame, bytes)) {
+    for (const HistoryEvent &event : frame)
+      visit(event);
+    seen += frame.size();
+  }
+  return seen;
+}
+
+/**
+ * @brief  Per-day counts come from the window's events only; the backlog at
+ *         each day's end is today's pending count minus what came after.
+ */
+HistoryReport build_report(const string &path, sys_days since, sys_days today, size_t pending) {
+  HistoryReport report;
+  size_t span = today >= since ? static_cast<size_t>((today - since).count()) + 1 : 0;
+  report.days.resize(span);
+  for (size_t i = 0; i < span; ++i)
+    report.days[i].day = since + days{static_cast<int>(i)};
+
+  int64_t from = duration_cast<seconds>(since.time_since_epoch()).count();
+  int64_t to = duration_cast<seconds>((today + days{1}).time_since_epoch()).count();
+  unordered_map<int, int64_t> opened; //< Open task → when it joined the backlog.
+
+  scan_history(path, [&](const HistoryEvent &event) {
+    bool adds = event.kind == HistoryKind::Reopened || (event.kind == HistoryKind::Created && event.open);
+    bool closes = !adds && event.kind != HistoryKind::Created && event.open;
+    if (adds)
+      opened[event.id] = event.at;
+    else if (auto it = opened.find(event.id); it != opened.end() && event.kind != HistoryKind::Created) {
+      if (event.kind == HistoryKind::Completed && event.at >= from && event.at < to)
+        report.lead_hours[static_cast<size_t>(event.pr)].push_back(static_cast<double>(event.at - it->second) / 3600);
+      opened.erase(it);
+    }
+
+    // Clock skew can stamp an event past today; it still happened before now
+    if (span == 0 || event.at < from || (!adds && !closes))
+      return;
+    HistoryReport::Day &day = report.days[min<size_t>(static_cast<size_t>((event.at - from) / 86400), span - 1)];
+    ++(adds ? day.added : day.closed);
+  });
+
+  size_t open = pending;
+  for (size_t i = span; i-- > 0;) {
+    report.days[i].open = open;
+    open = open + report.days[i].closed - min(open + report.days[i].closed, report.days[i].added);
+  }
+  return report;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file    task_history.hpp
+ * @brief   Append-only time series of task transitions (tasks.json.history)
+ *          and the `todo report` figures computed from it.
+ *
+ * Each save appends the transitions it made (create, complete, archive,
+ * reopen, remove) as one frame. A frame stores its events column by column:
+ * times as zigzag varint deltas in seconds, ids as zigzag varint deltas, then
+ * one tag byte per event (kind, priority, whether the backlog changed). Times
+ * and ids of neighbouring events are close, so most events take 3-4 bytes.
+ *
+ * Layout of a frame: "THIS", varint event count, varint payload size, the
+ * payload, then a fixed trailer. The trailer points back at the start of the
+ * run of small frames it belongs to; once kHistoryRun frames pile up, the run
+ * is re-encoded in place as one frame. Appends therefore touch only the end
+ * of the file, and a scan decodes big frames almost all the time.
+ *
+ * Layout of a trailer: run start offset (8 bytes), frames in the run (4),
+ * frame size (4), "THND". A run of 0 frames marks a merged frame.
+ */
+
+#pragma once
+#include "task.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Small frames appended before they are merged into one.
+static constexpr uint32_t kHistoryRun = 64;
+
+/**
+ * @enum  HistoryKind
+ * @brief What happened to a task.
+ */
+enum class HistoryKind : uint8_t { Created,
+                                   Completed,
+                                   Archived,
+                                   Reopened,
+                                   Removed };
+
+/**
+ * @struct HistoryEvent
+ * @brief  One transition of one task.
+ */
+struct HistoryEvent {
+  int64_t at{0}; //< Seconds since the Unix epoch.
+  int id{0};
+  HistoryKind kind{HistoryKind::Created};
+  Priority pr{Priority::Medium};
+  bool open{false}; //< Whether the task was pending before (or, for Created/Reopened, after).
+
+  bool operator==(const HistoryEvent &) const = default;
+};
+
+/**
+ * @brief   An event stamped now.
+ * @param   task  The task as it is after the change (for its id and priority).
+ * @param   kind  What happened.
+ * @param   open  See HistoryEvent::open.
+ */
+HistoryEvent history_event(const Task &task, HistoryKind kind, bool open);
+
+/**
+ * @brief   Append events as one frame, merging the current run of small frames
+ *          once it reaches kHistoryRun. A torn frame left at the end by an
+ *          interrupted write is cut off first; a crash while a run is being
+ *          merged loses at most that run.
+ * @param   path    History file path (created if missing).
+ * @param   events  Events in time order; nothing is written if empty.
+ * @return  True on success.
+ */
+bool append_history(const std::string &path, std::span<const HistoryEvent> events);
+
+/**
+ * @brief   Stream every event in file order, decoding one frame at a time.
+ * @param   path   History file path; a missing file has no events.
+ * @param   visit  Called once per event.
+ * @return  Events visited.
+ */
+size_t scan_history(const std::string &path, const std::function<void(const HistoryEvent &)> &visit);
+
+/**
+ * @struct HistoryReport
+ * @brief  Burn-down and lead times over a window of days.
+ */
+struct HistoryReport {
+  /**
+   * One day of the burn-down.
+   */
+  struct Day {
+    std::chrono::sys_days day;
+    size_t added{0};  //< Tasks that joined the backlog.
+    size_t closed{0}; //< Tasks that left it (completed, archived or removed).
+    size_t open{0};   //< Backlog at the end of the day.
+  };
+  std::vector<Day> days;
+
+  /**
+   * Lead times (creation or reopening to completion, in hours) of the tasks
+   * completed in the window, by priority; tasks created before the history
+   * began are not included.
+   */
+  std::array<std::vector<double>, 4> lead_hours;
+};
+
+/**
+ * @brief   Compute the report in one streaming pass. The backlog is anchored
+ *          at today's pending count and walked back, so tasks older than the
+ *          history still count; only creation times of open tasks are held.
+ * @param   path     History file path.
+ * @param   since    First day of the window.
+ * @param   today    Last day of the window.
+ * @param   pending  Tasks pending now.
+ */
+HistoryReport build_report(const std::string &path, std::chrono::sys_days since, std::chrono::sys_days today,
+                           size_t pending);
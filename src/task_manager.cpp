@@ -4,91 +4,257 @@
  */
 
 #include "task_manager.hpp"
+#include "async_io.hpp"
+#include "block_store.hpp"
+#include "list_kernel.hpp"
+#include "store_lock.hpp"
+#include "task_file.hpp"
+#include <charconv>
+#include <climits>
+#include <cstdio>
+#include <deque>
+#include <fcntl.h>
+#include <filesystem>
 #include <format>
 #include <fstream>
-#include <strings.h>
+#include <iterator>
+#include <numeric>
+#include <sstream>
+#include <string_view>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 
 using namespace std;
+using namespace std::chrono;
 
 const string BLANK_DATE = "None";
 int MAX_TASKS = 100;
-int WARN_TASKS = 90;
 
 /**
  * @brief  Validates if add is possible then passes to insertion function.
  */
-int TaskManager::addTask(const string &title, Priority pr, optional<ymd> due) {
+int TaskManager::addTask(const string &title, Priority pr, optional<ymd> due, Recurrence repeat, ListId list) {
   // Empty title → reject immediately
   if (title.empty()) {
     cerr << BLOOD << FAIL << " Task title cannot be empty." << RESET << endl;
     return FXN_FAILURE;
   }
 
-  // Check if it task cap (to avoid flooding)
-  if ((int)size() >= MAX_TASKS) {
-    cerr << BLOOD << FAIL << " Task limit reached (100). Cannot add more tasks." << RESET << endl;
+  // Check if it task cap (to avoid flooding). Claim a slot up front so
+  // concurrent adds cannot overshoot the limit together.
+  size_t limit = task_limit;
+  size_t held = task_count.fetch_add(1);
+  if (held >= limit) {
+    task_count.fetch_sub(1);
+    cerr << BLOOD << FAIL << " Task limit reached (" << limit << "). Cannot add more tasks." << RESET << endl;
     return FXN_FAILURE;
   }
 
   // Warn if approaching task cap
-  if ((int)size() >= WARN_TASKS) {
-    cerr << GOLD << WARN << "  Warning: Approaching task limit (" << (int)size() << "/100)." << RESET << endl;
+  if (held >= limit - limit / 10) {
+    cerr << GOLD << WARN << "  Warning: Approaching task limit (" << held << "/" << limit << ")." << RESET << endl;
   }
 
-  // Duplicate check
-  for (auto &[id, ptr] : task_map) {
-    if (strcasecmp(ptr->title.c_str(), title.c_str()) == 0 && ptr->due == due) {
-      cerr << BLOOD << FAIL << " Duplicate task: same title and due date already exists." << RESET << endl
-           << endl;
-      return FXN_FAILURE;
-    }
+  // Recurring tasks are always scheduled
+  if (repeat.active() && !due.has_value())
+    due = repeat.firstFrom(get_today());
+
+  // Duplicate check: O(1) hash lookup instead of scanning every title
+  string key = dedupKey(title, due, list);
+  if (!reserveTitle(key)) {
+    task_count.fetch_sub(1);
+    cerr << BLOOD << FAIL << " Duplicate task: same title and due date already exists." << RESET << endl
+         << endl;
+    return FXN_FAILURE;
+  }
+
+  int id = next_id.fetch_add(1);
+  Shard &shard = shardFor(id);
+  unique_lock shard_lock(shard.mtx);
+
+  auto task = make_unique<Task>(id, title, pr, due);
+  task->list = list;
+  task->repeat = repeat;
+  task->uid = new_uid();
+  task->clock.fill(tick());
+  Task *raw_task = insertTaskUnchecked(shard, std::move(task));
+  if (raw_task == nullptr) {
+    releaseTitle(key);
+    task_count.fetch_sub(1);
+    return FXN_FAILURE;
   }
 
-  return insertTaskUnchecked(next_id++, title, pr, due);
+  indexDue(shard, *raw_task);
+  title_index.add(id, title);
+  if (fuzzy_ready)
+    fuzzy_index.add(id, title);
+  record(*raw_task, HistoryKind::Created, true);
+
+  // Now push onto the heap
+  pushRanked(raw_task);
+  return id;
 }
 
 /**
- * @brief  Creates a task, inserts into the map, then pushes onto the heap.
+ * @brief  Moves the task into its shard.
  */
-int TaskManager::insertTaskUnchecked(int id, const string &title, Priority pr, optional<ymd> due) {
-  // Check for id collision (shouldn't happen, but just in case)
-  if (task_map.contains(id)) {
-    cerr << BLOOD << FAIL << " Duplicate ID (" << id << ") on insertTaskUnchecked." << RESET << endl;
-    return FXN_FAILURE;
-  }
+Task *TaskManager::insertTaskUnchecked(Shard &shard, unique_ptr<Task> task) {
+  int id = task->id;
 
   // Create a unique pointer → move into map (not copyable) to indicate
   // ownership by map. Grab raw pointer before moving.
-  auto task = make_unique<Task>(id, title, pr, due);
   Task *raw_task = task.get();
-
-  auto [it, ok] = task_map.emplace(id, std::move(task));
+  auto [it, ok] = shard.tasks.emplace(id, std::move(task));
   if (!ok) {
-    cerr << BLOOD << FAIL << " Insertion of task failed (" << id << ")." << RESET << endl;
-    return FXN_FAILURE;
+    cerr << BLOOD << FAIL << " Duplicate ID (" << id << ") on insertTaskUnchecked." << RESET << endl;
+    return nullptr;
   }
+  shard.by_status[static_cast<size_t>(raw_task->state)].insert(id);
+  tally(*raw_task, +1);
+  return raw_task;
+}
 
-  // Now push onto the heap
-  task_heap.push(raw_task);
+/**
+ * @brief  Keeps by_status and the aggregates in step with the task's state.
+ */
+void TaskManager::setState(Shard &shard, Task &task, Status state) {
+  if (state != task.state) {
+    HistoryKind kind = state == Status::Pending     ? HistoryKind::Reopened
+                       : state == Status::Completed ? HistoryKind::Completed
+                                                    : HistoryKind::Archived;
+    record(task, kind, task.state == Status::Pending || state == Status::Pending);
+  }
+  shard.by_status[static_cast<size_t>(task.state)].erase(task.id);
+  shard.by_status[static_cast<size_t>(state)].insert(task.id);
+  lock_guard stats_lock(stats_mtx);
+  counted.tally(task, -1);
+  task.state = state;
+  counted.tally(task, +1);
+}
 
-  // Maintain correct ID (depending on how many tasks we have already)
-  next_id = max(next_id, id + 1);
-  return id;
+void TaskManager::tally(const Task &task, int sign) {
+  lock_guard stats_lock(stats_mtx);
+  counted.tally(task, sign);
+}
+
+void TaskManager::record(const Task &task, HistoryKind kind, bool open) {
+  lock_guard history_lock(history_mtx);
+  transitions.push_back(history_event(task, kind, open));
 }
 
 /**
- * @brief  Marks a task as complete.
+ * @brief  A failed append loses only history, so the save still succeeds.
  */
-bool TaskManager::completeTask(int id) {
-  auto it = task_map.find(id);
+void TaskManager::flushHistory(const string &filename) const {
+  vector<HistoryEvent> batch;
+  {
+    lock_guard history_lock(history_mtx);
+    batch.swap(transitions);
+  }
+  append_history(history_path(filename), batch);
+}
 
-  if (it == task_map.end()) {
-    cerr << BLOOD << FAIL << " Could not find the task to complete." << RESET << endl;
-    return false;
+/**
+ * @brief  Sorted insert; new tasks are rare enough that the shift is cheap.
+ */
+void TaskManager::indexDue(Shard &shard, const Task &task) {
+  if (!task.due.has_value())
+    return;
+  pair entry{sys_days{task.due.value()}.time_since_epoch().count(), task.id};
+  shard.by_due.insert(lower_bound(shard.by_due.begin(), shard.by_due.end(), entry), entry);
+}
+
+void TaskManager::unindexDue(Shard &shard, const Task &task) {
+  if (!task.due.has_value())
+    return;
+  pair entry{sys_days{task.due.value()}.time_since_epoch().count(), task.id};
+  auto pos = lower_bound(shard.by_due.begin(), shard.by_due.end(), entry);
+  if (pos != shard.by_due.end() && *pos == entry)
+    shard.by_due.erase(pos);
+}
+
+/**
+ * @brief  Lower-cases the title and appends the due date (or "none") and,
+ *         outside the default list, the list id.
+ */
+string TaskManager::dedupKey(const string &title, const optional<ymd> &due, ListId list) {
+  string key = title;
+  transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return char(tolower(c)); });
+  key += '\0';
+  key += due.has_value() ? to_string(due.value()) : BLANK_DATE;
+  if (list != kDefaultList) {
+    key += '\0';
+    key += std::to_string(list);
+  }
+  return key;
+}
+
+bool TaskManager::reserveTitle(const string &key) {
+  DedupShard &part = dedup[hash<string>{}(key) % kShardCount];
+  lock_guard lock(part.mtx);
+  return part.keys.insert(key).second;
+}
+
+void TaskManager::releaseTitle(const string &key) {
+  DedupShard &part = dedup[hash<string>{}(key) % kShardCount];
+  lock_guard lock(part.mtx);
+  part.keys.erase(key);
+}
+
+/**
+ * @brief  Marks a task as complete; a recurring one spawns its successor
+ *         after the shard lock is dropped (addTask takes its own locks).
+ */
+bool TaskManager::completeTask(int id, int *next) {
+  if (next)
+    *next = FXN_FAILURE;
+
+  Task done;
+  {
+    Shard &shard = shardFor(id);
+    unique_lock lock(shard.mtx);
+    auto it = shard.tasks.find(id);
+
+    if (it == shard.tasks.end()) {
+      cerr << BLOOD << FAIL << " Could not find the task to complete." << RESET << endl;
+      return false;
+    }
+
+    // A task finished while still blocked joins the ranking now
+    bool was_blocked = it->second->blocked();
+    if (it->second->state != Status::Completed) {
+      lock_guard stats_lock(stats_mtx);
+      counted.completed(sys_days{get_today()}, +1);
+    }
+    setState(shard, *it->second, Status::Completed);
+    it->second->stamp(Field::State, tick());
+    if (was_blocked)
+      pushRanked(it->second.get());
+
+    done = *it->second;
+    if (done.repeat.active()) {
+      it->second->repeat = {};
+      it->second->stamp(Field::Repeat, tick());
+    }
   }
 
-  Task *raw = it->second.get();
-  raw->state = Status::Completed;
+  if (edge_count > 0)
+    resolveDependents(id);
+  if (!done.repeat.active())
+    return true;
+
+  ymd due = done.due.value_or(get_today());
+  int spawned = addTask(done.title, done.pr, done.repeat.nextOccurrence(due, get_today()), done.repeat, done.list);
+  if (spawned == FXN_FAILURE) {
+    // Keep the rule somewhere rather than silently ending the series
+    Shard &shard = shardFor(id);
+    unique_lock lock(shard.mtx);
+    if (auto it = shard.tasks.find(id); it != shard.tasks.end())
+      it->second->repeat = done.repeat;
+  }
+  if (next)
+    *next = spawned;
   return true;
 }
 
@@ -96,217 +262,2272 @@ bool TaskManager::completeTask(int id) {
  * @brief  Marks a task as archived.
  */
 bool TaskManager::archiveTask(int id) {
-  auto it = task_map.find(id);
+  Shard &shard = shardFor(id);
+  unique_lock lock(shard.mtx);
+  auto it = shard.tasks.find(id);
 
-  if (it == task_map.end()) {
+  if (it == shard.tasks.end()) {
     cerr << BLOOD << FAIL << " Could not find the task to archive." << RESET << endl;
     return false;
   }
 
-  Task *raw = it->second.get();
-  raw->state = Status::Archived;
+  bool was_blocked = it->second->blocked();
+  setState(shard, *it->second, Status::Archived);
+  it->second->stamp(Field::State, tick());
+  if (was_blocked)
+    pushRanked(it->second.get());
+  lock.unlock();
+
+  // Archiving gives up on a task, so nothing should keep waiting for it
+  if (edge_count > 0)
+    resolveDependents(id);
   return true;
 }
 
 /**
- * @brief  Removes task from map. Heap will pop off stale later.
+ * @brief  Drops the task's heap entry, then erases it from its shard.
  */
 bool TaskManager::removeTask(int id) {
-  auto it = task_map.find(id);
+  Shard &shard = shardFor(id);
+  unique_lock lock(shard.mtx);
+  auto it = shard.tasks.find(id);
 
-  if (it == task_map.end()) {
+  if (it == shard.tasks.end()) {
     cerr << BLOOD << FAIL << " Could not find the task to remove." << RESET << endl;
     return false;
   }
 
-  task_map.erase(it);
+  dropRanked(it->second.get());
+
+  // Stop waiting on its own prerequisites
+  if (!it->second->after.empty()) {
+    lock_guard dep_lock(dep_mtx);
+    for (int prereq : it->second->after) {
+      auto &waiting = dependents[prereq];
+      waiting.erase(remove(waiting.begin(), waiting.end(), id), waiting.end());
+      if (waiting.empty())
+        dependents.erase(prereq);
+    }
+    edge_count.fetch_sub(it->second->after.size());
+  }
+
+  shard.by_status[static_cast<size_t>(it->second->state)].erase(id);
+  tally(*it->second, -1);
+  record(*it->second, HistoryKind::Removed, it->second->state == Status::Pending);
+  unindexDue(shard, *it->second);
+  title_index.remove(id, it->second->title);
+  if (fuzzy_ready)
+    fuzzy_index.remove(id, it->second->title);
+  releaseTitle(dedupKey(it->second->title, it->second->due, it->second->list));
+  {
+    // Remembered so a merge does not bring it back from another store
+    lock_guard removed_lock(removed_mtx);
+    removed[it->second->uid] = tick();
+  }
+  shard.tasks.erase(it);
+  task_count.fetch_sub(1);
+  lock.unlock();
+
+  // Anything waiting on it is released
+  if (edge_count > 0)
+    resolveDependents(id);
   return true;
 }
 
+namespace {
+
+/**
+ * @brief  Store a task at a heap slot and tell it where it is.
+ */
+void place(vector<Task *> &heap, size_t slot, Task *task) {
+  heap[slot] = task;
+  task->heap_slot = slot;
+}
+
 /**
- * @brief  String representing date or status if no date provided.
+ * @brief  std::push_heap's layout and order (children of i at 2i+1 and 2i+2,
+ *         larger sort_key on top), but every task moved learns its new slot.
  */
-string TaskManager::formatDue(const Task *task, const ymd &today) const {
-  // If no due date provided
-  if (!task->due.has_value())
-    return BLANK_DATE + string("\t\t\t");
+void sift_up(vector<Task *> &heap, size_t slot) {
+  Task *task = heap[slot];
+  while (slot > 0) {
+    size_t parent = (slot - 1) / 2;
+    if (heap[parent]->sort_key >= task->sort_key)
+      break;
+    place(heap, slot, heap[parent]);
+    slot = parent;
+  }
+  place(heap, slot, task);
+}
 
-  // ISO date + color + overdue info
-  string out = to_string(task->due.value()) + ' ';
-  bool over = is_overdue(*task, today);
-  out += over ? RED : GREEN;
-  out += '(';
-  out += over ? "" : "+";
-  out += to_string(task->days_until_due()) + "d)\t";
+void sift_down(vector<Task *> &heap, size_t slot) {
+  Task *task = heap[slot];
+  size_t n = heap.size();
+  while (2 * slot + 1 < n) {
+    size_t child = 2 * slot + 1;
+    if (child + 1 < n && heap[child]->sort_key < heap[child + 1]->sort_key)
+      ++child;
+    if (heap[child]->sort_key <= task->sort_key)
+      break;
+    place(heap, slot, heap[child]);
+    slot = child;
+  }
+  place(heap, slot, task);
+}
 
-  return out;
+/**
+ * @brief  Restore the heap after the task at slot changed key (or moved in).
+ */
+void resift(vector<Task *> &heap, size_t slot) {
+  if (slot > 0 && heap[(slot - 1) / 2]->sort_key < heap[slot]->sort_key)
+    sift_up(heap, slot);
+  else
+    sift_down(heap, slot);
 }
 
+} // namespace
+
 /**
- * @brief  Outputs a table of all tasks.
+ * @brief  Aging is measured against ref_day, which rank_mtx guards.
  */
-void TaskManager::printTasks(Status filter) {
-  // 1) Header
-  cout << BOLD << "\nID   STATUS\tPRIORITY   DUE\t\t\tTITLE" << RESET << endl;
-  cout << "-----------------------------------------------------------------------------------" << endl;
+void TaskManager::pushRanked(Task *task) {
+  unique_lock rank_lock(rank_mtx);
+  pushRankedUnlocked(task);
+}
 
-  // 2) Gather matching tasks in heap order
-  vector<Task *> list;
-  auto heap_copy = task_heap;
+void TaskManager::pushRankedUnlocked(Task *task) {
+  task->sort_key = make_sort_key(*task, ref_day, kRecentThreshold);
+  vector<Task *> &heap = heaps[task->list];
+  heap.push_back(task);
+  sift_up(heap, heap.size() - 1);
+}
 
-  while (!heap_copy.empty()) {
-    Task *t = heap_copy.top();
-    heap_copy.pop();
+/**
+ * @brief  The task knows its slot, so the last entry fills the hole and is
+ *         sifted in O(log n) without searching the heap.
+ */
+void TaskManager::dropRanked(Task *task) {
+  unique_lock rank_lock(rank_mtx);
+  dropRankedUnlocked(task);
+}
 
-    switch (filter) {
-    case Status::All:
-      break;
-    case Status::Pending:
-      if (t->state != Status::Pending)
-        continue;
-      break;
-    case Status::Completed:
-      if (t->state != Status::Completed)
-        continue;
-      break;
-    case Status::Archived:
-      if (t->state != Status::Archived)
-        continue;
-      break;
-    }
-    list.push_back(t);
+void TaskManager::dropRankedUnlocked(Task *task) {
+  auto it = heaps.find(task->list);
+  if (it == heaps.end())
+    return;
+  vector<Task *> &heap = it->second;
+  size_t slot = task->heap_slot;
+  if (slot >= heap.size() || heap[slot] != task)
+    return;
+
+  Task *last = heap.back();
+  heap.pop_back();
+  task->heap_slot = SIZE_MAX;
+  if (slot < heap.size()) {
+    place(heap, slot, last);
+    resift(heap, slot);
+  }
+}
+
+/**
+ * @brief  Same slot bookkeeping as dropRanked; blocked tasks only get the key.
+ */
+void TaskManager::rerank(Task *task) {
+  unique_lock rank_lock(rank_mtx);
+  task->sort_key = make_sort_key(*task, ref_day, kRecentThreshold);
+  auto it = heaps.find(task->list);
+  if (it == heaps.end())
+    return;
+  vector<Task *> &heap = it->second;
+  if (task->heap_slot < heap.size() && heap[task->heap_slot] == task)
+    resift(heap, task->heap_slot);
+}
+
+/**
+ * @brief  Validates both ends and rejects cycles, then blocks the waiting task.
+ */
+bool TaskManager::addDependency(int id, int prereq) {
+  auto locks = lockShards<unique_lock<RwLock>>();
+
+  auto find_task = [&](int key) -> Task * {
+    auto &tasks = shardFor(key).tasks;
+    auto it = tasks.find(key);
+    return it == tasks.end() ? nullptr : it->second.get();
+  };
+  Task *task = find_task(id), *before = find_task(prereq);
+
+  if (task == nullptr || before == nullptr) {
+    cerr << BLOOD << FAIL << " Could not find task #" << (task ? prereq : id) << "." << RESET << endl;
+    return false;
+  }
+  if (before->state != Status::Pending) {
+    cerr << BLOOD << FAIL << " Task #" << prereq << " is already done." << RESET << endl;
+    return false;
+  }
+  if (find(task->after.begin(), task->after.end(), prereq) != task->after.end())
+    return true;
+  if (id == prereq || dependsOn(prereq, id)) {
+    cerr << BLOOD << FAIL << " Task #" << prereq << " already waits on #" << id
+         << "; the dependency would form a cycle." << RESET << endl;
+    return false;
   }
 
-  // 3) Body
-  if (list.empty())
-    cout << "No tasks." << endl;
-  else {
-    for (auto *task : list) {
-      cout
-          << "[" << task->id << "]  "
-          << print_status(task->state) << "\t"
-          << print_priority(task->pr) << "   "
-          << formatDue(task, get_today()) << RESET
-          << truncate(task->title) << endl;
+  bool was_blocked = task->blocked();
+  task->after.push_back(prereq);
+  {
+    lock_guard dep_lock(dep_mtx);
+    dependents[prereq].push_back(id);
+  }
+  edge_count.fetch_add(1);
+
+  if (!was_blocked && task->blocked())
+    dropRanked(task);
+  return true;
+}
+
+/**
+ * @brief  Depth-first walk over unfinished prerequisites only; finished ones
+ *         were erased from `after`, so the graph stays small.
+ */
+bool TaskManager::dependsOn(int prereq, int id) const {
+  vector<int> stack{prereq};
+  unordered_set<int> seen{prereq};
+  while (!stack.empty()) {
+    int cur = stack.back();
+    stack.pop_back();
+
+    const auto &tasks = shardFor(cur).tasks;
+    auto it = tasks.find(cur);
+    if (it == tasks.end())
+      continue;
+    for (int next : it->second->after) {
+      if (next == id)
+        return true;
+      if (seen.insert(next).second)
+        stack.push_back(next);
     }
   }
+  return false;
+}
 
-  // 4) Footer
-  const char *label = nullptr;
-  switch (filter) {
-  case Status::All:
-    label = "total";
-    break;
-  case Status::Pending:
-    label = "pending";
-    break;
-  case Status::Completed:
-    label = "completed";
-    break;
-  case Status::Archived:
-    label = "archived";
-    break;
+/**
+ * @brief  In-degree update: each dependent drops one prerequisite and joins
+ *         the heap once it has none left. No topological sort is recomputed.
+ */
+void TaskManager::resolveDependents(int id) {
+  auto locks = lockShards<unique_lock<RwLock>>();
+
+  vector<int> waiting;
+  {
+    lock_guard dep_lock(dep_mtx);
+    auto it = dependents.find(id);
+    if (it == dependents.end())
+      return;
+    waiting = std::move(it->second);
+    dependents.erase(it);
+  }
+  edge_count.fetch_sub(waiting.size());
+
+  for (int dependent : waiting) {
+    auto &tasks = shardFor(dependent).tasks;
+    auto it = tasks.find(dependent);
+    if (it == tasks.end())
+      continue;
+
+    Task *task = it->second.get();
+    bool was_blocked = task->blocked();
+    task->after.erase(remove(task->after.begin(), task->after.end(), id), task->after.end());
+    if (was_blocked && !task->blocked())
+      pushRanked(task);
   }
-  cout << "-----------------------------------------------------------------------------------\n";
-  cout << BOLD << list.size() << " tasks " << label << ".\n\n";
 }
 
 /**
- * @brief  If valid file, reads in contents as fields to construct Task.
+ * @brief  Scans the shards, since blocked tasks are not in the heap.
  */
-bool TaskManager::loadFromFile(const string &filename) {
-  ifstream in(filename);
+vector<Task> TaskManager::blockedTasks() const {
+  vector<Task> list;
+  auto locks = lockShards<shared_lock<RwLock>>();
+  for (const auto &shard : shards)
+    for (int id : shard.by_status[static_cast<size_t>(Status::Pending)])
+      if (const Task &task = *shard.tasks.at(id); task.blocked())
+        list.push_back(task);
 
-  // Did not find file. Not an error because this might be the first time we've run
-  // the program so nothing saved yet.
-  if (!in)
+  sort(list.begin(), list.end(), [](const Task &a, const Task &b) { return a.sort_key > b.sort_key; });
+  return list;
+}
+
+vector<int> TaskManager::dependentsOf(int id) const {
+  lock_guard dep_lock(dep_mtx);
+  auto it = dependents.find(id);
+  return it == dependents.end() ? vector<int>{} : it->second;
+}
+
+/**
+ * @brief  Same indexing as addTask, but keeps the snapshot's id and state.
+ */
+bool TaskManager::restoreTask(const Task &task) {
+  string key = dedupKey(task.title, task.due, task.list);
+  if (!reserveTitle(key)) {
+    cerr << BLOOD << FAIL << " Cannot restore task #" << task.id
+         << ": same title and due date already exists." << RESET << endl;
     return false;
+  }
 
-  string line;
-  int id = -1, pr = 0, status = 0;
-  string title;
-  optional<ymd> due_opt;
-  bool has_id = false, has_title = false, has_pr = false, has_status = false;
-
-  // Did find file. Read in each individual line and extract fields.
-  while (getline(in, line)) {
-    stringstream ss(line);
-
-    if (line.find("\"id\":") != string::npos) {
-      ss.ignore(256, ':');
-      ss >> id;
-      has_id = true;
-    } else if (line.find("\"title\":") != string::npos) {
-      size_t start = line.find("\"", line.find(':')) + 1;
-      size_t end = line.rfind("\"");
-      title = line.substr(start, end - start);
-      has_title = true;
-    } else if (line.find("\"priority\":") != string::npos) {
-      ss.ignore(256, ':');
-      ss >> pr;
-      has_pr = true;
-    } else if (line.find("\"due\":") != string::npos) {
-      if (line.find("null") != string::npos) {
-        due_opt = nullopt;
-      } else {
-        size_t start = line.find("\"", line.find(':')) + 1;
-        size_t end = line.rfind("\"");
-        string due_str = line.substr(start, end - start);
-        due_opt = to_ymd(due_str);
-      }
-    } else if (line.find("\"status\":") != string::npos) {
-      ss.ignore(256, ':');
-      ss >> status;
-      has_status = true;
-    } else if (line.find("}") != string::npos) {
-      // Check if we have all the required fields
-      if (has_id && has_title && has_pr && has_status) {
-        int result = insertTaskUnchecked(id, title, static_cast<Priority>(pr), due_opt);
-        if (result == -1)
-          cerr << BLOOD << FAIL << " Insertion of task failed." << RESET << endl;
-        else
-          task_map[id]->state = static_cast<Status>(status);
-      }
-      // Reset for next task
-      has_id = has_title = has_pr = has_status = false;
-      id = pr = status = -1;
-      due_opt = nullopt;
-      title.clear();
+  {
+    Shard &shard = shardFor(task.id);
+    unique_lock lock(shard.mtx);
+    // Stamped as a fresh change so it outlives its own tombstone elsewhere
+    auto copy = make_unique<Task>(task);
+    copy->after.clear();
+    copy->uid = task.uid != 0 ? task.uid : new_uid();
+    copy->clock.fill(tick());
+    Task *raw_task = insertTaskUnchecked(shard, std::move(copy));
+    if (raw_task == nullptr) {
+      releaseTitle(key);
+      return false;
     }
+
+    indexDue(shard, *raw_task);
+    title_index.add(task.id, task.title);
+    if (fuzzy_ready)
+      fuzzy_index.add(task.id, task.title);
+    record(*raw_task, HistoryKind::Created, raw_task->state == Status::Pending);
+    pushRanked(raw_task);
+    task_count.fetch_add(1);
+
+    lock_guard removed_lock(removed_mtx);
+    removed.erase(raw_task->uid);
   }
 
+  // Never hand the restored id out again
+  raiseNextId(task.id + 1);
+
+  if (task.state == Status::Pending)
+    for (int prereq : task.after)
+      if (optional<Task> before = getTask(prereq); before && before->state == Status::Pending)
+        addDependency(task.id, prereq);
   return true;
 }
 
 /**
- * @brief  Writes each field of Task as a line in a JSON file.
+ * @brief  Moves the task in or out of the ranking if it (un)blocks.
  */
-bool TaskManager::saveToFile(const string &filename) const {
-  ofstream out(filename);
+bool TaskManager::revertTask(const Task &before) {
+  Shard &shard = shardFor(before.id);
+  unique_lock lock(shard.mtx);
+  auto it = shard.tasks.find(before.id);
 
-  if (!out) {
-    cerr << BLOOD << FAIL << " Error opening file " << filename << ") for writing." << endl;
+  if (it == shard.tasks.end()) {
+    cerr << BLOOD << FAIL << " Could not find task #" << before.id << " to restore." << RESET << endl;
     return false;
   }
 
-  out << "{\n\t\"tasks\": [\n";
+  Task *task = it->second.get();
+  bool was_blocked = task->blocked();
+  if (task->state == Status::Completed && before.state != Status::Completed) {
+    // Undone the day it was done, as a rule, so it comes off today's count
+    lock_guard stats_lock(stats_mtx);
+    counted.completed(sys_days{get_today()}, -1);
+  }
+  setState(shard, *task, before.state);
+  task->repeat = before.repeat;
+  task->stamp(Field::State, tick());
+  task->stamp(Field::Repeat, tick());
+  if (was_blocked && !task->blocked())
+    pushRanked(task);
+  else if (!was_blocked && task->blocked())
+    dropRanked(task);
+  return true;
+}
 
-  int count = 0;
-  for (const auto &[id, task_ptr] : task_map) {
-    const Task &t = *task_ptr;
-    out << "\t\t{\n"; // open braces
-    out << "\t\t\t\"id\": " << t.id << ",\n";
-    out << "\t\t\t\"title\": \"" << t.title << "\",\n";
-    out << "\t\t\t\"priority\": " << static_cast<int>(t.pr) << ",\n";
-    if (t.due.has_value())
-      out << "\t\t\t\"due\": \"" << to_string(t.due.value()) << "\",\n";
-    else
-      out << "\t\t\t\"due\": null,\n";
-    out << "\t\t\t\"status\": " << static_cast<int>(t.state) << endl;
-    out << "\t\t}" << (++count < task_map.size() ? "," : "") << endl;
+/**
+ * @brief  Swaps the dedup key first so a clash leaves the task untouched;
+ *         only fields that actually change are stamped.
+ */
+bool TaskManager::updateTask(int id, const TaskEdit &edit) {
+  if (edit.title.has_value() && edit.title->empty()) {
+    cerr << BLOOD << FAIL << " Task title cannot be empty." << RESET << endl;
+    return false;
+  }
+
+  Shard &shard = shardFor(id);
+  unique_lock lock(shard.mtx);
+  auto it = shard.tasks.find(id);
+
+  if (it == shard.tasks.end()) {
+    cerr << BLOOD << FAIL << " Could not find the task to edit." << RESET << endl;
+    return false;
+  }
+
+  Task &task = *it->second;
+  string title = edit.title.value_or(task.title);
+  Priority pr = edit.pr.value_or(task.pr);
+  optional<ymd> due = edit.due.value_or(task.due);
+  if (task.repeat.active() && !due.has_value()) {
+    cerr << BLOOD << FAIL << " A recurring task needs a due date." << RESET << endl;
+    return false;
+  }
+
+  string old_key = dedupKey(task.title, task.due, task.list);
+  string new_key = dedupKey(title, due, task.list);
+  if (new_key != old_key) {
+    if (!reserveTitle(new_key)) {
+      cerr << BLOOD << FAIL << " Duplicate task: same title and due date already exists." << RESET << endl;
+      return false;
+    }
+    releaseTitle(old_key);
   }
 
-  out << "\t]\n}";
+  uint32_t at = tick();
+  if (title != task.title) {
+    title_index.remove(id, task.title);
+    title_index.add(id, title);
+    if (fuzzy_ready) {
+      fuzzy_index.remove(id, task.title);
+      fuzzy_index.add(id, title);
+    }
+    task.title = std::move(title);
+    task.stamp(Field::Title, at);
+  }
 
+  bool moved = due != task.due || pr != task.pr;
+  if (moved)
+    tally(task, -1);
+  if (due != task.due) {
+    unindexDue(shard, task);
+    task.due = due;
+    indexDue(shard, task);
+    task.stamp(Field::Due, at);
+  }
+  if (pr != task.pr) {
+    task.pr = pr;
+    task.stamp(Field::Pr, at);
+  }
+  if (moved) {
+    tally(task, +1);
+    rerank(&task);
+  }
   return true;
-}
\ No newline at end of file
+}
+
+namespace {
+
+/**
+ * @brief  Fields where theirs should replace ours: the later change wins and
+ *         equal times go to the larger value, so A←B and B←A agree.
+ * @return Bit per Field whose value differs and comes from theirs.
+ */
+unsigned newer_fields(const Task &theirs, const Task &ours) {
+  unsigned taken = 0;
+  // Values are only compared on a tie, and list names only when lists differ
+  auto take = [&](Field field, bool differs, auto theirs_larger) {
+    size_t f = static_cast<size_t>(field);
+    if (differs && (theirs.clock[f] > ours.clock[f] || (theirs.clock[f] == ours.clock[f] && theirs_larger())))
+      taken |= 1u << f;
+  };
+  take(Field::Title, theirs.title != ours.title, [&] { return theirs.title > ours.title; });
+  take(Field::Pr, theirs.pr != ours.pr, [&] { return theirs.pr > ours.pr; });
+  take(Field::Due, theirs.due != ours.due, [&] { return theirs.due > ours.due; });
+  take(Field::List, theirs.list != ours.list, [&] { return list_name(theirs.list) > list_name(ours.list); });
+  take(Field::Repeat, theirs.repeat != ours.repeat,
+       [&] { return pair{theirs.repeat.kind, theirs.repeat.n} > pair{ours.repeat.kind, ours.repeat.n}; });
+  take(Field::State, theirs.state != ours.state, [&] { return theirs.state > ours.state; });
+  return taken;
+}
+
+constexpr unsigned bit(Field field) {
+  return 1u << static_cast<size_t>(field);
+}
+
+} // namespace
+
+/**
+ * @brief  A hash join on uid: each task on either side is visited once, then
+ *         the due index, edges and heaps are rebuilt in bulk.
+ */
+TaskManager::MergeStats TaskManager::mergeFrom(vector<unique_ptr<Task>> theirs, const Tombstones &their_removed,
+                                               uint64_t their_generation) {
+  MergeStats stats;
+  auto locks = lockShards<unique_lock<RwLock>>();
+  unique_lock rank_lock(rank_mtx);
+
+  unordered_map<uint64_t, Task *> mine;
+  mine.reserve(task_count + theirs.size());
+  for (auto &shard : shards)
+    for (auto &[id, ptr] : shard.tasks)
+      mine.emplace(ptr->uid, ptr.get());
+
+  // Their prerequisites, by uid, to link once every task is in place
+  vector<pair<uint64_t, uint64_t>> edges;
+  if (any_of(theirs.begin(), theirs.end(), [](const auto &task) { return !task->after.empty(); })) {
+    unordered_map<int, uint64_t> their_uids;
+    their_uids.reserve(theirs.size());
+    for (const auto &task : theirs)
+      their_uids.emplace(task->id, task->uid);
+    for (const auto &task : theirs)
+      for (int prereq : task->after)
+        if (auto it = their_uids.find(prereq); it != their_uids.end())
+          edges.emplace_back(task->uid, it->second);
+  }
+
+  // Later local changes must outrank everything merged in
+  uint64_t seen = their_generation;
+  vector<int> added;
+  {
+    lock_guard removed_lock(removed_mtx);
+    for (const auto &[uid, at] : their_removed) {
+      uint32_t &ours = removed[uid];
+      ours = max(ours, at);
+      seen = max<uint64_t>(seen, at);
+    }
+
+    auto buried = [&](const Task &task) {
+      auto it = removed.find(task.uid);
+      return it != removed.end() && it->second >= task.lastChange();
+    };
+    auto drop = [&](Task *task, bool owns_key) {
+      record(*task, HistoryKind::Removed, task->state == Status::Pending);
+      mine.erase(task->uid);
+      eraseUnlocked(task, owns_key);
+      ++stats.removed;
+    };
+
+    // The same task added on both sides under two uids: the lower uid keeps
+    // the dedup key and the other is tombstoned, whichever side merges.
+    auto claim = [&](Task &task) {
+      string key = dedupKey(task.title, task.due, task.list);
+      if (reserveTitle(key))
+        return true;
+      Task *owner = ownerOf(key, task.title, &task);
+      if (owner == nullptr)
+        return true;
+      Task &loser = owner->uid < task.uid ? task : *owner;
+      uint32_t &at = removed[loser.uid];
+      at = max(at, loser.lastChange());
+      if (&loser == &task)
+        return false;
+      drop(owner, true);
+      reserveTitle(key);
+      return true;
+    };
+
+    for (auto &task : theirs) {
+      seen = max<uint64_t>(seen, task->lastChange());
+      if (buried(*task))
+        continue;
+
+      // Only on their side: keep its uid and clocks under a new local id
+      auto it = mine.find(task->uid);
+      if (it == mine.end()) {
+        if (!claim(*task))
+          continue;
+        task->id = next_id.fetch_add(1);
+        task->after.clear();
+        Shard &shard = shardFor(task->id);
+        Task *raw_task = insertTaskUnchecked(shard, std::move(task));
+        record(*raw_task, HistoryKind::Created, raw_task->state == Status::Pending);
+        mine.emplace(raw_task->uid, raw_task);
+        added.push_back(raw_task->id);
+        task_count.fetch_add(1);
+        ++stats.added;
+        continue;
+      }
+
+      // On both sides: field by field
+      Task &ours = *it->second;
+      unsigned taken = newer_fields(*task, ours);
+      for (size_t f = 0; f < kFieldCount; ++f)
+        ours.clock[f] = max(ours.clock[f], task->clock[f]);
+      if (taken == 0)
+        continue;
+      ++stats.updated;
+
+      bool rekey = taken & (bit(Field::Title) | bit(Field::Due) | bit(Field::List));
+      if (rekey)
+        releaseTitle(dedupKey(ours.title, ours.due, ours.list));
+      if (taken & bit(Field::Title)) {
+        title_index.remove(ours.id, ours.title);
+        if (fuzzy_ready)
+          fuzzy_index.remove(ours.id, ours.title);
+        ours.title = task->title;
+        title_index.add(ours.id, ours.title);
+        if (fuzzy_ready)
+          fuzzy_index.add(ours.id, ours.title);
+      }
+      bool recount = taken & (bit(Field::Pr) | bit(Field::Due));
+      if (recount)
+        tally(ours, -1);
+      if (taken & bit(Field::Pr))
+        ours.pr = task->pr;
+      if (taken & bit(Field::Due))
+        ours.due = task->due;
+      if (recount)
+        tally(ours, +1);
+      if (taken & bit(Field::List))
+        ours.list = task->list;
+      if (taken & bit(Field::Repeat))
+        ours.repeat = task->repeat;
+      if (taken & bit(Field::State))
+        setState(shardFor(ours.id), ours, task->state);
+      if (rekey && !claim(ours))
+        drop(&ours, false);
+    }
+
+    // Tasks they removed after our last change to them
+    for (const auto &[uid, at] : their_removed)
+      if (auto it = mine.find(uid); it != mine.end() && buried(*it->second))
+        drop(it->second, true);
+  }
+
+  // Index what was added, unless a later duplicate or tombstone took it again
+  vector<pair<int, string_view>> titles;
+  titles.reserve(added.size());
+  for (int id : added)
+    if (auto it = shardFor(id).tasks.find(id); it != shardFor(id).tasks.end())
+      titles.emplace_back(id, it->second->title);
+  title_index.addAll(titles);
+  if (fuzzy_ready)
+    fuzzy_index.addAll(titles);
+
+  for (auto &shard : shards) {
+    shard.by_due.clear();
+    for (auto &[id, ptr] : shard.tasks)
+      if (ptr->due.has_value())
+        shard.by_due.emplace_back(sys_days{ptr->due.value()}.time_since_epoch().count(), id);
+    sort(shard.by_due.begin(), shard.by_due.end());
+  }
+
+  // Union of both sides' prerequisites, skipping any that would close a cycle
+  for (auto &[uid, prereq_uid] : edges) {
+    auto task = mine.find(uid), prereq = mine.find(prereq_uid);
+    if (task == mine.end() || prereq == mine.end())
+      continue;
+    vector<int> &after = task->second->after;
+    int id = task->second->id, before = prereq->second->id;
+    if (id != before && find(after.begin(), after.end(), before) == after.end() && !dependsOn(before, id))
+      after.push_back(before);
+  }
+
+  // Rebuild the reverse edges, dropping prerequisites that are done or gone
+  {
+    lock_guard dep_lock(dep_mtx);
+    dependents.clear();
+    size_t edge_total = 0;
+    for (auto &shard : shards)
+      for (auto &[id, ptr] : shard.tasks) {
+        auto done = [&](int prereq) {
+          auto &tasks = shardFor(prereq).tasks;
+          auto it = tasks.find(prereq);
+          return it == tasks.end() || it->second->state != Status::Pending;
+        };
+        erase_if(ptr->after, done);
+        for (int prereq : ptr->after)
+          dependents[prereq].push_back(id);
+        edge_total += ptr->after.size();
+      }
+    edge_count = edge_total;
+  }
+
+  if (lamport < seen)
+    lamport = seen;
+  rekeyAll(ref_day);
+  return stats;
+}
+
+/**
+ * @brief  Their cold tasks join their hot ones unless a hot copy supersedes them.
+ */
+optional<TaskManager::MergeStats> TaskManager::mergeFile(const string &filename) {
+  StoreHeader their_header;
+  Tombstones their_removed;
+  auto theirs = readStore(filename, 0, their_header, their_removed);
+  if (!theirs.has_value())
+    return nullopt;
+
+  ArchiveContents their_cold;
+  {
+    StoreLock lock(filename, StoreLock::Mode::Shared);
+    their_cold = read_archive(archive_path(filename));
+  }
+  if (!their_cold.tasks.empty()) {
+    unordered_set<uint64_t> hot;
+    hot.reserve(theirs->size());
+    for (const auto &task : *theirs)
+      hot.insert(task->uid);
+    for (auto &task : their_cold.tasks)
+      if (!hot.contains(task->uid))
+        theirs->push_back(std::move(task));
+  }
+  return mergeFrom(std::move(*theirs), their_removed, their_header.generation);
+}
+
+/**
+ * @brief  Heaps, the due index and edges are left for the caller to rebuild.
+ */
+void TaskManager::eraseUnlocked(Task *task, bool owns_key) {
+  Shard &shard = shardFor(task->id);
+  shard.by_status[static_cast<size_t>(task->state)].erase(task->id);
+  tally(*task, -1);
+  title_index.remove(task->id, task->title);
+  if (fuzzy_ready)
+    fuzzy_index.remove(task->id, task->title);
+  if (owns_key)
+    releaseTitle(dedupKey(task->title, task->due, task->list));
+  task_count.fetch_sub(1);
+  shard.tasks.erase(task->id);
+}
+
+/**
+ * @brief  Candidates come from the title index; tasks not indexed yet (added
+ *         earlier in the same merge) are found by a scan, which only runs on
+ *         the rare clash.
+ */
+Task *TaskManager::ownerOf(const string &key, const string &title, const Task *except) const {
+  auto holds = [&](const Task *task) {
+    return task != except && dedupKey(task->title, task->due, task->list) == key;
+  };
+  for (int id : title_index.search(title))
+    if (auto it = shardFor(id).tasks.find(id); it != shardFor(id).tasks.end() && holds(it->second.get()))
+      return it->second.get();
+  for (const auto &shard : shards)
+    for (const auto &[id, ptr] : shard.tasks)
+      if (holds(ptr.get()))
+        return ptr.get();
+  return nullptr;
+}
+
+/**
+ * @brief  Public entry point for a bulk re-rank.
+ */
+void TaskManager::setReferenceDay(const ymd &today) {
+  auto locks = lockShards<unique_lock<RwLock>>();
+  unique_lock rank_lock(rank_mtx);
+  rekeyAll(sys_days{today});
+}
+
+/**
+ * @brief  Recompute every key for a day, then heapify once.
+ */
+void TaskManager::rekeyAll(sys_days today) {
+  ref_day = today;
+  for (auto &shard : shards)
+    for (auto &[id, ptr] : shard.tasks)
+      ptr->sort_key = make_sort_key(*ptr, ref_day, kRecentThreshold);
+  rebuildHeap();
+}
+
+/**
+ * @brief  Bulk heapify (make_heap) instead of n individual pushes. Blocked
+ *         tasks still get keys so they can be ranked among themselves.
+ */
+void TaskManager::rebuildHeap() {
+  for (auto &[list, heap] : heaps)
+    heap.clear();
+  for (auto &shard : shards)
+    for (auto &[id, ptr] : shard.tasks)
+      if (!ptr->blocked())
+        heaps[ptr->list].push_back(ptr.get());
+  for (auto &[list, heap] : heaps) {
+    make_heap(heap.begin(), heap.end(), PriorityCmp{});
+    for (size_t slot = 0; slot < heap.size(); ++slot)
+      heap[slot]->heap_slot = slot;
+  }
+}
+
+/**
+ * @brief  Aging is measured in whole days, so keys only go stale at midnight.
+ *         Caller holds every shard and rank_mtx exclusively.
+ */
+void TaskManager::refreshIfDayChanged() {
+  sys_days today{get_today()};
+  if (today != ref_day)
+    rekeyAll(today);
+}
+
+/**
+ * @brief  Readers share the locks; only a day rollover needs them exclusively.
+ */
+vector<Task> TaskManager::topTasks(size_t k, Status filter, optional<ListId> list, uint64_t below) {
+  {
+    auto locks = lockShards<shared_lock<RwLock>>();
+    shared_lock rank_lock(rank_mtx);
+    if (sys_days{get_today()} == ref_day)
+      return collectTop(k, filter, list, below);
+  }
+
+  auto locks = lockShards<unique_lock<RwLock>>();
+  unique_lock rank_lock(rank_mtx);
+  refreshIfDayChanged();
+  return collectTop(k, filter, list, below);
+}
+
+/**
+ * @brief  One dispatch on the filter, then a branch-free specialised loop per
+ *         heap; across lists, each heap's top K are merged by key. Blocked
+ *         tasks are in no heap: a listing that includes them puts them last,
+ *         ranked among themselves, the order writeStore saves them in.
+ */
+vector<Task> TaskManager::collectTop(size_t k, Status filter, optional<ListId> list, uint64_t below) const {
+  auto by_rank = [](const Task *a, const Task *b) { return a->sort_key > b->sort_key; };
+
+  // Blocked tasks are pending, so only --all shows them besides `blocked`.
+  // A cursor on a blocked row continues among the blocked ones (the key's
+  // low half is the inverted id).
+  bool with_blocked = filter == Status::All && edge_count > 0;
+  bool past_ranked = false;
+  if (with_blocked && below != UINT64_MAX) {
+    int id = static_cast<int>(UINT32_MAX - static_cast<uint32_t>(below));
+    const Shard &shard = shardFor(id);
+    auto it = shard.tasks.find(id);
+    past_ranked = it != shard.tasks.end() && it->second->blocked();
+  }
+
+  vector<const Task *> top;
+  for (const auto &[heap_list, heap] : heaps) {
+    if (past_ranked || (list.has_value() && heap_list != *list))
+      continue;
+    vector<const Task *> part = select_ranked(heap, filter, k, below);
+    top.insert(top.end(), part.begin(), part.end());
+  }
+
+  if (!list.has_value() && heaps.size() > 1) {
+    size_t keep = min(k, top.size());
+    partial_sort(top.begin(), top.begin() + static_cast<ptrdiff_t>(keep), top.end(), by_rank);
+    top.resize(keep);
+  }
+
+  if (with_blocked && top.size() < k) {
+    vector<const Task *> blocked;
+    for (const auto &shard : shards)
+      for (int id : shard.by_status[static_cast<size_t>(Status::Pending)])
+        if (const Task *task = shard.tasks.at(id).get();
+            task->blocked() && (!list.has_value() || task->list == *list) && (!past_ranked || task->sort_key < below))
+          blocked.push_back(task);
+    size_t keep = min(k - top.size(), blocked.size());
+    partial_sort(blocked.begin(), blocked.begin() + static_cast<ptrdiff_t>(keep), blocked.end(), by_rank);
+    top.insert(top.end(), blocked.begin(), blocked.begin() + static_cast<ptrdiff_t>(keep));
+  }
+
+  vector<Task> result;
+  result.reserve(top.size());
+  for (const Task *t : top)
+    result.push_back(*t);
+  return result;
+}
+
+/**
+ * @brief  Counts come from the heaps, which hold exactly the unblocked tasks.
+ */
+vector<pair<ListId, size_t>> TaskManager::listCounts() const {
+  vector<pair<ListId, size_t>> counts;
+  {
+    shared_lock rank_lock(rank_mtx);
+    for (const auto &[list, heap] : heaps)
+      if (!heap.empty())
+        counts.emplace_back(list, count_if(heap.begin(), heap.end(),
+                                           [](const Task *t) { return t->state == Status::Pending; }));
+  }
+  sort(counts.begin(), counts.end(), [](const auto &a, const auto &b) { return list_name(a.first) < list_name(b.first); });
+  return counts;
+}
+
+/**
+ * @brief  Same locking as topTasks: shared unless the day rolled over.
+ */
+vector<Task> TaskManager::queryTasks(const TaskQuery &query, size_t limit, QueryPlan *plan) {
+  QueryPlan local;
+  QueryPlan &out = plan ? *plan : local;
+  {
+    auto locks = lockShards<shared_lock<RwLock>>();
+    shared_lock rank_lock(rank_mtx);
+    if (sys_days{get_today()} == ref_day)
+      return runQuery(query, limit, out);
+  }
+
+  auto locks = lockShards<unique_lock<RwLock>>();
+  unique_lock rank_lock(rank_mtx);
+  refreshIfDayChanged();
+  return runQuery(query, limit, out);
+}
+
+/**
+ * @brief  Estimates come from index sizes (exact for status and due, an upper
+ *         bound for title prefixes); the smallest wins and the rest of the
+ *         predicate runs on what it returns.
+ */
+vector<Task> TaskManager::runQuery(const TaskQuery &query, size_t limit, QueryPlan &plan) const {
+  enum class Path { Scan,
+                    Status,
+                    Due,
+                    Title,
+                    List };
+  static constexpr const char *kStatusNames[kStatusCount] = {"pending", "completed", "archived"};
+
+  Path path = Path::Scan;
+  plan = QueryPlan{"full scan", task_count, {}, 0, 0};
+  auto consider = [&](Path p, string name, size_t rows) {
+    if (rows < plan.estimate) {
+      plan.alternatives.emplace_back(std::move(plan.access), plan.estimate);
+      plan.access = std::move(name);
+      plan.estimate = rows;
+      path = p;
+    } else {
+      plan.alternatives.emplace_back(std::move(name), rows);
+    }
+  };
+
+  // 1) Cost every usable access path
+  size_t status = query.status ? static_cast<size_t>(*query.status) : 0;
+  if (query.status) {
+    size_t rows = 0;
+    for (const auto &shard : shards)
+      rows += shard.by_status[status].size();
+    consider(Path::Status, string("status partition (") + kStatusNames[status] + ")", rows);
+  }
+
+  pair<sys_days::rep, int> due_lo{INT32_MIN, INT_MIN}, due_hi{INT32_MAX, INT_MAX};
+  if (query.hasDueRange()) {
+    if (query.due_lo)
+      due_lo.first = query.due_lo->time_since_epoch().count();
+    if (query.due_hi)
+      due_hi.first = query.due_hi->time_since_epoch().count();
+
+    size_t rows = 0;
+    for (const auto &shard : shards) {
+      auto first = lower_bound(shard.by_due.begin(), shard.by_due.end(), due_lo);
+      rows += static_cast<size_t>(upper_bound(first, shard.by_due.end(), due_hi) - first);
+    }
+    consider(Path::Due, "due index", rows);
+  }
+
+  string prefix;
+  if (!query.title_prefixes.empty()) {
+    size_t rows = SIZE_MAX;
+    for (const string &p : query.title_prefixes)
+      if (size_t n = title_index.prefixCount(p); n < rows)
+        rows = n, prefix = p;
+    consider(Path::Title, "title index (" + prefix + "*)", rows);
+  }
+
+  // A list's heap holds all of its unblocked tasks, so it covers blocked:no
+  const vector<Task *> *list_heap = nullptr;
+  if (query.list && query.blocked == false) {
+    auto it = heaps.find(*query.list);
+    static const vector<Task *> kEmpty;
+    list_heap = it == heaps.end() ? &kEmpty : &it->second;
+    consider(Path::List, "list heap (" + list_name(*query.list) + ")", list_heap->size());
+  }
+
+  // 2) Read the chosen path and run the full predicate on each row
+  vector<const Task *> hits;
+  auto check = [&](const Task *task) {
+    ++plan.examined;
+    if (query.matches(*task))
+      hits.push_back(task);
+  };
+
+  switch (path) {
+  case Path::Scan:
+    for (const auto &shard : shards)
+      for (const auto &[id, ptr] : shard.tasks)
+        check(ptr.get());
+    break;
+  case Path::Status:
+    for (const auto &shard : shards)
+      for (int id : shard.by_status[status])
+        check(shard.tasks.at(id).get());
+    break;
+  case Path::Due:
+    for (const auto &shard : shards) {
+      auto first = lower_bound(shard.by_due.begin(), shard.by_due.end(), due_lo);
+      auto last = upper_bound(first, shard.by_due.end(), due_hi);
+      for (; first < last; ++first)
+        check(shard.tasks.at(first->second).get());
+    }
+    break;
+  case Path::Title:
+    for (int id : title_index.searchPrefix(prefix)) {
+      const Shard &shard = shardFor(id);
+      if (auto it = shard.tasks.find(id); it != shard.tasks.end())
+        check(it->second.get());
+    }
+    break;
+  case Path::List:
+    for (const Task *task : *list_heap)
+      check(task);
+    break;
+  }
+  plan.matched = hits.size();
+
+  // 3) Rank order, first page only
+  auto by_rank = [](const Task *a, const Task *b) { return a->sort_key > b->sort_key; };
+  size_t keep = min(limit, hits.size());
+  partial_sort(hits.begin(), hits.begin() + static_cast<ptrdiff_t>(keep), hits.end(), by_rank);
+
+  vector<Task> list;
+  list.reserve(keep);
+  for (size_t i = 0; i < keep; ++i)
+    list.push_back(*hits[i]);
+  return list;
+}
+
+/**
+ * @brief  Walks one shard at a time so writers elsewhere are never blocked.
+ */
+size_t TaskManager::count(Status filter) const {
+  if (filter == Status::All)
+    return task_count;
+
+  size_t n = 0;
+  for (const auto &shard : shards) {
+    shared_lock lock(shard.mtx);
+    n += shard.by_status[static_cast<size_t>(filter)].size();
+  }
+  return n;
+}
+
+/**
+ * @brief  Copies the task out so the caller never holds a pointer past the lock.
+ */
+optional<Task> TaskManager::getTask(int id) const {
+  const Shard &shard = shardFor(id);
+  shared_lock lock(shard.mtx);
+  auto it = shard.tasks.find(id);
+  if (it == shard.tasks.end())
+    return nullopt;
+  return *it->second;
+}
+
+/**
+ * @brief  Outputs a table of all tasks.
+ */
+void TaskManager::printTasks(Status filter, size_t limit, optional<ListId> only, optional<PageCursor> after) {
+  // Gather matching tasks in heap order
+  vector<Task> list = topTasks(limit, filter, only, after ? after->key : UINT64_MAX);
+
+  const char *label = nullptr;
+  switch (filter) {
+  case Status::All:
+    label = "total";
+    break;
+  case Status::Pending:
+    label = "pending";
+    break;
+  case Status::Completed:
+    label = "completed";
+    break;
+  case Status::Archived:
+    label = "archived";
+    break;
+  }
+  printTable(list, label);
+
+  // A full page may have more after it
+  if (limit != SIZE_MAX && list.size() == limit)
+    cout << "Next page: --after " << PageCursor{list.back().sort_key, list.back().id}.str() << "\n\n";
+}
+
+/**
+ * @brief  Key then id, fixed width, so tokens compare and parse trivially.
+ */
+string TaskManager::PageCursor::str() const {
+  char token[25];
+  snprintf(token, sizeof(token), "%016llx%08x", static_cast<unsigned long long>(key), static_cast<unsigned>(id));
+  return token;
+}
+
+optional<TaskManager::PageCursor> TaskManager::PageCursor::parse(string_view token) {
+  PageCursor cursor;
+  unsigned id = 0;
+  if (token.size() != 24 ||
+      from_chars(token.data(), token.data() + 16, cursor.key, 16).ptr != token.data() + 16 ||
+      from_chars(token.data() + 16, token.data() + 24, id, 16).ptr != token.data() + 24)
+    return nullopt;
+
+  // The key's low half is the inverted id (see make_sort_key)
+  cursor.id = static_cast<int>(id);
+  if (static_cast<uint32_t>(cursor.key) != UINT32_MAX - id)
+    return nullopt;
+  return cursor;
+}
+
+/**
+ * @brief  Header, one row per task, then a count footer.
+ */
+void TaskManager::printTable(const vector<Task> &list, const char *label) {
+  // 1) Header
+  cout << BOLD << "\nID   STATUS\tPRIORITY   DUE\t\t\tTITLE" << RESET << endl;
+  cout << "-----------------------------------------------------------------------------------" << endl;
+
+  // 2) Body, rendered into one buffer with today looked up once
+  if (list.empty())
+    cout << "No tasks." << endl;
+  else {
+    string body;
+    body.reserve(list.size() * 160);
+    sys_days today{get_today()};
+    for (const Task &task : list)
+      append_row(body, task, today);
+    cout.write(body.data(), static_cast<streamsize>(body.size()));
+  }
+
+  // 3) Footer
+  cout << "-----------------------------------------------------------------------------------\n";
+  cout << BOLD << list.size() << " tasks " << label << ".\n\n";
+}
+
+/**
+ * @brief  Three blocks: a status × priority table, pending tasks by due week
+ *         with bars scaled to the largest week, and completions per day.
+ */
+void TaskManager::printStats(const StoreStats &stats) {
+  static constexpr array<const char *, kStatPriorities> kHeads = {"LOW", "MED", "HIGH", "CRIT"};
+  static constexpr int kBarWidth = 30;
+  sys_days today{get_today()};
+  string out;
+  char line[128];
+
+  // 1) Counts per status and priority
+  out += BOLD;
+  snprintf(line, sizeof(line), "\n%-10s%8s%8s%8s%8s%8s\n", "STATUS", kHeads[0], kHeads[1], kHeads[2], kHeads[3],
+           "TOTAL");
+  out += line;
+  out += RESET;
+  out += "----------------------------------------------------------\n";
+  array<size_t, kStatPriorities + 1> sums{};
+  for (size_t s = 0; s < kStatStatuses; ++s) {
+    const auto &row = stats.counts[s];
+    size_t total = stats.total(static_cast<Status>(s));
+    snprintf(line, sizeof(line), "%-10.*s%8zu%8zu%8zu%8zu%8zu\n", static_cast<int>(kStatusNames[s].size()),
+             kStatusNames[s].data(), row[0], row[1], row[2], row[3], total);
+    out += line;
+    for (size_t p = 0; p < kStatPriorities; ++p)
+      sums[p] += row[p];
+    sums[kStatPriorities] += total;
+  }
+  out += "----------------------------------------------------------\n";
+  snprintf(line, sizeof(line), "%-10s%8zu%8zu%8zu%8zu%8zu\n\n", "TOTAL", sums[0], sums[1], sums[2], sums[3], sums[4]);
+  out += line;
+
+  // 2) Pending tasks by due week, overdue first and undated last
+  array<size_t, kDueWeeks + 2> weeks = stats.dueByWeek(today);
+  size_t dated = 0;
+  for (size_t n : weeks)
+    dated += n;
+  size_t pending = stats.total(Status::Pending);
+  size_t widest = max<size_t>(pending - min(pending, dated), *max_element(weeks.begin(), weeks.end()));
+
+  out += BOLD;
+  out += "DUE (pending)\n";
+  out += RESET;
+  auto bar = [&](const char *label, size_t n) {
+    size_t width = widest == 0 ? 0 : (n * kBarWidth + widest - 1) / widest;
+    snprintf(line, sizeof(line), "%-12s%6zu", label, n);
+    out += line;
+    if (width > 0)
+      out.append("  ").append(width, '#');
+    out += '\n';
+  };
+  bar("overdue", weeks[0]);
+  for (size_t w = 0; w < kDueWeeks; ++w) {
+    char label[16];
+    if (w == 0)
+      snprintf(label, sizeof(label), "this week");
+    else
+      snprintf(label, sizeof(label), "+%zu week%s", w, w == 1 ? "" : "s");
+    bar(label, weeks[w + 1]);
+  }
+  bar("later", weeks[kDueWeeks + 1]);
+  bar("no date", pending - min(pending, dated));
+
+  // 3) Completion throughput
+  size_t week = stats.completedWithin(today, 7), month = stats.completedWithin(today, kThroughputDays);
+  snprintf(line, sizeof(line), "\n%sCompleted:%s %zu today, %zu in 7 days (%.1f/day), %zu in %d days (%.1f/day)\n\n",
+           BOLD, RESET, stats.completedWithin(today, 1), week, static_cast<double>(week) / 7, month, kThroughputDays,
+           static_cast<double>(month) / kThroughputDays);
+  out += line;
+  cout << out;
+}
+
+/**
+ * @brief  Buckets are summed from the days; a bucket's backlog is its last day's.
+ */
+void TaskManager::printReport(const HistoryReport &report) {
+  static constexpr array<const char *, kStatPriorities> kHeads = {"LOW", "MED", "HIGH", "CRIT"};
+  static constexpr int kBarWidth = 30;
+  static constexpr size_t kDailyDays = 31;
+  size_t step = report.days.size() > kDailyDays ? 7 : 1;
+  string out;
+  char line[128];
+
+  // 1) Burn-down
+  struct Bucket {
+    sys_days from;
+    size_t added{0}, closed{0}, open{0};
+  };
+  vector<Bucket> buckets;
+  size_t widest = 0;
+  for (size_t i = 0; i < report.days.size(); i += step) {
+    Bucket bucket{report.days[i].day};
+    for (size_t j = i; j < min(i + step, report.days.size()); ++j) {
+      bucket.added += report.days[j].added;
+      bucket.closed += report.days[j].closed;
+      bucket.open = report.days[j].open;
+    }
+    widest = max(widest, bucket.open);
+    buckets.push_back(bucket);
+  }
+
+  out += BOLD;
+  snprintf(line, sizeof(line), "\n%-12s%8s%8s%8s\n", step == 1 ? "DAY" : "WEEK OF", "ADDED", "CLOSED", "OPEN");
+  out += line;
+  out += RESET;
+  out += "------------------------------------\n";
+  for (const Bucket &bucket : buckets) {
+    ymd day{bucket.from};
+    size_t width = widest == 0 ? 0 : (bucket.open * kBarWidth + widest - 1) / widest;
+    snprintf(line, sizeof(line), "%04d-%02u-%02u  %8zu%8zu%8zu", static_cast<int>(day.year()),
+             static_cast<unsigned>(day.month()), static_cast<unsigned>(day.day()), bucket.added, bucket.closed,
+             bucket.open);
+    out += line;
+    if (width > 0)
+      out.append("  ").append(width, '#');
+    out += '\n';
+  }
+
+  // 2) Lead times, creation to completion
+  out += BOLD;
+  snprintf(line, sizeof(line), "\n%-10s%8s%10s%10s%10s\n", "LEAD (h)", "DONE", "MEDIAN", "P90", "MEAN");
+  out += line;
+  out += RESET;
+  out += "------------------------------------------------\n";
+  for (size_t p = 0; p < kStatPriorities; ++p) {
+    vector<double> hours = report.lead_hours[p];
+    if (hours.empty()) {
+      snprintf(line, sizeof(line), "%-10s%8d%10s%10s%10s\n", kHeads[p], 0, "-", "-", "-");
+      out += line;
+      continue;
+    }
+    sort(hours.begin(), hours.end());
+    double mean = accumulate(hours.begin(), hours.end(), 0.0) / static_cast<double>(hours.size());
+    snprintf(line, sizeof(line), "%-10s%8zu%10.1f%10.1f%10.1f\n", kHeads[p], hours.size(), hours[hours.size() / 2],
+             hours[(hours.size() - 1) * 9 / 10], mean);
+    out += line;
+  }
+  out += '\n';
+  cout << out;
+}
+
+// Files smaller than this are parsed on the calling thread.
+static constexpr size_t kParallelLoadBytes = 1 << 20;
+// Journals smaller than this (or an eighth of the store) take more edits.
+static constexpr uint64_t kJournalBytes = 64 * 1024;
+
+namespace {
+
+/**
+ * @brief  Block-store form of the parallel parse: each thread decompresses
+ *         and parses a run of whole blocks, which already end on records.
+ */
+optional<vector<unique_ptr<Task>>> parse_blocks(string_view file, unsigned threads, StoreHeader &header) {
+  optional<vector<BlockEntry>> blocks = block_index(file);
+  if (!blocks.has_value() || blocks->empty()) {
+    cerr << BLOOD << FAIL << " The compressed store is damaged." << RESET << endl;
+    return nullopt;
+  }
+
+  optional<string> first = unpack_block(file, blocks->front());
+  if (!first.has_value()) {
+    cerr << BLOOD << FAIL << " The compressed store is damaged." << RESET << endl;
+    return nullopt;
+  }
+  istringstream head(first->substr(0, min(first->size(), size_t{256})));
+  header = read_store_header(head);
+  header.compressed = true;
+
+  uint64_t raw_size = blocks->back().raw_offset + blocks->back().raw_size;
+  if (threads == 0)
+    threads = raw_size < kParallelLoadBytes ? 1 : max(1u, thread::hardware_concurrency());
+  threads = static_cast<unsigned>(min<size_t>(threads, blocks->size()));
+
+  vector<vector<unique_ptr<Task>>> parsed(threads);
+  atomic<bool> damaged{false};
+  auto work = [&](unsigned t) {
+    for (size_t i = blocks->size() * t / threads; i < blocks->size() * (t + 1) / threads; ++i) {
+      optional<string> text = i == 0 ? std::move(first) : unpack_block(file, (*blocks)[i]);
+      if (!text.has_value()) {
+        damaged = true;
+        return;
+      }
+      parse_records(*text, parsed[t]);
+    }
+  };
+  vector<thread> workers;
+  for (unsigned t = 1; t < threads; ++t)
+    workers.emplace_back(work, t);
+  work(0);
+  for (auto &w : workers)
+    w.join();
+
+  if (damaged) {
+    cerr << BLOOD << FAIL << " The compressed store is damaged." << RESET << endl;
+    return nullopt;
+  }
+  for (unsigned t = 1; t < threads; ++t)
+    std::move(parsed[t].begin(), parsed[t].end(), back_inserter(parsed[0]));
+  return std::move(parsed[0]);
+}
+
+/**
+ * @brief  Whether records were edited since the store was last saved in full.
+ */
+bool has_journal(const string &filename) {
+  error_code ec;
+  uint64_t size = filesystem::file_size(journal_path(filename), ec);
+  return !ec && size > 0;
+}
+
+/**
+ * @brief  End of the last whole record in text[from, end), or `from` if no
+ *         record closed there yet. Walks back a line at a time.
+ */
+size_t last_record_end(string_view text, size_t from) {
+  size_t end = text.size();
+  while (end > from) {
+    size_t eol = text.rfind('\n', end - 1);
+    if (eol == string_view::npos || eol < from)
+      return from;
+    size_t bol = eol == 0 ? 0 : text.rfind('\n', eol - 1) + 1;
+    if (closes_record(text.substr(bol, eol - bol)))
+      return eol + 1;
+    end = eol;
+  }
+  return from;
+}
+
+/**
+ * @brief  Read a whole store into `text` with up to kIoDepth chunk reads in
+ *         flight, parsing each record-aligned stretch as soon as every byte
+ *         before it is in. With one thread the stretch is parsed here,
+ *         between reads; with more, the file is read in one chunk per thread
+ *         and each stretch is parsed on its own thread. Compressed stores
+ *         are only read; they are parsed block by block afterwards.
+ * @param   text     Sized to the file; filled in place.
+ * @param   parsed   (out) One batch per stretch, in file order.
+ * @param   workers  (out) Parser threads for the caller to join.
+ * @param   ok       (out) Cleared if a read failed or came up short.
+ */
+IoJob read_and_parse(IoRing &ring, int fd, string &text, unsigned threads, deque<vector<unique_ptr<Task>>> &parsed,
+                     vector<thread> &workers, bool &ok) {
+  size_t chunk = threads > 1 ? max(kIoChunk, text.size() / threads + 1) : kIoChunk;
+  deque<IoRing::Op> reads;
+  size_t issued = 0, arrived = 0, parsed_to = 0;
+  auto issue = [&] {
+    size_t len = min(chunk, text.size() - issued);
+    reads.push_back(ring.read(fd, span{text.data() + issued, len}, issued));
+    issued += len;
+  };
+  while (issued < text.size() && reads.size() < kIoDepth)
+    issue();
+
+  bool blocks = false;
+  while (!reads.empty()) {
+    size_t want = min(chunk, text.size() - arrived);
+    int64_t got = co_await std::move(reads.front());
+    reads.pop_front();
+    if (got != static_cast<int64_t>(want)) {
+      ok = false;
+      co_return;
+    }
+    if (arrived == 0)
+      blocks = is_block_store(string_view{text}.substr(0, want));
+    arrived += want;
+    if (issued < text.size())
+      issue();
+    if (blocks)
+      continue;
+
+    size_t cut = arrived == text.size() ? arrived : last_record_end(string_view{text}.substr(0, arrived), parsed_to);
+    if (cut == parsed_to)
+      continue;
+    string_view stretch = string_view{text}.substr(parsed_to, cut - parsed_to);
+    parsed_to = cut;
+    auto &out = parsed.emplace_back();
+    if (threads > 1)
+      workers.emplace_back(parse_records, stretch, ref(out));
+    else
+      parse_records(stretch, out);
+  }
+}
+
+} // namespace
+
+/**
+ * @brief  If valid file, reads it in one go, parses record-aligned chunks in
+ *         parallel, then adopts all tasks at once.
+ */
+bool TaskManager::loadFromFile(const string &filename, unsigned threads) {
+  StoreHeader header;
+  Tombstones tombstones;
+  auto parsed = readStore(filename, threads, header, tombstones);
+
+  // Did not find file. Not an error because this might be the first time we've run
+  // the program so nothing saved yet.
+  if (!parsed.has_value())
+    return false;
+
+  generation = header.generation;
+  if (lamport < header.generation)
+    lamport = header.generation;
+  {
+    lock_guard removed_lock(removed_mtx);
+    removed = std::move(tombstones);
+  }
+  compressed = header.compressed;
+  adoptTasks(std::move(*parsed));
+
+  // Cold tasks are not loaded, but their ids stay taken and their counts
+  // come from the last save (if it is this generation's)
+  raiseNextId(header.next_id);
+  optional<SavedStats> saved = read_stats(stats_path(filename));
+  lock_guard stats_lock(stats_mtx);
+  if (saved.has_value())
+    counted.done = std::move(saved->total.done);
+  cold_known = saved.has_value() && saved->generation == header.generation;
+  cold_counted = cold_known ? std::move(saved->cold) : StoreStats{};
+  return true;
+}
+
+optional<vector<unique_ptr<Task>>> TaskManager::readStore(const string &filename, unsigned threads,
+                                                          StoreHeader &header, Tombstones &tombstones) {
+  string text;
+  vector<unique_ptr<Task>> edits;
+  deque<vector<unique_ptr<Task>>> parsed;
+  vector<thread> workers;
+  bool ok = true;
+  {
+    // Shared: other readers may read along, writers wait until the bytes are
+    // in. Stretches already read are parsed meanwhile, so less is left after.
+    StoreLock lock(filename, StoreLock::Mode::Shared);
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return nullopt;
+    struct stat info{};
+    fstat(fd, &info);
+    text.resize(static_cast<size_t>(info.st_size));
+    if (threads == 0)
+      threads = text.size() < kParallelLoadBytes ? 1 : max(1u, thread::hardware_concurrency());
+
+    IoRing ring;
+    IoJob job = read_and_parse(ring, fd, text, threads, parsed, workers, ok);
+    // A job left waiting on a read that will never complete has not read it all
+    if (!ring.run(job))
+      ok = false;
+    close(fd);
+    tombstones = read_tombstones(tombstone_path(filename));
+    edits = read_journal(journal_path(filename));
+  }
+  for (auto &w : workers)
+    w.join();
+  if (!ok) {
+    cerr << BLOOD << FAIL << " Error reading file " << filename << "." << RESET << endl;
+    return nullopt;
+  }
+
+  if (is_block_store(text)) {
+    auto blocks = parse_blocks(text, threads, header);
+    if (blocks.has_value())
+      fold_journal(*blocks, std::move(edits));
+    return blocks;
+  }
+
+  istringstream head(text.substr(0, min(text.size(), size_t{256})));
+  header = read_store_header(head);
+  if (parsed.empty())
+    parsed.emplace_back();
+
+  // Merge the per-stretch buffers
+  for (size_t i = 1; i < parsed.size(); ++i)
+    std::move(parsed[i].begin(), parsed[i].end(), back_inserter(parsed[0]));
+  fold_journal(parsed[0], std::move(edits));
+  return std::move(parsed[0]);
+}
+
+/**
+ * @brief  Inserts a parsed batch under every lock, then keys and heapifies once.
+ */
+void TaskManager::adoptTasks(vector<unique_ptr<Task>> batch) {
+  auto locks = lockShards<unique_lock<RwLock>>();
+  unique_lock rank_lock(rank_mtx);
+
+  // Size the tables once instead of rehashing as they grow
+  size_t per_shard = (task_count + batch.size()) / kShardCount + 1;
+  for (size_t i = 0; i < kShardCount; ++i) {
+    shards[i].tasks.reserve(per_shard);
+    lock_guard dedup_lock(dedup[i].mtx);
+    dedup[i].keys.reserve(per_shard);
+  }
+
+  vector<pair<int, string_view>> titles;
+  titles.reserve(batch.size());
+  vector<Task *> waiting;
+
+  for (auto &task : batch) {
+    int id = task->id;
+    string key = dedupKey(task->title, task->due, task->list);
+    Task *raw_task = insertTaskUnchecked(shardFor(id), std::move(task));
+    if (raw_task == nullptr) {
+      cerr << BLOOD << FAIL << " Insertion of task failed." << RESET << endl;
+      continue;
+    }
+    titles.emplace_back(id, raw_task->title);
+    if (uint64_t last = raw_task->lastChange(); lamport < last)
+      lamport = last;
+    if (raw_task->due.has_value())
+      shardFor(id).by_due.emplace_back(sys_days{raw_task->due.value()}.time_since_epoch().count(), id);
+    if (!raw_task->after.empty())
+      waiting.push_back(raw_task);
+
+    // Maintain correct ID (depending on how many tasks we have already)
+    reserveTitle(key);
+    task_count.fetch_add(1);
+    raiseNextId(id + 1);
+  }
+
+  // Sort each due index once rather than inserting in order
+  for (auto &shard : shards)
+    sort(shard.by_due.begin(), shard.by_due.end());
+
+  // Link edges once every task is in place; drop ones to finished or missing tasks
+  for (Task *task : waiting) {
+    auto done = [&](int prereq) {
+      auto &tasks = shardFor(prereq).tasks;
+      auto it = tasks.find(prereq);
+      return it == tasks.end() || it->second->state != Status::Pending;
+    };
+    task->after.erase(remove_if(task->after.begin(), task->after.end(), done), task->after.end());
+
+    lock_guard dep_lock(dep_mtx);
+    for (int prereq : task->after)
+      dependents[prereq].push_back(task->id);
+    edge_count.fetch_add(task->after.size());
+  }
+
+  title_index.addAll(titles);
+  if (fuzzy_ready)
+    fuzzy_index.addAll(titles);
+  rekeyAll(ref_day);
+}
+
+/**
+ * @brief  Old versions go out the way removeTask takes a task out and new
+ *         ones come in the way restoreTask puts one back, but under one set
+ *         of locks and without stamps, tombstones or history. Tasks that
+ *         waited on one now finished or gone are released afterwards.
+ */
+size_t TaskManager::adoptChanges(StoreChanges changes, const string &filename) {
+  vector<int> released;
+  size_t changed = 0;
+  {
+    auto locks = lockShards<unique_lock<RwLock>>();
+    unique_lock rank_lock(rank_mtx);
+
+    auto find_task = [&](int id) -> Task * {
+      auto &tasks = shardFor(id).tasks;
+      auto it = tasks.find(id);
+      return it == tasks.end() ? nullptr : it->second.get();
+    };
+    auto take_out = [&](Task *task) {
+      dropRankedUnlocked(task);
+      if (!task->after.empty()) {
+        lock_guard dep_lock(dep_mtx);
+        for (int prereq : task->after) {
+          auto &waiting = dependents[prereq];
+          waiting.erase(remove(waiting.begin(), waiting.end(), task->id), waiting.end());
+          if (waiting.empty())
+            dependents.erase(prereq);
+        }
+        edge_count.fetch_sub(task->after.size());
+      }
+      unindexDue(shardFor(task->id), *task);
+      eraseUnlocked(task, true);
+      ++changed;
+    };
+
+    for (int id : changes.gone) {
+      Task *task = find_task(id);
+      if (task == nullptr || (archive_loaded && task->state != Status::Pending &&
+                              (!changes.removed.has_value() || !changes.removed->contains(task->uid))))
+        continue;
+      take_out(task);
+      released.push_back(id);
+    }
+
+    vector<Task *> added;
+    added.reserve(changes.records.size());
+    for (auto &record : changes.records) {
+      int id = record->id;
+      if (Task *old = find_task(id)) {
+        take_out(old);
+        --changed;
+      }
+      Shard &shard = shardFor(id);
+      string key = dedupKey(record->title, record->due, record->list);
+      Task *task = insertTaskUnchecked(shard, std::move(record));
+      if (task == nullptr)
+        continue;
+      // The saved store is the authority, so a clash does not keep it out
+      reserveTitle(key);
+      indexDue(shard, *task);
+      title_index.add(id, task->title);
+      if (fuzzy_ready)
+        fuzzy_index.add(id, task->title);
+      task_count.fetch_add(1);
+      raiseNextId(id + 1);
+      if (uint64_t last = task->lastChange(); lamport < last)
+        lamport = last;
+      if (task->state != Status::Pending)
+        released.push_back(id);
+      added.push_back(task);
+      ++changed;
+    }
+
+    // Edges once every new version is in place, so they can wait on each other
+    for (Task *task : added) {
+      auto done = [&](int prereq) {
+        Task *before = find_task(prereq);
+        return before == nullptr || before->state != Status::Pending;
+      };
+      erase_if(task->after, done);
+      if (!task->after.empty()) {
+        lock_guard dep_lock(dep_mtx);
+        for (int prereq : task->after)
+          dependents[prereq].push_back(task->id);
+        edge_count.fetch_add(task->after.size());
+      }
+      if (task->blocked())
+        task->sort_key = make_sort_key(*task, ref_day, kRecentThreshold);
+      else
+        pushRankedUnlocked(task);
+    }
+
+    generation = changes.generation;
+    if (lamport < changes.generation)
+      lamport = changes.generation;
+    raiseNextId(changes.next_id);
+    if (changes.removed.has_value()) {
+      lock_guard removed_lock(removed_mtx);
+      removed = std::move(*changes.removed);
+    }
+  }
+
+  if (edge_count > 0)
+    for (int id : released)
+      resolveDependents(id);
+
+  // The same counts loadFromFile would take; the archive's own once it is loaded
+  optional<SavedStats> saved = read_stats(stats_path(filename));
+  lock_guard stats_lock(stats_mtx);
+  if (saved.has_value())
+    counted.done = std::move(saved->total.done);
+  if (!archive_loaded) {
+    cold_known = saved.has_value() && saved->generation == generation;
+    cold_counted = cold_known ? std::move(saved->cold) : StoreStats{};
+  }
+  return changed;
+}
+
+/**
+ * @brief  Writes each field of Task as a line in a JSON file, most important
+ *         task first, plus the id→offset index for single-record commands.
+ */
+/**
+ * @brief  Last writer wins, but the generation still moves past whatever is
+ *         on disk so other processes' optimistic saves notice.
+ */
+bool TaskManager::saveToFile(const string &filename) const {
+  StoreLock lock(filename, StoreLock::Mode::Exclusive);
+  unique_ptr<istream> current = open_store(filename);
+  uint64_t on_disk = current ? read_store_header(*current).generation : 0;
+  current.reset();
+  return writeStore(filename, max<uint64_t>(on_disk, generation) + 1);
+}
+
+/**
+ * @brief  The generation check and the write happen under one exclusive lock,
+ *         so two processes can never both pass the check.
+ */
+TaskManager::SaveResult TaskManager::saveIfUnchanged(const string &filename) const {
+  StoreLock lock(filename, StoreLock::Mode::Exclusive);
+  unique_ptr<istream> current = open_store(filename);
+  uint64_t on_disk = current ? read_store_header(*current).generation : 0;
+  current.reset();
+  if (on_disk != generation)
+    return SaveResult::Conflict;
+  return writeStore(filename, on_disk + 1) ? SaveResult::Saved : SaveResult::Failed;
+}
+
+/**
+ * @brief  One record appended and the generation digits patched, both under
+ *         the exclusive lock; the .idx and .search sidecars stay keyed to the
+ *         unchanged store size, and readers that use them check the journal.
+ */
+TaskManager::SaveResult TaskManager::saveTaskIfUnchanged(const string &filename, int id) const {
+  StoreLock lock(filename, StoreLock::Mode::Exclusive);
+  unique_ptr<istream> current = open_store(filename);
+  StoreHeader header = current ? read_store_header(*current) : StoreHeader{};
+  current.reset();
+  if (header.generation != generation)
+    return SaveResult::Conflict;
+
+  // The edit was stamped lamport + 1, so the new generation still covers it
+  uint64_t next = max<uint64_t>(header.generation, lamport) + 1;
+  optional<Task> task = getTask(id);
+  error_code ec;
+  uint64_t store_size = filesystem::file_size(filename, ec);
+  bool journal = task.has_value() && !ec && !compressed && header.generation_at != 0 && next <= UINT32_MAX;
+  if (journal) {
+    uint64_t journal_size = filesystem::file_size(journal_path(filename), ec);
+    journal = ec || journal_size < max<uint64_t>(kJournalBytes, store_size / 8);
+  }
+  if (journal) {
+    optional<IndexEntry> entry = find_in_index(index_path(filename), store_size, id);
+    journal = entry.has_value() && entry->id != -1;
+  }
+  if (!journal)
+    return writeStore(filename, header.generation + 1) ? SaveResult::Saved : SaveResult::Failed;
+
+  fstream file(filename, ios::in | ios::out | ios::binary);
+  if (!append_journal(journal_path(filename), *task) || !patch_generation(file, header, next))
+    return SaveResult::Failed;
+
+  // The edit moved no task between tiers, so the saved cold counts still hold
+  optional<SavedStats> saved = read_stats(stats_path(filename));
+  bool fresh = saved.has_value() && saved->generation == header.generation;
+  write_stats(stats_path(filename), savedStats(fresh ? next : 0, fresh ? saved->cold : StoreStats{}));
+  flushHistory(filename);
+  generation = next;
+  lamport = next;
+  return SaveResult::Saved;
+}
+
+bool TaskManager::writeStore(const string &filename, uint64_t next_generation) const {
+  // Every stamp in the file stays at or below its generation (see patchStatus)
+  next_generation = max<uint64_t>(next_generation, lamport + 1);
+
+  auto locks = lockShards<shared_lock<RwLock>>();
+  shared_lock rank_lock(rank_mtx);
+
+  // Split off the cold tier: archived tasks, old completions, and anything
+  // already archived that has not changed since
+  vector<const Task *> ranked, completed, to_archive;
+  ranked.reserve(task_count);
+  bool revived = false;
+
+  // Counts of what the archive holds once this save is done: unloaded cold
+  // tasks, loaded ones that stay cold, and those about to move there
+  StoreStats cold_after;
+  error_code ec;
+  bool counts_known = archive_loaded || !filesystem::exists(archive_path(filename), ec);
+  {
+    lock_guard stats_lock(stats_mtx);
+    counts_known = counts_known || cold_known;
+    cold_after = cold_counted;
+  }
+  {
+    lock_guard cold_lock(cold_mtx);
+    for (const auto &shard : shards)
+      for (const auto &[id, ptr] : shard.tasks) {
+        const Task *task = ptr.get();
+        auto known = cold.find(id);
+        if (task->state != Status::Pending && known != cold.end() && known->second == task->lastChange()) {
+          cold_after.tally(*task, +1);
+          continue;
+        }
+        if (task->state == Status::Archived)
+          to_archive.push_back(task);
+        else if (task->state == Status::Completed)
+          completed.push_back(task);
+        else
+          ranked.push_back(task);
+      }
+
+    // Newest completions by status stamp stay hot
+    auto stamp = [](const Task *t) { return t->clock[static_cast<size_t>(Field::State)]; };
+    if (completed.size() > kHotCompleted) {
+      nth_element(completed.begin(), completed.begin() + kHotCompleted, completed.end(),
+                  [&](const Task *a, const Task *b) { return stamp(a) > stamp(b); });
+      to_archive.insert(to_archive.end(), completed.begin() + kHotCompleted, completed.end());
+      completed.resize(kHotCompleted);
+    }
+    ranked.insert(ranked.end(), completed.begin(), completed.end());
+
+    // A cold task back in the hot file leaves a stale archive copy behind;
+    // one that was removed is covered by its tombstone
+    for (const Task *task : ranked)
+      revived |= cold.erase(task->id) > 0;
+    erase_if(cold, [&](const auto &entry) { return !shardFor(entry.first).tasks.contains(entry.first); });
+
+    // The archive goes first, so a crash before the hot file is written
+    // leaves both copies rather than neither
+    if (!append_archive(archive_path(filename), to_archive)) {
+      cerr << BLOOD << FAIL << " Error writing archive " << archive_path(filename) << "." << RESET << endl;
+      return false;
+    }
+    for (const Task *task : to_archive) {
+      cold[task->id] = task->lastChange();
+      cold_after.tally(*task, +1);
+    }
+    archive_records += to_archive.size();
+  }
+
+  // Rank order, so a reader that only needs the first page can stop early.
+  // Blocked tasks are not in the heap and go last, ranked among themselves.
+  sort(ranked.begin(), ranked.end(), [](const Task *a, const Task *b) {
+    if (a->blocked() != b->blocked())
+      return b->blocked();
+    return a->sort_key > b->sort_key;
+  });
+
+  int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (fd < 0) {
+    cerr << BLOOD << FAIL << " Error opening file " << filename << ") for writing." << endl;
+    return false;
+  }
+  lock_guard dep_lock(dep_mtx);
+
+  // Each full chunk is handed to the ring at once, so earlier records are
+  // written while later ones are still being serialised
+  IoRing ring;
+  AsyncWriter out(ring, fd);
+  string &buf = out.pending();
+  buf = write_store_header(ymd{ref_day}, next_generation, next_id);
+  vector<IndexEntry> entries;
+  entries.reserve(ranked.size());
+
+  for (size_t i = 0; i < ranked.size(); ++i) {
+    uint64_t start = out.size();
+    auto waiting = dependents.find(ranked[i]->id);
+    write_record(buf, *ranked[i], i + 1 == ranked.size(),
+                 waiting == dependents.end() ? span<const int>{} : span<const int>{waiting->second});
+    entries.push_back({ranked[i]->id, static_cast<uint32_t>(out.size() - start), start});
+    if (!compressed)
+      out.submit();
+  }
+
+  buf += "\t]\n}";
+
+  // Compressed blocks end on record boundaries; index offsets stay raw
+  if (compressed) {
+    vector<uint64_t> cuts;
+    cuts.reserve(entries.size());
+    for (const IndexEntry &entry : entries)
+      cuts.push_back(entry.offset + entry.length);
+    buf = pack_blocks(buf, cuts);
+  }
+  uint64_t size = out.size();
+  bool written = out.finish();
+  if (close(fd) != 0 || !written) {
+    cerr << BLOOD << FAIL << " Error writing file " << filename << "." << RESET << endl;
+    return false;
+  }
+
+  // Every journalled edit is in the file now
+  filesystem::remove(journal_path(filename), ec);
+
+  // A missing index only disables the fast paths, so it is not an error.
+  // Both are keyed to the size of the file as written.
+  write_index(index_path(filename), size, std::move(entries));
+  title_index.save(search_path(filename), size);
+  {
+    lock_guard removed_lock(removed_mtx);
+    write_tombstones(tombstone_path(filename), removed);
+  }
+  write_stats(stats_path(filename), savedStats(counts_known ? next_generation : 0, std::move(cold_after)));
+  flushHistory(filename);
+
+  // Rewrite the archive once stale copies could show up in a cold search, or
+  // once superseded and removed records outnumber live ones
+  lock_guard cold_lock(cold_mtx);
+  if (revived || archive_records > 2 * cold.size()) {
+    unordered_set<uint64_t> hot;
+    hot.reserve(ranked.size());
+    for (const Task *task : ranked)
+      hot.insert(task->uid);
+
+    ArchiveContents contents = read_archive(archive_path(filename));
+    vector<const Task *> keep;
+    {
+      lock_guard removed_lock(removed_mtx);
+      for (const auto &task : contents.tasks) {
+        auto gone = removed.find(task->uid);
+        if (!hot.contains(task->uid) && (gone == removed.end() || gone->second < task->lastChange()))
+          keep.push_back(task.get());
+      }
+    }
+    if (write_archive(archive_path(filename), keep))
+      archive_records = keep.size();
+  }
+
+  generation = next_generation;
+  lamport = next_generation;
+  return true;
+}
+
+/**
+ * @brief  Skips what the hot file already holds: a newer copy, or an id in
+ *         use. Tasks buried by a later tombstone stay out.
+ */
+size_t TaskManager::loadArchive(const string &filename) {
+  if (archive_loaded.exchange(true))
+    return 0;
+
+  ArchiveContents contents;
+  {
+    StoreLock lock(filename, StoreLock::Mode::Shared);
+    contents = read_archive(archive_path(filename));
+  }
+
+  vector<unique_ptr<Task>> batch;
+  vector<pair<int, uint32_t>> adopted;
+  {
+    auto locks = lockShards<shared_lock<RwLock>>();
+    unordered_set<uint64_t> hot;
+    hot.reserve(task_count);
+    for (const auto &shard : shards)
+      for (const auto &[id, ptr] : shard.tasks)
+        hot.insert(ptr->uid);
+
+    lock_guard removed_lock(removed_mtx);
+    for (auto &task : contents.tasks) {
+      auto gone = removed.find(task->uid);
+      if (hot.contains(task->uid) || shardFor(task->id).tasks.contains(task->id) ||
+          (gone != removed.end() && gone->second >= task->lastChange()))
+        continue;
+      adopted.emplace_back(task->id, task->lastChange());
+      batch.push_back(std::move(task));
+    }
+  }
+
+  adoptTasks(std::move(batch));
+  {
+    // Every cold task is loaded and counted now
+    lock_guard stats_lock(stats_mtx);
+    cold_counted = {};
+    cold_known = true;
+  }
+  lock_guard cold_lock(cold_mtx);
+  cold.insert(adopted.begin(), adopted.end());
+  archive_records = contents.records;
+  return adopted.size();
+}
+
+SavedStats TaskManager::savedStats(uint64_t generation, StoreStats cold) const {
+  SavedStats saved{generation, {}, std::move(cold)};
+  lock_guard stats_lock(stats_mtx);
+  saved.total = counted;
+  saved.total += cold_counted;
+  saved.total.trim(sys_days{get_today()});
+  return saved;
+}
+
+optional<StoreStats> TaskManager::stats() const {
+  lock_guard stats_lock(stats_mtx);
+  if (!cold_known)
+    return nullopt;
+  StoreStats all = counted;
+  all += cold_counted;
+  all.trim(sys_days{get_today()});
+  return all;
+}
+
+/**
+ * @brief  One header read and one small file; the cost does not depend on
+ *         how many tasks the store holds.
+ */
+optional<StoreStats> TaskManager::statsFile(const string &filename) {
+  StoreLock lock(filename, StoreLock::Mode::Shared);
+  unique_ptr<istream> in = open_store(filename);
+  if (!in)
+    return nullopt;
+  uint64_t on_disk = read_store_header(*in).generation;
+  optional<SavedStats> saved = read_stats(stats_path(filename));
+  if (!saved.has_value() || saved->generation == 0 || saved->generation != on_disk)
+    return nullopt;
+  saved->total.trim(sys_days{get_today()});
+  return std::move(saved->total);
+}
+
+/**
+ * @brief  The loaded cold tasks are the ones in `cold`; the rest of the
+ *         archive was superseded or removed and is not counted.
+ */
+bool TaskManager::saveStats(const string &filename) const {
+  StoreLock lock(filename, StoreLock::Mode::Exclusive);
+  unique_ptr<istream> current = open_store(filename);
+  if (!current || read_store_header(*current).generation != generation || !stats().has_value())
+    return false;
+  current.reset();
+
+  StoreStats cold_now;
+  {
+    auto locks = lockShards<shared_lock<RwLock>>();
+    lock_guard cold_lock(cold_mtx);
+    for (const auto &[id, last] : cold)
+      if (auto it = shardFor(id).tasks.find(id); it != shardFor(id).tasks.end())
+        cold_now.tally(*it->second, +1);
+  }
+  {
+    lock_guard stats_lock(stats_mtx);
+    cold_now += cold_counted;
+  }
+  return write_stats(stats_path(filename), savedStats(generation, std::move(cold_now)));
+}
+
+/**
+ * @brief  Indexes the archive's titles on the fly; no sidecar is kept for it.
+ */
+vector<Task> TaskManager::searchArchive(const string &filename, const string &query) {
+  ArchiveContents contents;
+  Tombstones gone;
+  {
+    StoreLock lock(filename, StoreLock::Mode::Shared);
+    contents = read_archive(archive_path(filename));
+    gone = read_tombstones(tombstone_path(filename));
+  }
+
+  vector<pair<int, string_view>> titles;
+  titles.reserve(contents.tasks.size());
+  for (size_t i = 0; i < contents.tasks.size(); ++i)
+    titles.emplace_back(static_cast<int>(i), contents.tasks[i]->title);
+  TitleIndex index;
+  index.addAll(titles);
+
+  sys_days today{get_today()};
+  vector<Task> hits;
+  for (int i : index.search(query)) {
+    Task &task = *contents.tasks[static_cast<size_t>(i)];
+    auto it = gone.find(task.uid);
+    if (it != gone.end() && it->second >= task.lastChange())
+      continue;
+    task.sort_key = make_sort_key(task, today, kRecentThreshold);
+    hits.push_back(std::move(task));
+  }
+
+  sort(hits.begin(), hits.end(), [](const Task &a, const Task &b) { return a.sort_key > b.sort_key; });
+  return hits;
+}
+
+/**
+ * @brief  Posting-list intersection, then one shard lookup per hit.
+ */
+vector<Task> TaskManager::searchTasks(const string &query) const {
+  vector<Task> hits;
+  for (int id : title_index.search(query))
+    if (auto task = getTask(id))
+      hits.push_back(std::move(*task));
+
+  sort(hits.begin(), hits.end(), [](const Task &a, const Task &b) { return a.sort_key > b.sort_key; });
+  return hits;
+}
+
+/**
+ * @brief  Prefix-filtered trigram candidates, then one shard lookup per hit.
+ */
+vector<Task> TaskManager::findSimilar(const string &query, double threshold, size_t limit,
+                                      FuzzyMetric metric) const {
+  ensureFuzzyIndex();
+
+  vector<Task> hits;
+  for (const FuzzyMatch &m : fuzzy_index.match(query, threshold, limit, metric))
+    if (auto task = getTask(m.id))
+      hits.push_back(std::move(*task));
+  return hits;
+}
+
+/**
+ * @brief  Writers update fuzzy_index under their shard lock once fuzzy_ready
+ *         is set, so holding every shard while building leaves no gap.
+ */
+void TaskManager::ensureFuzzyIndex() const {
+  if (fuzzy_ready)
+    return;
+
+  auto locks = lockShards<shared_lock<RwLock>>();
+  lock_guard build_lock(fuzzy_build_mtx);
+  if (fuzzy_ready)
+    return;
+
+  vector<pair<int, string_view>> titles;
+  titles.reserve(task_count);
+  for (const auto &shard : shards)
+    for (const auto &[id, ptr] : shard.tasks)
+      titles.emplace_back(id, ptr->title);
+
+  fuzzy_index.addAll(titles);
+  fuzzy_ready = true;
+}
+
+/**
+ * @brief  Reads the saved inverted index, then only the matching records.
+ */
+optional<vector<Task>> TaskManager::searchFile(const string &filename, const string &query) {
+  StoreLock lock(filename, StoreLock::Mode::Shared);
+  error_code ec;
+  uint64_t store_size = filesystem::file_size(filename, ec);
+  if (ec || has_journal(filename))
+    return nullopt;
+
+  TitleIndex saved;
+  if (!saved.load(search_path(filename), store_size))
+    return nullopt;
+
+  vector<int> ids = saved.search(query);
+  optional<vector<IndexEntry>> entries = find_in_index(index_path(filename), store_size, ids);
+  if (!entries.has_value())
+    return nullopt;
+
+  unique_ptr<istream> in = open_store(filename);
+  if (!in)
+    return nullopt;
+  sys_days today{get_today()};
+  vector<Task> hits;
+  for (const IndexEntry &entry : *entries) {
+    unique_ptr<Task> task = read_record(*in, entry);
+    if (task == nullptr)
+      return nullopt;
+    task->sort_key = make_sort_key(*task, today, kRecentThreshold);
+    hits.push_back(std::move(*task));
+  }
+
+  sort(hits.begin(), hits.end(), [](const Task &a, const Task &b) { return a.sort_key > b.sort_key; });
+  return hits;
+}
+
+/**
+ * @brief  O(log n) index probe plus one record read and a one-byte write.
+ */
+TaskManager::PatchResult TaskManager::patchStatus(const string &filename, int id, Status state, Task *before) {
+  StoreLock lock(filename, StoreLock::Mode::Exclusive);
+
+  // Without a generation field the patch could not be noticed by other
+  // processes, and compressed bytes cannot be edited in place
+  ifstream current(filename, ios::binary);
+  char magic[4] = {};
+  current.read(magic, sizeof(magic));
+  if (is_block_store({magic, static_cast<size_t>(current.gcount())}))
+    return PatchResult::Unavailable;
+  current.clear();
+  current.seekg(0);
+  StoreHeader header = read_store_header(current);
+  current.close();
+  if (header.generation_at == 0)
+    return PatchResult::Unavailable;
+
+  error_code ec;
+  uint64_t store_size = filesystem::file_size(filename, ec);
+  if (ec)
+    return PatchResult::Unavailable;
+
+  optional<IndexEntry> entry = find_in_index(index_path(filename), store_size, id);
+  if (!entry.has_value())
+    return PatchResult::Unavailable;
+  if (entry->id == -1)
+    return PatchResult::Missing;
+
+  // The new generation doubles as the change's logical time
+  uint64_t next = header.generation + 1;
+  Task was;
+  if (next > UINT32_MAX || !patch_status(filename, *entry, state, static_cast<uint32_t>(next), &was))
+    return PatchResult::Unavailable;
+  fstream file(filename, ios::in | ios::out | ios::binary);
+  patch_generation(file, header, next, true);
+
+  // The record on disk may predate an edit still in the journal
+  if (has_journal(filename)) {
+    vector<unique_ptr<Task>> one;
+    one.push_back(make_unique<Task>(was));
+    fold_journal(one, read_journal(journal_path(filename)));
+    was = *one.front();
+  }
+
+  // Move the task's count across, if the saved counts were current
+  if (optional<SavedStats> saved = read_stats(stats_path(filename));
+      saved.has_value() && saved->generation == header.generation) {
+    Task now = was;
+    now.state = state;
+    saved->total.tally(was, -1);
+    saved->total.tally(now, +1);
+    if (state == Status::Completed && was.state != Status::Completed)
+      saved->total.completed(sys_days{get_today()}, +1);
+    saved->generation = next;
+    write_stats(stats_path(filename), *saved);
+  }
+  if (was.state != state) {
+    HistoryKind kind = state == Status::Pending     ? HistoryKind::Reopened
+                       : state == Status::Completed ? HistoryKind::Completed
+                                                    : HistoryKind::Archived;
+    HistoryEvent event = history_event(was, kind, was.state == Status::Pending || state == Status::Pending);
+    append_history(history_path(filename), span{&event, 1});
+  }
+  if (before != nullptr)
+    *before = std::move(was);
+  return PatchResult::Patched;
+}
+
+/**
+ * @brief  Streams records from the top of a store ranked today, or from the
+ *         cursor's position in it, and stops once the page is full; any other
+ *         store is loaded in full.
+ */
+bool TaskManager::loadFirstPage(const string &filename, Status filter, size_t limit, optional<ListId> list,
+                                optional<PageCursor> after) {
+  StoreLock lock(filename, StoreLock::Mode::Shared);
+  unique_ptr<istream> in = open_store(filename);
+  if (!in)
+    return false;
+
+  // Journalled edits can move records, so their order is no longer the ranking.
+  // Only pending pages stop at the blocked tasks; --all lists those too.
+  StoreHeader header = read_store_header(*in);
+  if (!header.ranked.has_value() || sys_days{*header.ranked} != sys_days{get_today()} || has_journal(filename) ||
+      filter == Status::All) {
+    in.reset();
+    return loadFromFile(filename);
+  }
+  generation = header.generation;
+  lamport = header.generation;
+  raiseNextId(header.next_id);
+
+  // Records are in rank order with blocked ones last, so "blocked or ranked
+  // below the cursor" holds from some record to the end
+  if (after.has_value()) {
+    sys_days today{get_today()};
+    seek_record(*in, [&](const Task &task) {
+      return task.blocked() || make_sort_key(task, today, kRecentThreshold) < after->key;
+    });
+  }
+
+  vector<unique_ptr<Task>> page;
+  string record, line;
+  while (page.size() < limit && getline(*in, line)) {
+    record += line;
+    record += '\n';
+    if (!closes_record(line))
+      continue;
+
+    // Only keep what this page will show; blocked tasks come last and are never listed
+    parse_records(record, page);
+    record.clear();
+    if (!page.empty() && page.back()->blocked()) {
+      page.pop_back();
+      break;
+    }
+    if (!page.empty() && (!matches(*page.back(), filter) || (list && page.back()->list != *list)))
+      page.pop_back();
+  }
+
+  adoptTasks(std::move(page));
+  return true;
+}
@@ -6,21 +6,79 @@
  *
  * The TaskManager owns all Task instances, provides methods to add,
  * complete, remove, archive, list, save, and load tasks.
+ *
+ * All public methods are safe to call from multiple threads. Tasks live in
+ * kShardCount shards chosen by id, each behind its own reader-writer lock, so
+ * writers touching different ids do not contend; queries that need the whole
+ * store (list, save) take every shard shared. Lock order is always shards in
+ * ascending index, then the rank lock; the duplicate-title and dependency
+ * locks are leaves.
+ *
+ * Tasks belong to named lists (Task::list). Ids, shards and the status,
+ * due-date and title indexes are shared by the whole store; each list has its
+ * own rank heap, so listing one list never visits another's tasks.
+ *
+ * A pending task with unfinished prerequisites is "blocked" and kept out of
+ * the rank heap, so listings only show what can be worked on. Each task's
+ * `after` list holds its unfinished prerequisites; finishing or removing a
+ * prerequisite erases it there and releases tasks whose list empties.
+ *
+ * Ids are local handles. Across stores a task is known by its uid, and each
+ * field carries the Lamport time of its last change: local changes are
+ * stamped one past the highest time this store has seen, which every save
+ * writes as its generation. mergeFrom keeps, per field, the later change and
+ * drops tasks whose removal (a tombstone) is later than all their changes.
+ *
+ * Saves keep the hot file small: archived tasks, and completed ones older
+ * than the newest kHotCompleted, move to the compressed cold archive, and
+ * loadFromFile reads only the hot file. Commands that need finished tasks
+ * call loadArchive on top. A cold task that changes (e.g. undo of archive)
+ * is written back to the hot file on the next save.
+ *
+ * A store may be saved block-compressed instead of as plain text; every
+ * reader accepts both, and a loaded store is saved back in its own form.
+ *
+ * An edit to one task can be saved on its own: the record is appended to an
+ * edit journal that every read folds in and the next full save empties.
+ *
+ * Counts for `todo stats` (StoreStats) follow every mutation in O(1). The
+ * cold tier's share is saved with them in tasks.json.stats, so a manager that
+ * only loaded the hot file still reports the whole store.
+ *
+ * Creations and status changes are also stamped with the wall-clock time and
+ * appended by the next save to tasks.json.history, for `todo report`.
  */
 
 #pragma once
+#include "rw_lock.hpp"
 #include "task.hpp"
+#include "task_history.hpp"
+#include "task_query.hpp"
+#include "task_stats.hpp"
+#include "title_index.hpp"
+#include "trigram_index.hpp"
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <memory>
-#include <queue>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 // How many days count towards "recent" for aging score.
 static constexpr int kRecentThreshold = 7;
 // Failure return code for functions.
 static constexpr int FXN_FAILURE = -1;
+// Completed tasks kept in the hot file; older completions go to the archive.
+static constexpr size_t kHotCompleted = 100;
+// Default cap on the number of stored tasks (see TaskManager::setTaskLimit).
+extern int MAX_TASKS;
+
+struct StoreHeader;
+struct SavedStats;
 
 using day = std::chrono::day;
 using month = std::chrono::month;
@@ -48,25 +106,34 @@ public:
    * @brief  Initializes empty map and next ID starting at 1.
    *         Note: same as doing TaskManager() = default;
    */
-  TaskManager() : task_map(), next_id(1) {}
+  TaskManager() : next_id(1), task_count(0), task_limit(MAX_TASKS) {}
 
   /**
    * @brief  Add a new task.
    * @param  title  Non-empty task title.
    * @param  pr     Priority (default Medium).
    * @param  due    Optional due date.
+   * @param  repeat Recurrence rule; a recurring task without a due date is
+   *                due on its first scheduled day from today.
+   * @param  list   Named list to add it to. Titles only clash within a list.
    * @return Task ID on success; FXN_FAILURE on error.
    */
   int addTask(const std::string &title,
               Priority pr = Priority::Medium,
-              std::optional<ymd> due = std::nullopt);
+              std::optional<ymd> due = std::nullopt,
+              Recurrence repeat = {},
+              ListId list = kDefaultList);
 
   /**
-   * @brief  Mark an existing task as completed.
-   * @param  id  Identifier of the task.
+   * @brief  Mark an existing task as completed. A recurring task hands its
+   *         rule to a newly added next occurrence, so only one pending
+   *         instance of it ever exists.
+   * @param  id    Identifier of the task.
+   * @param  next  If given, receives the next occurrence's id (FXN_FAILURE
+   *               when the task does not recur or it could not be added).
    * @return True if found and updated, false otherwise.
    */
-  bool completeTask(int id);
+  bool completeTask(int id, int *next = nullptr);
 
   /**
    * @brief  Remove an existing task permanently.
@@ -83,10 +150,180 @@ public:
   bool archiveTask(int id);
 
   /**
-   * @brief  Print tasks filtered by Status.
+   * @brief  Make a task wait for another one to be completed (or archived).
+   * @param  id      Task that waits.
+   * @param  prereq  Task that must finish first.
+   * @return False if either task is missing, prereq is already done, or the
+   *         edge would close a cycle.
+   */
+  bool addDependency(int id, int prereq);
+
+  /**
+   * @brief  Pending tasks still waiting on a prerequisite, in rank order.
+   */
+  std::vector<Task> blockedTasks() const;
+
+  /**
+   * @brief  Ids of the tasks currently waiting on a task.
+   */
+  std::vector<int> dependentsOf(int id) const;
+
+  /**
+   * @brief  Put a removed task back under its original id (undo of remove,
+   *         redo of add). Prerequisites in task.after that are still pending
+   *         are linked again; the task limit is not enforced.
+   * @param  task  Snapshot taken before the task was removed.
+   * @return False if the id or its title and due date are taken.
+   */
+  bool restoreTask(const Task &task);
+
+  /**
+   * @brief  Roll a task's status and recurrence rule back to a snapshot
+   *         (undo of complete or archive).
+   * @param  before  Snapshot taken before the status changed.
+   * @return False if the task no longer exists.
+   */
+  bool revertTask(const Task &before);
+
+  /**
+   * @struct TaskEdit
+   * @brief  Fields `todo edit` can change; unset ones are left alone.
+   */
+  struct TaskEdit {
+    std::optional<std::string> title;
+    std::optional<Priority> pr;
+    std::optional<std::optional<ymd>> due; //< An engaged nullopt clears the due date.
+  };
+
+  /**
+   * @brief  Change a task's title, priority or due date in place. The dedup
+   *         key and the title, trigram and due-date indexes follow, and the
+   *         task moves to its new rank heap slot in O(log n).
+   * @param  id    Identifier of the task.
+   * @param  edit  Fields to change.
+   * @return False if the task is missing, the title is empty, a recurring
+   *         task would lose its due date, or the new title and due date clash
+   *         with another task in its list.
+   */
+  bool updateTask(int id, const TaskEdit &edit);
+
+  /**
+   * @struct MergeStats
+   * @brief  What a merge changed in this store.
+   */
+  struct MergeStats {
+    size_t added{0};   //< Tasks only the other store had.
+    size_t updated{0}; //< Tasks that took at least one field from the other store.
+    size_t removed{0}; //< Tasks the other store removed (or merged away as duplicates).
+  };
+
+  /**
+   * @brief  Fold another store into this one. Tasks are matched by uid; each
+   *         field keeps whichever side changed it last (ties go to the larger
+   *         value, so both directions agree). New tasks get local ids. The
+   *         same title and due date in one list under two uids keeps the
+   *         lower uid. Prerequisites are unioned unless that forms a cycle.
+   *         Linear in both stores.
+   * @param  theirs            The other store's tasks (their own ids).
+   * @param  their_removed     The other store's tombstones.
+   * @param  their_generation  The other store's generation.
+   * @return Counts of what changed here.
+   */
+  MergeStats mergeFrom(std::vector<std::unique_ptr<Task>> theirs, const Tombstones &their_removed,
+                       uint64_t their_generation);
+
+  /**
+   * @brief  Read another store file and its archive and merge them in (see
+   *         mergeFrom). This store's own archive should be loaded first.
+   * @param  filename  Path to the other tasks.json.
+   * @return What changed here, or nullopt if the file cannot be read.
+   */
+  std::optional<MergeStats> mergeFile(const std::string &filename);
+
+  /**
+   * @brief  Pending (unblocked) tasks per list, for lists that have any tasks.
+   * @return (list, pending count) pairs ordered by list name.
+   */
+  std::vector<std::pair<ListId, size_t>> listCounts() const;
+
+  /**
+   * @struct PageCursor
+   * @brief  Where a listing page ended: the sort key and id of its last row.
+   *         The next page holds only tasks ranked below it, so tasks added in
+   *         between never shift or repeat rows.
+   */
+  struct PageCursor {
+    uint64_t key{UINT64_MAX};
+    int id{0};
+
+    /**
+     * @brief  Opaque token for `list --after` (24 hex digits).
+     */
+    std::string str() const;
+
+    /**
+     * @brief  Read a token written by str().
+     * @return nullopt if it is malformed or its key and id disagree.
+     */
+    static std::optional<PageCursor> parse(std::string_view token);
+  };
+
+  /**
+   * @brief  Print tasks filtered by Status, and a cursor for the next page
+   *         when the page is full.
    * @param  filter  Status enum to select which tasks to show.
+   * @param  limit   Maximum number of rows (page size).
+   * @param  list    Only this list; every list if nullopt.
+   * @param  after   Start below this cursor; from the top if nullopt.
+   */
+  void printTasks(Status filter = Status::Pending, size_t limit = SIZE_MAX, std::optional<ListId> list = std::nullopt,
+                  std::optional<PageCursor> after = std::nullopt);
+
+  /**
+   * @brief  Print a table of tasks with a "N tasks <label>." footer.
+   * @param  list   Tasks in the order to show them.
+   * @param  label  Footer word, e.g. "pending" or "found".
+   */
+  static void printTable(const std::vector<Task> &list, const char *label);
+
+  /**
+   * @brief  Aggregates over the whole store: the loaded tasks, plus the cold
+   *         tier's counts from the last save if the archive is not loaded.
+   * @return nullopt if the cold tier's counts are not current (loadArchive
+   *         first).
+   */
+  std::optional<StoreStats> stats() const;
+
+  /**
+   * @brief  Read a saved store's aggregates from tasks.json.stats, without
+   *         loading any task.
+   * @param  filename  Path to JSON file.
+   * @return nullopt if they are missing or describe an older generation
+   *         (caller falls back to load + loadArchive + stats).
+   */
+  static std::optional<StoreStats> statsFile(const std::string &filename);
+
+  /**
+   * @brief  Write tasks.json.stats for the store as loaded, e.g. after
+   *         statsFile found it stale. Needs the archive loaded.
+   * @param  filename  Path to JSON file.
+   * @return False if the file changed since it was loaded.
+   */
+  bool saveStats(const std::string &filename) const;
+
+  /**
+   * @brief  Print counts per status and priority, the overdue count, a due
+   *         date histogram by week and completion throughput.
+   * @param  stats  Aggregates to show.
+   */
+  static void printStats(const StoreStats &stats);
+
+  /**
+   * @brief  Print a burn-down (added, closed and open per day, or per week
+   *         for windows longer than a month) and lead times per priority.
+   * @param  report  Computed by build_report.
    */
-  void printTasks(Status filter = Status::Pending);
+  static void printReport(const HistoryReport &report);
 
   // Convenience wrappers
   void printAllTasks() { printTasks(Status::All); }
@@ -95,19 +332,166 @@ public:
   void printArchivedTasks() { printTasks(Status::Archived); }
 
   /**
-   * @brief  Load tasks from JSON file.
+   * @brief  Load tasks from JSON file. Large files are split into record-aligned
+   *         chunks parsed on separate threads; the heap is built once at the end.
+   * @param  filename  Path to JSON file.
+   * @param  threads   Parser threads; 0 picks one per core for large files.
+   * @return True if loaded, false if file missing or error.
+   */
+  bool loadFromFile(const std::string &filename = "tasks.json", unsigned threads = 0);
+
+  /**
+   * @struct StoreChanges
+   * @brief  What changed in a store since it was loaded, as found by a
+   *         StoreFollower.
+   */
+  struct StoreChanges {
+    std::vector<std::unique_ptr<Task>> records; //< Tasks as now saved, journal folded in; replace by id.
+    std::vector<int> gone;                      //< Ids no longer in the store.
+    uint64_t generation{0};                     //< Store generation they bring the manager to.
+    int next_id{0};                             //< Store's next_id.
+    std::optional<Tombstones> removed;          //< Tombstones as now saved, if they were re-read.
+  };
+
+  /**
+   * @brief  Bring a loaded store up to date with changes another process
+   *         saved, touching only the tasks involved: each is unlinked from
+   *         the heaps, edges and indexes and its new version linked back in.
+   *         Nothing is stamped, journaled or recorded in the history, so the
+   *         result is what loadFromFile would read now. Finished tasks that
+   *         went cold stay if the archive is loaded. Assumes no unsaved
+   *         changes are held (they could be overwritten).
+   * @param  changes   Records and removals to apply.
+   * @param  filename  Store they come from; its stats sidecar is re-read.
+   * @return Tasks replaced, added or dropped.
+   */
+  size_t adoptChanges(StoreChanges changes, const std::string &filename);
+
+  /**
+   * @brief  Add the cold tier (archived and old completed tasks) to what
+   *         loadFromFile read. Tasks already loaded, or removed since they
+   *         were archived, are skipped. Does nothing the second time.
+   * @param  filename  Path to JSON file (the archive sits next to it).
+   * @return Number of tasks added.
+   */
+  size_t loadArchive(const std::string &filename = "tasks.json");
+
+  /**
+   * @brief  Search the cold archive of a saved store (see searchTasks).
    * @param  filename  Path to JSON file.
+   * @param  query     Free text.
+   * @return Matching cold tasks, most important first.
+   */
+  static std::vector<Task> searchArchive(const std::string &filename, const std::string &query);
+
+  /**
+   * @brief  Load just enough of the file to show one page of a listing.
+   *         Saved stores are ranked, so when the ranking is still current the
+   *         read stops after `limit` matching records, and a later page
+   *         starts with a binary search for its cursor (O(log n) records).
+   *         Status::All, which also lists blocked tasks, loads the whole file.
+   * @param  filename  Path to JSON file.
+   * @param  filter    Status the listing will show.
+   * @param  limit     Page size.
+   * @param  list      Only keep records of this list (every list if nullopt).
+   * @param  after     Cursor of the previous page; the first page if nullopt.
    * @return True if loaded, false if file missing or error.
    */
-  bool loadFromFile(const std::string &filename = "tasks.json");
+  bool loadFirstPage(const std::string &filename, Status filter, size_t limit,
+                     std::optional<ListId> list = std::nullopt, std::optional<PageCursor> after = std::nullopt);
 
   /**
-   * @brief  Save current tasks to JSON file.
+   * @brief  Save current tasks to JSON file (rank order) and its id index,
+   *         whatever other processes wrote meanwhile.
    * @param  filename  Path to output file.
    * @return True on success, false otherwise.
    */
   bool saveToFile(const std::string &filename = "tasks.json") const;
 
+  /**
+   * @enum   SaveResult
+   * @brief  Outcome of an optimistic save.
+   */
+  enum class SaveResult { Saved,
+                          Conflict,
+                          Failed };
+
+  /**
+   * @brief  Save only if the file is still the generation this manager
+   *         loaded (or last saved), i.e. no other process wrote it since.
+   * @param  filename  Path to output file.
+   * @return Saved; Conflict if the file moved on (reload and re-apply);
+   *         Failed on I/O errors.
+   */
+  SaveResult saveIfUnchanged(const std::string &filename = "tasks.json") const;
+
+  /**
+   * @brief  Persist a change to one task without rewriting the store: its
+   *         record is appended to the edit journal (tasks.json.journal), which
+   *         every reader folds in and the next full save empties. Falls back
+   *         to a full save when the record is not in the hot file's index,
+   *         the store is compressed, or the journal has outgrown the store.
+   * @param  filename  Path to JSON file.
+   * @param  id        Task whose record changed.
+   * @return As saveIfUnchanged.
+   */
+  SaveResult saveTaskIfUnchanged(const std::string &filename, int id) const;
+
+  /**
+   * @brief  Full-text search over titles: every query word must appear
+   *         (case-insensitive, whole words).
+   * @param  query  Free text.
+   * @return Matching tasks, most important first.
+   */
+  std::vector<Task> searchTasks(const std::string &query) const;
+
+  /**
+   * @brief  Search a saved store without loading it, using the inverted index
+   *         and id index written by saveToFile.
+   * @param  filename  Path to JSON file.
+   * @param  query     Free text.
+   * @return Matching tasks, most important first; nullopt if either index is
+   *         missing or stale, or records were edited since the last full save
+   *         (caller falls back to load + searchTasks).
+   */
+  static std::optional<std::vector<Task>> searchFile(const std::string &filename, const std::string &query);
+
+  /**
+   * @brief  Typo-tolerant title lookup ranked by trigram similarity. The
+   *         trigram index is built on first use and kept in sync afterwards.
+   * @param  query      Free text, e.g. "grocries".
+   * @param  threshold  Minimum similarity in (0, 1].
+   * @param  limit      Maximum number of results.
+   * @param  metric     Coverage for lookups, Jaccard for duplicate checks.
+   * @return Matching tasks, most similar first.
+   */
+  std::vector<Task> findSimilar(const std::string &query,
+                                double threshold = kFuzzyThreshold,
+                                size_t limit = 10,
+                                FuzzyMetric metric = FuzzyMetric::Coverage) const;
+
+  /**
+   * @enum   PatchResult
+   * @brief  Outcome of changing a single record directly on disk.
+   */
+  enum class PatchResult { Patched,
+                           Missing,
+                           Unavailable };
+
+  /**
+   * @brief  Change one task's status in the store file without loading it,
+   *         using the id index written by saveToFile. The edit keeps the
+   *         record's length, so the index stays valid afterwards.
+   * @param  filename  Path to JSON file.
+   * @param  id        Identifier of the task.
+   * @param  state     New status.
+   * @param  before    (out, optional) The task as it was before the change.
+   * @return Patched; Missing if the index has no such id; Unavailable if there
+   *         is no usable index or the change needs more than one record, e.g.
+   *         completing a recurring task (caller falls back to load/modify/save).
+   */
+  static PatchResult patchStatus(const std::string &filename, int id, Status state, Task *before = nullptr);
+
   /**
    * @brief   Compute a combined score from priority and due date.
    * @param   task       Reference to Task.
@@ -134,55 +518,402 @@ public:
     return base_pr + aging_norm;
   }
 
+  /**
+   * @brief   Pack the effective score into an integer so ranking is a plain compare.
+   *          Bits 63..32 hold base_pr * threshold + aging steps (the effective score
+   *          scaled by threshold, so the order is unchanged); bits 31..0 hold the
+   *          inverted id so equal scores always rank the older task first.
+   * @param   task       Reference to Task.
+   * @param   today      Reference day the aging is measured from.
+   * @param   threshold  Days window for aging norm.
+   * @return  Key where larger means more important.
+   */
+  static uint64_t make_sort_key(const Task &task, std::chrono::sys_days today, int threshold) {
+    uint64_t score = static_cast<uint64_t>(static_cast<int>(task.pr) + 1) * threshold;
+
+    if (task.due.has_value()) {
+      long long delta = (std::chrono::sys_days{task.due.value()} - today).count();
+      score += static_cast<uint64_t>(std::clamp<long long>(threshold - delta, 0, threshold));
+    }
+
+    return (score << 32) | (UINT32_MAX - static_cast<uint32_t>(task.id));
+  }
+
+  /**
+   * @brief   Re-rank every task against a new reference day. Keys only depend on
+   *          priority, due date and this day, so this is the only bulk refresh.
+   * @param   today  Day the aging is measured from.
+   */
+  void setReferenceDay(const ymd &today);
+
+  /**
+   * @brief   Collect the K most important tasks matching a filter, in rank order.
+   * @param   k       Maximum number of tasks to return.
+   * @param   filter  Status enum to select which tasks to return.
+   * @param   list    Only this list's heap; every list's if nullopt.
+   * @param   below   Only tasks keyed below this (see PageCursor).
+   * @return  Copies of the matching tasks.
+   */
+  std::vector<Task> topTasks(size_t k, Status filter = Status::Pending, std::optional<ListId> list = std::nullopt,
+                             uint64_t below = UINT64_MAX);
+
+  /**
+   * @brief   Run a filter expression. The plan reads whichever of the status
+   *          partitions, the due-date index, the title index or a full scan is
+   *          expected to touch the fewest rows, then checks the full predicate.
+   * @param   query  Parsed filter.
+   * @param   limit  Maximum number of tasks to return.
+   * @param   plan   Optional out-parameter describing the chosen plan.
+   * @return  Matching tasks in rank order.
+   */
+  std::vector<Task> queryTasks(const TaskQuery &query, size_t limit = SIZE_MAX, QueryPlan *plan = nullptr);
+
+  /**
+   * @brief   Count tasks matching a filter without materialising them.
+   * @param   filter  Status enum to select which tasks to count.
+   * @return  Number of matching tasks.
+   */
+  size_t count(Status filter = Status::All) const;
+
+  /**
+   * @brief   Look up a single task by id.
+   * @param   id  Identifier of the task.
+   * @return  Copy of the task, or nullopt if it does not exist.
+   */
+  std::optional<Task> getTask(int id) const;
+
+  /**
+   * @brief   Change the cap enforced by addTask (defaults to MAX_TASKS).
+   * @param   limit  Maximum number of tasks; a warning is printed at 90%.
+   */
+  void setTaskLimit(size_t limit) {
+    task_limit = limit;
+  }
+
+  /**
+   * @brief   Choose the form the next save writes: block-compressed or plain
+   *          text. Loading a store adopts the form it was saved in.
+   * @param   on  True for the block-compressed form (see block_store.hpp).
+   */
+  void setCompressed(bool on) {
+    compressed = on;
+  }
+
+  /**
+   * @brief   Whether saves write the block-compressed form.
+   */
+  bool isCompressed() const {
+    return compressed;
+  }
+
   /**
    * @brief   Utility: number of tasks in the manager.
-   * @return  Size of the internal task_map.
+   * @return  Number of tasks across all shards.
    */
   size_t size() const {
-    return task_map.size();
+    return task_count;
   }
 
 private:
+  // Number of independently locked partitions of the store.
+  static constexpr size_t kShardCount = 16;
+
   /**
-   * Comparator for priority_queue: higher score = higher priority. No need to guard
+   * Comparator for the rank heap: higher score = higher priority. No need to guard
    * against nullptr because should never push that to heap anyways.
    */
   struct PriorityCmp {
     bool operator()(const Task *a, const Task *b) const noexcept {
-      double score_a = effective_score(*a, kRecentThreshold);
-      double score_b = effective_score(*b, kRecentThreshold);
-      return score_a < score_b; // true when a less important than b
+      return a->sort_key < b->sort_key; // true when a less important than b
     }
   };
 
+  // Statuses a task can actually be in (Status::All is only a filter).
+  static constexpr size_t kStatusCount = static_cast<size_t>(Status::All);
+
+  /**
+   * One partition of the store. Owns its Tasks so uses unique_ptr. by_status
+   * and by_due are secondary indexes for queryTasks, kept under the same lock.
+   */
+  struct Shard {
+    mutable RwLock mtx;
+    std::unordered_map<int, std::unique_ptr<Task>> tasks;
+    std::array<std::unordered_set<int>, kStatusCount> by_status;      //< ids per status
+    std::vector<std::pair<std::chrono::sys_days::rep, int>> by_due; //< (due day, id), sorted
+  };
+
+  /**
+   * One partition of the duplicate-detection set (case-folded title + due).
+   */
+  struct DedupShard {
+    std::mutex mtx;
+    std::unordered_set<std::string> keys;
+  };
+
+  std::array<Shard, kShardCount> shards;
+  std::array<DedupShard, kShardCount> dedup;
+
+  /**
+   * Keeps track of which Task should be completed next, as one binary heap
+   * per list in std::push_heap's layout; each task records its slot
+   * (Task::heap_slot) so it can be dropped or re-ranked in place. Uses raw
+   * pointers because points back to objects owned by the shards. Guarded by
+   * rank_mtx, as is ref_day.
+   */
+  std::unordered_map<ListId, std::vector<Task *>> heaps;
+  mutable RwLock rank_mtx;
+
+  std::chrono::sys_days ref_day{get_today()}; //< Day the sort keys were computed for.
+
+  std::atomic<int> next_id;       //< Next ID to assign.
+  std::atomic<size_t> task_count; //< Tasks across all shards.
+  std::atomic<size_t> task_limit; //< Cap enforced by addTask.
+
+  mutable std::atomic<uint64_t> generation{0}; //< Store generation last loaded or saved.
+  mutable std::atomic<uint64_t> lamport{0};    //< Highest logical time this store has seen.
+
+  Tombstones removed;               //< Uid → logical time of its removal.
+  mutable std::mutex removed_mtx;   //< Guards removed; only dedup locks are taken under it.
+
+  mutable std::unordered_map<int, uint32_t> cold; //< Id → lastChange of tasks already in the archive.
+  mutable size_t archive_records{0};              //< Records in the archive file, superseded included.
+  mutable std::mutex cold_mtx;                    //< Guards cold and archive_records (leaf lock).
+  std::atomic<bool> archive_loaded{false};        //< Set once loadArchive has run.
+
+  std::atomic<bool> compressed{false}; //< Save in the block-compressed form.
+
+  StoreStats counted;           //< Aggregates over the loaded tasks, plus completion history.
+  StoreStats cold_counted;      //< Counts of cold tasks that are not loaded.
+  bool cold_known{true};        //< Whether cold_counted is current.
+  mutable std::mutex stats_mtx; //< Guards the three above (leaf lock).
+
+  mutable std::vector<HistoryEvent> transitions; //< Made since the last save, oldest first.
+  mutable std::mutex history_mtx;                //< Guards transitions (leaf lock).
+
+  TitleIndex title_index; //< Word → ids, self-synchronised (leaf lock).
+
+  /**
+   * Reverse dependency edges: prerequisite id → ids waiting on it. The forward
+   * edges (Task::after) are guarded by each task's shard.
+   */
+  std::unordered_map<int, std::vector<int>> dependents;
+  mutable std::mutex dep_mtx;           //< Guards dependents (leaf lock).
+  std::atomic<size_t> edge_count{0};    //< Unresolved edges; 0 skips all dependency work.
+
+  mutable TrigramIndex fuzzy_index;           //< Trigram → ids, self-synchronised (leaf lock).
+  mutable std::atomic<bool> fuzzy_ready{false}; //< Set once fuzzy_index covers every task.
+  mutable std::mutex fuzzy_build_mtx;           //< Serialises the one-off build (leaf lock).
+
+  Shard &shardFor(int id) { return shards[static_cast<size_t>(id) % kShardCount]; }
+  const Shard &shardFor(int id) const { return shards[static_cast<size_t>(id) % kShardCount]; }
+
+  /**
+   * @brief   Lock every shard in index order.
+   * @tparam  Lock  std::shared_lock<RwLock> or std::unique_lock<RwLock>.
+   */
+  template <typename Lock>
+  std::array<Lock, kShardCount> lockShards() const {
+    std::array<Lock, kShardCount> locks;
+    for (size_t i = 0; i < kShardCount; ++i)
+      locks[i] = Lock(shards[i].mtx);
+    return locks;
+  }
+
+  /**
+   * @brief   Logical time for a change made now: one past anything seen, so it
+   *          wins every field comparison in a later merge.
+   */
+  uint32_t tick() const {
+    return static_cast<uint32_t>(std::min<uint64_t>(lamport + 1, UINT32_MAX));
+  }
+
+  /**
+   * @brief   Make sure next_id is at least `floor`. addTask takes ids without
+   *          any lock, so this never lowers it and never overwrites an id
+   *          handed out in between.
+   */
+  void raiseNextId(int floor) {
+    int seen = next_id.load();
+    while (seen < floor && !next_id.compare_exchange_weak(seen, floor)) {
+    }
+  }
+
+  /**
+   * @brief   Duplicate-detection key: case-folded title, due date and list.
+   */
+  static std::string dedupKey(const std::string &title, const std::optional<ymd> &due, ListId list);
+
+  /**
+   * @brief   Atomically claim a dedup key.
+   * @return  False if another task already holds it.
+   */
+  bool reserveTitle(const std::string &key);
+
+  /**
+   * @brief   Give a dedup key back (task removed or insert rolled back).
+   */
+  void releaseTitle(const std::string &key);
+
+  /**
+   * @brief   Build the trigram index from every shard unless already built.
+   *          Only `find` and `add` warnings need it, so loads skip the cost.
+   */
+  void ensureFuzzyIndex() const;
+
+  /**
+   * @brief   Key a task and push it onto the rank heap. Caller holds its shard.
+   */
+  void pushRanked(Task *task);
+
+  /**
+   * @brief   Take a task off the rank heap if it is there. Caller holds its shard.
+   */
+  void dropRanked(Task *task);
+
+  /**
+   * @brief   Re-key a task after its priority or due date changed and move it
+   *          to its new heap position (O(log n)). Caller holds its shard.
+   */
+  void rerank(Task *task);
+
+  /**
+   * @brief   Erase a finished or removed task from its dependents' `after`
+   *          lists and push any that become ready. Takes every lock.
+   */
+  void resolveDependents(int id);
+
+  /**
+   * @brief   Whether prereq already (transitively) waits on id. Caller holds
+   *          every shard.
+   */
+  bool dependsOn(int prereq, int id) const;
+
   /**
-   * Stores each Task. Owns them so uses unique_ptr.
+   * @brief   Heapify every unblocked task in the shards from scratch (O(n)).
+   *          Caller holds every shard and rank_mtx.
    */
-  std::unordered_map<int, std::unique_ptr<Task>> task_map;
+  void rebuildHeap();
 
   /**
-   * Keeps track of which Task should be completed next.
-   * Uses raw pointers because points back to objects owned by map.
+   * @brief   Recompute every sort key against a day and rebuild the heap.
+   *          Caller holds every shard and rank_mtx exclusively.
    */
-  std::priority_queue<Task *, std::vector<Task *>, PriorityCmp> task_heap;
+  void rekeyAll(std::chrono::sys_days today);
 
-  int next_id; //< Next ID to assign.
+  /**
+   * @brief   Re-rank if the calendar day moved on since keys were computed.
+   */
+  void refreshIfDayChanged();
+
+  /**
+   * @brief   Check whether a task passes a Status filter.
+   */
+  static bool matches(const Task &task, Status filter) {
+    return filter == Status::All || task.state == filter;
+  }
+
+  /**
+   * @brief   Move a task between status partitions and their counts. Caller
+   *          holds the shard.
+   */
+  void setState(Shard &shard, Task &task, Status state);
+
+  /**
+   * @brief   Count a task into (+1) or out of (-1) the aggregates.
+   */
+  void tally(const Task &task, int sign);
+
+  /**
+   * @brief   Stamp a transition for the history; the next save appends it.
+   */
+  void record(const Task &task, HistoryKind kind, bool open);
+
+  /**
+   * @brief   Append the recorded transitions to the store's history file.
+   *          Caller holds the exclusive StoreLock.
+   */
+  void flushHistory(const std::string &filename) const;
+
+  /**
+   * @brief   tasks.json.stats contents for a save: the aggregates as they are
+   *          now, with the cold tier's counts as that save leaves it.
+   * @param   generation  Generation being written; 0 if the counts are unknown.
+   * @param   cold        Counts of every task in the archive after the save.
+   */
+  SavedStats savedStats(uint64_t generation, StoreStats cold) const;
+
+  /**
+   * @brief   Add or drop a task's entry in its shard's due-date index.
+   */
+  static void indexDue(Shard &shard, const Task &task);
+  static void unindexDue(Shard &shard, const Task &task);
+
+  /**
+   * @brief   Plan and run a query; caller holds every shard and rank_mtx
+   *          (shared is enough).
+   */
+  std::vector<Task> runQuery(const TaskQuery &query, size_t limit, QueryPlan &plan) const;
+
+  /**
+   * @brief   Collect the top K matches from one list's heap or, merged, from
+   *          every list's; caller holds every shard and rank_mtx (shared is
+   *          enough).
+   */
+  std::vector<Task> collectTop(size_t k, Status filter, std::optional<ListId> list, uint64_t below) const;
+
+  /**
+   * @brief   Low-level insert that assumes validation is done. Counts it into
+   *          the aggregates but does not touch the heap or task_count.
+   * @param   shard  Shard owning task->id, held exclusively by the caller.
+   * @param   task   Fully built task.
+   * @return  Pointer to the stored task, or nullptr on id collision.
+   */
+  Task *insertTaskUnchecked(Shard &shard, std::unique_ptr<Task> task);
+
+  /**
+   * @brief   Unlink a task from its shard, status partition, aggregates and
+   *          title indexes.
+   *          Caller holds every shard and rank_mtx and rebuilds the heaps,
+   *          due index and edges afterwards.
+   * @param   task      Task to erase (freed on return).
+   * @param   owns_key  Whether its dedup key is reserved for it.
+   */
+  void eraseUnlocked(Task *task, bool owns_key);
+
+  /**
+   * @brief   pushRanked and dropRanked for a caller already holding rank_mtx.
+   */
+  void pushRankedUnlocked(Task *task);
+  void dropRankedUnlocked(Task *task);
+
+  /**
+   * @brief   Task holding a dedup key, other than `except`. Caller holds every
+   *          shard.
+   */
+  Task *ownerOf(const std::string &key, const std::string &title, const Task *except) const;
+
+  /**
+   * @brief   Read and parse a whole store in record-aligned chunks, one per
+   *          thread, under the shared StoreLock, with its edit journal folded in.
+   * @param   filename    Path to JSON file.
+   * @param   threads     Parser threads; 0 picks one per core for large files.
+   * @param   header      (out) The store's header.
+   * @param   tombstones  (out) Its removed-task tombstones.
+   * @return  Parsed tasks, or nullopt if the file is missing.
+   */
+  static std::optional<std::vector<std::unique_ptr<Task>>> readStore(const std::string &filename, unsigned threads,
+                                                                     StoreHeader &header, Tombstones &tombstones);
 
   /**
-   * @brief   Low-level insert that assumes validation is done.
-   * @param   id      Task ID.
-   * @param   title   Task title.
-   * @param   pr      Priority.
-   * @param   due     Optional due date.
-   * @return  ID on success or FXN_FAILURE.
+   * @brief   Write the store and its sidecars as a given generation. Caller
+   *          holds the exclusive StoreLock.
    */
-  int insertTaskUnchecked(int id, const std::string &title, Priority pr, std::optional<ymd> due);
+  bool writeStore(const std::string &filename, uint64_t next_generation) const;
 
   /**
-   * @brief   Format a single task’s due/status column.
-   * @param   task   Pointer to the Task.
-   * @param   today  Date for overdue calculations.
-   * @return  Formatted string fragment.
+   * @brief   Insert a batch of parsed tasks under every lock, then key and
+   *          heapify once instead of pushing per task.
+   * @param   batch  Tasks to take ownership of.
    */
-  std::string formatDue(const Task *task, const ymd &today) const;
+  void adoptTasks(std::vector<std::unique_ptr<Task>> batch);
 };
\ No newline at end of file
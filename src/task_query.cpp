@@ -0,0 +1,205 @@
+/**
+ * @file    task_query.cpp
+ * @brief   Implements term parsing and predicate evaluation for TaskQuery.
+ */
+
+#include "task_query.hpp"
+#include "title_index.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+enum class Op { Eq,
+                Lt,
+                Le,
+                Gt,
+                Ge };
+
+/**
+ * @brief  Split "key<op>value" at the first operator character.
+ */
+bool split_term(const string &term, string &key, Op &op, string &value) {
+  size_t pos = term.find_first_of(":=<>~");
+  if (pos == string::npos || pos == 0)
+    return false;
+
+  key = term.substr(0, pos);
+  transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return char(tolower(c)); });
+
+  size_t len = 1;
+  switch (term[pos]) {
+  case '<':
+    op = term.compare(pos, 2, "<=") == 0 ? (len = 2, Op::Le) : Op::Lt;
+    break;
+  case '>':
+    op = term.compare(pos, 2, ">=") == 0 ? (len = 2, Op::Ge) : Op::Gt;
+    break;
+  default: // ':', '=' and '~' all compare for equality / containment
+    op = Op::Eq;
+  }
+  value = term.substr(pos + len);
+  transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return char(tolower(c)); });
+  return !value.empty();
+}
+
+optional<Priority> priority_of(const string &s) {
+  if (s == "low")
+    return Priority::Low;
+  if (s == "med" || s == "medium")
+    return Priority::Medium;
+  if (s == "high")
+    return Priority::High;
+  if (s == "crit" || s == "critical")
+    return Priority::Critical;
+  return nullopt;
+}
+
+optional<sys_days> date_of(const string &s) {
+  int y, m, d;
+  if (sscanf(s.c_str(), "%d-%d-%d", &y, &m, &d) != 3)
+    return nullopt;
+  ymd date{year{y}, month{unsigned(m)}, day{unsigned(d)}};
+  return date.ok() ? optional{sys_days{date}} : nullopt;
+}
+
+/**
+ * @brief  Narrow the inclusive range [lo, hi] by one comparison against v.
+ *         An impossible combination leaves lo > hi, which matches nothing.
+ */
+void narrow(long long &lo, long long &hi, Op op, long long v) {
+  switch (op) {
+  case Op::Eq:
+    lo = max(lo, v);
+    hi = min(hi, v);
+    break;
+  case Op::Lt:
+    hi = min(hi, v - 1);
+    break;
+  case Op::Le:
+    hi = min(hi, v);
+    break;
+  case Op::Gt:
+    lo = max(lo, v + 1);
+    break;
+  case Op::Ge:
+    lo = max(lo, v);
+    break;
+  }
+}
+
+} // namespace
+
+bool TaskQuery::isTerm(const string &arg) {
+  return !arg.empty() && arg[0] != '-' && arg.find_first_of(":=<>~") != string::npos;
+}
+
+bool TaskQuery::addTerm(const string &term, string &error) {
+  string key, value;
+  Op op;
+  if (!split_term(term, key, op, value)) {
+    error = "Malformed filter '" + term + "'.";
+    return false;
+  }
+
+  if (key == "status") {
+    if (op != Op::Eq) {
+      error = "status only supports ':'.";
+      return false;
+    }
+    if (value == "pending")
+      status = Status::Pending;
+    else if (value == "completed" || value == "done")
+      status = Status::Completed;
+    else if (value == "archived")
+      status = Status::Archived;
+    else if (value == "all")
+      status = nullopt;
+    else {
+      error = "Unknown status '" + value + "'.";
+      return false;
+    }
+  } else if (key == "pr" || key == "priority") {
+    optional<Priority> pr = priority_of(value);
+    if (!pr) {
+      error = "Unknown priority '" + value + "'.";
+      return false;
+    }
+    long long lo = static_cast<int>(pr_lo), hi = static_cast<int>(pr_hi);
+    narrow(lo, hi, op, static_cast<int>(*pr));
+    pr_lo = static_cast<Priority>(lo);
+    pr_hi = static_cast<Priority>(hi);
+  } else if (key == "due") {
+    if (value == "none" && op == Op::Eq) {
+      due_none = true;
+      return true;
+    }
+    optional<sys_days> date = date_of(value);
+    if (!date) {
+      error = "Due date must be YYYY-MM-DD or 'none'.";
+      return false;
+    }
+    long long lo = due_lo ? due_lo->time_since_epoch().count() : INT32_MIN;
+    long long hi = due_hi ? due_hi->time_since_epoch().count() : INT32_MAX;
+    narrow(lo, hi, op, date->time_since_epoch().count());
+    due_lo = sys_days{days{lo}};
+    due_hi = sys_days{days{hi}};
+  } else if (key == "blocked") {
+    if (value == "yes" || value == "true")
+      blocked = true;
+    else if (value == "no" || value == "false")
+      blocked = false;
+    else if (value == "any")
+      blocked = nullopt;
+    else {
+      error = "blocked takes yes, no or any.";
+      return false;
+    }
+  } else if (key == "list") {
+    if (op != Op::Eq) {
+      error = "list only supports ':'.";
+      return false;
+    }
+    list = intern_list(value);
+  } else if (key == "title") {
+    for (auto &token : TitleIndex::tokenize(value))
+      title_prefixes.push_back(token);
+  } else {
+    error = "Unknown field '" + key + "'.";
+    return false;
+  }
+  return true;
+}
+
+bool TaskQuery::matches(const Task &task) const {
+  if (status && task.state != *status)
+    return false;
+  if (task.pr < pr_lo || task.pr > pr_hi)
+    return false;
+  if (blocked && task.blocked() != *blocked)
+    return false;
+  if (list && task.list != *list)
+    return false;
+
+  if (due_none && task.due.has_value())
+    return false;
+  if (hasDueRange()) {
+    if (!task.due.has_value())
+      return false;
+    sys_days due{*task.due};
+    if ((due_lo && due < *due_lo) || (due_hi && due > *due_hi))
+      return false;
+  }
+
+  if (!title_prefixes.empty()) {
+    vector<string> words = TitleIndex::tokenize(task.title);
+    for (const string &prefix : title_prefixes)
+      if (none_of(words.begin(), words.end(), [&](const string &w) { return w.starts_with(prefix); }))
+        return false;
+  }
+  return true;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file    task_query.hpp
+ * @brief   Filter expressions for `todo list`, parsed once into a predicate.
+ *
+ * A query is a list of terms that must all hold:
+ *
+ *   status:<pending|completed|archived|all>
+ *   pr<op><low|med|high|crit>        op is one of : = < <= > >=
+ *   due<op>YYYY-MM-DD  or  due:none
+ *   title~<text>                     every word of text starts a title word
+ *   blocked:<yes|no|any>             waiting on a prerequisite (default no)
+ *   list:<name>                      only tasks in that named list
+ *
+ * TaskManager::queryTasks turns the parsed query into a plan that reads from
+ * the narrowest available index before checking the full predicate.
+ */
+
+#pragma once
+#include "task.hpp"
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct TaskQuery {
+  std::optional<Status> status{Status::Pending}; //< nullopt matches every status.
+  Priority pr_lo{Priority::Low};                //< Inclusive priority bounds.
+  Priority pr_hi{Priority::Critical};
+  std::optional<std::chrono::sys_days> due_lo; //< Inclusive due bounds; either
+  std::optional<std::chrono::sys_days> due_hi; //< one requires a due date.
+  bool due_none{false};                        //< Only tasks without a due date.
+  std::vector<std::string> title_prefixes;     //< Case-folded word prefixes.
+  std::optional<bool> blocked{false};          //< nullopt matches either.
+  std::optional<ListId> list;                  //< nullopt matches every list.
+
+  /**
+   * @brief   Parse one term and narrow the query by it.
+   * @param   term   e.g. "pr>=high".
+   * @param   error  Set to a message when the term is rejected.
+   * @return  True if the term was understood.
+   */
+  bool addTerm(const std::string &term, std::string &error);
+
+  /**
+   * @brief   Whether any due bound is set.
+   */
+  bool hasDueRange() const { return due_lo.has_value() || due_hi.has_value(); }
+
+  /**
+   * @brief   Evaluate the whole predicate against one task.
+   */
+  bool matches(const Task &task) const;
+
+  /**
+   * @brief   Whether an argument looks like a query term rather than a flag.
+   */
+  static bool isTerm(const std::string &arg);
+};
+
+/**
+ * @struct QueryPlan
+ * @brief  What queryTasks chose and how much work it did, for `--explain`.
+ */
+struct QueryPlan {
+  std::string access;                                       //< Chosen access path.
+  size_t estimate{0};                                       //< Rows it was expected to read.
+  std::vector<std::pair<std::string, size_t>> alternatives; //< Other paths and their estimates.
+  size_t examined{0};                                       //< Rows the predicate ran on.
+  size_t matched{0};                                        //< Rows that passed.
+};
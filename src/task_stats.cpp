@@ -0,0 +1,85 @@
+/**
+ * @file    task_stats.cpp
+ * @brief   Implements the O(1) updates and the day-relative reads of StoreStats.
+ */
+
+#include "task_stats.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+/**
+ * @brief  Add to a per-day count, dropping the entry when it reaches zero.
+ */
+void bump(map<StoreStats::Day, size_t> &days, StoreStats::Day day, int sign) {
+  if (sign > 0) {
+    ++days[day];
+    return;
+  }
+  auto it = days.find(day);
+  if (it != days.end() && --it->second == 0)
+    days.erase(it);
+}
+
+} // namespace
+
+void StoreStats::tally(const Task &task, int sign) {
+  size_t &cell = counts[static_cast<size_t>(task.state)][static_cast<size_t>(task.pr)];
+  cell = sign > 0 ? cell + 1 : cell - (cell > 0);
+  if (task.state == Status::Pending && task.due.has_value())
+    bump(due, sys_days{task.due.value()}.time_since_epoch().count(), sign);
+}
+
+void StoreStats::completed(sys_days on, int sign) {
+  bump(done, on.time_since_epoch().count(), sign);
+}
+
+void StoreStats::trim(sys_days today) {
+  done.erase(done.begin(), done.lower_bound((today - days{kThroughputDays - 1}).time_since_epoch().count()));
+}
+
+size_t StoreStats::total(Status state) const {
+  size_t sum = 0;
+  for (size_t n : counts[static_cast<size_t>(state)])
+    sum += n;
+  return sum;
+}
+
+size_t StoreStats::overdue(sys_days today) const {
+  size_t sum = 0;
+  for (auto it = due.begin(); it != due.end() && it->first < today.time_since_epoch().count(); ++it)
+    sum += it->second;
+  return sum;
+}
+
+array<size_t, kDueWeeks + 2> StoreStats::dueByWeek(sys_days today) const {
+  array<size_t, kDueWeeks + 2> weeks{};
+  Day from = today.time_since_epoch().count();
+  for (const auto &[day, n] : due) {
+    if (day < from)
+      weeks[0] += n;
+    else
+      weeks[min<size_t>(static_cast<size_t>((day - from) / 7), kDueWeeks) + 1] += n;
+  }
+  return weeks;
+}
+
+size_t StoreStats::completedWithin(sys_days today, int days) const {
+  size_t sum = 0;
+  for (auto it = done.lower_bound((today - chrono::days{days - 1}).time_since_epoch().count()); it != done.end(); ++it)
+    sum += it->second;
+  return sum;
+}
+
+StoreStats &StoreStats::operator+=(const StoreStats &other) {
+  for (size_t s = 0; s < kStatStatuses; ++s)
+    for (size_t p = 0; p < kStatPriorities; ++p)
+      counts[s][p] += other.counts[s][p];
+  for (const auto &[day, n] : other.due)
+    due[day] += n;
+  for (const auto &[day, n] : other.done)
+    done[day] += n;
+  return *this;
+}
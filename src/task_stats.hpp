@@ -0,0 +1,82 @@
+/**
+ * @file    task_stats.hpp
+ * @brief   Aggregate counts behind `todo stats`, kept up to date as tasks change.
+ *
+ * Every mutation adds or takes away one task's contribution, so a count never
+ * needs a scan: status × priority is a fixed table, and due dates and
+ * completions are counted per day in ordered maps whose size is the number of
+ * distinct days, not tasks. Anything relative to today (overdue, this week)
+ * is read off those maps when asked.
+ */
+
+#pragma once
+#include "task.hpp"
+#include <array>
+#include <chrono>
+#include <map>
+
+// Statuses a task can be in (Status::All is only a filter).
+static constexpr size_t kStatStatuses = static_cast<size_t>(Status::All);
+// Priority levels.
+static constexpr size_t kStatPriorities = static_cast<size_t>(Priority::Critical) + 1;
+// Weeks ahead shown one by one in the due-date histogram; later ones are summed.
+static constexpr size_t kDueWeeks = 4;
+// Days of completion history kept for the throughput figures.
+static constexpr int kThroughputDays = 30;
+
+/**
+ * @struct StoreStats
+ * @brief  Counts over a set of tasks, updated one task at a time.
+ */
+struct StoreStats {
+  using Day = std::chrono::sys_days::rep;
+  using Counts = std::array<std::array<size_t, kStatPriorities>, kStatStatuses>;
+
+  Counts counts{};           //< Tasks per status, then priority.
+  std::map<Day, size_t> due; //< Pending tasks by due day.
+  std::map<Day, size_t> done; //< Completions by the day they were made.
+
+  /**
+   * @brief  Count a task in (sign +1) or out (sign -1). Only its status,
+   *         priority and due date matter.
+   */
+  void tally(const Task &task, int sign);
+
+  /**
+   * @brief  Record that a task was completed (+1) or un-completed (-1) on a day.
+   */
+  void completed(std::chrono::sys_days on, int sign);
+
+  /**
+   * @brief  Forget completions older than kThroughputDays before today.
+   */
+  void trim(std::chrono::sys_days today);
+
+  /**
+   * @brief  Tasks with a status, any priority.
+   */
+  size_t total(Status state) const;
+
+  /**
+   * @brief  Pending tasks due before today.
+   */
+  size_t overdue(std::chrono::sys_days today) const;
+
+  /**
+   * @brief  Pending tasks bucketed by due week: overdue, then kDueWeeks weeks
+   *         starting today, then everything later.
+   */
+  std::array<size_t, kDueWeeks + 2> dueByWeek(std::chrono::sys_days today) const;
+
+  /**
+   * @brief  Completions made in the last `days` days, today included.
+   */
+  size_t completedWithin(std::chrono::sys_days today, int days) const;
+
+  /**
+   * @brief  Add another set's counts (e.g. the unloaded cold tier's).
+   */
+  StoreStats &operator+=(const StoreStats &other);
+
+  bool operator==(const StoreStats &) const = default;
+};
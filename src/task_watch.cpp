@@ -0,0 +1,94 @@
+/**
+ * @file    task_watch.cpp
+ * @brief   Implements reminder scheduling on the timer wheel.
+ */
+
+#include "task_watch.hpp"
+#include <algorithm>
+#include <unordered_set>
+
+using namespace std;
+using namespace std::chrono;
+
+int64_t due_deadline(const ymd &due) {
+  return duration_cast<seconds>((sys_days{due} + days{1}).time_since_epoch()).count();
+}
+
+DueWatcher::DueWatcher(vector<int64_t> leads, int64_t now) : leads(std::move(leads)), wheel(now) {
+  erase_if(this->leads, [](int64_t lead) { return lead <= 0; });
+  sort(this->leads.begin(), this->leads.end(), greater<>());
+  this->leads.erase(unique(this->leads.begin(), this->leads.end()), this->leads.end());
+  if (this->leads.size() > kMaxReminders)
+    this->leads.resize(kMaxReminders);
+  this->leads.push_back(0);
+}
+
+/**
+ * @brief  Leads are in descending order, so fire times ascend; of those
+ *         already past only the last is kept, and the wheel fires it on the
+ *         next advance.
+ */
+bool DueWatcher::track(const Task &task) {
+  if (task.state != Status::Pending || !task.due.has_value())
+    return forget(task.id);
+
+  auto [it, fresh] = watched.try_emplace(task.id);
+  Watched &entry = it->second;
+  entry.title = task.title;
+  entry.pr = task.pr;
+  if (!fresh && entry.due == *task.due)
+    return false;
+
+  for (TimerWheel::Handle handle : entry.timers)
+    wheel.cancel(handle);
+  entry.timers.clear();
+  entry.due = *task.due;
+
+  int64_t deadline = due_deadline(*task.due), now = wheel.now();
+  size_t first = 0;
+  while (first + 1 < leads.size() && deadline - leads[first + 1] < now)
+    ++first;
+  for (size_t i = first; i < leads.size(); ++i) {
+    uint64_t payload = static_cast<uint64_t>(static_cast<uint32_t>(task.id)) << 8 | i;
+    entry.timers.push_back(wheel.schedule(deadline - leads[i], payload));
+  }
+  return true;
+}
+
+bool DueWatcher::forget(int id) {
+  auto it = watched.find(id);
+  if (it == watched.end())
+    return false;
+  for (TimerWheel::Handle handle : it->second.timers)
+    wheel.cancel(handle);
+  watched.erase(it);
+  return true;
+}
+
+size_t DueWatcher::sync(const vector<Task> &pending) {
+  size_t changed = 0;
+  unordered_set<int> seen;
+  seen.reserve(pending.size());
+  for (const Task &task : pending) {
+    seen.insert(task.id);
+    changed += track(task);
+  }
+  vector<int> gone;
+  for (const auto &[id, entry] : watched)
+    if (!seen.contains(id))
+      gone.push_back(id);
+  for (int id : gone)
+    changed += forget(id);
+  return changed;
+}
+
+void DueWatcher::advance(int64_t now, const function<void(const DueEvent &)> &emit) {
+  wheel.advance(now, [&](uint64_t payload, int64_t when) {
+    auto id = static_cast<int>(static_cast<uint32_t>(payload >> 8));
+    auto it = watched.find(id);
+    if (it == watched.end())
+      return;
+    const Watched &entry = it->second;
+    emit({id, entry.title, entry.pr, entry.due, leads[payload & 0xff], when});
+  });
+}
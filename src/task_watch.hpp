@@ -0,0 +1,107 @@
+/**
+ * @file    task_watch.hpp
+ * @brief   Due-date reminders for `todo watch`, kept in a TimerWheel.
+ *
+ * A pending task with a due date is overdue once its due day has ended (the
+ * same rule as is_overdue). Each tracked task holds one timer for that
+ * deadline and one per reminder lead before it. Adding, rescheduling or
+ * finishing a task cancels and schedules only that task's timers, so nothing
+ * is rescanned as time passes.
+ */
+
+#pragma once
+#include "task.hpp"
+#include "timer_wheel.hpp"
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Most reminder leads per task (the payload keeps the lead's index in a byte).
+static constexpr size_t kMaxReminders = 16;
+
+/**
+ * @struct DueEvent
+ * @brief  One reminder or deadline that came up.
+ */
+struct DueEvent {
+  int id{0};
+  std::string title;
+  Priority pr{Priority::Medium};
+  ymd due;
+  int64_t lead{0}; //< Seconds before the deadline it was set for; 0 means overdue.
+  int64_t at{0};   //< When it was set to fire (Unix seconds); earlier than now
+                   //< for one already past when the task was tracked.
+};
+
+/**
+ * @brief   Unix second at which a task due on a day becomes overdue.
+ */
+int64_t due_deadline(const ymd &due);
+
+class DueWatcher {
+public:
+  /**
+   * @brief  Watch nothing yet.
+   * @param  leads  Reminder offsets in seconds before each deadline (at most
+   *                kMaxReminders; zero and duplicates are ignored).
+   * @param  now    Current Unix second.
+   */
+  DueWatcher(std::vector<int64_t> leads, int64_t now);
+
+  /**
+   * @brief  Start, update or stop watching a task. A pending task with a due
+   *         date gets timers for its deadline and reminders (only the latest
+   *         one already passed, which fires at once); anything else is
+   *         forgotten. A task whose due date did not change keeps its timers.
+   * @return True if timers were scheduled or cancelled.
+   */
+  bool track(const Task &task);
+
+  /**
+   * @brief  Stop watching a task, cancelling its timers.
+   * @return False if it was not watched.
+   */
+  bool forget(int id);
+
+  /**
+   * @brief  Make the watched set match the given pending tasks: track each
+   *         one and forget watched tasks that are missing.
+   * @return Tasks whose timers changed.
+   */
+  size_t sync(const std::vector<Task> &pending);
+
+  /**
+   * @brief  Report every reminder and deadline up to a time, in time order.
+   * @param  now   Current Unix second.
+   * @param  emit  Called once per event.
+   */
+  void advance(int64_t now, const std::function<void(const DueEvent &)> &emit);
+
+  /**
+   * @brief  Unix second of the next possible event (INT64_MAX if none).
+   */
+  int64_t nextWake() const { return wheel.nextWake(); }
+
+  /**
+   * @brief  Tasks watched.
+   */
+  size_t size() const { return watched.size(); }
+
+  /**
+   * @brief  Timers pending.
+   */
+  size_t timers() const { return wheel.size(); }
+
+private:
+  struct Watched {
+    ymd due;
+    std::string title;
+    Priority pr{Priority::Medium};
+    std::vector<TimerWheel::Handle> timers;
+  };
+
+  std::vector<int64_t> leads; //< Descending, ending with 0 for the deadline itself.
+  TimerWheel wheel;
+  std::unordered_map<int, Watched> watched;
+};
@@ -0,0 +1,191 @@
+/**
+ * @file    timer_wheel.cpp
+ * @brief   Implements the slot lists, the cascade and the skip over empty
+ *          stretches of the wheel.
+ */
+
+#include "timer_wheel.hpp"
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+namespace {
+
+constexpr int64_t span_of(size_t level) {
+  return int64_t{1} << (kWheelBits * level);
+}
+
+constexpr uint32_t slot_of(size_t level, int64_t when) {
+  return static_cast<uint32_t>(level * kWheelSlots + static_cast<size_t>((when >> (kWheelBits * level)) & (kWheelSlots - 1)));
+}
+
+} // namespace
+
+TimerWheel::TimerWheel(int64_t now) : current(now) {
+  heads.fill(kNone);
+}
+
+TimerWheel::Handle TimerWheel::schedule(int64_t when, uint64_t payload) {
+  uint32_t index = free_head;
+  if (index != kNone) {
+    free_head = nodes[index].next;
+  } else {
+    index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+  }
+  Node &node = nodes[index];
+  node.when = when;
+  node.payload = payload;
+  link(index);
+  ++live;
+  return static_cast<Handle>(node.gen) << 32 | index;
+}
+
+bool TimerWheel::cancel(Handle handle) {
+  auto index = static_cast<uint32_t>(handle);
+  if (index >= nodes.size() || nodes[index].gen != handle >> 32 || nodes[index].slot == kNone)
+    return false;
+  unlink(index);
+  release(index);
+  --live;
+  return true;
+}
+
+/**
+ * @brief  The level is the lowest whose slot span covers every bit in which
+ *         the tick differs from the current one; timers past the top level's
+ *         reach wrap around and are re-placed when their slot comes up.
+ */
+void TimerWheel::link(uint32_t index) {
+  Node &node = nodes[index];
+  int64_t when = node.when;
+  if (when < current) {
+    node.slot = kLate;
+    node.prev = kNone;
+    node.next = heads[kLate];
+    if (node.next != kNone)
+      nodes[node.next].prev = index;
+    heads[kLate] = index;
+    return;
+  }
+  uint64_t differ = static_cast<uint64_t>(when ^ current);
+  size_t level = 0;
+  while (level + 1 < kWheelLevels && (differ >> (kWheelBits * (level + 1))) != 0)
+    ++level;
+
+  uint32_t slot = slot_of(level, when);
+  node.slot = slot;
+  node.prev = kNone;
+  node.next = heads[slot];
+  if (node.next != kNone)
+    nodes[node.next].prev = index;
+  heads[slot] = index;
+  ++per_level[level];
+}
+
+void TimerWheel::unlink(uint32_t index) {
+  Node &node = nodes[index];
+  if (node.prev != kNone)
+    nodes[node.prev].next = node.next;
+  else
+    heads[node.slot] = node.next;
+  if (node.next != kNone)
+    nodes[node.next].prev = node.prev;
+  if (node.slot != kLate)
+    --per_level[node.slot / kWheelSlots];
+  node.slot = kNone;
+}
+
+uint32_t TimerWheel::take(uint32_t slot) {
+  uint32_t first = heads[slot];
+  heads[slot] = kNone;
+  size_t count = 0;
+  for (uint32_t index = first; index != kNone; index = nodes[index].next) {
+    nodes[index].slot = kNone;
+    ++count;
+  }
+  if (slot != kLate)
+    per_level[slot / kWheelSlots] -= count;
+  return first;
+}
+
+void TimerWheel::release(uint32_t index) {
+  Node &node = nodes[index];
+  node.slot = kNone;
+  ++node.gen;
+  if (node.gen == 0)
+    node.gen = 1;
+  node.next = free_head;
+  free_head = index;
+}
+
+/**
+ * @brief  Ticks with nothing on the levels below a boundary are skipped in
+ *         one step, so an idle hour costs a handful of iterations.
+ */
+void TimerWheel::advance(int64_t now, const function<void(uint64_t, int64_t)> &fire) {
+  vector<pair<uint64_t, int64_t>> due;
+  auto fire_slot = [&](uint32_t slot) {
+    // Free the fired nodes before calling out, so callbacks see a consistent wheel
+    for (uint32_t index = take(slot); index != kNone;) {
+      uint32_t next = nodes[index].next;
+      due.emplace_back(nodes[index].payload, nodes[index].when);
+      release(index);
+      --live;
+      index = next;
+    }
+    for (auto &[payload, when] : due)
+      fire(payload, when);
+    due.clear();
+  };
+  fire_slot(kLate);
+
+  while (current <= now) {
+    // Higher slots starting at this tick drop down first, so a timer can
+    // fall all the way to level 0 and fire below
+    for (size_t level = kWheelLevels - 1; level > 0; --level) {
+      if ((current & (span_of(level) - 1)) != 0 || per_level[level] == 0)
+        continue;
+      for (uint32_t index = take(slot_of(level, current)); index != kNone;) {
+        uint32_t next = nodes[index].next;
+        link(index);
+        index = next;
+      }
+    }
+
+    uint32_t slot = slot_of(0, current++);
+    fire_slot(slot);
+
+    // Jump to the next tick where a non-empty level has a slot boundary
+    size_t empty = 0;
+    while (empty < kWheelLevels && per_level[empty] == 0)
+      ++empty;
+    if (empty == kWheelLevels) {
+      current = max(current, now + 1);
+      break;
+    }
+    if (empty > 0) {
+      int64_t span = span_of(empty);
+      current = min((current + span - 1) & ~(span - 1), now + 1);
+    }
+  }
+}
+
+int64_t TimerWheel::nextWake() const {
+  if (live == 0)
+    return INT64_MAX;
+  if (heads[kLate] != kNone)
+    return current - 1;
+  size_t level = 0;
+  while (per_level[level] == 0)
+    ++level;
+
+  // Slots before the current one on this level were already processed
+  auto first = static_cast<size_t>((current >> (kWheelBits * level)) & (kWheelSlots - 1));
+  int64_t base = current & ~(span_of(level + 1) - 1);
+  for (size_t slot = first; slot < kWheelSlots; ++slot)
+    if (heads[level * kWheelSlots + slot] != kNone)
+      return max(current, base + static_cast<int64_t>(slot) * span_of(level));
+  return base + span_of(level + 1); // wrapped around: next turn of this level
+}
@@ -0,0 +1,120 @@
+/**
+ * @file    timer_wheel.hpp
+ * @brief   Hierarchical timer wheel: O(1) schedule and cancel, and an advance
+ *          whose cost follows the timers that fire, not the time that passed.
+ *
+ * Times are whole ticks (seconds for `todo watch`). Level l has kWheelSlots
+ * slots of kWheelSlots^l ticks each, so kWheelLevels levels cover
+ * kWheelSlots^kWheelLevels ticks (over 2000 years of seconds). A timer sits
+ * in the lowest level whose slot span separates it from the current tick;
+ * when the current tick reaches the start of a slot on a higher level, that
+ * slot's timers drop down a level, and those on level 0 fire.
+ *
+ * Timers scheduled for a tick already processed go on a separate late list
+ * that the next advance fires first.
+ *
+ * Each slot is an intrusive doubly linked list threaded through a node pool,
+ * so cancelling unlinks one node and a handle is just its index plus a
+ * generation that makes stale handles harmless.
+ */
+
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Bits of the tick consumed by each level.
+static constexpr int kWheelBits = 6;
+// Slots per level.
+static constexpr size_t kWheelSlots = size_t{1} << kWheelBits;
+// Levels; together they span kWheelSlots^kWheelLevels ticks.
+static constexpr size_t kWheelLevels = 6;
+
+class TimerWheel {
+public:
+  using Handle = uint64_t; //< Generation (high 32 bits) and node index; never 0.
+
+  /**
+   * @brief  Empty wheel.
+   * @param  now  Current tick; timers at or before it fire on the next advance.
+   */
+  explicit TimerWheel(int64_t now = 0);
+
+  /**
+   * @brief  Add a timer. O(1).
+   * @param  when     Tick to fire at; earlier ticks fire on the next advance.
+   * @param  payload  Passed back when it fires.
+   * @return Handle for cancel().
+   */
+  Handle schedule(int64_t when, uint64_t payload);
+
+  /**
+   * @brief  Remove a timer that has not fired. O(1).
+   * @return False if it already fired or was cancelled.
+   */
+  bool cancel(Handle handle);
+
+  /**
+   * @brief  Fire every timer due at or before a tick, in tick order.
+   * @param  now   Tick reached; earlier ticks than the last advance are ignored.
+   * @param  fire  Called with each timer's payload and tick. It may schedule
+   *               and cancel timers.
+   */
+  void advance(int64_t now, const std::function<void(uint64_t payload, int64_t when)> &fire);
+
+  /**
+   * @brief  Earliest tick at which advance() can have work to do: a timer
+   *         firing, or a slot dropping down a level. INT64_MAX when empty.
+   */
+  int64_t nextWake() const;
+
+  /**
+   * @brief  Timers scheduled and not yet fired or cancelled.
+   */
+  size_t size() const { return live; }
+
+  /**
+   * @brief  Next tick advance() will process.
+   */
+  int64_t now() const { return current; }
+
+private:
+  static constexpr uint32_t kNone = UINT32_MAX;
+  static constexpr uint32_t kLate = kWheelLevels * kWheelSlots; //< Head of the late list.
+
+  struct Node {
+    int64_t when{0};
+    uint64_t payload{0};
+    uint32_t prev{kNone}, next{kNone};
+    uint32_t gen{1};
+    uint32_t slot{kNone}; //< Index into heads, or kNone when free.
+  };
+
+  std::vector<Node> nodes;
+  uint32_t free_head{kNone}; //< Free nodes, chained through next.
+  std::array<uint32_t, kWheelLevels * kWheelSlots + 1> heads;
+  std::array<size_t, kWheelLevels> per_level{}; //< Timers on each level.
+  int64_t current;                               //< Every earlier tick has been processed.
+  size_t live{0};
+
+  /**
+   * @brief  Put a node in the slot its tick belongs to, given the current tick.
+   */
+  void link(uint32_t index);
+
+  /**
+   * @brief  Take a node out of its slot.
+   */
+  void unlink(uint32_t index);
+
+  /**
+   * @brief  Detach a whole slot, returning its first node.
+   */
+  uint32_t take(uint32_t slot);
+
+  /**
+   * @brief  Return a node to the pool; its handle stops working.
+   */
+  void release(uint32_t index);
+};
@@ -0,0 +1,207 @@
+/**
+ * @file    title_index.cpp
+ * @brief   Implements tokenisation, posting-list maintenance and intersection.
+ */
+
+#include "title_index.hpp"
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_set>
+
+using namespace std;
+
+// First line of a saved index: magic followed by the store size it matches.
+static constexpr const char *kSearchMagic = "TSRC";
+
+vector<string> TitleIndex::tokenize(string_view text) {
+  vector<string> tokens;
+  string current;
+
+  auto flush = [&] {
+    if (!current.empty() && find(tokens.begin(), tokens.end(), current) == tokens.end())
+      tokens.push_back(current);
+    current.clear();
+  };
+
+  for (unsigned char c : text) {
+    if (isalnum(c) || c >= 0x80)
+      current += static_cast<char>(tolower(c));
+    else
+      flush();
+  }
+  flush();
+  return tokens;
+}
+
+void TitleIndex::add(int id, string_view title) {
+  unique_lock lock(mtx);
+  for (auto &token : tokenize(title)) {
+    auto &list = postings[token];
+    // Ids are handed out in increasing order, so this is almost always an append
+    if (list.empty() || list.back() < id)
+      list.push_back(id);
+    else if (auto pos = lower_bound(list.begin(), list.end(), id); pos == list.end() || *pos != id)
+      list.insert(pos, id);
+  }
+}
+
+void TitleIndex::addAll(const vector<pair<int, string_view>> &docs) {
+  unique_lock lock(mtx);
+  unordered_set<vector<int> *> touched;
+  for (auto &[id, title] : docs) {
+    for (auto &token : tokenize(title)) {
+      auto &list = postings[token];
+      list.push_back(id);
+      touched.insert(&list);
+    }
+  }
+
+  for (auto *list : touched) {
+    sort(list->begin(), list->end());
+    list->erase(unique(list->begin(), list->end()), list->end());
+  }
+}
+
+void TitleIndex::remove(int id, string_view title) {
+  unique_lock lock(mtx);
+  for (auto &token : tokenize(title)) {
+    auto it = postings.find(token);
+    if (it == postings.end())
+      continue;
+
+    auto &list = it->second;
+    auto pos = lower_bound(list.begin(), list.end(), id);
+    if (pos != list.end() && *pos == id)
+      list.erase(pos);
+    if (list.empty())
+      postings.erase(it);
+  }
+}
+
+/**
+ * @brief  Shortest list first; each further list is probed with a galloping
+ *         lower_bound from the last match, so cost tracks the rarest token.
+ */
+vector<int> TitleIndex::search(string_view query) const {
+  vector<string> tokens = tokenize(query);
+  if (tokens.empty())
+    return {};
+
+  shared_lock lock(mtx);
+  vector<const vector<int> *> lists;
+  for (auto &token : tokens) {
+    auto it = postings.find(token);
+    if (it == postings.end())
+      return {};
+    lists.push_back(&it->second);
+  }
+  sort(lists.begin(), lists.end(), [](auto *a, auto *b) { return a->size() < b->size(); });
+
+  vector<int> result = *lists[0];
+  for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+    const vector<int> &other = *lists[i];
+    auto from = other.begin();
+    size_t kept = 0;
+
+    for (int id : result) {
+      // Gallop: double the step until we reach id, then binary-search that window
+      auto lo = from, hi = from;
+      for (size_t step = 1; hi != other.end() && *hi < id; step *= 2) {
+        lo = hi;
+        hi = static_cast<size_t>(other.end() - hi) > step ? hi + step : other.end();
+      }
+      from = lower_bound(lo, hi, id);
+      if (from == other.end())
+        break;
+      if (*from == id)
+        result[kept++] = id;
+    }
+    result.resize(kept);
+  }
+  return result;
+}
+
+/**
+ * @brief  Walks the vocabulary, which is far smaller than the store.
+ */
+size_t TitleIndex::prefixCount(string_view prefix) const {
+  shared_lock lock(mtx);
+  size_t n = 0;
+  for (auto &[token, list] : postings)
+    if (token.starts_with(prefix))
+      n += list.size();
+  return n;
+}
+
+vector<int> TitleIndex::searchPrefix(string_view prefix) const {
+  vector<int> ids;
+  {
+    shared_lock lock(mtx);
+    for (auto &[token, list] : postings)
+      if (token.starts_with(prefix))
+        ids.insert(ids.end(), list.begin(), list.end());
+  }
+  sort(ids.begin(), ids.end());
+  ids.erase(unique(ids.begin(), ids.end()), ids.end());
+  return ids;
+}
+
+/**
+ * @brief  One line per token: `token count first +delta +delta ...`.
+ */
+bool TitleIndex::save(const string &path, uint64_t store_size) const {
+  ofstream out(path, ios::trunc);
+  if (!out)
+    return false;
+
+  shared_lock lock(mtx);
+  string buf = string(kSearchMagic) + ' ' + std::to_string(store_size) + '\n';
+  for (auto &[token, list] : postings) {
+    buf += token;
+    buf += ' ';
+    buf += std::to_string(list.size());
+    int prev = 0;
+    for (int id : list) {
+      buf += ' ';
+      buf += std::to_string(id - prev);
+      prev = id;
+    }
+    buf += '\n';
+  }
+  out.write(buf.data(), static_cast<streamsize>(buf.size()));
+  return static_cast<bool>(out);
+}
+
+bool TitleIndex::load(const string &path, uint64_t store_size) {
+  ifstream in(path);
+  string magic;
+  uint64_t indexed_size = 0;
+  if (!(in >> magic >> indexed_size) || magic != kSearchMagic || indexed_size != store_size)
+    return false;
+
+  unordered_map<string, vector<int>> loaded;
+  string token;
+  size_t count = 0;
+  while (in >> token >> count) {
+    vector<int> &list = loaded[token];
+    list.resize(count);
+    int prev = 0;
+    for (int &id : list) {
+      if (!(in >> id))
+        return false;
+      id += prev;
+      prev = id;
+    }
+  }
+
+  unique_lock lock(mtx);
+  postings = std::move(loaded);
+  return true;
+}
+
+size_t TitleIndex::terms() const {
+  shared_lock lock(mtx);
+  return postings.size();
+}
@@ -0,0 +1,94 @@
+/**
+ * @file    title_index.hpp
+ * @brief   Inverted index over task titles for `todo search`.
+ *
+ * Titles are split into case-folded alphanumeric tokens; each token maps to a
+ * sorted posting list of task ids. A query returns the ids whose titles
+ * contain every query token, intersecting the shortest lists first.
+ */
+
+#pragma once
+#include "rw_lock.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class TitleIndex {
+public:
+  /**
+   * @brief   Split text into lower-case tokens (ASCII letters/digits, plus any
+   *          non-ASCII byte so UTF-8 words stay whole). Duplicates removed.
+   * @param   text  Title or query.
+   * @return  Distinct tokens in first-seen order.
+   */
+  static std::vector<std::string> tokenize(std::string_view text);
+
+  /**
+   * @brief   Index one title.
+   * @param   id     Task id.
+   * @param   title  Task title.
+   */
+  void add(int id, std::string_view title);
+
+  /**
+   * @brief   Index many titles at once (appends, then sorts each touched list
+   *          once instead of inserting in the middle per id).
+   * @param   docs  (id, title) pairs.
+   */
+  void addAll(const std::vector<std::pair<int, std::string_view>> &docs);
+
+  /**
+   * @brief   Drop one title from the index.
+   * @param   id     Task id.
+   * @param   title  Title it was indexed under.
+   */
+  void remove(int id, std::string_view title);
+
+  /**
+   * @brief   Ids whose titles contain every token of the query.
+   * @param   query  Free text; empty or token-less queries match nothing.
+   * @return  Sorted ids.
+   */
+  std::vector<int> search(std::string_view query) const;
+
+  /**
+   * @brief   Upper bound on ids with a title word starting with prefix (sum of
+   *          the matching posting lists), for query planning.
+   */
+  size_t prefixCount(std::string_view prefix) const;
+
+  /**
+   * @brief   Ids with at least one title word starting with prefix.
+   * @param   prefix  Case-folded word prefix.
+   * @return  Sorted ids.
+   */
+  std::vector<int> searchPrefix(std::string_view prefix) const;
+
+  /**
+   * @brief   Write the index next to the store it describes.
+   * @param   path        Output file.
+   * @param   store_size  Size of the store file, checked again on load.
+   * @return  True on success.
+   */
+  bool save(const std::string &path, uint64_t store_size) const;
+
+  /**
+   * @brief   Replace the contents with a saved index.
+   * @param   path        Index file.
+   * @param   store_size  Current size of the store; a mismatch means stale.
+   * @return  False if missing, malformed or stale.
+   */
+  bool load(const std::string &path, uint64_t store_size);
+
+  /**
+   * @brief   Number of distinct tokens indexed.
+   */
+  size_t terms() const;
+
+private:
+  std::unordered_map<std::string, std::vector<int>> postings;
+  mutable RwLock mtx;
+};
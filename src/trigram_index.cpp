@@ -0,0 +1,174 @@
+/**
+ * @file    trigram_index.cpp
+ * @brief   Implements trigram extraction, posting maintenance and prefix-filtered
+ *          candidate search.
+ */
+
+#include "trigram_index.hpp"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+
+using namespace std;
+
+vector<uint32_t> TrigramIndex::trigrams(string_view text) {
+  vector<uint32_t> grams;
+  string word;
+
+  auto flush = [&] {
+    if (word.empty())
+      return;
+    string padded = "  " + word + " ";
+    for (size_t i = 0; i + 3 <= padded.size(); ++i)
+      grams.push_back((uint32_t(uint8_t(padded[i])) << 16) | (uint32_t(uint8_t(padded[i + 1])) << 8) |
+                      uint32_t(uint8_t(padded[i + 2])));
+    word.clear();
+  };
+
+  for (unsigned char c : text) {
+    if (isalnum(c) || c >= 0x80)
+      word += static_cast<char>(tolower(c));
+    else
+      flush();
+  }
+  flush();
+
+  sort(grams.begin(), grams.end());
+  grams.erase(unique(grams.begin(), grams.end()), grams.end());
+  return grams;
+}
+
+double TrigramIndex::similarity(string_view a, string_view b) {
+  vector<uint32_t> ga = trigrams(a), gb = trigrams(b);
+  if (ga.empty() || gb.empty())
+    return 0.0;
+
+  vector<uint32_t> shared;
+  set_intersection(ga.begin(), ga.end(), gb.begin(), gb.end(), back_inserter(shared));
+  return double(shared.size()) / double(ga.size() + gb.size() - shared.size());
+}
+
+double TrigramIndex::duplicateThreshold(string_view title) {
+  double grams = static_cast<double>(trigrams(title).size());
+  return 1 - (1 - kNearDuplicate) * min(1.0, grams / kShortTitleGrams);
+}
+
+void TrigramIndex::add(int id, string_view title) {
+  vector<uint32_t> grams = trigrams(title);
+  unique_lock lock(mtx);
+  for (uint32_t g : grams) {
+    auto &list = postings[g];
+    if (list.empty() || list.back() < id)
+      list.push_back(id);
+    else if (auto pos = lower_bound(list.begin(), list.end(), id); pos == list.end() || *pos != id)
+      list.insert(pos, id);
+  }
+  sizes[id] = static_cast<uint32_t>(grams.size());
+}
+
+void TrigramIndex::addAll(const vector<pair<int, string_view>> &docs) {
+  unique_lock lock(mtx);
+  for (auto &[id, title] : docs) {
+    vector<uint32_t> grams = trigrams(title);
+    for (uint32_t g : grams)
+      postings[g].push_back(id);
+    sizes[id] = static_cast<uint32_t>(grams.size());
+  }
+
+  for (auto &[g, list] : postings) {
+    if (!is_sorted(list.begin(), list.end())) {
+      sort(list.begin(), list.end());
+      list.erase(unique(list.begin(), list.end()), list.end());
+    }
+  }
+}
+
+void TrigramIndex::remove(int id, string_view title) {
+  unique_lock lock(mtx);
+  for (uint32_t g : trigrams(title)) {
+    auto it = postings.find(g);
+    if (it == postings.end())
+      continue;
+
+    auto &list = it->second;
+    auto pos = lower_bound(list.begin(), list.end(), id);
+    if (pos != list.end() && *pos == id)
+      list.erase(pos);
+    if (list.empty())
+      postings.erase(it);
+  }
+  sizes.erase(id);
+}
+
+/**
+ * @brief  Candidates come only from the rarest query trigrams; every other
+ *         trigram is checked per candidate by binary search.
+ */
+vector<FuzzyMatch> TrigramIndex::match(string_view query, double threshold, size_t limit,
+                                       FuzzyMetric metric) const {
+  vector<uint32_t> grams = trigrams(query);
+  if (grams.empty() || limit == 0)
+    return {};
+
+  shared_lock lock(mtx);
+
+  // Posting lists for the query, rarest first (missing trigrams are empty)
+  static const vector<int> kEmpty;
+  vector<const vector<int> *> lists;
+  for (uint32_t g : grams) {
+    auto it = postings.find(g);
+    lists.push_back(it == postings.end() ? &kEmpty : &it->second);
+  }
+  sort(lists.begin(), lists.end(), [](auto *a, auto *b) { return a->size() < b->size(); });
+
+  size_t q = grams.size();
+  size_t min_shared = max<size_t>(1, static_cast<size_t>(ceil(threshold * q)));
+  size_t prefix = q - min_shared + 1;
+
+  // Any title reaching min_shared must appear in at least one prefix list
+  vector<int> candidates;
+  for (size_t i = 0; i < prefix; ++i)
+    candidates.insert(candidates.end(), lists[i]->begin(), lists[i]->end());
+  sort(candidates.begin(), candidates.end());
+  candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+  last_candidates.store(candidates.size(), memory_order_relaxed);
+
+  vector<pair<FuzzyMatch, double>> hits; // hit + Jaccard for tie-breaks
+  for (int id : candidates) {
+    size_t shared = 0;
+    for (size_t i = 0; i < q; ++i) {
+      shared += binary_search(lists[i]->begin(), lists[i]->end(), id);
+      // Stop early once the remaining lists cannot lift it to min_shared
+      if (shared + (q - i - 1) < min_shared)
+        break;
+    }
+    if (shared < min_shared)
+      continue;
+
+    double jaccard = double(shared) / double(q + sizes.at(id) - shared);
+    double score = metric == FuzzyMetric::Jaccard ? jaccard : double(shared) / double(q);
+    if (score >= threshold)
+      hits.push_back({{id, score}, jaccard});
+  }
+
+  auto better = [](const auto &a, const auto &b) {
+    if (a.first.score != b.first.score)
+      return a.first.score > b.first.score;
+    return a.second != b.second ? a.second > b.second : a.first.id < b.first.id;
+  };
+  size_t keep = min(limit, hits.size());
+  partial_sort(hits.begin(), hits.begin() + static_cast<ptrdiff_t>(keep), hits.end(), better);
+
+  vector<FuzzyMatch> ranked;
+  ranked.reserve(keep);
+  for (size_t i = 0; i < keep; ++i)
+    ranked.push_back(hits[i].first);
+  return ranked;
+}
+
+size_t TrigramIndex::size() const {
+  shared_lock lock(mtx);
+  return sizes.size();
+}
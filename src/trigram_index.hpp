@@ -0,0 +1,102 @@
+/**
+ * @file    trigram_index.hpp
+ * @brief   Typo-tolerant title matching for `todo find` and near-duplicate
+ *          warnings on `todo add`.
+ *
+ * Each title is reduced to its set of character trigrams (lower-cased, each
+ * word padded as "  word "), and similarity is the Jaccard ratio of two such
+ * sets (or, for lookups, the share of the query's trigrams found in the title,
+ * so a short query is not penalised for the title's extra words). A trigram → ids posting map finds candidates without scoring every
+ * title: to reach similarity θ a title must share at least ⌈θ·|Q|⌉ of the
+ * query's |Q| trigrams, so only the rarest |Q| − ⌈θ·|Q|⌉ + 1 query trigrams
+ * need to be scanned for candidates ("prefix filtering"); the rest are probed
+ * per candidate with a binary search.
+ */
+
+#pragma once
+#include "rw_lock.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Default minimum query coverage for `todo find`.
+static constexpr double kFuzzyThreshold = 0.5;
+// Similarity at which `todo add` warns about a likely duplicate.
+static constexpr double kNearDuplicate = 0.5;
+// Titles with fewer trigrams than this need more similarity to count as one.
+static constexpr size_t kShortTitleGrams = 12;
+
+/**
+ * @struct FuzzyMatch
+ * @brief  One ranked hit.
+ */
+struct FuzzyMatch {
+  int id;
+  double score; //< Similarity in (0, 1] under the requested metric.
+};
+
+/**
+ * @enum   FuzzyMetric
+ * @brief  How a candidate's shared trigrams are turned into a score.
+ */
+enum class FuzzyMetric { Jaccard,   //< shared / union: whole titles look alike.
+                         Coverage }; //< shared / query: query looks like part of the title.
+
+class TrigramIndex {
+public:
+  /**
+   * @brief   Distinct trigrams of a title, packed three bytes to a uint32.
+   * @param   text  Title or query.
+   * @return  Sorted, de-duplicated trigrams.
+   */
+  static std::vector<uint32_t> trigrams(std::string_view text);
+
+  /**
+   * @brief   Jaccard similarity of two titles (reference implementation).
+   */
+  static double similarity(std::string_view a, std::string_view b);
+
+  /**
+   * @brief   Similarity a title needs to count as a near duplicate. In a
+   *          short title the shared words outweigh the one that differs
+   *          ("Task 1" and "Task 2" are 0.56 alike), so below
+   *          kShortTitleGrams trigrams the allowed difference shrinks with
+   *          the title.
+   */
+  static double duplicateThreshold(std::string_view title);
+
+  void add(int id, std::string_view title);
+  void addAll(const std::vector<std::pair<int, std::string_view>> &docs);
+  void remove(int id, std::string_view title);
+
+  /**
+   * @brief   Ranked fuzzy lookup.
+   * @param   query      Text to match (typos welcome).
+   * @param   threshold  Minimum similarity to report.
+   * @param   limit      Maximum number of hits.
+   * @param   metric     Scoring; either way a hit shares ≥ ⌈threshold·|Q|⌉ trigrams.
+   * @return  Best matches first; ties broken by Jaccard, then lower id.
+   */
+  std::vector<FuzzyMatch> match(std::string_view query, double threshold, size_t limit,
+                                FuzzyMetric metric = FuzzyMetric::Jaccard) const;
+
+  /**
+   * @brief   Number of candidates scored by the most recent match() call
+   *          (exposed for benchmarks).
+   */
+  size_t lastCandidates() const { return last_candidates.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief   Number of titles indexed.
+   */
+  size_t size() const;
+
+private:
+  std::unordered_map<uint32_t, std::vector<int>> postings;
+  std::unordered_map<int, uint32_t> sizes; //< id → trigram count, for the Jaccard denominator.
+  mutable std::atomic<size_t> last_candidates{0};
+  mutable RwLock mtx;
+};
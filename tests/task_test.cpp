@@ -1,7 +1,26 @@
+#include "async_io.hpp"
+#include "block_store.hpp"
+#include "list_kernel.hpp"
+#include "load_gen.hpp"
+#include "lz_codec.hpp"
+#include "op_log.hpp"
+#include "store_follower.hpp"
 #include "task.hpp"
+#include "task_history.hpp"
 #include "task_cli.hpp"
+#include "task_file.hpp"
 #include "task_manager.hpp"
+#include "task_watch.hpp"
+#include "timer_wheel.hpp"
+#include <atomic>
+#include <filesystem>
 #include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <thread>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -168,4 +187,2137 @@ TEST(TaskManagerArchive, SetsState) {
 TEST(TaskManagerRemove, Nonexistent) {
   TaskManager mgr;
   EXPECT_FALSE(mgr.removeTask(99));
-}
\ No newline at end of file
+}
+/* --------------------------- Tests for Sort Keys ------------------------- */
+TEST(SortKey, MatchesEffectiveScoreOrder) {
+  const auto ref = chrono::sys_days{today};
+  Task low_overdue(1, "a", Priority::Low, ymd{ref - chrono::days{3}});
+  Task med_none(2, "b", Priority::Medium);
+  Task med_soon(3, "c", Priority::Medium, ymd{ref + chrono::days{2}});
+  Task crit_far(4, "d", Priority::Critical, ymd{ref + chrono::days{90}});
+
+  vector<Task *> tasks{&low_overdue, &med_none, &med_soon, &crit_far};
+  for (Task *a : tasks) {
+    for (Task *b : tasks) {
+      double sa = TaskManager::effective_score(*a, kRecentThreshold);
+      double sb = TaskManager::effective_score(*b, kRecentThreshold);
+      if (sa == sb)
+        continue;
+      uint64_t ka = TaskManager::make_sort_key(*a, ref, kRecentThreshold);
+      uint64_t kb = TaskManager::make_sort_key(*b, ref, kRecentThreshold);
+      EXPECT_EQ(sa < sb, ka < kb) << a->id << " vs " << b->id;
+    }
+  }
+}
+
+TEST(SortKey, EqualScoreOlderIdFirst) {
+  TaskManager mgr;
+  int first = mgr.addTask("Same score 1", Priority::High);
+  int second = mgr.addTask("Same score 2", Priority::High);
+  auto top = mgr.topTasks(2);
+  ASSERT_EQ(top.size(), 2u);
+  EXPECT_EQ(top[0].id, first);
+  EXPECT_EQ(top[1].id, second);
+}
+
+TEST(SortKey, TopTasksRespectsLimitAndRank) {
+  TaskManager mgr;
+  mgr.addTask("Low", Priority::Low);
+  int crit = mgr.addTask("Crit", Priority::Critical);
+  mgr.addTask("Med", Priority::Medium);
+  auto top = mgr.topTasks(1);
+  ASSERT_EQ(top.size(), 1u);
+  EXPECT_EQ(top[0].id, crit);
+}
+
+TEST(SortKey, RemoveLeavesNoStaleEntries) {
+  TaskManager mgr;
+  int a = mgr.addTask("Keep", Priority::Low);
+  int b = mgr.addTask("Drop", Priority::Critical);
+  ASSERT_TRUE(mgr.removeTask(b));
+  auto all = mgr.topTasks(SIZE_MAX, Status::All);
+  ASSERT_EQ(all.size(), 1u);
+  EXPECT_EQ(all[0].id, a);
+}
+
+/* ------------------------- Tests for Concurrency ------------------------- */
+TEST(TaskManagerConcurrency, ReadersAndWritersInterleave) {
+  TaskManager mgr;
+  mgr.setTaskLimit(100000);
+  for (int i = 0; i < 200; ++i)
+    mgr.addTask("Seed " + to_string(i), static_cast<Priority>(i % 4));
+
+  atomic<bool> stop{false};
+  atomic<int> bad_reads{0};
+  vector<thread> threads;
+
+  // Writers: add, then complete/archive/remove their own tasks
+  for (int w = 0; w < 4; ++w) {
+    threads.emplace_back([&, w] {
+      for (int i = 0; i < 150; ++i) {
+        int id = mgr.addTask("W" + to_string(w) + "-" + to_string(i), Priority::High);
+        ASSERT_NE(id, FXN_FAILURE);
+        switch (i % 3) {
+        case 0:
+          mgr.completeTask(id);
+          break;
+        case 1:
+          mgr.archiveTask(id);
+          break;
+        default:
+          mgr.removeTask(id);
+        }
+      }
+    });
+  }
+
+  // Readers: every snapshot must be internally consistent
+  for (int r = 0; r < 4; ++r) {
+    threads.emplace_back([&] {
+      while (!stop) {
+        auto all = mgr.topTasks(SIZE_MAX, Status::All);
+        for (size_t i = 1; i < all.size(); ++i)
+          if (all[i - 1].sort_key < all[i].sort_key)
+            ++bad_reads;
+        if (mgr.count(Status::Pending) > mgr.size())
+          ++bad_reads;
+      }
+    });
+  }
+
+  for (int w = 0; w < 4; ++w)
+    threads[w].join();
+  stop = true;
+  for (size_t t = 4; t < threads.size(); ++t)
+    threads[t].join();
+
+  EXPECT_EQ(bad_reads, 0);
+  EXPECT_EQ(mgr.size(), 200u + 4 * 100);
+  EXPECT_EQ(mgr.count(Status::Completed), 4u * 50);
+  EXPECT_EQ(mgr.count(Status::Archived), 4u * 50);
+}
+
+TEST(TaskManagerConcurrency, GetTaskReturnsCopy) {
+  TaskManager mgr;
+  int id = mgr.addTask("Lookup", Priority::Low);
+  auto t = mgr.getTask(id);
+  ASSERT_TRUE(t.has_value());
+  EXPECT_EQ(t->title, "Lookup");
+  EXPECT_FALSE(mgr.getTask(id + 1).has_value());
+}
+
+TEST(TaskManagerConcurrency, ParallelAddsGetUniqueIds) {
+  TaskManager mgr;
+  mgr.setTaskLimit(100000);
+  constexpr int kThreads = 8, kPerThread = 500;
+  vector<vector<int>> ids(kThreads);
+  vector<thread> threads;
+
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < kPerThread; ++i)
+        ids[t].push_back(mgr.addTask("T" + to_string(t) + "#" + to_string(i)));
+    });
+  }
+  for (auto &th : threads)
+    th.join();
+
+  vector<int> all;
+  for (auto &v : ids)
+    all.insert(all.end(), v.begin(), v.end());
+  sort(all.begin(), all.end());
+  EXPECT_EQ(adjacent_find(all.begin(), all.end()), all.end());
+  EXPECT_EQ(all.front(), 1);
+  EXPECT_EQ(mgr.size(), size_t(kThreads * kPerThread));
+  EXPECT_EQ(mgr.topTasks(SIZE_MAX, Status::All).size(), size_t(kThreads * kPerThread));
+}
+
+TEST(TaskManagerConcurrency, RacingDuplicatesOnlyOneWins) {
+  TaskManager mgr;
+  atomic<int> wins{0};
+  vector<thread> threads;
+  for (int t = 0; t < 8; ++t)
+    threads.emplace_back([&] { wins += mgr.addTask("Same title", Priority::Low, today) != FXN_FAILURE; });
+  for (auto &th : threads)
+    th.join();
+  EXPECT_EQ(wins, 1);
+  EXPECT_EQ(mgr.size(), 1u);
+}
+
+TEST(TaskManagerError, DuplicateTitleIgnoresCase) {
+  TaskManager mgr;
+  EXPECT_NE(mgr.addTask("Buy milk"), FXN_FAILURE);
+  EXPECT_EQ(mgr.addTask("buy MILK"), FXN_FAILURE);
+  EXPECT_NE(mgr.addTask("buy MILK", Priority::Medium, today), FXN_FAILURE);
+}
+
+TEST(TaskManagerError, RemovedTitleCanBeReused) {
+  TaskManager mgr;
+  int id = mgr.addTask("Again");
+  ASSERT_TRUE(mgr.removeTask(id));
+  EXPECT_NE(mgr.addTask("Again"), FXN_FAILURE);
+}
+
+/* ------------------------- Tests for Persistence ------------------------- */
+static string temp_store(const string &name) {
+  return (filesystem::temp_directory_path() / name).string();
+}
+
+static void remove_store(const string &path) {
+  for (const string &file :
+       {path, index_path(path), search_path(path), tombstone_path(path), lock_path(path), archive_path(path),
+        journal_path(path), stats_path(path), history_path(path)})
+    filesystem::remove(file);
+}
+
+TEST(Persistence, SaveLoadRoundTrip) {
+  string path = temp_store("roundtrip_tasks.json");
+  TaskManager out;
+  int a = out.addTask("Pay rent", Priority::Critical, ymd(2030y, chrono::March, 1d));
+  int b = out.addTask("Water plants", Priority::Low);
+  out.completeTask(b);
+  ASSERT_TRUE(out.saveToFile(path));
+
+  TaskManager in;
+  ASSERT_TRUE(in.loadFromFile(path));
+  filesystem::remove(path);
+  ASSERT_EQ(in.size(), 2u);
+  EXPECT_EQ(*in.getTask(a), *out.getTask(a));
+  EXPECT_EQ(in.getTask(a)->due, out.getTask(a)->due);
+  EXPECT_EQ(*in.getTask(b), *out.getTask(b));
+  // IDs keep counting from the highest loaded one
+  EXPECT_EQ(in.addTask("Next"), b + 1);
+}
+
+TEST(Persistence, ParallelLoadMatchesSequential) {
+  string path = temp_store("parallel_tasks.json");
+  remove_store(path);
+  TaskManager out;
+  out.setTaskLimit(5000);
+  for (int i = 0; i < 2000; ++i) {
+    int id = out.addTask("Chunked " + to_string(i), static_cast<Priority>(i % 4),
+                         i % 3 ? optional{ymd(2031y, chrono::January, chrono::day(1 + i % 28))} : nullopt);
+    if (i % 5 == 0)
+      out.archiveTask(id);
+  }
+  ASSERT_TRUE(out.saveToFile(path));
+
+  TaskManager seq, par;
+  ASSERT_TRUE(seq.loadFromFile(path, 1));
+  ASSERT_TRUE(par.loadFromFile(path, 7));
+  EXPECT_EQ(seq.size(), 1600u); // archived tasks went cold
+  seq.loadArchive(path);
+  par.loadArchive(path);
+  remove_store(path);
+
+  auto a = seq.topTasks(SIZE_MAX, Status::All);
+  auto b = par.topTasks(SIZE_MAX, Status::All);
+  ASSERT_EQ(a.size(), 2000u);
+  ASSERT_EQ(a.size(), b.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    EXPECT_EQ(a[i], b[i]);
+    EXPECT_EQ(a[i].due, b[i].due);
+  }
+}
+
+TEST(Persistence, MissingFileIsNotAnError) {
+  TaskManager mgr;
+  EXPECT_FALSE(mgr.loadFromFile(temp_store("does_not_exist_tasks.json")));
+  EXPECT_EQ(mgr.size(), 0u);
+}
+
+TEST(Persistence, PatchStatusInPlace) {
+  string path = temp_store("patch_tasks.json");
+  TaskManager out;
+  int a = out.addTask("Patch me", Priority::High);
+  int b = out.addTask("Leave me", Priority::Low);
+  ASSERT_TRUE(out.saveToFile(path));
+  auto size_before = filesystem::file_size(path);
+
+  EXPECT_EQ(TaskManager::patchStatus(path, a, Status::Completed), TaskManager::PatchResult::Patched);
+  EXPECT_EQ(TaskManager::patchStatus(path, 999, Status::Completed), TaskManager::PatchResult::Missing);
+  EXPECT_EQ(filesystem::file_size(path), size_before);
+
+  TaskManager in;
+  ASSERT_TRUE(in.loadFromFile(path));
+  EXPECT_EQ(in.getTask(a)->state, Status::Completed);
+  EXPECT_EQ(in.getTask(b)->state, Status::Pending);
+
+  // Without an index the caller has to fall back to a full load
+  filesystem::remove(index_path(path));
+  EXPECT_EQ(TaskManager::patchStatus(path, b, Status::Archived), TaskManager::PatchResult::Unavailable);
+  filesystem::remove(path);
+}
+
+TEST(Persistence, FirstPageStopsEarly) {
+  string path = temp_store("page_tasks.json");
+  TaskManager out;
+  out.setTaskLimit(1000);
+  for (int i = 0; i < 300; ++i)
+    out.addTask("Page " + to_string(i), static_cast<Priority>(i % 4));
+  auto expected = out.topTasks(5);
+  ASSERT_TRUE(out.saveToFile(path));
+
+  TaskManager in;
+  ASSERT_TRUE(in.loadFirstPage(path, Status::Pending, 5));
+  filesystem::remove(path);
+  filesystem::remove(index_path(path));
+  EXPECT_EQ(in.size(), 5u);
+  auto page = in.topTasks(5);
+  ASSERT_EQ(page.size(), 5u);
+  for (size_t i = 0; i < page.size(); ++i)
+    EXPECT_EQ(page[i], expected[i]);
+}
+
+/* ----------------------------- Tests for CLI ----------------------------- */
+// Runs each CLI test inside a scratch directory so tasks.json is private.
+class CliTest : public testing::Test {
+protected:
+  void SetUp() override {
+    old_cwd = filesystem::current_path();
+    dir = filesystem::temp_directory_path() / ("todo_cli_" + to_string(::getpid()));
+    filesystem::create_directories(dir);
+    filesystem::current_path(dir);
+  }
+  void TearDown() override {
+    filesystem::current_path(old_cwd);
+    filesystem::remove_all(dir);
+  }
+  int run(vector<string> args) {
+    args.insert(args.begin(), "todo");
+    vector<char *> argv;
+    for (auto &a : args)
+      argv.push_back(a.data());
+    TaskCLI cli;
+    testing::internal::CaptureStdout();
+    testing::internal::CaptureStderr();
+    int rc = cli.run(static_cast<int>(argv.size()), argv.data());
+    output = testing::internal::GetCapturedStdout() + testing::internal::GetCapturedStderr();
+    return rc;
+  }
+  filesystem::path old_cwd, dir;
+  string output;
+};
+
+TEST_F(CliTest, HelpDoesNotTouchStore) {
+  EXPECT_EQ(run({"help", "add"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Add a task"), string::npos);
+  EXPECT_FALSE(filesystem::exists(STORE_FILE));
+}
+
+TEST_F(CliTest, CompleteUsesIndexedPatch) {
+  ASSERT_EQ(run({"add", "First"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Second"}), EXIT_SUCCESS);
+  ASSERT_TRUE(filesystem::exists(index_path(STORE_FILE)));
+
+  EXPECT_EQ(run({"complete", "2"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"complete", "7"}), EXIT_FAILURE);
+
+  TaskManager mgr;
+  mgr.loadFromFile(STORE_FILE);
+  EXPECT_EQ(mgr.getTask(2)->state, Status::Completed);
+  EXPECT_EQ(mgr.getTask(1)->state, Status::Pending);
+}
+
+TEST_F(CliTest, ListLimit) {
+  for (string t : {"a", "b", "c"})
+    ASSERT_EQ(run({"add", t}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"list", "--limit", "2"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("2 tasks pending"), string::npos);
+}
+
+/* ---------------------------- Tests for Search --------------------------- */
+TEST(TitleIndex, TokenizeFoldsCaseAndPunctuation) {
+  auto tokens = TitleIndex::tokenize("File TAXES (2025), file-taxes!");
+  EXPECT_EQ(tokens, (vector<string>{"file", "taxes", "2025"}));
+}
+
+TEST(TitleIndex, IntersectsAllTerms) {
+  TitleIndex index;
+  index.add(1, "Buy milk and eggs");
+  index.add(2, "Buy eggs");
+  index.add(3, "Sell milk");
+  index.addAll({{4, "milk eggs buy"}, {5, "unrelated"}});
+
+  EXPECT_EQ(index.search("eggs BUY"), (vector<int>{1, 2, 4}));
+  EXPECT_EQ(index.search("milk eggs"), (vector<int>{1, 4}));
+  EXPECT_TRUE(index.search("milk bread").empty());
+  EXPECT_TRUE(index.search("  ").empty());
+
+  index.remove(1, "Buy milk and eggs");
+  EXPECT_EQ(index.search("milk eggs"), (vector<int>{4}));
+}
+
+TEST(TitleIndex, SaveLoadRoundTrip) {
+  string path = temp_store("roundtrip.search");
+  TitleIndex out, in, stale;
+  for (int id = 1; id <= 50; ++id)
+    out.add(id, id % 2 ? "odd task" : "even task");
+  ASSERT_TRUE(out.save(path, 1234));
+  ASSERT_TRUE(in.load(path, 1234));
+  EXPECT_FALSE(stale.load(path, 999));
+  filesystem::remove(path);
+  EXPECT_EQ(in.search("odd"), out.search("odd"));
+  EXPECT_EQ(in.terms(), 3u);
+}
+
+TEST(TaskManagerSearch, FollowsAddsAndRemoves) {
+  TaskManager mgr;
+  int a = mgr.addTask("Renew passport", Priority::Low);
+  int b = mgr.addTask("Passport photos", Priority::Critical);
+  auto hits = mgr.searchTasks("passport");
+  ASSERT_EQ(hits.size(), 2u);
+  EXPECT_EQ(hits[0].id, b); // most important first
+  mgr.removeTask(b);
+  hits = mgr.searchTasks("passport");
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits[0].id, a);
+}
+
+TEST_F(CliTest, SearchUsesSavedIndex) {
+  ASSERT_EQ(run({"add", "A very long title about quarterly taxes that gets truncated"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Walk dog"}), EXIT_SUCCESS);
+  auto hits = TaskManager::searchFile(STORE_FILE, "quarterly TAXES");
+  ASSERT_TRUE(hits.has_value());
+  ASSERT_EQ(hits->size(), 1u);
+  EXPECT_EQ(hits->front().id, 1);
+
+  EXPECT_EQ(run({"search", "dog"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("1 tasks found"), string::npos);
+}
+
+/* ------------------------- Tests for Fuzzy Find -------------------------- */
+TEST(TrigramIndex, RanksTyposByClosestTitle) {
+  TrigramIndex index;
+  index.add(1, "Buy groceries");
+  index.add(2, "Call grandma");
+  index.addAll({{3, "Groceries for the party"}, {4, "Grocery list"}});
+
+  auto hits = index.match("grocries", kFuzzyThreshold, 10, FuzzyMetric::Coverage);
+  ASSERT_EQ(hits.size(), 2u);
+  EXPECT_EQ(hits[0].id, 1); // same coverage as #3, but a closer whole title
+  EXPECT_EQ(hits[1].id, 3);
+
+  index.remove(1, "Buy groceries");
+  hits = index.match("grocries", kFuzzyThreshold, 10, FuzzyMetric::Coverage);
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits[0].id, 3);
+  EXPECT_TRUE(index.match("grocries", kNearDuplicate, 10).empty()); // Jaccard
+}
+
+TEST(TrigramIndex, PruningMatchesFullScan) {
+  TrigramIndex index;
+  vector<string> titles;
+  const char *words[] = {"pay", "rent", "water", "plants", "call", "mom", "fix", "bike", "email", "boss"};
+  for (int id = 0; id < 300; ++id) {
+    titles.push_back(string(words[id % 10]) + ' ' + words[(id / 10) % 10] + ' ' + to_string(id % 7));
+    index.add(id, titles.back());
+  }
+
+  for (string query : {"pay rnet", "wter plnts", "emial bos 3"}) {
+    vector<pair<double, int>> expected;
+    for (int id = 0; id < 300; ++id)
+      if (double s = TrigramIndex::similarity(query, titles[id]); s >= 0.4)
+        expected.emplace_back(-s, id);
+    sort(expected.begin(), expected.end());
+
+    auto hits = index.match(query, 0.4, SIZE_MAX);
+    ASSERT_EQ(hits.size(), expected.size()) << query;
+    for (size_t i = 0; i < hits.size(); ++i)
+      EXPECT_EQ(hits[i].id, expected[i].second) << query;
+    EXPECT_LT(index.lastCandidates(), titles.size()) << query;
+  }
+}
+
+TEST(TaskManagerFind, FollowsAddsAndRemovesAfterFirstUse) {
+  TaskManager mgr;
+  int a = mgr.addTask("Schedule dentist");
+  auto hits = mgr.findSimilar("dentst");
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits.front().id, a);
+
+  int b = mgr.addTask("Dentist invoice");
+  mgr.removeTask(a);
+  hits = mgr.findSimilar("dentst");
+  ASSERT_EQ(hits.size(), 1u);
+  EXPECT_EQ(hits.front().id, b);
+}
+
+TEST_F(CliTest, AddWarnsOnNearDuplicateAndFindRanks) {
+  ASSERT_EQ(run({"add", "Buy groceries"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Buy grocerys"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Similar to task #1"), string::npos);
+  ASSERT_EQ(run({"add", "Walk dog"}), EXIT_SUCCESS);
+  EXPECT_EQ(output.find("Similar"), string::npos);
+
+  // Short numbered titles share all but one word; that is not a typo
+  for (int i = 1; i <= 12; ++i) {
+    ASSERT_EQ(run({"add", "Task " + to_string(i)}), EXIT_SUCCESS);
+    EXPECT_EQ(output.find("Similar"), string::npos) << i;
+  }
+  ASSERT_EQ(run({"add", "Call moms"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Call mom"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Similar to task #"), string::npos);
+
+  EXPECT_EQ(run({"find", "grocery"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("2 tasks matched"), string::npos);
+}
+
+/* ---------------------------- Tests for Query ---------------------------- */
+TEST(TaskQuery, ParsesTermsIntoRanges) {
+  TaskQuery q;
+  string error;
+  ASSERT_TRUE(q.addTerm("status:all", error));
+  ASSERT_TRUE(q.addTerm("pr>=high", error));
+  ASSERT_TRUE(q.addTerm("due<2026-11-01", error));
+  ASSERT_TRUE(q.addTerm("title~Tax", error));
+  EXPECT_FALSE(q.status.has_value());
+  EXPECT_EQ(q.pr_lo, Priority::High);
+  EXPECT_EQ(q.pr_hi, Priority::Critical);
+  EXPECT_EQ(*q.due_hi, chrono::sys_days(ymd{year{2026}, month{10}, day{31}}));
+  EXPECT_EQ(q.title_prefixes, vector<string>{"tax"});
+
+  EXPECT_FALSE(q.addTerm("pr>urgent", error));
+  EXPECT_FALSE(q.addTerm("colour:red", error));
+  EXPECT_FALSE(q.addTerm("due<tomorrow", error));
+  EXPECT_TRUE(TaskQuery::isTerm("pr<=med"));
+  EXPECT_FALSE(TaskQuery::isTerm("--limit"));
+}
+
+TEST(TaskManagerQuery, PlannerPicksNarrowestIndex) {
+  TaskManager mgr;
+  mgr.setTaskLimit(2000);
+  ymd soon{year{2030}, month{1}, day{1}};
+  for (int i = 0; i < 1000; ++i) {
+    optional<ymd> due = i % 100 == 0 ? optional{ymd{chrono::sys_days{soon} + chrono::days{i / 100}}} : nullopt;
+    mgr.addTask((i % 250 == 0 ? "Pay tax " : "Chore ") + to_string(i), Priority(i % 4), due);
+  }
+  for (int id = 1; id <= 990; ++id)
+    mgr.completeTask(id);
+
+  auto run = [&](vector<string> terms, QueryPlan &plan) {
+    TaskQuery q;
+    string error;
+    for (auto &t : terms)
+      EXPECT_TRUE(q.addTerm(t, error)) << error;
+    // Every plan must agree with checking the predicate on every task
+    size_t expected = 0;
+    for (int id = 1; id <= 1000; ++id)
+      expected += q.matches(*mgr.getTask(id));
+    auto list = mgr.queryTasks(q, SIZE_MAX, &plan);
+    EXPECT_EQ(list.size(), expected);
+    EXPECT_TRUE(is_sorted(list.begin(), list.end(), [](auto &a, auto &b) { return a.sort_key > b.sort_key; }));
+    return list;
+  };
+
+  QueryPlan plan;
+  run({"status:pending"}, plan);
+  EXPECT_EQ(plan.access, "status partition (pending)");
+  EXPECT_EQ(plan.examined, 10u);
+
+  run({"status:all", "due<=2030-01-03"}, plan);
+  EXPECT_EQ(plan.access, "due index");
+  EXPECT_EQ(plan.examined, 3u);
+
+  auto hits = run({"status:completed", "title~ta"}, plan);
+  EXPECT_EQ(plan.access, "title index (ta*)");
+  EXPECT_EQ(plan.examined, 4u);
+  EXPECT_EQ(hits.size(), 4u);
+
+  run({"status:all", "pr>crit"}, plan);
+  EXPECT_EQ(plan.access, "full scan");
+  EXPECT_EQ(plan.matched, 0u);
+}
+
+TEST_F(CliTest, ListQueryExplain) {
+  ASSERT_EQ(run({"add", "File taxes", "--priority", "high", "--due", "2030-01-15"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Tax refund", "--priority", "low"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Walk dog"}), EXIT_SUCCESS);
+
+  EXPECT_EQ(run({"list", "pr>=high", "title~tax", "--explain"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("1 tasks matched"), string::npos);
+  EXPECT_NE(output.find("Plan:"), string::npos);
+  EXPECT_NE(output.find("Examined"), string::npos);
+
+  EXPECT_EQ(run({"list", "due:soon"}), EXIT_FAILURE);
+}
+
+/* ------------------------- Tests for List Kernels ------------------------ */
+TEST(ListKernel, TablesMatchRenderedText) {
+  EXPECT_EQ(print_status(Status::Pending), "PENDING");
+  EXPECT_EQ(print_status(Status::Archived), "ARCHIVED");
+  EXPECT_EQ(status_name(Status::All), "---");
+
+  string low;
+  for (int i = 0; i < 8; ++i)
+    low += i < 2 ? "\e[0;104m \033[0m" : "\033[40m \033[0m";
+  EXPECT_EQ(print_priority(Priority::Low), low);
+  EXPECT_EQ(priority_bar(Priority::Critical).size(), 8 * string_view("\e[0;101m \033[0m").size());
+}
+
+TEST(ListKernel, SelectRankedFiltersAndOrders) {
+  vector<Task> store;
+  for (int id = 1; id <= 200; ++id) {
+    Task t(id, "t" + to_string(id), Priority(id % 4));
+    t.state = Status(id % 3);
+    t.sort_key = TaskManager::make_sort_key(t, chrono::sys_days{today}, kRecentThreshold);
+    store.push_back(t);
+  }
+  vector<Task *> ptrs;
+  for (auto &t : store)
+    ptrs.push_back(&t);
+  make_heap(ptrs.begin(), ptrs.end(), [](auto *a, auto *b) { return a->sort_key < b->sort_key; });
+
+  for (Status filter : {Status::Pending, Status::Completed, Status::Archived, Status::All}) {
+    vector<const Task *> expected;
+    for (auto *t : ptrs)
+      if (filter == Status::All || t->state == filter)
+        expected.push_back(t);
+    sort(expected.begin(), expected.end(), [](auto *a, auto *b) { return a->sort_key > b->sort_key; });
+
+    EXPECT_EQ(select_ranked(ptrs, filter, SIZE_MAX), expected);
+    expected.resize(5);
+    EXPECT_EQ(select_ranked<true>(ptrs, filter, 5), expected);
+    EXPECT_EQ(select_ranked<false>(ptrs, filter, 5), expected);
+  }
+}
+
+/* -------------------------- Tests for Recurrence ------------------------- */
+TEST(Recurrence, ParsesAndSchedules) {
+  EXPECT_EQ(Recurrence::parse("3d"), (Recurrence{Repeat::Days, 3}));
+  EXPECT_EQ(Recurrence::parse("weekly"), (Recurrence{Repeat::Weeks, 1}));
+  EXPECT_EQ(Recurrence::parse("month:31")->str(), "month:31");
+  EXPECT_FALSE(Recurrence::parse("0d").has_value());
+  EXPECT_FALSE(Recurrence::parse("month:32").has_value());
+  EXPECT_FALSE(Recurrence::parse("3x").has_value());
+
+  ymd jan31{year{2026}, month{1}, day{31}};
+  Recurrence monthly{Repeat::Monthly, 31};
+  EXPECT_EQ(monthly.nextAfter(jan31), (ymd{year{2026}, month{2}, day{28}})); // clamped
+  EXPECT_EQ(monthly.nextAfter(ymd{year{2026}, month{2}, day{28}}), (ymd{year{2026}, month{3}, day{31}}));
+  EXPECT_EQ((Recurrence{Repeat::Monthly, 15}).nextAfter(ymd{year{2026}, month{3}, day{1}}),
+            (ymd{year{2026}, month{3}, day{15}}));
+
+  // Missed occurrences collapse into the first one not before today
+  Recurrence weekly{Repeat::Weeks, 1};
+  ymd mon{year{2026}, month{3}, day{2}};
+  EXPECT_EQ(weekly.nextOccurrence(mon, ymd{year{2026}, month{3}, day{20}}), (ymd{year{2026}, month{3}, day{23}}));
+  EXPECT_EQ(weekly.nextOccurrence(mon, mon), (ymd{year{2026}, month{3}, day{9}}));
+}
+
+TEST(TaskManagerRecurrence, CompleteSpawnsNextAndMovesRule) {
+  TaskManager mgr;
+  int id = mgr.addTask("Water plants", Priority::Medium, today, Recurrence{Repeat::Days, 3});
+  ASSERT_NE(id, FXN_FAILURE);
+
+  int next = 0;
+  ASSERT_TRUE(mgr.completeTask(id, &next));
+  ASSERT_NE(next, FXN_FAILURE);
+  EXPECT_EQ(mgr.size(), 2u);
+  EXPECT_EQ(mgr.count(Status::Pending), 1u);
+
+  Task done = *mgr.getTask(id), upcoming = *mgr.getTask(next);
+  EXPECT_FALSE(done.repeat.active());
+  EXPECT_EQ(upcoming.repeat, (Recurrence{Repeat::Days, 3}));
+  EXPECT_EQ(*upcoming.due, ymd{chrono::sys_days{today} + chrono::days{3}});
+
+  // Without a due date the first occurrence is scheduled from today
+  int plain = mgr.addTask("Stand-up", Priority::Low, nullopt, Recurrence{Repeat::Weeks, 2});
+  EXPECT_EQ(*mgr.getTask(plain)->due, today);
+  ASSERT_TRUE(mgr.completeTask(mgr.addTask("One-off"), &next));
+  EXPECT_EQ(next, FXN_FAILURE);
+}
+
+TEST_F(CliTest, CompletingRecurringTaskPersistsNextOccurrence) {
+  ASSERT_EQ(run({"add", "Take out bins", "--every", "1w"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"add", "Bad", "--every", "sometimes"}), EXIT_FAILURE);
+
+  // The in-place patch cannot add a record, so this goes through a full save
+  EXPECT_EQ(run({"complete", "1"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Next occurrence: task #2"), string::npos);
+
+  TaskManager mgr;
+  mgr.loadFromFile(STORE_FILE);
+  EXPECT_EQ(mgr.getTask(1)->state, Status::Completed);
+  EXPECT_EQ(mgr.getTask(2)->repeat, (Recurrence{Repeat::Weeks, 1}));
+  EXPECT_EQ(*mgr.getTask(2)->due, ymd{chrono::sys_days{today} + chrono::weeks{1}});
+}
+
+/* ------------------------- Tests for Dependencies ------------------------ */
+TEST(TaskManagerDependencies, BlockedTasksLeaveTheRankingUntilReady) {
+  TaskManager mgr;
+  int design = mgr.addTask("Design", Priority::Low);
+  int build = mgr.addTask("Build", Priority::Critical);
+  int ship = mgr.addTask("Ship", Priority::Critical);
+  ASSERT_TRUE(mgr.addDependency(build, design));
+  ASSERT_TRUE(mgr.addDependency(ship, build));
+
+  auto top = mgr.topTasks(10);
+  ASSERT_EQ(top.size(), 1u);
+  EXPECT_EQ(top[0].id, design);
+  EXPECT_EQ(mgr.blockedTasks().size(), 2u);
+
+  // Cycles and finished prerequisites are rejected
+  EXPECT_FALSE(mgr.addDependency(design, ship));
+  EXPECT_FALSE(mgr.addDependency(design, design));
+
+  ASSERT_TRUE(mgr.completeTask(design));
+  top = mgr.topTasks(10);
+  ASSERT_EQ(top.size(), 1u);
+  EXPECT_EQ(top[0].id, build);
+  EXPECT_TRUE(mgr.getTask(build)->after.empty());
+  EXPECT_FALSE(mgr.addDependency(ship, design));
+
+  // Removing a prerequisite releases its dependents too
+  ASSERT_TRUE(mgr.removeTask(build));
+  top = mgr.topTasks(10);
+  ASSERT_EQ(top.size(), 1u);
+  EXPECT_EQ(top[0].id, ship);
+  EXPECT_TRUE(mgr.blockedTasks().empty());
+}
+
+TEST(Persistence, DependenciesRoundTripAndDisableFastPaths) {
+  string path = temp_store("deps.json");
+  {
+    TaskManager out;
+    int a = out.addTask("Prerequisite", Priority::Low);
+    int b = out.addTask("Waits", Priority::Critical);
+    out.addTask("Free", Priority::Medium);
+    ASSERT_TRUE(out.addDependency(b, a));
+    ASSERT_TRUE(out.saveToFile(path));
+  }
+
+  // The waiting task's prerequisite would need its record updated too
+  EXPECT_EQ(TaskManager::patchStatus(path, 1, Status::Completed), TaskManager::PatchResult::Unavailable);
+  EXPECT_EQ(TaskManager::patchStatus(path, 3, Status::Completed), TaskManager::PatchResult::Patched);
+
+  TaskManager in;
+  ASSERT_TRUE(in.loadFromFile(path));
+  EXPECT_EQ(in.getTask(2)->after, vector<int>{1});
+  EXPECT_EQ(in.topTasks(10).size(), 1u); // #2 is blocked, #3 completed
+  vector<Task> all = in.topTasks(10, Status::All);
+  ASSERT_EQ(all.size(), 3u);
+  EXPECT_EQ(all.back().id, 2); // blocked ones last
+  vector<int> paged;
+  for (uint64_t below = UINT64_MAX;;) {
+    vector<Task> row = in.topTasks(1, Status::All, nullopt, below);
+    if (row.empty())
+      break;
+    paged.push_back(row.front().id);
+    below = row.front().sort_key;
+  }
+  EXPECT_EQ(paged, (vector<int>{all[0].id, all[1].id, 2}));
+  ASSERT_TRUE(in.completeTask(1));
+  EXPECT_EQ(in.topTasks(1).front().id, 2);
+
+  // A first page of pending tasks stops where the blocked tasks start
+  TaskManager page;
+  ASSERT_TRUE(page.loadFirstPage(path, Status::Pending, 10));
+  EXPECT_EQ(page.size(), 1u);
+  filesystem::remove(path);
+  filesystem::remove(index_path(path));
+  filesystem::remove(search_path(path));
+}
+
+TEST_F(CliTest, DependAndListBlocked) {
+  ASSERT_EQ(run({"add", "Buy paint"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Paint fence", "--after", "1"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Invite friends"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"depend", "1", "2"}), EXIT_FAILURE); // cycle
+  EXPECT_EQ(run({"add", "Orphan", "--after", "9"}), EXIT_FAILURE);
+
+  EXPECT_EQ(run({"list"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("2 tasks pending"), string::npos);
+  EXPECT_EQ(run({"list", "--blocked"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("1 tasks blocked"), string::npos);
+  EXPECT_EQ(run({"list", "--all"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Paint fence"), string::npos);
+  EXPECT_NE(output.find("3 tasks total"), string::npos);
+
+  EXPECT_EQ(run({"complete", "1"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"list"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("2 tasks pending"), string::npos);
+  EXPECT_NE(output.find("Paint fence"), string::npos);
+}
+
+/* --------------------------- Tests for Undo/Redo -------------------------- */
+TEST(OpLog, UndoRemoveRestoresIdAndDependencies) {
+  TaskManager mgr;
+  OpLog log;
+  int paint = mgr.addTask("Buy paint", Priority::Low, today);
+  int fence = mgr.addTask("Paint fence", Priority::High);
+  ASSERT_TRUE(mgr.addDependency(fence, paint));
+
+  Operation op{OpKind::Remove, *mgr.getTask(paint), mgr.dependentsOf(paint)};
+  ASSERT_TRUE(mgr.removeTask(paint));
+  log.record(op);
+  EXPECT_TRUE(mgr.blockedTasks().empty());
+
+  Operation undone;
+  ASSERT_TRUE(log.undo(mgr, &undone));
+  EXPECT_EQ(undone.kind, OpKind::Remove);
+  EXPECT_EQ(mgr.getTask(paint)->title, "Buy paint");
+  EXPECT_EQ(*mgr.getTask(paint)->due, today);
+  EXPECT_EQ(mgr.getTask(fence)->after, vector<int>{paint});
+  EXPECT_EQ(mgr.topTasks(10).size(), 1u);
+  EXPECT_FALSE(log.undo(mgr));
+
+  // Redo removes it again; a new change clears the redo stack
+  ASSERT_TRUE(log.redo(mgr));
+  EXPECT_FALSE(mgr.getTask(paint).has_value());
+  ASSERT_TRUE(log.undo(mgr));
+  log.record({OpKind::Add, *mgr.getTask(mgr.addTask("Other"))});
+  EXPECT_EQ(log.redoDepth(), 0u);
+  EXPECT_EQ(mgr.addTask("Next"), 4); // restored ids are never reused
+}
+
+TEST(OpLog, UndoCompleteTakesBackNextOccurrence) {
+  TaskManager mgr;
+  OpLog log;
+  int id = mgr.addTask("Water plants", Priority::Medium, today, Recurrence{Repeat::Days, 3});
+  Operation op{OpKind::Complete, *mgr.getTask(id)};
+  ASSERT_TRUE(mgr.completeTask(id, &op.spawned));
+  log.record(op);
+
+  ASSERT_TRUE(log.undo(mgr));
+  EXPECT_EQ(mgr.size(), 1u);
+  EXPECT_EQ(mgr.getTask(id)->state, Status::Pending);
+  EXPECT_EQ(mgr.getTask(id)->repeat, (Recurrence{Repeat::Days, 3}));
+
+  ASSERT_TRUE(log.redo(mgr));
+  EXPECT_EQ(mgr.size(), 2u);
+  EXPECT_EQ(mgr.getTask(id)->state, Status::Completed);
+}
+
+TEST(OpLog, SaveLoadRoundTripIsBounded) {
+  string path = temp_store("ops.log");
+  OpLog log;
+  Task task(7, "Call mum, then dad", Priority::Critical, today);
+  task.after = {2, 3};
+  task.repeat = Recurrence{Repeat::Weeks, 1};
+  for (size_t i = 0; i < OpLog::kMaxOps + 5; ++i)
+    log.record({OpKind::Remove, task, {9}, 11});
+  ASSERT_TRUE(log.save(path));
+
+  OpLog in;
+  ASSERT_TRUE(in.load(path));
+  EXPECT_EQ(in.undoDepth(), OpLog::kMaxOps);
+  TaskManager mgr;
+  Operation op;
+  ASSERT_TRUE(in.undo(mgr, &op));
+  EXPECT_EQ(op.task.title, task.title);
+  EXPECT_EQ(op.task.after, task.after);
+  EXPECT_EQ(op.task.repeat, task.repeat);
+  EXPECT_EQ(*op.task.due, today);
+  EXPECT_EQ(op.waiting, vector<int>{9});
+  EXPECT_EQ(op.spawned, 11);
+  EXPECT_EQ(mgr.getTask(7)->pr, Priority::Critical);
+  filesystem::remove(path);
+}
+
+TEST_F(CliTest, UndoRedoRemoveAndPatchedComplete) {
+  EXPECT_EQ(run({"undo"}), EXIT_FAILURE);
+  ASSERT_EQ(run({"add", "Keep me", "--priority", "high"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Finish me"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"remove", "1"}), EXIT_SUCCESS);
+
+  EXPECT_EQ(run({"undo"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Undid remove of task #1"), string::npos);
+  EXPECT_EQ(run({"redo"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"undo"}), EXIT_SUCCESS);
+
+  // Completing through the in-place patch is undoable too
+  ASSERT_EQ(run({"complete", "2"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"undo"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Undid complete of task #2"), string::npos);
+
+  TaskManager mgr;
+  mgr.loadFromFile(STORE_FILE);
+  EXPECT_EQ(mgr.getTask(1)->pr, Priority::High);
+  EXPECT_EQ(mgr.getTask(2)->state, Status::Pending);
+
+  // Undoing both adds empties the store
+  EXPECT_EQ(run({"undo"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"undo"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"undo"}), EXIT_FAILURE);
+  EXPECT_EQ(run({"list", "--all"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("0 tasks"), string::npos);
+}
+
+/* --------------------------- Tests for Named Lists ------------------------ */
+TEST(TaskManagerLists, EachListRanksOnItsOwnHeap) {
+  TaskManager mgr;
+  ListId ops = intern_list("ops");
+  EXPECT_EQ(intern_list("ops"), ops);
+  EXPECT_EQ(list_name(ops), "ops");
+  EXPECT_EQ(intern_list(kDefaultListName), kDefaultList);
+
+  int home = mgr.addTask("Renew certs", Priority::Low);
+  int mine = mgr.addTask("Renew certs", Priority::Critical, nullopt, {}, ops); // same title, other list
+  int other = mgr.addTask("Page rotation", Priority::Medium, nullopt, {}, ops);
+  ASSERT_NE(mine, FXN_FAILURE);
+  EXPECT_EQ(mgr.addTask("renew CERTS", Priority::High, nullopt, {}, ops), FXN_FAILURE);
+
+  auto top = mgr.topTasks(10, Status::Pending, ops);
+  ASSERT_EQ(top.size(), 2u);
+  EXPECT_EQ(top[0].id, mine);
+  EXPECT_EQ(top[1].id, other);
+  top = mgr.topTasks(10);
+  ASSERT_EQ(top.size(), 3u);
+  EXPECT_EQ(top[2].id, home);
+  EXPECT_EQ(mgr.topTasks(1).front().id, mine);
+
+  TaskQuery query;
+  string error;
+  ASSERT_TRUE(query.addTerm("list:ops", error));
+  QueryPlan plan;
+  EXPECT_EQ(mgr.queryTasks(query, SIZE_MAX, &plan).size(), 2u);
+  EXPECT_EQ(plan.access, "list heap (ops)");
+
+  // Recurring tasks keep their list; counts are per list
+  int daily = mgr.addTask("Check alerts", Priority::High, today, Recurrence{Repeat::Days, 1}, ops);
+  int next = 0;
+  ASSERT_TRUE(mgr.completeTask(daily, &next));
+  EXPECT_EQ(mgr.getTask(next)->list, ops);
+  auto counts = mgr.listCounts();
+  ASSERT_EQ(counts.size(), 2u);
+  EXPECT_EQ(counts[0], (pair<ListId, size_t>{kDefaultList, 1}));
+  EXPECT_EQ(counts[1], (pair<ListId, size_t>{ops, 3}));
+}
+
+TEST(Persistence, ListsRoundTripAndPageByList) {
+  string path = temp_store("lists.json");
+  ListId ops = intern_list("ops");
+  {
+    TaskManager out;
+    out.addTask("Home chore", Priority::Critical);
+    out.addTask("Ops one", Priority::High, nullopt, {}, ops);
+    out.addTask("Ops two", Priority::Low, nullopt, {}, ops);
+    ASSERT_TRUE(out.saveToFile(path));
+  }
+
+  TaskManager in;
+  ASSERT_TRUE(in.loadFromFile(path));
+  EXPECT_EQ(in.getTask(1)->list, kDefaultList);
+  EXPECT_EQ(in.getTask(2)->list, ops);
+
+  // A page of one list never adopts another list's records
+  TaskManager page;
+  ASSERT_TRUE(page.loadFirstPage(path, Status::Pending, 1, ops));
+  ASSERT_EQ(page.size(), 1u);
+  EXPECT_EQ(page.topTasks(1).front().title, "Ops one");
+  filesystem::remove(path);
+  filesystem::remove(index_path(path));
+  filesystem::remove(search_path(path));
+}
+
+TEST_F(CliTest, NamedListsSelectWithFlag) {
+  ASSERT_EQ(run({"add", "Rotate certs", "--list", "Ops"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Buy milk"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"add", "Bad", "--list", "no spaces"}), EXIT_FAILURE);
+
+  EXPECT_EQ(run({"list", "--list", "ops"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Rotate certs"), string::npos);
+  EXPECT_EQ(output.find("Buy milk"), string::npos);
+  EXPECT_EQ(run({"list"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("2 tasks pending"), string::npos);
+  EXPECT_EQ(run({"search", "milk", "--list", "ops"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("0 tasks found"), string::npos);
+
+  EXPECT_EQ(run({"lists"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("ops"), string::npos);
+  EXPECT_NE(output.find("2 lists."), string::npos);
+}
+
+/* ---------------------- Tests for Multi-Process Access ---------------------- */
+TEST(Persistence, GenerationDetectsConcurrentWriters) {
+  string path = temp_store("generation.json");
+  {
+    TaskManager first;
+    first.addTask("Seed");
+    ASSERT_TRUE(first.saveToFile(path));
+  }
+
+  TaskManager a, b;
+  ASSERT_TRUE(a.loadFromFile(path));
+  ASSERT_TRUE(b.loadFromFile(path));
+  a.addTask("From A");
+  b.addTask("From B");
+  EXPECT_EQ(a.saveIfUnchanged(path), TaskManager::SaveResult::Saved);
+  EXPECT_EQ(b.saveIfUnchanged(path), TaskManager::SaveResult::Conflict);
+
+  // An in-place patch moves the generation too
+  TaskManager c;
+  ASSERT_TRUE(c.loadFromFile(path));
+  EXPECT_EQ(TaskManager::patchStatus(path, 1, Status::Completed), TaskManager::PatchResult::Patched);
+  EXPECT_EQ(c.saveIfUnchanged(path), TaskManager::SaveResult::Conflict);
+
+  TaskManager d;
+  ASSERT_TRUE(d.loadFromFile(path));
+  EXPECT_EQ(d.getTask(1)->state, Status::Completed);
+  EXPECT_EQ(d.size(), 2u);
+  EXPECT_EQ(d.saveIfUnchanged(path), TaskManager::SaveResult::Saved);
+  filesystem::remove(path);
+  filesystem::remove(index_path(path));
+  filesystem::remove(search_path(path));
+  filesystem::remove(lock_path(path));
+}
+
+TEST_F(CliTest, ConcurrentAddProcessesLoseNothing) {
+  constexpr int kProcs = 200;
+  int saved_max = MAX_TASKS;
+  MAX_TASKS = kProcs;
+
+  vector<pid_t> children;
+  for (int p = 0; p < kProcs; ++p) {
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+      freopen("/dev/null", "w", stdout);
+      freopen("/dev/null", "w", stderr);
+      string title = "Parallel task " + to_string(p);
+      char *args[] = {(char *)"todo", (char *)"add", title.data()};
+      _exit(TaskCLI().run(3, args));
+    }
+    children.push_back(pid);
+  }
+
+  int failures = 0;
+  for (pid_t pid : children) {
+    int status = 0;
+    waitpid(pid, &status, 0);
+    failures += !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS;
+  }
+  MAX_TASKS = saved_max;
+  EXPECT_EQ(failures, 0);
+
+  TaskManager mgr;
+  ASSERT_TRUE(mgr.loadFromFile(STORE_FILE));
+  EXPECT_EQ(mgr.size(), size_t(kProcs));
+  EXPECT_EQ(mgr.searchTasks("parallel task").size(), size_t(kProcs));
+}
+
+/* ------------------------- Tests for Store Merging ------------------------- */
+// Every task by uid: (title, status), to compare stores whose ids differ.
+static map<uint64_t, pair<string, Status>> by_uid(TaskManager &mgr) {
+  map<uint64_t, pair<string, Status>> out;
+  for (const Task &t : mgr.topTasks(SIZE_MAX, Status::All))
+    out[t.uid] = {t.title, t.state};
+  return out;
+}
+
+TEST(TaskManagerMerge, DivergedCopiesConverge) {
+  string base = temp_store("merge_base.json"), left = temp_store("merge_left.json"),
+         right = temp_store("merge_right.json");
+  {
+    TaskManager seed;
+    seed.addTask("Shared one");
+    seed.addTask("Shared two");
+    seed.addTask("Shared three");
+    ASSERT_TRUE(seed.saveToFile(base));
+  }
+
+  // Each side changes its own copy
+  TaskManager a, b;
+  ASSERT_TRUE(a.loadFromFile(base));
+  ASSERT_TRUE(b.loadFromFile(base));
+  ASSERT_TRUE(a.completeTask(1));
+  a.addTask("Only on A");
+  ASSERT_TRUE(b.removeTask(2));
+  ASSERT_TRUE(b.archiveTask(3));
+  b.addTask("Only on B");
+  ASSERT_TRUE(a.saveToFile(left));
+  ASSERT_TRUE(b.saveToFile(right));
+
+  auto stats = a.mergeFile(right);
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_EQ(stats->added, 1u);
+  EXPECT_EQ(stats->updated, 1u);
+  EXPECT_EQ(stats->removed, 1u);
+  ASSERT_TRUE(b.mergeFile(left).has_value());
+
+  auto merged = by_uid(a);
+  EXPECT_EQ(merged, by_uid(b));
+  ASSERT_EQ(merged.size(), 4u);
+  EXPECT_EQ(a.getTask(1)->state, Status::Completed);
+  EXPECT_FALSE(a.getTask(2).has_value());
+  EXPECT_EQ(a.getTask(3)->state, Status::Archived);
+  EXPECT_EQ(a.searchTasks("only").size(), 2u);
+
+  // A local change after the merge beats everything merged in
+  ASSERT_TRUE(a.archiveTask(1));
+  ASSERT_TRUE(a.saveToFile(left));
+  ASSERT_TRUE(b.mergeFile(left).has_value());
+  EXPECT_EQ(by_uid(b), by_uid(a));
+  for (const string &path : {base, left, right})
+    remove_store(path);
+}
+
+TEST(TaskManagerMerge, SameTaskAddedTwiceKeepsOneAndRestoreOutlivesRemoval) {
+  string left = temp_store("merge_twice_left.json"), right = temp_store("merge_twice_right.json");
+  TaskManager a, b;
+  a.addTask("Buy milk");
+  b.addTask("Buy milk");
+  ASSERT_TRUE(a.saveToFile(left));
+  ASSERT_TRUE(b.saveToFile(right));
+  ASSERT_TRUE(a.mergeFile(right).has_value());
+  ASSERT_TRUE(b.mergeFile(left).has_value());
+  EXPECT_EQ(a.size(), 1u);
+  EXPECT_EQ(by_uid(a), by_uid(b));
+
+  // Removed on one side, then restored there: the restore is the later change
+  Task kept = a.topTasks(1, Status::All).front();
+  ASSERT_TRUE(a.removeTask(kept.id));
+  ASSERT_TRUE(a.saveToFile(left));
+  ASSERT_TRUE(b.mergeFile(left).has_value());
+  EXPECT_EQ(b.size(), 0u);
+  ASSERT_TRUE(a.restoreTask(kept));
+  ASSERT_TRUE(a.saveToFile(left));
+  ASSERT_TRUE(b.mergeFile(left).has_value());
+  EXPECT_EQ(by_uid(b), by_uid(a));
+  EXPECT_EQ(b.size(), 1u);
+  remove_store(left);
+  remove_store(right);
+}
+
+TEST_F(CliTest, MergeAnotherStoreIncludingPatchedStatus) {
+  ASSERT_EQ(run({"add", "Pay rent"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Call mom"}), EXIT_SUCCESS);
+  filesystem::copy_file(STORE_FILE, "laptop.json");
+  filesystem::copy_file(index_path(STORE_FILE), index_path("laptop.json"));
+
+  // The laptop completes a task through the in-place patch and adds another
+  ASSERT_EQ(TaskManager::patchStatus("laptop.json", 1, Status::Completed), TaskManager::PatchResult::Patched);
+  {
+    TaskManager laptop;
+    ASSERT_TRUE(laptop.loadFromFile("laptop.json"));
+    laptop.addTask("Book flights");
+    ASSERT_TRUE(laptop.saveToFile("laptop.json"));
+  }
+
+  ASSERT_EQ(run({"merge", "laptop.json"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("1 added, 1 updated, 0 removed"), string::npos);
+  EXPECT_EQ(run({"list", "--all"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Book flights"), string::npos);
+  EXPECT_NE(output.find("3 tasks total"), string::npos);
+
+  TaskManager here;
+  ASSERT_TRUE(here.loadFromFile(STORE_FILE));
+  EXPECT_EQ(here.getTask(1)->state, Status::Completed);
+  EXPECT_EQ(run({"merge", "missing.json"}), EXIT_FAILURE);
+}
+
+/* ------------------------- Tests for Cold Archive ------------------------ */
+TEST(LzCodec, RoundTripsAndRejectsCorruptInput) {
+  mt19937 rng(7);
+  string noise(5000, '\0');
+  for (char &c : noise)
+    c = static_cast<char>(rng());
+  string records;
+  for (int i = 0; i < 500; ++i)
+    records += "\t\t{\n\t\t\t\"id\": " + to_string(i) + ",\n\t\t\t\"title\": \"Task " + to_string(i % 37) + "\",\n";
+
+  for (const string &raw : {string{}, string("abc"), string(70000, 'x'), noise, records}) {
+    string packed = lz_compress(raw);
+    EXPECT_EQ(lz_decompress(packed, raw.size()), raw);
+  }
+  EXPECT_LT(lz_compress(records).size(), records.size() / 4);
+
+  string packed = lz_compress(records);
+  EXPECT_EQ(lz_decompress(packed, records.size() + 1), nullopt);
+  EXPECT_EQ(lz_decompress(packed.substr(0, packed.size() / 2), records.size()), nullopt);
+}
+
+TEST(Persistence, FinishedTasksMoveToTheColdArchive) {
+  string path = temp_store("tiered_tasks.json");
+  remove_store(path);
+  TaskManager out;
+  out.setTaskLimit(1000);
+  for (int i = 1; i <= 200; ++i)
+    out.addTask("Chore " + to_string(i));
+  for (int id = 1; id <= 100; ++id)
+    out.completeTask(id);
+  ASSERT_TRUE(out.saveToFile(path));
+  for (int id = 101; id <= 150; ++id)
+    out.completeTask(id);
+  for (int id = 151; id <= 175; ++id)
+    out.archiveTask(id);
+  ASSERT_TRUE(out.saveToFile(path));
+
+  // Pending tasks and the newest completions stay hot; cold ids stay taken
+  TaskManager hot;
+  hot.setTaskLimit(1000);
+  ASSERT_TRUE(hot.loadFromFile(path));
+  EXPECT_EQ(hot.size(), 25u + kHotCompleted);
+  EXPECT_EQ(hot.count(Status::Archived), 0u);
+  EXPECT_TRUE(hot.getTask(150).has_value());
+  EXPECT_FALSE(hot.getTask(151).has_value());
+  EXPECT_EQ(hot.addTask("Fresh"), 201);
+
+  // A cold task that changes comes back to the hot file; stale copies go
+  EXPECT_EQ(hot.loadArchive(path), 75u);
+  EXPECT_EQ(hot.loadArchive(path), 0u);
+  Task before = *hot.getTask(151);
+  before.state = Status::Pending;
+  ASSERT_TRUE(hot.revertTask(before));
+  ASSERT_TRUE(hot.removeTask(160));
+  ASSERT_TRUE(hot.saveToFile(path));
+
+  TaskManager again;
+  ASSERT_TRUE(again.loadFromFile(path));
+  EXPECT_EQ(again.getTask(151)->state, Status::Pending);
+  EXPECT_EQ(TaskManager::searchArchive(path, "151").size(), 0u);
+  EXPECT_EQ(TaskManager::searchArchive(path, "160").size(), 0u);
+  EXPECT_EQ(TaskManager::searchArchive(path, "170").size(), 1u);
+  again.loadArchive(path);
+  EXPECT_FALSE(again.getTask(160).has_value());
+  EXPECT_EQ(again.size(), 200u);
+  remove_store(path);
+}
+
+TEST_F(CliTest, ArchivedTasksListAndSearchFromTheArchive) {
+  ASSERT_EQ(run({"add", "Renew passport"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Buy stamps"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"archive", "1"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Post letter"}), EXIT_SUCCESS); // full save moves #1 to the archive
+  ASSERT_TRUE(filesystem::exists(archive_path(STORE_FILE)));
+
+  EXPECT_EQ(run({"list"}), EXIT_SUCCESS);
+  EXPECT_EQ(output.find("Renew passport"), string::npos);
+  EXPECT_EQ(run({"list", "--archived"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Renew passport"), string::npos);
+  EXPECT_EQ(run({"search", "passport"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("1 tasks found"), string::npos);
+
+  // Commands on a cold task still find it, and undo brings it back
+  EXPECT_EQ(run({"undo"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"undo"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"list"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Renew passport"), string::npos);
+  EXPECT_EQ(run({"archive", "1"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"add", "Water plants"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"remove", "1"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"search", "passport"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("0 tasks found"), string::npos);
+}
+
+/* ---------------------- Tests for Compressed Storage --------------------- */
+TEST(BlockStore, BlocksEndOnCutsAndSeekAnywhere) {
+  string text;
+  vector<uint64_t> cuts;
+  for (int i = 0; i < 20000; ++i) {
+    text += "record " + to_string(i) + " of the block store test\n";
+    cuts.push_back(text.size());
+  }
+  string file = pack_blocks(text, cuts);
+  auto blocks = block_index(file);
+  ASSERT_TRUE(blocks.has_value());
+  ASSERT_GT(blocks->size(), 5u);
+  EXPECT_LT(file.size(), text.size() / 3);
+  for (const BlockEntry &b : *blocks) {
+    EXPECT_TRUE(binary_search(cuts.begin(), cuts.end(), b.raw_offset + b.raw_size));
+    EXPECT_EQ(unpack_block(file, b), text.substr(b.raw_offset, b.raw_size));
+  }
+
+  string path = temp_store("blocks.bin");
+  { ofstream(path, ios::binary) << file; }
+  BlockStream in(path);
+  string line;
+  for (uint64_t at : {uint64_t{0}, (*blocks)[3].raw_offset - 5, uint64_t{text.size() - 40}}) {
+    in.clear();
+    in.seekg(static_cast<streamoff>(at));
+    ASSERT_TRUE(getline(in, line));
+    EXPECT_EQ(line, text.substr(at, text.find('\n', at) - at));
+  }
+  in.seekg(0);
+  string all((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+  EXPECT_EQ(all, text);
+  filesystem::remove(path);
+
+  file[file.size() - 1] = 'X';
+  EXPECT_FALSE(block_index(file).has_value());
+}
+
+TEST(Persistence, CompressedStoreRoundTripsThroughEveryReader) {
+  string path = temp_store("compressed_tasks.json");
+  remove_store(path);
+  TaskManager out;
+  out.setTaskLimit(5000);
+  for (int i = 0; i < 3000; ++i)
+    out.addTask("Compressed " + to_string(i), static_cast<Priority>(i % 4));
+  ASSERT_TRUE(out.saveToFile(path));
+  uintmax_t plain = filesystem::file_size(path);
+  out.setCompressed(true);
+  ASSERT_TRUE(out.saveToFile(path));
+  EXPECT_LT(filesystem::file_size(path), plain / 3);
+
+  TaskManager seq, par;
+  ASSERT_TRUE(seq.loadFromFile(path, 1));
+  ASSERT_TRUE(par.loadFromFile(path, 4));
+  EXPECT_TRUE(seq.isCompressed());
+  EXPECT_EQ(seq.topTasks(SIZE_MAX), out.topTasks(SIZE_MAX));
+  EXPECT_EQ(par.topTasks(SIZE_MAX), out.topTasks(SIZE_MAX));
+
+  TaskManager page;
+  ASSERT_TRUE(page.loadFirstPage(path, Status::Pending, 5));
+  EXPECT_EQ(page.topTasks(5), out.topTasks(5));
+  auto hits = TaskManager::searchFile(path, "compressed 2999");
+  ASSERT_TRUE(hits.has_value());
+  ASSERT_EQ(hits->size(), 1u);
+  EXPECT_EQ(hits->front().id, 3000);
+
+  // No in-place patch; a full save keeps the form until it is switched off
+  EXPECT_EQ(TaskManager::patchStatus(path, 1, Status::Completed), TaskManager::PatchResult::Unavailable);
+  seq.completeTask(1);
+  EXPECT_EQ(seq.saveIfUnchanged(path), TaskManager::SaveResult::Saved);
+  TaskManager again;
+  ASSERT_TRUE(again.loadFromFile(path));
+  EXPECT_EQ(again.getTask(1)->state, Status::Completed);
+  again.setCompressed(false);
+  ASSERT_TRUE(again.saveToFile(path));
+  EXPECT_EQ(TaskManager::patchStatus(path, 2, Status::Completed), TaskManager::PatchResult::Patched);
+  remove_store(path);
+}
+
+TEST_F(CliTest, CompressOnAndOff) {
+  ASSERT_EQ(run({"add", "Renew passport"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Buy stamps"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"compress", "sideways"}), EXIT_FAILURE);
+  ASSERT_EQ(run({"compress", "on"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("compressed"), string::npos);
+
+  EXPECT_EQ(run({"complete", "2"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"add", "Post letter"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"list", "--limit", "5"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("2 tasks pending"), string::npos);
+  EXPECT_EQ(run({"search", "stamps"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("1 tasks found"), string::npos);
+
+  ASSERT_EQ(run({"compress", "off"}), EXIT_SUCCESS);
+  ifstream in(STORE_FILE);
+  EXPECT_EQ(in.get(), '{');
+}
+
+TEST(TaskManagerEdit, UpdateKeepsHeapAndIndexesInStep) {
+  TaskManager mgr;
+  mgr.setTaskLimit(1000);
+  for (int i = 0; i < 300; ++i)
+    mgr.addTask("Chore " + to_string(i), static_cast<Priority>(i % 4));
+
+  // Random re-prioritising and removals; the heap must stay exactly ranked
+  mt19937 rng(7);
+  for (int step = 0; step < 500; ++step) {
+    int id = static_cast<int>(rng() % 300) + 1;
+    if (step % 10 == 9) {
+      mgr.removeTask(id);
+    } else if (mgr.getTask(id).has_value()) {
+      ASSERT_TRUE(mgr.updateTask(id, {nullopt, static_cast<Priority>(rng() % 4), nullopt}));
+    }
+  }
+  auto ranked = mgr.topTasks(SIZE_MAX);
+  EXPECT_EQ(ranked.size(), mgr.size());
+  EXPECT_TRUE(is_sorted(ranked.begin(), ranked.end(),
+                        [](const Task &a, const Task &b) { return a.sort_key > b.sort_key; }));
+
+  int id = ranked.back().id;
+  ASSERT_TRUE(mgr.updateTask(id, {"Urgent renewal", Priority::Critical, today}));
+  EXPECT_EQ(mgr.topTasks(1).front().id, id);
+  EXPECT_TRUE(mgr.searchTasks("chore " + to_string(id - 1)).empty());
+  ASSERT_EQ(mgr.searchTasks("urgent").size(), 1u);
+  TaskQuery query;
+  string error;
+  ASSERT_TRUE(query.addTerm("due<=" + to_string(today), error));
+  EXPECT_EQ(mgr.queryTasks(query).size(), 1u);
+
+  // Clearing the due date drops it from the due index; clashes are refused
+  ASSERT_TRUE(mgr.updateTask(id, {nullopt, nullopt, optional<ymd>{}}));
+  EXPECT_TRUE(mgr.queryTasks(query).empty());
+  int other = ranked.front().id;
+  EXPECT_FALSE(mgr.updateTask(other, {"URGENT renewal", nullopt, nullopt}));
+  EXPECT_FALSE(mgr.updateTask(other, {"", nullopt, nullopt}));
+  EXPECT_FALSE(mgr.updateTask(9999, {"Nothing", nullopt, nullopt}));
+  int daily = mgr.addTask("Stand-up", Priority::High, today, Recurrence{Repeat::Days, 1});
+  EXPECT_FALSE(mgr.updateTask(daily, {nullopt, nullopt, optional<ymd>{}}));
+}
+
+TEST(Persistence, EditsAreJournalledUntilTheNextFullSave) {
+  string path = temp_store("journal_tasks.json");
+  remove_store(path);
+  {
+    TaskManager out;
+    out.addTask("Draft report", Priority::Low);
+    out.addTask("Book flights", Priority::Medium);
+    ASSERT_TRUE(out.saveToFile(path));
+  }
+  uintmax_t size = filesystem::file_size(path);
+
+  TaskManager mgr;
+  ASSERT_TRUE(mgr.loadFromFile(path));
+  ASSERT_TRUE(mgr.updateTask(1, {"Draft quarterly report", Priority::Critical, nullopt}));
+  EXPECT_EQ(mgr.saveTaskIfUnchanged(path, 1), TaskManager::SaveResult::Saved);
+  EXPECT_EQ(filesystem::file_size(path), size);
+  EXPECT_TRUE(filesystem::exists(journal_path(path)));
+
+  // Every reader sees the edit; the indexed fast paths step aside
+  TaskManager again;
+  ASSERT_TRUE(again.loadFromFile(path));
+  EXPECT_EQ(again.getTask(1)->title, "Draft quarterly report");
+  EXPECT_EQ(again.topTasks(1).front().id, 1);
+  EXPECT_FALSE(TaskManager::searchFile(path, "quarterly").has_value());
+  TaskManager page;
+  ASSERT_TRUE(page.loadFirstPage(path, Status::Pending, 1));
+  EXPECT_EQ(page.topTasks(1).front().id, 1);
+
+  // A status patched in place afterwards keeps both changes
+  Task before;
+  ASSERT_EQ(TaskManager::patchStatus(path, 1, Status::Completed, &before), TaskManager::PatchResult::Patched);
+  EXPECT_EQ(before.title, "Draft quarterly report");
+  EXPECT_EQ(mgr.saveTaskIfUnchanged(path, 1), TaskManager::SaveResult::Conflict);
+  TaskManager patched;
+  ASSERT_TRUE(patched.loadFromFile(path));
+  EXPECT_EQ(patched.getTask(1)->state, Status::Completed);
+  EXPECT_EQ(patched.getTask(1)->pr, Priority::Critical);
+
+  ASSERT_EQ(patched.saveIfUnchanged(path), TaskManager::SaveResult::Saved);
+  EXPECT_FALSE(filesystem::exists(journal_path(path)));
+  ASSERT_TRUE(TaskManager::searchFile(path, "quarterly").has_value());
+  EXPECT_EQ(TaskManager::searchFile(path, "quarterly")->size(), 1u);
+  remove_store(path);
+}
+
+TEST_F(CliTest, EditThenUndoAndRedo) {
+  ASSERT_EQ(run({"add", "Call plumber"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Pay rent", "--due", "2030-01-01"}), EXIT_SUCCESS);
+  EXPECT_EQ(run({"edit", "1"}), EXIT_FAILURE);
+  EXPECT_EQ(run({"edit", "1", "--due", "someday"}), EXIT_FAILURE);
+  EXPECT_EQ(run({"edit", "1", "--title", "Pay rent", "--due", "2030-01-01"}), EXIT_FAILURE);
+
+  ASSERT_EQ(run({"edit", "1", "--title", "Call electrician", "--priority", "crit"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"edit", "2", "--due", "none"}), EXIT_SUCCESS);
+  EXPECT_TRUE(filesystem::exists(journal_path(STORE_FILE)));
+  EXPECT_EQ(run({"search", "electrician"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("1 tasks found"), string::npos);
+
+  ASSERT_EQ(run({"undo"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"undo"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Undid edit of task #1: Call plumber."), string::npos);
+  EXPECT_EQ(run({"search", "plumber"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("1 tasks found"), string::npos);
+  ASSERT_EQ(run({"redo"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Redid edit of task #1: Call electrician."), string::npos);
+  EXPECT_EQ(run({"search", "electrician"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("1 tasks found"), string::npos);
+}
+
+TEST(Persistence, CursorPagesSeekTheRankedStoreAndStayStable) {
+  string path = temp_store("paged_tasks.json");
+  remove_store(path);
+  TaskManager mgr;
+  mgr.setTaskLimit(2000);
+  for (int i = 0; i < 600; ++i)
+    mgr.addTask("Item " + to_string(i) + "}", static_cast<Priority>(i % 4),
+                i % 3 ? optional{ymd{chrono::sys_days{today} + chrono::days{i % 20}}} : nullopt);
+  for (int id = 1; id <= 600; id += 50)
+    mgr.completeTask(id);
+  mgr.addDependency(2, 3);
+  ASSERT_TRUE(mgr.saveToFile(path));
+  vector<Task> everything = mgr.topTasks(SIZE_MAX);
+
+  for (bool packed : {false, true}) {
+    mgr.setCompressed(packed);
+    ASSERT_TRUE(mgr.saveToFile(path));
+
+    // Pages read from the file, each after the last one's cursor, add up to
+    // the in-memory ranking with nothing repeated or skipped
+    vector<Task> walked;
+    optional<TaskManager::PageCursor> after;
+    for (;;) {
+      TaskManager page;
+      ASSERT_TRUE(page.loadFirstPage(path, Status::Pending, 37, nullopt, after));
+      vector<Task> rows = page.topTasks(37, Status::Pending, nullopt, after ? after->key : UINT64_MAX);
+      EXPECT_EQ(rows, mgr.topTasks(37, Status::Pending, nullopt, after ? after->key : UINT64_MAX));
+      walked.insert(walked.end(), rows.begin(), rows.end());
+      if (rows.size() < 37)
+        break;
+      after = TaskManager::PageCursor{rows.back().sort_key, rows.back().id};
+      ASSERT_EQ(TaskManager::PageCursor::parse(after->str())->key, after->key);
+    }
+    vector<Task> pending = mgr.topTasks(SIZE_MAX, Status::Pending);
+    EXPECT_EQ(walked, pending);
+  }
+
+  // A task added ahead of the cursor does not shift the next page
+  auto cursor = TaskManager::PageCursor{everything[99].sort_key, everything[99].id};
+  vector<Task> next = mgr.topTasks(10, Status::All, nullopt, cursor.key);
+  mgr.addTask("Urgent newcomer", Priority::Critical, today);
+  EXPECT_EQ(mgr.topTasks(10, Status::All, nullopt, cursor.key), next);
+  EXPECT_FALSE(TaskManager::PageCursor::parse("not a cursor").has_value());
+  EXPECT_FALSE(TaskManager::PageCursor::parse("0000001cfffffff500000009").has_value());
+  remove_store(path);
+}
+
+TEST_F(CliTest, ListPagesWithCursor) {
+  for (const char *title : {"Alpha", "Bravo", "Charlie", "Delta", "Echo"})
+    ASSERT_EQ(run({"add", title}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"list", "--limit", "2"}), EXIT_SUCCESS);
+  size_t at = output.find("--after ");
+  ASSERT_NE(at, string::npos);
+  string cursor = output.substr(at + 8, 24);
+  EXPECT_NE(output.find("Bravo"), string::npos);
+
+  ASSERT_EQ(run({"add", "Zulu", "--priority", "crit"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"list", "--limit", "2", "--after", cursor}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("Charlie"), string::npos);
+  EXPECT_NE(output.find("Delta"), string::npos);
+  EXPECT_EQ(output.find("Zulu"), string::npos);
+  EXPECT_EQ(output.find("Bravo"), string::npos);
+
+  EXPECT_EQ(run({"list", "--after", "bogus"}), EXIT_FAILURE);
+  EXPECT_EQ(run({"list", "--limit", "2", "--after", cursor, "pr>=low"}), EXIT_FAILURE);
+}
+
+/* ---------------------------- Tests for Stats ---------------------------- */
+// Counts recomputed from scratch, to compare the incremental ones against
+static StoreStats recount(TaskManager &mgr) {
+  StoreStats fresh;
+  for (const Task &task : mgr.topTasks(SIZE_MAX, Status::All))
+    fresh.tally(task, +1);
+  for (const Task &task : mgr.blockedTasks())
+    fresh.tally(task, +1);
+  return fresh;
+}
+
+TEST(TaskManagerStats, CountsFollowEveryMutation) {
+  chrono::sys_days day{today};
+  TaskManager mgr;
+  mgr.setTaskLimit(100);
+  int late = mgr.addTask("Late", Priority::High, ymd{day - chrono::days{3}});
+  int soon = mgr.addTask("Soon", Priority::Low, ymd{day + chrono::days{2}});
+  int later = mgr.addTask("Later", Priority::Critical, ymd{day + chrono::days{40}});
+  int undated = mgr.addTask("Undated");
+  int blocked = mgr.addTask("Blocked", Priority::Medium, ymd{day + chrono::days{9}});
+  ASSERT_TRUE(mgr.addDependency(blocked, undated));
+
+  ASSERT_TRUE(mgr.completeTask(late));
+  ASSERT_TRUE(mgr.archiveTask(soon));
+  ASSERT_TRUE(mgr.updateTask(later, {nullopt, Priority::Low, optional<ymd>{ymd{day - chrono::days{1}}}}));
+  Task before = *mgr.getTask(undated);
+  ASSERT_TRUE(mgr.completeTask(undated));
+  ASSERT_TRUE(mgr.revertTask(before));
+  ASSERT_TRUE(mgr.removeTask(soon));
+
+  optional<StoreStats> stats = mgr.stats();
+  ASSERT_TRUE(stats.has_value());
+  StoreStats fresh = recount(mgr);
+  EXPECT_EQ(stats->counts, fresh.counts);
+  EXPECT_EQ(stats->due, fresh.due);
+  EXPECT_EQ(stats->total(Status::Pending), 3u);
+  EXPECT_EQ(stats->counts[size_t(Status::Completed)][size_t(Priority::High)], 1u);
+  EXPECT_EQ(stats->overdue(day), 1u);
+  EXPECT_EQ((stats->dueByWeek(day)), (array<size_t, kDueWeeks + 2>{1, 0, 1, 0, 0, 0}));
+  EXPECT_EQ(stats->completedWithin(day, 1), 1u); // the undone completion came back off
+}
+
+TEST(Persistence, SavedStatsCoverTheArchiveAndInPlaceWrites) {
+  string path = temp_store("stats_tasks.json");
+  remove_store(path);
+  TaskManager out;
+  out.setTaskLimit(1000);
+  for (int i = 1; i <= 300; ++i)
+    out.addTask("Chore " + to_string(i), static_cast<Priority>(i % 4),
+                i % 2 ? optional{ymd{chrono::sys_days{today} + chrono::days{i % 50 - 10}}} : nullopt);
+  for (int id = 1; id <= 150; ++id)
+    out.completeTask(id);
+  for (int id = 151; id <= 175; ++id)
+    out.archiveTask(id);
+  ASSERT_TRUE(out.saveToFile(path));
+
+  // What the whole store holds, counted from scratch
+  auto full = [&] {
+    TaskManager all;
+    all.setTaskLimit(1000);
+    all.loadFromFile(path);
+    all.loadArchive(path);
+    return recount(all);
+  };
+  auto same = [](const optional<StoreStats> &stats, const StoreStats &fresh) {
+    return stats.has_value() && stats->counts == fresh.counts && stats->due == fresh.due;
+  };
+
+  // The hot file alone answers for the cold tier too
+  EXPECT_TRUE(same(TaskManager::statsFile(path), full()));
+  EXPECT_EQ(TaskManager::statsFile(path)->completedWithin(chrono::sys_days{today}, 1), 150u);
+  TaskManager hot;
+  hot.setTaskLimit(1000);
+  ASSERT_TRUE(hot.loadFromFile(path));
+  EXPECT_LT(hot.size(), 300u);
+  EXPECT_TRUE(same(hot.stats(), full()));
+
+  // A status patch and a journalled edit keep the saved counts current
+  ASSERT_EQ(TaskManager::patchStatus(path, 200, Status::Completed), TaskManager::PatchResult::Patched);
+  EXPECT_TRUE(same(TaskManager::statsFile(path), full()));
+  EXPECT_EQ(TaskManager::statsFile(path)->completedWithin(chrono::sys_days{today}, 7), 151u);
+  TaskManager editor;
+  editor.setTaskLimit(1000);
+  ASSERT_TRUE(editor.loadFromFile(path));
+  ASSERT_TRUE(editor.updateTask(201, {nullopt, Priority::Critical, optional<ymd>{today}}));
+  ASSERT_EQ(editor.saveTaskIfUnchanged(path, 201), TaskManager::SaveResult::Saved);
+  ASSERT_TRUE(filesystem::exists(journal_path(path)));
+  EXPECT_TRUE(same(TaskManager::statsFile(path), full()));
+
+  // Without the file the cold tier is unknown until the archive is loaded
+  filesystem::remove(stats_path(path));
+  EXPECT_FALSE(TaskManager::statsFile(path).has_value());
+  TaskManager blind;
+  blind.setTaskLimit(1000);
+  ASSERT_TRUE(blind.loadFromFile(path));
+  EXPECT_FALSE(blind.stats().has_value());
+  blind.loadArchive(path);
+  ASSERT_TRUE(blind.saveStats(path));
+  EXPECT_TRUE(same(TaskManager::statsFile(path), full()));
+  remove_store(path);
+}
+
+TEST_F(CliTest, StatsShowCountsAndThroughput) {
+  ASSERT_EQ(run({"add", "Old bill", "--priority", "high", "--due", "2001-01-01"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Walk dog"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Feed cat"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"complete", "2"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"archive", "3"}), EXIT_SUCCESS);
+
+  ASSERT_EQ(run({"stats"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("overdue          1"), string::npos);
+  EXPECT_NE(output.find("1 today"), string::npos);
+  EXPECT_NE(output.find("TOTAL            0       2       1       0       3"), string::npos);
+
+  // Rebuilt when the saved counts are gone
+  filesystem::remove(stats_path(STORE_FILE));
+  ASSERT_EQ(run({"stats"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("overdue          1"), string::npos);
+  EXPECT_TRUE(filesystem::exists(stats_path(STORE_FILE)));
+  EXPECT_EQ(run({"stats", "--list", "work"}), EXIT_FAILURE);
+}
+
+TEST(History, AppendsScanMergesRunsAndCutsATornTail) {
+  string path = temp_store("history_tasks.json.history");
+  filesystem::remove(path);
+  vector<HistoryEvent> all;
+  for (int i = 0; i < 150; ++i) {
+    HistoryEvent event{1700000000 + i * 37, 1 + i % 9, static_cast<HistoryKind>(i % 5), static_cast<Priority>(i % 4),
+                       i % 3 != 0};
+    ASSERT_TRUE(append_history(path, span{&event, 1}));
+    all.push_back(event);
+  }
+  vector<HistoryEvent> seen;
+  EXPECT_EQ(scan_history(path, [&](const HistoryEvent &event) { seen.push_back(event); }), all.size());
+  EXPECT_EQ(seen, all);
+
+  // Two full runs were merged, so the file is far smaller than 150 frames
+  uintmax_t merged = filesystem::file_size(path);
+  EXPECT_LT(merged, 150u * 20);
+
+  // Half a frame from an interrupted write is cut off by the next append
+  {
+    ofstream out(path, ios::binary | ios::app);
+    out.write("THIS\x05\x20garbage", 13);
+  }
+  HistoryEvent last{1800000000, 4, HistoryKind::Completed, Priority::High, true};
+  ASSERT_TRUE(append_history(path, span{&last, 1}));
+  all.push_back(last);
+  seen.clear();
+  scan_history(path, [&](const HistoryEvent &event) { seen.push_back(event); });
+  EXPECT_EQ(seen, all);
+  filesystem::remove(path);
+}
+
+TEST(Persistence, HistoryRecordsTransitionsForTheReport) {
+  string path = temp_store("history_tasks.json");
+  remove_store(path);
+  TaskManager mgr;
+  int fix = mgr.addTask("Fix bug", Priority::High);
+  int doc = mgr.addTask("Write docs", Priority::Low);
+  int old = mgr.addTask("Old idea");
+  ASSERT_TRUE(mgr.completeTask(fix));
+  ASSERT_TRUE(mgr.removeTask(old));
+  ASSERT_TRUE(mgr.saveToFile(path));
+  ASSERT_EQ(TaskManager::patchStatus(path, doc, Status::Archived), TaskManager::PatchResult::Patched);
+
+  vector<HistoryKind> kinds;
+  scan_history(history_path(path), [&](const HistoryEvent &event) { kinds.push_back(event.kind); });
+  EXPECT_EQ(kinds, (vector<HistoryKind>{HistoryKind::Created, HistoryKind::Created, HistoryKind::Created,
+                                        HistoryKind::Completed, HistoryKind::Removed, HistoryKind::Archived}));
+
+  // Three added and three closed today, nothing left open
+  chrono::sys_days day{today};
+  HistoryReport report = build_report(history_path(path), day - chrono::days{2}, day, 0);
+  ASSERT_EQ(report.days.size(), 3u);
+  EXPECT_EQ(report.days[2].added, 3u);
+  EXPECT_EQ(report.days[2].closed, 3u);
+  EXPECT_EQ(report.days[1].open, 0u);
+  EXPECT_EQ(report.lead_hours[size_t(Priority::High)].size(), 1u);
+  EXPECT_TRUE(report.lead_hours[size_t(Priority::Low)].empty());
+  remove_store(path);
+
+  // The backlog walks back from today's count; lead times span days
+  string events = temp_store("history_report.history");
+  filesystem::remove(events);
+  int64_t midnight = chrono::duration_cast<chrono::seconds>(day.time_since_epoch()).count();
+  vector<HistoryEvent> log = {
+      {midnight - 2 * 86400, 1, HistoryKind::Created, Priority::Medium, true},
+      {midnight - 2 * 86400 + 60, 2, HistoryKind::Created, Priority::Critical, true},
+      {midnight - 86400, 1, HistoryKind::Completed, Priority::Medium, true},
+      {midnight + 3600, 2, HistoryKind::Completed, Priority::Critical, true},
+      {midnight + 7200, 3, HistoryKind::Created, Priority::Medium, true},
+  };
+  ASSERT_TRUE(append_history(events, log));
+  report = build_report(events, day - chrono::days{2}, day, 5);
+  EXPECT_EQ(report.days[0].added, 2u);
+  EXPECT_EQ(report.days[0].open, 6u);
+  EXPECT_EQ(report.days[1].open, 5u);
+  EXPECT_EQ(report.days[2].open, 5u);
+  EXPECT_EQ(report.lead_hours[size_t(Priority::Medium)], vector<double>{24});
+  ASSERT_EQ(report.lead_hours[size_t(Priority::Critical)].size(), 1u);
+  EXPECT_NEAR(report.lead_hours[size_t(Priority::Critical)][0], 49 - 1.0 / 60, 1e-9);
+  filesystem::remove(events);
+}
+
+TEST_F(CliTest, ReportShowsBurnDownAndLeadTimes) {
+  ASSERT_EQ(run({"add", "Fix bug", "--priority", "high"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Walk dog"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"complete", "1"}), EXIT_SUCCESS);
+  ASSERT_TRUE(filesystem::exists(history_path(STORE_FILE)));
+
+  ASSERT_EQ(run({"report"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("       2       1       1"), string::npos);
+  EXPECT_NE(output.find("HIGH             1       0.0"), string::npos);
+  ASSERT_EQ(run({"report", "--since", "2000-01-01"}), EXIT_SUCCESS);
+  EXPECT_NE(output.find("WEEK OF"), string::npos);
+  EXPECT_EQ(run({"report", "--since", "tomorrow"}), EXIT_FAILURE);
+  EXPECT_EQ(run({"report", "--list", "work"}), EXIT_FAILURE);
+}
+
+TEST(TimerWheel, FiresLikeASortedListAndCancelsInPlace) {
+  mt19937_64 rng(5);
+  int64_t start = 1700000000;
+  TimerWheel wheel(start);
+  multimap<int64_t, uint64_t> expected; //< Reference: fire tick → payload.
+  map<uint64_t, pair<TimerWheel::Handle, int64_t>> live;
+  uint64_t serial = 1;
+  int64_t now = start;
+
+  for (int round = 0; round < 2000; ++round) {
+    // Spread ticks over seconds to years so every level is used
+    for (int i = 0; i < 5; ++i) {
+      int64_t when = now + static_cast<int64_t>(rng() % (int64_t{1} << (rng() % 30)));
+      live[serial] = {wheel.schedule(when, serial), when};
+      expected.emplace(when, serial++);
+    }
+    if (!live.empty() && rng() % 2 == 0) {
+      auto it = next(live.begin(), static_cast<long>(rng() % live.size()));
+      ASSERT_TRUE(wheel.cancel(it->second.first));
+      EXPECT_FALSE(wheel.cancel(it->second.first));
+      auto [from, to] = expected.equal_range(it->second.second);
+      expected.erase(find_if(from, to, [&](auto &entry) { return entry.second == it->first; }));
+      live.erase(it);
+    }
+
+    now += static_cast<int64_t>(rng() % (int64_t{1} << (rng() % 24)));
+    vector<pair<int64_t, uint64_t>> fired;
+    wheel.advance(now, [&](uint64_t payload, int64_t when) { fired.emplace_back(when, payload); });
+    vector<pair<int64_t, uint64_t>> want;
+    for (auto it = expected.begin(); it != expected.end() && it->first <= now; it = expected.erase(it)) {
+      want.emplace_back(it->first, it->second);
+      live.erase(it->second);
+    }
+    sort(fired.begin(), fired.end());
+    sort(want.begin(), want.end());
+    ASSERT_EQ(fired, want) << "round " << round;
+    ASSERT_EQ(wheel.size(), expected.size());
+    if (!expected.empty()) {
+      ASSERT_LE(wheel.nextWake(), expected.begin()->first);
+    }
+  }
+}
+
+TEST(DueWatcher, RemindsOnceAndFollowsRescheduling) {
+  int64_t day = 86400;
+  ymd due{chrono::year{2030}, chrono::month{6}, chrono::day{10}};
+  int64_t deadline = due_deadline(due);
+  DueWatcher watcher({day, 2 * day}, deadline - 3 * day);
+  vector<pair<int, int64_t>> events;
+  auto record = [&](const DueEvent &event) { events.emplace_back(event.id, event.lead); };
+  auto sorted = [&] {
+    sort(events.begin(), events.end());
+    return events;
+  };
+
+  Task rent(1, "Rent", Priority::High, due);
+  Task late(2, "Late", Priority::Low, ymd{chrono::sys_days{due} - chrono::days{30}});
+  Task later(3, "Later", Priority::Low, ymd{chrono::sys_days{due} + chrono::days{1}});
+  EXPECT_EQ(watcher.sync({rent, late, later}), 3u);
+  EXPECT_EQ(watcher.sync({rent, late, later}), 0u); // unchanged due dates keep their timers
+
+  // Already overdue: only the deadline, at once
+  watcher.advance(deadline - 3 * day, record);
+  EXPECT_EQ(sorted(), (vector<pair<int, int64_t>>{{2, 0}}));
+  events.clear();
+  watcher.advance(deadline - day, record);
+  EXPECT_EQ(sorted(), (vector<pair<int, int64_t>>{{1, day}, {1, 2 * day}, {3, 2 * day}}));
+
+  // Pushing rent back a day re-arms its reminders; dropping `late` and
+  // finishing `later` cancels theirs
+  events.clear();
+  rent.due = ymd{chrono::sys_days{due} + chrono::days{1}};
+  later.state = Status::Completed;
+  EXPECT_EQ(watcher.sync({rent, later}), 3u);
+  EXPECT_EQ(watcher.size(), 1u);
+  watcher.advance(deadline + day, record);
+  EXPECT_EQ(sorted(), (vector<pair<int, int64_t>>{{1, 0}, {1, day}, {1, 2 * day}}));
+}
+
+TEST_F(CliTest, WatchReportsOverdueAndRunsTheHook) {
+  ASSERT_EQ(run({"add", "Old bill", "--priority", "high", "--due", "2001-01-01"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Someday", "--due", "2999-01-01"}), EXIT_SUCCESS);
+  ASSERT_EQ(run({"add", "Undated"}), EXIT_SUCCESS);
+
+  ASSERT_EQ(run({"watch", "--once", "--remind", "1d", "--exec", "echo \"$TODO_EVENT $TODO_ID $TODO_DUE\" >> hook.txt"}),
+            EXIT_SUCCESS);
+  EXPECT_NE(output.find("overdue\033[0m  #1  HIGH  Old bill (due 2001-01-01)"), string::npos);
+  EXPECT_EQ(output.find("Someday"), string::npos);
+  ifstream in("hook.txt");
+  string line;
+  ASSERT_TRUE(getline(in, line));
+  EXPECT_EQ(line, "overdue 1 2001-01-01");
+  EXPECT_FALSE(getline(in, line));
+  EXPECT_EQ(run({"watch", "--remind", "soon"}), EXIT_FAILURE);
+}
+
+/**
+ * @brief  Every loaded task's visible state, ordered by id, for comparing a
+ *         followed manager with a fresh load.
+ */
+static vector<tuple<int, string, int, int, bool>> contents(TaskManager &mgr) {
+  vector<tuple<int, string, int, int, bool>> out;
+  for (Status state : {Status::Pending, Status::Completed, Status::Archived})
+    for (const Task &task : mgr.topTasks(SIZE_MAX, state))
+      out.emplace_back(task.id, task.title, static_cast<int>(task.pr), static_cast<int>(task.state), false);
+  for (const Task &task : mgr.blockedTasks())
+    out.emplace_back(task.id, task.title, static_cast<int>(task.pr), static_cast<int>(task.state), true);
+  sort(out.begin(), out.end());
+  return out;
+}
+
+TEST(StoreFollower, JournalTailAndRecordDiffMatchAFreshLoad) {
+  string path = temp_store("follow_tasks.json");
+  remove_store(path);
+  {
+    TaskManager out;
+    int a = out.addTask("Renew passport", Priority::High);
+    out.addTask("Draft report", Priority::Low);
+    int c = out.addTask("Book flights", Priority::Medium);
+    ASSERT_TRUE(out.addDependency(c, a));
+    out.addTask("Call plumber", Priority::Low);
+    ASSERT_TRUE(out.saveToFile(path));
+  }
+  auto fresh = [&] {
+    TaskManager mgr;
+    mgr.loadFromFile(path);
+    return contents(mgr);
+  };
+
+  StoreFollower follower(path);
+  TaskManager mgr;
+  ASSERT_TRUE(follower.load(mgr));
+  EXPECT_EQ(follower.refresh(mgr).kind, StoreFollower::Refresh::Kind::Unchanged);
+  EXPECT_EQ(mgr.blockedTasks().size(), 1u);
+
+  // An edit appended to the journal: only the new journal record is parsed
+  TaskManager writer;
+  ASSERT_TRUE(writer.loadFromFile(path));
+  ASSERT_TRUE(writer.updateTask(2, {"Draft quarterly report", Priority::Critical, nullopt}));
+  ASSERT_EQ(writer.saveTaskIfUnchanged(path, 2), TaskManager::SaveResult::Saved);
+  StoreFollower::Refresh step = follower.refresh(mgr);
+  EXPECT_EQ(step.kind, StoreFollower::Refresh::Kind::Journal);
+  EXPECT_EQ(step.parsed, 1u);
+  EXPECT_EQ(mgr.getTask(2)->title, "Draft quarterly report");
+  EXPECT_EQ(contents(mgr), fresh());
+
+  // A status patched in place: only that record, with its journaled edit
+  ASSERT_EQ(TaskManager::patchStatus(path, 2, Status::Completed), TaskManager::PatchResult::Patched);
+  step = follower.refresh(mgr);
+  EXPECT_EQ(step.kind, StoreFollower::Refresh::Kind::Diff);
+  EXPECT_EQ(step.parsed, 1u);
+  EXPECT_EQ(mgr.getTask(2)->state, Status::Completed);
+  EXPECT_EQ(mgr.getTask(2)->title, "Draft quarterly report");
+  EXPECT_EQ(contents(mgr), fresh());
+
+  // A full save that adds, removes and unblocks: the rest is not parsed again
+  TaskManager saver;
+  ASSERT_TRUE(saver.loadFromFile(path));
+  saver.addTask("Pack bags", Priority::Low);
+  ASSERT_TRUE(saver.removeTask(2));
+  ASSERT_TRUE(saver.completeTask(1));
+  ASSERT_EQ(saver.saveIfUnchanged(path), TaskManager::SaveResult::Saved);
+  step = follower.refresh(mgr);
+  EXPECT_EQ(step.kind, StoreFollower::Refresh::Kind::Diff);
+  EXPECT_LT(step.parsed, saver.size());
+  EXPECT_FALSE(mgr.getTask(2).has_value());
+  EXPECT_EQ(mgr.getTask(5)->title, "Pack bags");
+  EXPECT_TRUE(mgr.blockedTasks().empty());
+  EXPECT_EQ(mgr.size(), 4u);
+  EXPECT_EQ(mgr.count(Status::Pending), 3u);
+  EXPECT_EQ(contents(mgr), fresh());
+
+  // Adding after the refresh takes the next free id
+  EXPECT_EQ(mgr.addTask("Water plants", Priority::Low), 6);
+  remove_store(path);
+}
+
+TEST(StoreFollower, WaitWakesOnWritesToTheStoreOnly) {
+  string path = temp_store("follow_wait_tasks.json");
+  remove_store(path);
+  {
+    TaskManager out;
+    out.addTask("Draft report", Priority::Low);
+    ASSERT_TRUE(out.saveToFile(path));
+  }
+  StoreFollower follower(path);
+  TaskManager mgr;
+  ASSERT_TRUE(follower.load(mgr));
+  EXPECT_FALSE(follower.wait(0));
+  ofstream(path + ".unrelated") << "x";
+  EXPECT_FALSE(follower.wait(10));
+
+  TaskManager writer;
+  ASSERT_TRUE(writer.loadFromFile(path));
+  ASSERT_TRUE(writer.updateTask(1, {"Draft quarterly report", nullopt, nullopt}));
+  ASSERT_EQ(writer.saveTaskIfUnchanged(path, 1), TaskManager::SaveResult::Saved);
+  EXPECT_TRUE(follower.wait(1000));
+  EXPECT_EQ(follower.refresh(mgr).kind, StoreFollower::Refresh::Kind::Journal);
+  EXPECT_EQ(mgr.getTask(1)->title, "Draft quarterly report");
+  filesystem::remove(path + ".unrelated");
+  remove_store(path);
+}
+
+/**
+ * @brief  Read a file back in kIoChunk pieces, all in flight at once, and
+ *         ask for a few bytes past its end.
+ */
+static IoJob read_back(IoRing &ring, int fd, string &into, int64_t &past_end) {
+  deque<IoRing::Op> reads;
+  for (size_t at = 0; at < into.size(); at += kIoChunk)
+    reads.push_back(ring.read(fd, span{into.data() + at, min(kIoChunk, into.size() - at)}, at));
+  string tail(16, '\0');
+  IoRing::Op past = ring.read(fd, span{tail}, into.size() - 5);
+  while (!reads.empty()) {
+    co_await std::move(reads.front());
+    reads.pop_front();
+  }
+  past_end = co_await std::move(past);
+}
+
+TEST(AsyncIo, WritesAndReadsBackThroughBothBackends) {
+  string path = temp_store("async_io.bin");
+  string data(3 * kIoChunk + 12345, '\0');
+  mt19937 rng(11);
+  for (char &c : data)
+    c = static_cast<char>(rng());
+
+  for (bool threads : {false, true}) {
+    if (threads)
+      setenv("TODO_IO", "threads", 1);
+    IoRing ring;
+    EXPECT_TRUE(!threads || !ring.kernel());
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    AsyncWriter out(ring, fd);
+    for (size_t at = 0; at < data.size(); at += 1000) {
+      out.pending().append(data, at, 1000);
+      out.submit();
+    }
+    EXPECT_EQ(out.size(), data.size());
+    ASSERT_TRUE(out.finish());
+    EXPECT_EQ(filesystem::file_size(path), data.size());
+
+    string back(data.size(), '\0');
+    int64_t past_end = 0;
+    IoJob job = read_back(ring, fd, back, past_end);
+    EXPECT_TRUE(ring.run(job));
+    EXPECT_TRUE(job.done());
+    EXPECT_EQ(back, data);
+    EXPECT_EQ(past_end, 5);
+
+    // Errors come back as -errno rather than bytes
+    IoRing::Op bad = ring.read(-1, span{back.data(), 16}, 0);
+    EXPECT_EQ(ring.wait(bad), -EBADF);
+    close(fd);
+    unsetenv("TODO_IO");
+  }
+  filesystem::remove(path);
+}
+
+TEST(Persistence, PipelinedLoadMatchesAcrossThreadCountsAndBackends) {
+  string path = temp_store("pipelined_tasks.json");
+  remove_store(path);
+  TaskManager out;
+  out.setTaskLimit(100000);
+  for (int i = 0; i < 12000; ++i)
+    out.addTask("Task number " + to_string(i) + string(200 + i % 200, 'x'), static_cast<Priority>(i % 4),
+                i % 3 ? optional<ymd>{ymd(2030y, chrono::March, chrono::day(1 + i % 28))} : nullopt);
+  for (int id = 5; id <= 12000; id += 150)
+    out.completeTask(id);
+  ASSERT_TRUE(out.addDependency(2, 1));
+  ASSERT_TRUE(out.saveToFile(path));
+  ASSERT_GT(filesystem::file_size(path), kIoChunk);
+
+  for (const char *backend : {"", "threads"}) {
+    setenv("TODO_IO", backend, 1);
+    for (unsigned threads : {1u, 3u}) {
+      TaskManager in;
+      in.setTaskLimit(100000);
+      ASSERT_TRUE(in.loadFromFile(path, threads));
+      EXPECT_EQ(in.size(), out.size());
+      EXPECT_EQ(in.count(Status::Completed), out.count(Status::Completed));
+      EXPECT_EQ(contents(in), contents(out));
+    }
+  }
+  unsetenv("TODO_IO");
+  remove_store(path);
+}
+
+TEST(Persistence, FailedReissueFailsTheLoadInsteadOfTruncatingIt) {
+  string path = temp_store("reissue_tasks.json");
+  remove_store(path);
+  TaskManager out;
+  out.setTaskLimit(100000);
+  for (int i = 0; i < 12000; ++i)
+    out.addTask("Task number " + to_string(i) + string(200 + i % 200, 'x'));
+  ASSERT_TRUE(out.saveToFile(path));
+  ASSERT_GT(filesystem::file_size(path), kIoChunk);
+
+  // Every read comes back short; the reissues carry it to the end...
+  for (const char *backend : {"", "threads"}) {
+    setenv("TODO_IO", backend, 1);
+    for (unsigned threads : {1u, 3u}) {
+      IoRing::inject({size_t{64} << 10, nullopt});
+      TaskManager in;
+      in.setTaskLimit(100000);
+      EXPECT_TRUE(in.loadFromFile(path, threads));
+      EXPECT_EQ(in.size(), out.size());
+
+      // ...until one cannot be handed over, which fails the whole load
+      IoRing::inject({size_t{64} << 10, 5u});
+      TaskManager cut;
+      cut.setTaskLimit(100000);
+      EXPECT_FALSE(cut.loadFromFile(path, threads)) << backend << " " << threads;
+      EXPECT_EQ(cut.size(), 0u);
+    }
+  }
+  IoRing::inject({});
+  unsetenv("TODO_IO");
+  remove_store(path);
+}
+
+TEST(LoadGen, TraceFollowsTheMixAndRoundTrips) {
+  LoadProfile profile;
+  profile.preload = 1000;
+  profile.ops = 20000;
+  Trace trace = generate_trace(profile);
+  ASSERT_EQ(trace.entries.size(), profile.ops);
+
+  array<size_t, kLoadOpCount> seen{};
+  int next_add = 1001;
+  for (size_t i = 0; i < trace.entries.size(); ++i) {
+    const TraceEntry &entry = trace.entries[i];
+    ++seen[static_cast<size_t>(entry.op)];
+    if (i > 0) {
+      EXPECT_LE(trace.entries[i - 1].at_us, entry.at_us);
+    }
+    if (entry.op == LoadOp::Add) {
+      EXPECT_EQ(entry.id, next_add++);
+    } else if (entry.op == LoadOp::List) {
+      EXPECT_EQ(entry.id, profile.list_rows);
+    } else {
+      EXPECT_TRUE(entry.id >= 1 && entry.id < next_add);
+    }
+  }
+  for (size_t op = 0; op < kLoadOpCount; ++op)
+    EXPECT_NEAR(seen[op] / double(profile.ops), profile.mix[op] / 100, 0.02) << load_op_name(LoadOp(op));
+
+  // Bursts put the mean rate between the base and the burst rate
+  double rate = profile.ops / (trace.entries.back().at_us / 1e6);
+  EXPECT_GT(rate, profile.rate * 1.1);
+  EXPECT_LT(rate, profile.rate * profile.burst);
+
+  string path = temp_store("loadgen.trace");
+  ASSERT_TRUE(write_trace(path, trace));
+  optional<Trace> back = read_trace(path);
+  ASSERT_TRUE(back.has_value());
+  EXPECT_EQ(back->preload, trace.preload);
+  EXPECT_EQ(back->entries, trace.entries);
+  {
+    ofstream bad(path, ios::app);
+    bad << "12 frobnicate 3\n";
+  }
+  EXPECT_FALSE(read_trace(path).has_value());
+  filesystem::remove(path);
+}
+
+TEST(LoadGen, ZipfRanksFallOffAsAPowerLaw) {
+  mt19937_64 rng(3);
+  for (double s : {0.0, 0.99, 1.5}) {
+    ZipfSampler zipf(s);
+    vector<size_t> hits(1000);
+    for (int i = 0; i < 200000; ++i) {
+      uint64_t rank = zipf(rng, hits.size());
+      ASSERT_LT(rank, hits.size());
+      ++hits[rank];
+    }
+    // P(0) / P(r) = (r + 1)^s
+    for (size_t r : {1, 3, 9})
+      EXPECT_NEAR(double(hits[0]) / hits[r], pow(r + 1.0, s), pow(r + 1.0, s) * 0.25) << s << " " << r;
+  }
+  EXPECT_EQ(ZipfSampler(0.99)(rng, 1), 0u);
+}
+
+TEST(LoadGen, ReplayTimesEveryOperationAgainstTheManager) {
+  LoadProfile profile;
+  profile.preload = 500;
+  profile.ops = 3000;
+  Trace trace = generate_trace(profile);
+
+  TaskManager mgr;
+  mgr.setTaskLimit(SIZE_MAX);
+  preload_tasks(mgr, trace.preload);
+  ASSERT_EQ(mgr.size(), trace.preload);
+  LoadReport report = replay_trace(trace, mgr);
+  EXPECT_EQ(report.ops, trace.entries.size());
+  EXPECT_GT(report.throughput(), 0);
+
+  array<size_t, kLoadOpCount> seen{};
+  for (const TraceEntry &entry : trace.entries)
+    ++seen[static_cast<size_t>(entry.op)];
+  for (size_t op = 0; op < kLoadOpCount; ++op) {
+    const OpLatency &stats = report.per_op[op];
+    EXPECT_EQ(stats.count, seen[op]);
+    EXPECT_LE(stats.p50, stats.p99);
+    EXPECT_LE(stats.p99, stats.p999);
+    EXPECT_LE(stats.p999, stats.max);
+  }
+  const auto &ops = report.per_op;
+  EXPECT_EQ(ops[size_t(LoadOp::Add)].misses, 0u);
+  EXPECT_EQ(ops[size_t(LoadOp::List)].misses, 0u);
+  size_t removed = ops[size_t(LoadOp::Remove)].count - ops[size_t(LoadOp::Remove)].misses;
+  EXPECT_EQ(mgr.size(), trace.preload + seen[size_t(LoadOp::Add)] - removed);
+
+  // Against a manager that already holds tasks, adds land on other ids and
+  // later operations follow them
+  TaskManager busy;
+  busy.setTaskLimit(SIZE_MAX);
+  busy.addTask("Already here");
+  preload_tasks(busy, trace.preload);
+  LoadReport shifted = replay_trace(trace, busy, 2);
+  EXPECT_EQ(shifted.ops, trace.entries.size());
+  EXPECT_EQ(shifted.per_op[size_t(LoadOp::Add)].misses, 0u);
+}